@@ -351,14 +351,9 @@ namespace tavernmx::client
             requires std::forward_iterator<Iterator> && std::same_as<std::iter_value_t<Iterator>, rooms::ClientRoomEvent>
         void rewrite_chat_history(const std::string& room_name, Iterator begin, Iterator end) {
             std::lock_guard lock_guard{ this->chat_history_mutex };
-            if (this->chat_room_history.contains(room_name)) {
-                this->chat_room_history[room_name] = {};
-            } else {
-                this->chat_room_history[room_name].reset();
-            }
-            for (auto it = begin; it != end; ++it) {
-                this->chat_room_history[room_name].insert(std::move(*it));
-            }
+            auto& history = this->chat_room_history[room_name];
+            history.reset();
+            history.insert_range(std::make_move_iterator(begin), std::make_move_iterator(end));
             this->reset_scroll_pos = room_name == this->current_room_name;
         }
 
@@ -132,9 +132,9 @@ namespace tavernmx::client
     {
     public:
         /// Queue for messages received from the server.
-        std::shared_ptr<ThreadSafeQueue<messaging::Message>> messages_in;
+        std::shared_ptr<SpscQueue<messaging::Message>> messages_in;
         /// Queue for messages to be sent to the server.
-        std::shared_ptr<ThreadSafeQueue<messaging::Message>> messages_out;
+        std::shared_ptr<MpscQueue<messaging::Message>> messages_out;
 
         /**
          * @brief Creates a ServerConnection that will connect to \p host_name on TCP port \p host_port.
@@ -0,0 +1,513 @@
+#pragma once
+
+#include <concepts>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include "messaging.h"
+
+namespace tavernmx::messaging
+{
+	/**
+     * @brief Minimal msgpack primitives used by the typed message codec. Integers and containers are
+     * written with the smallest representation, matching nlohmann::json::to_msgpack(), so typed and
+     * JSON-encoded messages produce identical bytes.
+     */
+	namespace msgpack
+	{
+		/**
+         * @brief Appends a signed integer to \p output.
+         * @param output Byte buffer to append to.
+         * @param value Integer value.
+         */
+		void write_int(std::vector<CharType>& output, int64_t value);
+
+		/**
+         * @brief Appends a string to \p output.
+         * @param output Byte buffer to append to.
+         * @param value String value.
+         */
+		void write_string(std::vector<CharType>& output, std::string_view value);
+
+		/**
+         * @brief Appends an array header for \p count elements to \p output.
+         * @param output Byte buffer to append to.
+         * @param count Number of elements that will follow.
+         */
+		void write_array_header(std::vector<CharType>& output, size_t count);
+
+		/**
+         * @brief Appends a map header for \p count key/value pairs to \p output.
+         * @param output Byte buffer to append to.
+         * @param count Number of key/value pairs that will follow.
+         */
+		void write_map_header(std::vector<CharType>& output, size_t count);
+
+		/**
+         * @brief Sequential reader over msgpack-encoded bytes. Every read method returns false (and leaves
+         * the reader in an unspecified position) if the next value isn't of the requested type or the
+         * data is truncated.
+         */
+		class Reader
+		{
+		public:
+			/**
+             * @brief Creates a Reader over \p data.
+             * @param data msgpack bytes. Must outlive the Reader.
+             */
+			explicit Reader(std::span<const CharType> data) noexcept : data{ data } {};
+
+			bool read_int(int64_t& value);
+			bool read_string(std::string_view& value);
+			bool read_array_header(size_t& count);
+			bool read_map_header(size_t& count);
+
+			/**
+             * @brief Skips over the next value, including any nested values.
+             * @return true if a complete value was skipped.
+             */
+			bool skip();
+
+			/**
+             * @brief Returns the bytes of the next value without decoding it, and moves past it.
+             * @param value Receives a view of the encoded value.
+             * @return true if a complete value was read.
+             */
+			bool read_raw(std::span<const CharType>& value);
+
+			/**
+             * @brief Checks if all data has been read.
+             * @return true if there are no more bytes.
+             */
+			bool at_end() const { return this->pos == this->data.size(); }
+
+		private:
+			std::span<const CharType> data;
+			size_t pos{ 0 };
+
+			bool read_bytes(size_t count, std::span<const CharType>& bytes);
+			bool read_uint(size_t size, uint64_t& value);
+			bool skip_values(size_t count);
+		};
+	}
+
+	/**
+     * @brief Associates a msgpack key with a data member of a typed message.
+     * @tparam T Owning struct.
+     * @tparam M Member type.
+     */
+	template <typename T, typename M>
+	struct Field
+	{
+		/// Key used on the wire.
+		std::string_view name;
+		/// Pointer to the data member.
+		M T::* member;
+	};
+
+	/**
+     * @brief Helper to build a Field with deduced types.
+     * @param name Key used on the wire.
+     * @param member Pointer to the data member.
+     * @return Field<T, M>
+     */
+	template <typename T, typename M>
+	constexpr Field<T, M> field(std::string_view name, M T::* member) {
+		return Field<T, M>{ name, member };
+	}
+
+	/**
+     * @brief A struct whose msgpack encoding is generated from a static fields() table.
+     * @note Fields must be listed in ascending key order, which is the order nlohmann::json writes object keys.
+     */
+	template <typename T>
+	concept FieldRecord = std::default_initializable<T> && requires { T::fields(); };
+
+	/**
+     * @brief A FieldRecord that is the body of a specific MessageType.
+     */
+	template <typename T>
+	concept TypedMessage = FieldRecord<T> && requires {
+		{ T::MESSAGE_TYPE } -> std::convertible_to<MessageType>;
+	};
+
+	/// Values of a NAK message.
+	struct Nak
+	{
+		static constexpr MessageType MESSAGE_TYPE = MessageType::NAK;
+		/// Optional error message.
+		std::string error{};
+
+		static constexpr auto fields() { return std::make_tuple(field("error", &Nak::error)); }
+	};
+
+	/// Values of a HELLO message.
+	struct Hello
+	{
+		static constexpr MessageType MESSAGE_TYPE = MessageType::HELLO;
+		/// User name.
+		std::string user_name{};
+
+		static constexpr auto fields() { return std::make_tuple(field("user_name", &Hello::user_name)); }
+	};
+
+	/// Values of a ROOM_CREATE message.
+	struct RoomCreate
+	{
+		static constexpr MessageType MESSAGE_TYPE = MessageType::ROOM_CREATE;
+		/// The room's unique name.
+		std::string room_name{};
+
+		static constexpr auto fields() { return std::make_tuple(field("room_name", &RoomCreate::room_name)); }
+	};
+
+	/// Values of a ROOM_JOIN message.
+	struct RoomJoin
+	{
+		static constexpr MessageType MESSAGE_TYPE = MessageType::ROOM_JOIN;
+		/// The room's unique name.
+		std::string room_name{};
+
+		static constexpr auto fields() { return std::make_tuple(field("room_name", &RoomJoin::room_name)); }
+	};
+
+	/// Values of a ROOM_DESTROY message.
+	struct RoomDestroy
+	{
+		static constexpr MessageType MESSAGE_TYPE = MessageType::ROOM_DESTROY;
+		/// The room's unique name.
+		std::string room_name{};
+
+		static constexpr auto fields() { return std::make_tuple(field("room_name", &RoomDestroy::room_name)); }
+	};
+
+	/// A single event inside a ROOM_HISTORY message.
+	struct RoomHistoryEvent
+	{
+		/// Line of chat text.
+		std::string text{};
+		/// Time of the event, in seconds from epoch.
+		int32_t timestamp{};
+		/// Origin user name.
+		std::string user_name{};
+
+		static constexpr auto fields() {
+			return std::make_tuple(field("text", &RoomHistoryEvent::text),
+				field("timestamp", &RoomHistoryEvent::timestamp), field("user_name", &RoomHistoryEvent::user_name));
+		}
+	};
+
+	/// Values of a ROOM_HISTORY message.
+	struct RoomHistory
+	{
+		static constexpr MessageType MESSAGE_TYPE = MessageType::ROOM_HISTORY;
+		/// Requested maximum, or actual count, of events.
+		int32_t event_count{};
+		/// Events being delivered, oldest first. Empty for a request.
+		std::vector<RoomHistoryEvent> events{};
+		/// The room's unique name.
+		std::string room_name{};
+
+		static constexpr auto fields() {
+			return std::make_tuple(field("event_count", &RoomHistory::event_count),
+				field("events", &RoomHistory::events), field("room_name", &RoomHistory::room_name));
+		}
+	};
+
+	/// Values of a CHAT_SEND message.
+	struct ChatSend
+	{
+		static constexpr MessageType MESSAGE_TYPE = MessageType::CHAT_SEND;
+		/// Target room name.
+		std::string room_name{};
+		/// Line of chat text.
+		std::string text{};
+
+		static constexpr auto fields() {
+			return std::make_tuple(field("room_name", &ChatSend::room_name), field("text", &ChatSend::text));
+		}
+	};
+
+	/// Values of a CHAT_ECHO message.
+	struct ChatEcho
+	{
+		static constexpr MessageType MESSAGE_TYPE = MessageType::CHAT_ECHO;
+		/// Origin room name.
+		std::string room_name{};
+		/// Line of chat text.
+		std::string text{};
+		/// Number of seconds since epoch when the event occurred.
+		int32_t timestamp{};
+		/// Origin user name.
+		std::string user_name{};
+
+		static constexpr auto fields() {
+			return std::make_tuple(field("room_name", &ChatEcho::room_name), field("text", &ChatEcho::text),
+				field("timestamp", &ChatEcho::timestamp), field("user_name", &ChatEcho::user_name));
+		}
+	};
+
+	/// Values of a CHAT_MISSED message.
+	struct ChatMissed
+	{
+		static constexpr MessageType MESSAGE_TYPE = MessageType::CHAT_MISSED;
+		/// Number of chat events the client missed.
+		int32_t event_count{};
+
+		static constexpr auto fields() { return std::make_tuple(field("event_count", &ChatMissed::event_count)); }
+	};
+
+	namespace detail
+	{
+		template <FieldRecord T>
+		consteval bool fields_are_sorted() {
+			return std::apply(
+				[](const auto&... fields) {
+					std::string_view previous{};
+					bool sorted = true;
+					((sorted = sorted && previous < fields.name, previous = fields.name), ...);
+					return sorted;
+				},
+				T::fields());
+		}
+
+		template <typename T>
+		struct is_vector : std::false_type
+		{
+		};
+
+		template <typename T>
+		struct is_vector<std::vector<T>> : std::true_type
+		{
+		};
+
+		template <typename V>
+		void write_value(std::vector<CharType>& output, const V& value);
+
+		template <typename V>
+		bool read_value(msgpack::Reader& reader, V& value);
+
+		template <FieldRecord T>
+		void write_record(std::vector<CharType>& output, const T& record) {
+			static_assert(fields_are_sorted<T>(), "fields() must be listed in ascending key order");
+			std::apply(
+				[&output, &record](const auto&... fields) {
+					msgpack::write_map_header(output, sizeof...(fields));
+					((msgpack::write_string(output, fields.name), write_value(output, record.*(fields.member))), ...);
+				},
+				T::fields());
+		}
+
+		template <FieldRecord T>
+		bool read_record(msgpack::Reader& reader, T& record) {
+			size_t count = 0;
+			if (!reader.read_map_header(count)) {
+				return false;
+			}
+			for (size_t i = 0; i < count; ++i) {
+				std::string_view key{};
+				if (!reader.read_string(key)) {
+					return false;
+				}
+				bool matched = false;
+				bool ok = true;
+				std::apply(
+					[&](const auto&... fields) {
+						((!matched && fields.name == key
+								 ? (matched = true, ok = read_value(reader, record.*(fields.member)))
+								 : false),
+							...);
+					},
+					T::fields());
+				if (!matched) {
+					ok = reader.skip();
+				}
+				if (!ok) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		template <typename V>
+		void write_value(std::vector<CharType>& output, const V& value) {
+			if constexpr (std::is_same_v<V, std::string>) {
+				msgpack::write_string(output, value);
+			} else if constexpr (std::is_integral_v<V>) {
+				msgpack::write_int(output, value);
+			} else if constexpr (is_vector<V>::value) {
+				msgpack::write_array_header(output, value.size());
+				for (const auto& element : value) {
+					write_value(output, element);
+				}
+			} else {
+				static_assert(FieldRecord<V>, "unsupported field type");
+				write_record(output, value);
+			}
+		}
+
+		template <typename V>
+		bool read_value(msgpack::Reader& reader, V& value) {
+			if constexpr (std::is_same_v<V, std::string>) {
+				std::string_view view{};
+				if (!reader.read_string(view)) {
+					return false;
+				}
+				value.assign(view);
+				return true;
+			} else if constexpr (std::is_integral_v<V>) {
+				int64_t number = 0;
+				if (!reader.read_int(number)) {
+					return false;
+				}
+				value = static_cast<V>(number);
+				return true;
+			} else if constexpr (is_vector<V>::value) {
+				size_t count = 0;
+				if (!reader.read_array_header(count)) {
+					return false;
+				}
+				value.clear();
+				value.reserve(count);
+				for (size_t i = 0; i < count; ++i) {
+					if (!read_value(reader, value.emplace_back())) {
+						return false;
+					}
+				}
+				return true;
+			} else {
+				static_assert(FieldRecord<V>, "unsupported field type");
+				return read_record(reader, value);
+			}
+		}
+	}
+
+	/**
+     * @brief Appends the msgpack encoding of the values of \p message to \p output. Found by
+     * MessagePacker::add() through argument-dependent lookup.
+     * @tparam T TypedMessage
+     * @param output Byte buffer to append to.
+     * @param message Typed message values.
+     */
+	template <TypedMessage T>
+	void encode_values(std::vector<CharType>& output, const T& message) {
+		detail::write_record(output, message);
+	}
+
+	/**
+     * @brief A message inside a decoded MessageBlock whose values haven't been parsed yet.
+     */
+	struct MessageView
+	{
+		/// The type of message sent.
+		MessageType message_type{ MessageType::Invalid };
+		/// msgpack bytes of the message values. Refers into the MessageBlock payload.
+		std::span<const CharType> values{};
+	};
+
+	/**
+     * @brief Splits \p block into its messages without parsing their values.
+     * @param block MessageBlock
+     * @return std::vector<MessageView> referring into \p block, which must outlive the result.
+     * @note Stops at the first malformed message.
+     */
+	std::vector<MessageView> view_messages(const MessageBlock& block);
+
+	/**
+     * @brief Parses the values of \p view into a (JSON) Message.
+     * @param view MessageView
+     * @return Message
+     */
+	Message to_message(const MessageView& view);
+
+	/**
+     * @brief Decodes the values of \p view into the typed message T.
+     * @tparam T TypedMessage matching view.message_type.
+     * @param view MessageView
+     * @return T, or empty if the type doesn't match or the values are malformed.
+     * @note Unknown keys are ignored and missing keys keep their default value.
+     */
+	template <TypedMessage T>
+	std::optional<T> decode_message(const MessageView& view) {
+		if (view.message_type != T::MESSAGE_TYPE) {
+			return std::nullopt;
+		}
+		msgpack::Reader reader{ view.values };
+		T message{};
+		if (!detail::read_record(reader, message)) {
+			return std::nullopt;
+		}
+		return message;
+	}
+
+	/**
+     * @brief Converts a typed message into a (JSON) Message.
+     * @tparam T TypedMessage
+     * @param message Typed message values.
+     * @return Message
+     */
+	template <TypedMessage T>
+	Message to_message(const T& message) {
+		std::vector<CharType> values{};
+		encode_values(values, message);
+		return Message{ .message_type = T::MESSAGE_TYPE, .values = json::from_msgpack(values) };
+	}
+
+	/**
+     * @brief Converts a (JSON) Message into the typed message T.
+     * @tparam T TypedMessage matching message.message_type.
+     * @param message Message
+     * @return T, or empty if the type doesn't match or the values don't fit T.
+     */
+	template <TypedMessage T>
+	std::optional<T> from_message(const Message& message) {
+		const std::vector<CharType> values = json::to_msgpack(message.values);
+		return decode_message<T>(MessageView{ .message_type = message.message_type, .values = values });
+	}
+
+	/**
+     * @brief Packs a typed \p message into a MessageBlock struct.
+     * @tparam T TypedMessage
+     * @param message Typed message values.
+     * @return MessageBlock
+     */
+	template <TypedMessage T>
+	MessageBlock pack_message(const T& message) {
+		MessagePacker packer{};
+		packer.add(message);
+		return packer.finish();
+	}
+
+	/**
+     * @brief Packs a typed \p message into a shareable Frame.
+     * @tparam T TypedMessage
+     * @param message Typed message values.
+     * @return Frame
+     */
+	template <TypedMessage T>
+	Frame make_frame(const T& message) {
+		MessagePacker packer{};
+		packer.add(message);
+		return packer.finish_frame();
+	}
+
+	/**
+     * @brief Packs zero or more typed \p messages into a MessageBlock struct.
+     * @tparam Iterator Forward iterator of typed messages.
+     * @param begin Beginning of the range of typed messages to pack.
+     * @param end End of the range of typed messages to pack.
+     * @return MessageBlock
+     */
+	template <class Iterator>
+		requires std::forward_iterator<Iterator> && TypedMessage<std::iter_value_t<Iterator>>
+	MessageBlock pack_messages(Iterator begin, Iterator end) {
+		MessagePacker packer{};
+		for (auto it = begin; it != end; ++it) {
+			packer.add(*it);
+		}
+		return packer.finish();
+	}
+}
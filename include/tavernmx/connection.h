@@ -78,25 +78,53 @@ namespace tavernmx
          * @brief Attempts to read a message from the server, if one is waiting.
          * @return a tavernmx::messaging::MessageBlock if a well-formed message block was read, otherwise empty
          * @throws TransportError if a network error occurs
+         * @note Bytes belonging to further blocks are kept for subsequent calls.
          */
         std::optional<messaging::MessageBlock> receive_message();
 
         /**
-         * @brief Attempts to send a message block to the server.
+         * @brief Reads everything waiting on the socket and returns all complete message blocks.
+         * @return zero or more tavernmx::messaging::MessageBlock values, in the order received
+         * @throws TransportError if a network error occurs
+         * @note A partially received block is kept until the rest of it arrives.
+         */
+        std::vector<messaging::MessageBlock> receive_messages();
+
+        /**
+         * @brief Queues a message block to the server and writes as much as the socket will accept.
          * @param block block of data to send
          * @throws TransportError if a network error occurs
+         * @note Does not block. Anything the socket can't take right now stays queued until the next
+         * call that sends or flushes.
          */
         void send_message_block(const messaging::MessageBlock& block);
 
         /**
-         * @brief Attempts to send a single message to the server.
+         * @brief Sends an already-encoded \p frame, writing as much as the socket will accept.
+         * @param frame tavernmx::messaging::Frame
+         * @throws TransportError if a network error occurs
+         * @note If nothing else is queued, the frame is written straight from its shared buffer and only
+         * an unsent remainder is copied into the outbound queue.
+         */
+        void send_frame(const messaging::Frame& frame);
+
+        /**
+         * @brief Copies an already-encoded \p frame into the outbound queue without writing anything, so a run
+         * of small frames can go out together with the next flush_outbound().
+         * @param frame tavernmx::messaging::Frame
+         */
+        void buffer_frame(const messaging::Frame& frame) { this->outbound.append(*frame); }
+
+        /**
+         * @brief Queues a single message to the server and writes as much as the socket will accept.
          * @param message tavernmx::messaging::Message
          * @throws TransportError if a network error occurs
          */
         void send_message(const messaging::Message& message);
 
         /**
-         * @brief Attempts to send zero or more messages to the server.
+         * @brief Queues zero or more messages to the server as a single block and writes as much as the
+         * socket will accept. If the range is empty, any previously queued data is still flushed.
          * @param begin start of range pointing to Message values
          * @param end end of range pointing to Message values
          * @throws TransportError if a network error occurs
@@ -105,12 +133,14 @@ namespace tavernmx
             requires std::forward_iterator<Iterator> && std::same_as<std::iter_value_t<Iterator>, messaging::Message>
         void send_messages(Iterator begin, Iterator end) {
             if (begin != end) {
-                this->send_message_block(messaging::pack_messages(begin, end));
+                this->outbound.append(messaging::pack_messages(begin, end));
             }
+            this->flush_outbound();
         };
 
         /**
-         * @brief Attempts to send zero or more message blocks to the server.
+         * @brief Queues zero or more message blocks to the server and writes them together, as much as
+         * the socket will accept.
          * @param begin start of range pointing to MessageBlock& values
          * @param end end of range pointing to MessageBlock& values
          * @throws TransportError if a network error occurs
@@ -120,10 +150,30 @@ namespace tavernmx
                          messaging::MessageBlock>
         void send_message_blocks(Iterator begin, Iterator end) {
             for (auto it = begin; it != end; ++it) {
-                this->send_message_block(*it);
+                this->outbound.append(*it);
             }
+            this->flush_outbound();
         };
 
+        /**
+         * @brief Writes as much queued outbound data as the socket will currently accept.
+         * @return true if all queued data has been written, otherwise false.
+         * @throws TransportError if a network error occurs
+         */
+        bool flush_outbound();
+
+        /**
+         * @brief Returns the number of queued bytes that haven't been written to the socket yet.
+         * @return size_t
+         */
+        size_t outbound_size() const { return this->outbound.size(); }
+
+        /**
+         * @brief Gets the socket descriptor underlying the connection, e.g. to watch it with a Reactor.
+         * @return socket descriptor, or -1 if there is no socket
+         */
+        int32_t get_socket() const { return ssl::get_fd(this->bio.get()); }
+
         /**
          * @brief Tests if the connection to the server is active.
          * @return true if the socket is connected to the server, otherwise false
@@ -161,5 +211,11 @@ namespace tavernmx
 
     protected:
         ssl::ssl_unique_ptr<BIO> bio{ nullptr };
+
+    private:
+        messaging::MessageBlockDecoder decoder{};
+        messaging::OutboundBuffer outbound{};
+
+        void receive_bytes();
     };
 }
@@ -0,0 +1,130 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <utility>
+
+namespace tavernmx
+{
+    /**
+     * @brief Shares a fixed budget of work per tick between any number of flows, such as client connections,
+     * using deficit round robin. Only flows with work waiting are kept, on an active list that persists between
+     * ticks; they are served in turn, each up to a quantum per round, so one busy flow can't hold up the others
+     * for longer than a quantum.
+     * @tparam Key Identifies a flow. Must be equality comparable.
+     * @note A flow cut short because the tick's budget ran out keeps the credit it didn't use, and the next
+     * tick starts with the flow after it, so busy flows still share the budget evenly over many ticks. A flow
+     * that runs out of work leaves the active list and forfeits its credit, so idle flows can't bank it for
+     * later, and cost nothing until they are activated again.
+     */
+    template <typename Key>
+    class DeficitRoundRobin
+    {
+    public:
+        /**
+         * @brief Creates a DeficitRoundRobin.
+         * @param quantum Units of work each flow may do per round (at least 1).
+         * @param tick_budget Units of work done across all flows per call to run() (at least 1).
+         */
+        DeficitRoundRobin(size_t quantum, size_t tick_budget)
+            : quantum{ std::max<size_t>(quantum, 1) }, tick_budget{ std::max<size_t>(tick_budget, 1) } {
+        }
+
+        /**
+         * @brief Adds \p flow, which has work waiting, to the back of the active list with no credit.
+         * @param flow The flow.
+         * @note The caller keeps track of which flows are active: a flow must not be activated again until
+         * run() has seen it run out of work. A flow the last tick cut short stays at the very back, since the
+         * flows after it, new ones included, have their turn before it spends its leftover credit.
+         */
+        void activate(Key flow) {
+            const auto position = this->resume_last ? std::prev(this->active.end()) : this->active.end();
+            this->active.insert(position, ActiveFlow{ .key = std::move(flow), .deficit = 0 });
+        }
+
+        /**
+         * @brief Runs one tick: serves the active flows in turn, a round at a time, until none of them has work
+         * left or the tick's budget is spent.
+         * @param serve Function taking (const Key&, size_t max_units), which does up to max_units units of work
+         * for the flow and returns how many it did. Doing fewer than max_units means the flow has run out, and
+         * it leaves the active list.
+         * @return Units of work done.
+         */
+        template <typename Serve>
+        size_t run(Serve&& serve) {
+            this->resume_last = false;
+            size_t budget = this->tick_budget;
+            while (!this->active.empty() && budget > 0) {
+                // one round: every flow active at its start gets a turn, from the front of the list
+                for (size_t turns = this->active.size(); turns > 0 && budget > 0; --turns) {
+                    ActiveFlow& flow = this->active.front();
+                    flow.deficit += this->quantum;
+                    const size_t allowed = std::min(flow.deficit, budget);
+                    const size_t done = std::min(std::invoke(serve, std::as_const(flow.key), allowed), allowed);
+                    flow.deficit -= done;
+                    budget -= done;
+                    if (done < allowed) {
+                        this->active.pop_front();
+                        continue;
+                    }
+                    // to the back, so whether this round finishes or the budget ran out, the next turn is the
+                    // next flow's
+                    this->active.push_back(std::move(flow));
+                    this->active.pop_front();
+                }
+            }
+            this->resume_last = budget == 0;
+            return this->tick_budget - budget;
+        }
+
+        /**
+         * @brief Checks if any flow is still active, which after run() means the tick's budget ran out before
+         * every flow ran out of work.
+         * @return true if flows may still have work waiting, otherwise false.
+         */
+        bool has_backlog() const { return !this->active.empty(); }
+
+        /**
+         * @brief Returns the number of active flows.
+         * @return size_t
+         */
+        size_t size() const { return this->active.size(); }
+
+        /**
+         * @brief Gets the credit \p flow carries into the next tick.
+         * @param flow The flow.
+         * @return Units of work, 0 if the flow isn't active.
+         */
+        size_t deficit(const Key& flow) const {
+            const auto it = std::find_if(this->active.begin(), this->active.end(),
+                [&flow](const ActiveFlow& active_flow) { return active_flow.key == flow; });
+            return it == this->active.end() ? 0 : it->deficit;
+        }
+
+        /**
+         * @brief Gets the units of work each flow may do per round.
+         * @return size_t
+         */
+        size_t get_quantum() const { return this->quantum; }
+
+        /**
+         * @brief Gets the units of work done across all flows per tick.
+         * @return size_t
+         */
+        size_t get_tick_budget() const { return this->tick_budget; }
+
+    private:
+        struct ActiveFlow
+        {
+            Key key;
+            size_t deficit{};
+        };
+
+        size_t quantum;
+        size_t tick_budget;
+        std::deque<ActiveFlow> active{};
+        bool resume_last{ false };
+    };
+}
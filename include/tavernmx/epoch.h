@@ -0,0 +1,129 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
+
+#include "queue.h"
+
+namespace tavernmx
+{
+    /**
+     * @brief Epoch-based reclamation for containers with one writer and lock-free readers. Readers hold a
+     * ReadGuard while they follow pointers into the container; the writer retires whatever it unlinks and
+     * frees it only once every reader that could still hold it has left.
+     * @note Anything retired in epoch E was unlinked before E was read, so a reader can only hold it if it
+     * announced an epoch <= E. advance() moves the epoch on first, so readers arriving afterwards announce a
+     * later one and the oldest announcement bounds what can be freed.
+     */
+    class EpochDomain
+    {
+    public:
+        /// Maximum number of threads that can be reading at once. Further readers wait for a free slot.
+        static constexpr size_t MAX_READERS = 16;
+
+        /// Marks a reader active from construction to destruction, so nothing it can see is freed.
+        class ReadGuard
+        {
+        public:
+            explicit ReadGuard(const EpochDomain& domain) : reader_epoch{ &domain.claim_reader() } {
+            }
+
+            ~ReadGuard() { this->reader_epoch->store(0); }
+
+            ReadGuard(const ReadGuard&) = delete;
+
+            ReadGuard& operator=(const ReadGuard&) = delete;
+
+        private:
+            std::atomic<uint64_t>* reader_epoch;
+        };
+
+        /**
+         * @brief Returns the epoch to tag something with, once the writer has unlinked it.
+         * @return uint64_t
+         */
+        uint64_t current() const {
+            return this->epoch.load();
+        }
+
+        /**
+         * @brief Advances the epoch. Called by the writer only.
+         * @return The oldest epoch any active reader entered in; anything tagged with an earlier epoch can be freed.
+         */
+        uint64_t advance() {
+            uint64_t oldest_reader = this->epoch.fetch_add(1) + 1;
+            for (const std::atomic<uint64_t>& reader_epoch : this->reader_epochs) {
+                if (const uint64_t announced = reader_epoch.load(); announced != 0) {
+                    oldest_reader = std::min(oldest_reader, announced);
+                }
+            }
+            return oldest_reader;
+        }
+
+    private:
+        std::atomic<uint64_t> epoch{ 1 };
+        // epoch each active reader entered in, or 0 for a free slot
+        alignas(CACHE_LINE_SIZE) mutable std::array<std::atomic<uint64_t>, MAX_READERS> reader_epochs{};
+
+        /// Claims a reader slot, announcing the current epoch in it.
+        std::atomic<uint64_t>& claim_reader() const {
+            const size_t start = std::hash<std::thread::id>{}(std::this_thread::get_id());
+            for (;;) {
+                for (size_t i = 0; i < MAX_READERS; ++i) {
+                    std::atomic<uint64_t>& reader_epoch = this->reader_epochs[(start + i) % MAX_READERS];
+                    uint64_t expected = 0;
+                    if (reader_epoch.compare_exchange_strong(expected, this->epoch.load())) {
+                        return reader_epoch;
+                    }
+                }
+                std::this_thread::yield();
+            }
+        }
+    };
+
+    /**
+     * @brief Objects unlinked by the writer of an EpochDomain, oldest first, waiting to be freed.
+     * @tparam T Type of object retired.
+     * @note Writer only.
+     */
+    template <typename T>
+    class RetiredList
+    {
+    public:
+        /**
+         * @brief Takes ownership of \p item, which the writer has just unlinked.
+         * @param domain The domain readers of \p item announce themselves in.
+         * @param item The unlinked object.
+         */
+        void retire(const EpochDomain& domain, std::unique_ptr<T> item) {
+            this->retired.emplace_back(domain.current(), std::move(item));
+        }
+
+        /**
+         * @brief Frees everything retired before \p oldest_reader.
+         * @param oldest_reader Result of EpochDomain::advance().
+         */
+        void free_before(uint64_t oldest_reader) {
+            while (!this->retired.empty() && this->retired.front().first < oldest_reader) {
+                this->retired.pop_front();
+            }
+        }
+
+        /**
+         * @brief Returns the number of objects waiting to be freed.
+         * @return size_t
+         */
+        size_t size() const {
+            return this->retired.size();
+        }
+
+    private:
+        std::deque<std::pair<uint64_t, std::unique_ptr<T>>> retired{};
+    };
+}
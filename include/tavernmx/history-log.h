@@ -0,0 +1,261 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "queue.h"
+#include "room.h"
+
+namespace tavernmx::rooms
+{
+    /// Size at which a room's history log starts a new segment file.
+    constexpr size_t HISTORY_SEGMENT_SIZE = 8 * 1024 * 1024;
+    /// Bytes of log between entries in a segment's sparse index.
+    constexpr size_t HISTORY_INDEX_INTERVAL = 64 * 1024;
+
+    /**
+     * @brief Exception for history log errors.
+     */
+    class HistoryLogError : public std::exception
+    {
+    public:
+        /**
+         * @brief Create a new HistoryLogError.
+         * @param what (copied) description of the error
+         */
+        explicit HistoryLogError(std::string what) noexcept
+            : what_str{ std::move(what) } {
+        };
+
+        /**
+         * @brief Create a new HistoryLogError.
+         * @param what description of the error
+         */
+        explicit HistoryLogError(const char* what) noexcept
+            : what_str{ what } {
+        };
+
+        /**
+         * @brief Create a new HistoryLogError.
+         * @param what (copied) description of the error
+         * @param inner exception that caused this error
+         */
+        HistoryLogError(std::string what, const std::exception& inner) noexcept
+            : what_str{ std::move(what) } {
+            this->what_str += std::string{ ", caused by: " } + inner.what();
+        };
+
+        /**
+         * @brief Returns an explanatory string.
+         * @return pointer to a NULL-terminated string
+         */
+        const char* what() const noexcept override { return this->what_str.c_str(); }
+
+    private:
+        std::string what_str{};
+    };
+
+    /**
+     * @brief Append-only log of one chat room's events, stored in a directory of segment files.
+     * @note Each segment is named after the sequence number of its first event and has a sparse index
+     * (sequence, timestamp and offset every HISTORY_INDEX_INTERVAL bytes) alongside it. Only the last
+     * segment is ever written to. Opening the log checks the tail of that segment and truncates any
+     * partially written event left by a crash.
+     * @note Reads map segments into memory and use the index to skip straight to the events wanted, so
+     * the cost of reading the newest events doesn't depend on how long the log is.
+     * @note append(), sync() and remove() may be called from different threads. Reads must not overlap
+     * writes; they are meant for recovery, before any events are appended.
+     */
+    class RoomHistoryLog
+    {
+    public:
+        /**
+         * @brief Opens the log stored in \p directory, creating it if it doesn't exist yet.
+         * @param directory Directory holding the room's segment files.
+         * @param segment_size Size at which a new segment is started.
+         * @throws HistoryLogError if the log can't be opened or created
+         */
+        explicit RoomHistoryLog(std::filesystem::path directory, size_t segment_size = HISTORY_SEGMENT_SIZE);
+
+        ~RoomHistoryLog();
+
+        RoomHistoryLog(const RoomHistoryLog&) = delete;
+
+        RoomHistoryLog& operator=(const RoomHistoryLog&) = delete;
+
+        /**
+         * @brief Returns the number of events ever appended to this log, including any not yet synced.
+         * @return uint64_t
+         */
+        uint64_t event_count() const;
+
+        /**
+         * @brief Returns the number of segment files making up the log.
+         * @return size_t
+         */
+        size_t segment_count() const;
+
+        /**
+         * @brief Calls \p visitor with each of the newest \p count events that have been synced, oldest first.
+         * @param count Maximum number of events to read.
+         * @param visitor Function taking RoomEvent.
+         * @return Number of events read.
+         * @throws HistoryLogError if a segment can't be read
+         */
+        size_t read_last(size_t count, const std::function<void(RoomEvent)>& visitor) const;
+
+        /**
+         * @brief Calls \p visitor with each synced event whose timestamp is at least \p since, oldest first.
+         * @param since Earliest timestamp wanted.
+         * @param visitor Function taking RoomEvent.
+         * @return Number of events read.
+         * @throws HistoryLogError if a segment can't be read
+         * @note Timestamps are assumed to increase along the log; the index finds where to start.
+         */
+        size_t read_since(EventTimeStamp since, const std::function<void(RoomEvent)>& visitor) const;
+
+        /**
+         * @brief Buffers \p event to be written by the next sync(). Does nothing once the log is removed.
+         * @param event The event.
+         */
+        void append(const RoomEvent& event);
+
+        /**
+         * @brief Writes all buffered events and waits for them to reach the disk.
+         * @throws HistoryLogError if a write fails
+         */
+        void sync();
+
+        /**
+         * @brief Deletes the log's files. Buffered and later events are discarded.
+         */
+        void remove() noexcept;
+
+    private:
+        struct IndexEntry
+        {
+            uint64_t sequence{};
+            int64_t timestamp{};
+            uint64_t offset{};
+        };
+
+        struct Segment
+        {
+            uint64_t base_sequence{};
+            /// Bytes of complete, synced events.
+            uint64_t size{};
+            std::vector<IndexEntry> index{};
+        };
+
+        std::filesystem::path directory{};
+        size_t segment_size{};
+        std::vector<Segment> segments{};
+        /// Sequence number of the next event appended.
+        uint64_t next_sequence{ 0 };
+        /// Sequence number after the newest event that has been synced.
+        uint64_t synced_sequence{ 0 };
+        /// Encoded events and index entries not yet written to the last segment.
+        std::vector<char> pending_events{};
+        std::vector<IndexEntry> pending_index{};
+        uint64_t bytes_since_index{ HISTORY_INDEX_INTERVAL };
+        int32_t log_fd{ -1 };
+        int32_t index_fd{ -1 };
+        bool removed{ false };
+        mutable std::mutex log_mutex{};
+
+        void recover_last_segment();
+        void start_segment(uint64_t base_sequence);
+        void open_files();
+        void write_pending();
+        void close_files() noexcept;
+        std::filesystem::path segment_path(uint64_t base_sequence, const char* extension) const;
+        size_t read_from(size_t segment, uint64_t sequence, EventTimeStamp since,
+            const std::function<void(RoomEvent)>& visitor) const;
+    };
+
+    /**
+     * @brief Writes room history logs on a background thread, batching events so that many of them share
+     * each fsync (group commit). Chat never waits for the disk.
+     */
+    class HistoryLogWriter
+    {
+    public:
+        /**
+         * @brief Starts the writer for logs stored under \p root, one directory per room.
+         * @param root Directory holding all room logs. Created if it doesn't exist.
+         * @param segment_size Size at which logs start a new segment.
+         * @throws HistoryLogError if \p root can't be created
+         */
+        explicit HistoryLogWriter(std::filesystem::path root, size_t segment_size = HISTORY_SEGMENT_SIZE);
+
+        /**
+         * @brief Writes and syncs everything queued, then stops the background thread.
+         */
+        ~HistoryLogWriter();
+
+        HistoryLogWriter(const HistoryLogWriter&) = delete;
+
+        HistoryLogWriter& operator=(const HistoryLogWriter&) = delete;
+
+        /**
+         * @brief Lists the rooms that have a log on disk.
+         * @return std::vector of room names.
+         */
+        std::vector<std::string> room_names() const;
+
+        /**
+         * @brief Opens (or creates) the log for \p room_name. Any recovery happens on the calling thread.
+         * @param room_name The room's unique name. Must be a valid room name.
+         * @return std::shared_ptr<RoomHistoryLog>
+         * @throws HistoryLogError if the log can't be opened
+         */
+        std::shared_ptr<RoomHistoryLog> open(std::string_view room_name) const;
+
+        /**
+         * @brief Queues \p event to be appended to \p log and synced with the next batch.
+         * @param log The room's log.
+         * @param event The event.
+         * @note Thread safe.
+         */
+        void append(std::shared_ptr<RoomHistoryLog> log, RoomEvent event);
+
+        /**
+         * @brief Blocks until everything queued before the call has been synced.
+         */
+        void flush();
+
+        /**
+         * @brief Returns the number of fsync batches written so far.
+         * @return uint64_t
+         */
+        uint64_t batch_count() const { return this->batches.load(); }
+
+    private:
+        struct Entry
+        {
+            std::shared_ptr<RoomHistoryLog> log{};
+            RoomEvent event{};
+        };
+
+        std::filesystem::path root{};
+        size_t segment_size{};
+        MpscQueue<Entry> entries{};
+        std::atomic<bool> running{ true };
+        std::atomic<uint64_t> appended{ 0 };
+        std::atomic<uint64_t> synced{ 0 };
+        std::atomic<uint64_t> batches{ 0 };
+        std::mutex synced_mutex{};
+        std::condition_variable synced_cv{};
+        std::thread thread{};
+
+        void run();
+    };
+}
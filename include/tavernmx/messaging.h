@@ -1,7 +1,10 @@
 #pragma once
 
+#include <array>
 #include <cassert>
 #include <cstdint>
+#include <memory>
+#include <optional>
 #include <span>
 #include <string>
 #include <string_view>
@@ -24,7 +27,7 @@ namespace tavernmx::messaging
     struct MessageBlock
     {
         /// Header, for locating the start of a MessageBlock.
-        const CharType HEADER[4] = { 't', 'm', 'x', 0x02 };
+        static constexpr CharType HEADER[4] = { 't', 'm', 'x', 0x02 };
         /// Size in bytes of payload.
         uint32_t payload_size{ 0 };
         /// Payload data.
@@ -40,6 +43,12 @@ namespace tavernmx::messaging
         }
     };
 
+    /**
+     * @brief The complete wire bytes of a MessageBlock (header, payload size and payload). Frames are
+     * immutable once built, so a single encoding can be shared by every connection it is sent to.
+     */
+    using Frame = std::shared_ptr<const std::vector<CharType>>;
+
     /**
      * @brief Specific messages understood by client and server.
      */
@@ -77,8 +86,52 @@ namespace tavernmx::messaging
         CHAT_SEND = 0x4000,
         /// Server echoing a single line of chat to a room.
         CHAT_ECHO = 0x4001,
+        /// Server telling a client that fell behind how many chat echoes it missed; it should resync from ROOM_HISTORY.
+        CHAT_MISSED = 0x4002,
     };
 
+    /// Every MessageType that can be processed, i.e. all but MessageType::Invalid.
+    inline constexpr std::array ALL_MESSAGE_TYPES{ MessageType::ACK, MessageType::NAK, MessageType::HELLO,
+        MessageType::HEARTBEAT, MessageType::ROOM_LIST, MessageType::ROOM_CREATE, MessageType::ROOM_JOIN,
+        MessageType::ROOM_DESTROY, MessageType::ROOM_HISTORY, MessageType::CHAT_SEND, MessageType::CHAT_ECHO,
+        MessageType::CHAT_MISSED };
+
+    /**
+     * @brief Gets the name of \p message_type, for logs and metrics.
+     * @param message_type MessageType
+     * @return The enumerator name, e.g. "CHAT_SEND", or "Invalid" for an unknown value.
+     */
+    constexpr std::string_view message_type_name(MessageType message_type) {
+        switch (message_type) {
+        case MessageType::ACK:
+            return "ACK";
+        case MessageType::NAK:
+            return "NAK";
+        case MessageType::HELLO:
+            return "HELLO";
+        case MessageType::HEARTBEAT:
+            return "HEARTBEAT";
+        case MessageType::ROOM_LIST:
+            return "ROOM_LIST";
+        case MessageType::ROOM_CREATE:
+            return "ROOM_CREATE";
+        case MessageType::ROOM_JOIN:
+            return "ROOM_JOIN";
+        case MessageType::ROOM_DESTROY:
+            return "ROOM_DESTROY";
+        case MessageType::ROOM_HISTORY:
+            return "ROOM_HISTORY";
+        case MessageType::CHAT_SEND:
+            return "CHAT_SEND";
+        case MessageType::CHAT_ECHO:
+            return "CHAT_ECHO";
+        case MessageType::CHAT_MISSED:
+            return "CHAT_MISSED";
+        default:
+            return "Invalid";
+        }
+    }
+
     /// Maximum number of entries that can be retrieved as part of MessageType::ROOM_HISTORY.
     constexpr int32_t ROOM_HISTORY_MAX_ENTRIES = 100;
 
@@ -139,6 +192,140 @@ namespace tavernmx::messaging
      */
     size_t apply_buffer_to_block(const std::span<CharType>& buffer, MessageBlock& block, size_t payload_offset = 0);
 
+    /// Largest payload_size a MessageBlockDecoder will accept before treating the header as corrupt.
+    constexpr uint32_t MAX_BLOCK_PAYLOAD_SIZE = 16 * 1024 * 1024;
+
+    /**
+     * @brief Incremental decoder that turns a stream of received bytes into MessageBlocks.
+     * Bytes are appended as they arrive; every complete block can then be taken out, while
+     * a partially received block stays buffered until the rest of it arrives.
+     * @note If the stream contains bytes that aren't part of a block (or a block header is corrupt),
+     * the decoder discards data until it finds the next MessageBlock::HEADER.
+     */
+    class MessageBlockDecoder
+    {
+    public:
+        /**
+         * @brief Creates an empty decoder.
+         */
+        MessageBlockDecoder() noexcept = default;
+
+        /**
+         * @brief Returns a writable region of at least \p min_size bytes at the end of the receive buffer.
+         * After writing received bytes into it, call commit() with the number of bytes written.
+         * @param min_size Minimum number of bytes needed.
+         * @return std::span<CharType>
+         * @note The returned span is invalidated by any other call on the decoder.
+         */
+        std::span<CharType> prepare(size_t min_size);
+
+        /**
+         * @brief Marks \p size bytes of the region returned by prepare() as received.
+         * @param size Number of bytes written.
+         */
+        void commit(size_t size);
+
+        /**
+         * @brief Appends a copy of \p bytes to the receive buffer.
+         * @param bytes Received bytes.
+         */
+        void feed(std::span<const CharType> bytes);
+
+        /**
+         * @brief Takes the next complete MessageBlock out of the receive buffer, if one is available.
+         * @return MessageBlock, or empty if more bytes are needed.
+         */
+        std::optional<MessageBlock> next();
+
+        /**
+         * @brief Returns the number of received bytes that haven't been decoded into a MessageBlock yet.
+         * @return size_t
+         */
+        size_t buffered() const { return this->buffer_end - this->read_pos; }
+
+        /**
+         * @brief Discards all buffered bytes.
+         */
+        void reset() {
+            this->read_pos = 0;
+            this->buffer_end = 0;
+        }
+
+    private:
+        std::vector<CharType> buffer{};
+        size_t read_pos{ 0 };
+        size_t buffer_end{ 0 };
+
+        bool resync();
+    };
+
+    /**
+     * @brief Queue of encoded bytes waiting to be written to a connection. Blocks are framed directly
+     * into the queue, consecutive blocks are sent together, and a partial write leaves the unsent
+     * remainder at the front of the queue for the next attempt.
+     */
+    class OutboundBuffer
+    {
+    public:
+        /**
+         * @brief Creates an empty buffer.
+         */
+        OutboundBuffer() noexcept = default;
+
+        /**
+         * @brief Appends the framed bytes of \p block (header, payload size and payload).
+         * @param block MessageBlock
+         */
+        void append(const MessageBlock& block);
+
+        /**
+         * @brief Appends already-framed bytes.
+         * @param bytes Encoded bytes to send as-is.
+         */
+        void append(std::span<const CharType> bytes);
+
+        /**
+         * @brief Returns the bytes that haven't been written yet.
+         * @return std::span<const CharType>
+         * @note The returned span is invalidated by any other call on the buffer.
+         */
+        std::span<const CharType> pending() const {
+            return std::span{ this->buffer }.subspan(this->read_pos, this->buffer.size() - this->read_pos);
+        }
+
+        /**
+         * @brief Removes \p size bytes from the front of pending(), after they were written.
+         * @param size Number of bytes written.
+         */
+        void consume(size_t size);
+
+        /**
+         * @brief Checks if all queued bytes have been written.
+         * @return true if nothing is pending, otherwise false.
+         */
+        bool empty() const { return this->read_pos == this->buffer.size(); }
+
+        /**
+         * @brief Returns the number of bytes waiting to be written.
+         * @return size_t
+         */
+        size_t size() const { return this->buffer.size() - this->read_pos; }
+
+        /**
+         * @brief Discards all pending bytes.
+         */
+        void reset() {
+            this->buffer.clear();
+            this->read_pos = 0;
+        }
+
+    private:
+        std::vector<CharType> buffer{};
+        size_t read_pos{ 0 };
+
+        void compact();
+    };
+
     /**
      * @brief Converts a Message struct into a JSON representation.
      * @param message Message
@@ -160,6 +347,86 @@ namespace tavernmx::messaging
      */
     MessageBlock pack_message(const Message& message);
 
+    /**
+     * @brief Converts \p block into a shareable Frame.
+     * @param block MessageBlock
+     * @return Frame
+     */
+    Frame make_frame(const MessageBlock& block);
+
+    /**
+     * @brief Packs a \p message into a shareable Frame.
+     * @param message Message
+     * @return Frame
+     */
+    Frame make_frame(const Message& message);
+
+    /**
+     * @brief Builds the payload of a MessageBlock one message at a time, writing msgpack directly
+     * instead of assembling an intermediate JSON document. JSON Messages only have their values
+     * serialized; typed messages (see codec.h) are encoded straight from their field tables.
+     * @note The payload is byte-for-byte identical to serializing a JSON array of message_to_json().
+     */
+    class MessagePacker
+    {
+    public:
+        /**
+         * @brief Creates an empty MessagePacker.
+         */
+        MessagePacker() noexcept = default;
+
+        /**
+         * @brief Appends a (JSON) Message.
+         * @param message Message
+         */
+        void add(const Message& message);
+
+        /**
+         * @brief Appends a typed message.
+         * @tparam T Typed message struct with an encode_values() overload, see codec.h.
+         * @param message Typed message values.
+         */
+        template <typename T>
+            requires requires(std::vector<CharType>& output, const T& message) {
+                { T::MESSAGE_TYPE } -> std::convertible_to<MessageType>;
+                encode_values(output, message);
+            }
+        void add(const T& message) {
+            this->begin_message(T::MESSAGE_TYPE);
+            encode_values(this->body, message);
+        }
+
+        /**
+         * @brief Checks if no messages have been added.
+         * @return true if empty, otherwise false.
+         */
+        bool empty() const { return this->count == 0; }
+
+        /**
+         * @brief Returns the number of messages added.
+         * @return size_t
+         */
+        size_t size() const { return this->count; }
+
+        /**
+         * @brief Produces a MessageBlock containing all messages added so far, and resets the packer.
+         * @return MessageBlock
+         */
+        MessageBlock finish();
+
+        /**
+         * @brief Produces a Frame containing all messages added so far, and resets the packer.
+         * @return Frame
+         */
+        Frame finish_frame();
+
+    private:
+        std::vector<CharType> body{};
+        size_t count{ 0 };
+
+        void begin_message(MessageType message_type);
+    };
+
     /**
      * @brief Packs zero or more \p messages into a MessageBlock struct.
      * @tparam Iterator Forward iterator of Message structs.
@@ -170,14 +437,11 @@ namespace tavernmx::messaging
     template <class Iterator>
         requires std::forward_iterator<Iterator> && std::same_as<std::iter_value_t<Iterator>, Message>
     MessageBlock pack_messages(Iterator begin, Iterator end) {
-        json group_json = json::array();
-        std::for_each(begin, end, [&group_json](typename Iterator::reference message) {
-            group_json.push_back(message_to_json(message));
+        MessagePacker packer{};
+        std::for_each(begin, end, [&packer](typename Iterator::reference message) {
+            packer.add(message);
         });
-
-        MessageBlock block{};
-        block.set_payload(json::to_msgpack(group_json));
-        return block;
+        return packer.finish();
     }
 
     /**
@@ -207,6 +471,21 @@ namespace tavernmx::messaging
         };
     }
 
+    /**
+     * @brief Creates a NAK Message struct refusing a message because the client is sending that kind too fast.
+     * @param refused_type Type of the message refused.
+     * @param retry_after_ms Milliseconds until a message of \p refused_type will be accepted again.
+     * @return Message
+     */
+    inline Message create_rate_limited_nak(MessageType refused_type, int32_t retry_after_ms) {
+        return Message{
+            .message_type = MessageType::NAK,
+            .values = { { "error", "Too many messages, slow down." },
+                        { "message_type", static_cast<int32_t>(refused_type) },
+                        { "retry_after_ms", retry_after_ms } }
+        };
+    }
+
     /**
      * @brief Create a HELLO Message struct.
      * @param user_name User name
@@ -341,4 +620,14 @@ namespace tavernmx::messaging
                             { "timestamp", timestamp }
                         } };
     }
+
+    /**
+     * @brief Create a CHAT_MISSED Message struct to tell a client that chat echoes were dropped for it.
+     * @param event_count Number of chat events the client missed.
+     * @return Message
+     */
+    inline Message create_chat_missed(int32_t event_count) {
+        return Message{ .message_type = MessageType::CHAT_MISSED,
+                        .values = { { "event_count", event_count } } };
+    }
 }
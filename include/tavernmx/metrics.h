@@ -0,0 +1,317 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tavernmx::metrics
+{
+    /// Number of shards each Counter and Histogram is split into, so threads recording at once rarely share one.
+    constexpr size_t METRIC_SHARDS = 8;
+
+    /**
+     * @brief Picks the next shard for a thread that records its first metric.
+     * @return Shard index below METRIC_SHARDS.
+     */
+    size_t assign_shard();
+
+    /**
+     * @brief Gets the shard the calling thread records metrics to. Each thread keeps the same shard for its
+     * lifetime, and threads are spread over the shards in turn.
+     * @return Shard index below METRIC_SHARDS.
+     */
+    inline size_t current_shard() {
+        thread_local const size_t shard = assign_shard();
+        return shard;
+    }
+
+    /// Name/value pairs telling apart the series of one metric, e.g. { { "step", "gather" } }.
+    using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+    /**
+     * @brief A count that only goes up, such as bytes sent. Split into per-thread shards, each on its own cache
+     * line, so threads counting at once don't contend.
+     * @note Thread safe. add() is a relaxed atomic increment of the calling thread's shard.
+     */
+    class Counter
+    {
+    public:
+        /**
+         * @brief Adds \p amount to the count.
+         * @param amount Amount to add.
+         */
+        void add(uint64_t amount = 1) {
+            this->shards[current_shard()].value.fetch_add(amount, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Sums the shards.
+         * @return uint64_t
+         */
+        uint64_t value() const {
+            uint64_t total = 0;
+            for (const Shard& shard : this->shards) {
+                total += shard.value.load(std::memory_order_relaxed);
+            }
+            return total;
+        }
+
+    private:
+        struct alignas(64) Shard
+        {
+            std::atomic<uint64_t> value{ 0 };
+        };
+
+        std::array<Shard, METRIC_SHARDS> shards{};
+    };
+
+    /**
+     * @brief A value that goes up and down, such as the number of active connections.
+     * @note Thread safe.
+     */
+    class Gauge
+    {
+    public:
+        /**
+         * @brief Sets the value.
+         * @param value The value.
+         */
+        void set(int64_t value) { this->current.store(value, std::memory_order_relaxed); }
+
+        /**
+         * @brief Adds \p amount to the value.
+         * @param amount Amount to add; negative to subtract.
+         */
+        void add(int64_t amount) { this->current.fetch_add(amount, std::memory_order_relaxed); }
+
+        /**
+         * @brief Gets the value.
+         * @return int64_t
+         */
+        int64_t value() const { return this->current.load(std::memory_order_relaxed); }
+
+    private:
+        alignas(64) std::atomic<int64_t> current{ 0 };
+    };
+
+    /**
+     * @brief What the values recorded to a Histogram measure, which decides how they are reported.
+     */
+    enum class HistogramUnit
+    {
+        /// Durations, recorded in nanoseconds and reported in seconds.
+        Nanoseconds,
+        /// Plain counts, such as the number of clients a chat line was sent to.
+        Count,
+    };
+
+    /**
+     * @brief Counts of the values recorded to a Histogram at one moment.
+     */
+    struct HistogramSnapshot
+    {
+        /// Number of values recorded in each bucket, see Histogram::bucket_index().
+        std::vector<uint64_t> buckets{};
+        /// Number of values recorded.
+        uint64_t count{};
+        /// Sum of the values recorded.
+        uint64_t sum{};
+
+        /**
+         * @brief Estimates the value below which a fraction \p quantile of the recorded values fall.
+         * @param quantile Fraction between 0 and 1, e.g. 0.99.
+         * @return The highest value in the bucket holding that rank, or 0 if nothing was recorded.
+         */
+        uint64_t value_at_quantile(double quantile) const;
+
+        /**
+         * @brief Counts the recorded values known to be no more than \p value: those in buckets whose every
+         * value is no more than \p value.
+         * @param value The value.
+         * @return uint64_t
+         */
+        uint64_t count_at_or_below(uint64_t value) const;
+    };
+
+    /**
+     * @brief Distribution of non-negative values, such as latencies, kept in log-linear buckets in the style of
+     * HdrHistogram: values below SUB_BUCKETS get a bucket each, and every power of two above that is split into
+     * SUB_BUCKETS equal buckets, so any recorded value is known to within 1 / SUB_BUCKETS (6.25%).
+     * @note Thread safe. record() is two relaxed atomic increments in the calling thread's shard, with no locks
+     * or allocation; values above MAX_VALUE are counted as MAX_VALUE.
+     */
+    class Histogram
+    {
+    public:
+        /// Number of buckets each power of two is split into.
+        static constexpr size_t SUB_BUCKETS = 16;
+        /// Largest value told apart from larger ones: about 9 minutes, in nanoseconds.
+        static constexpr uint64_t MAX_VALUE = (uint64_t{ 1 } << 39) - 1;
+        /// Number of buckets.
+        static constexpr size_t BUCKET_COUNT = SUB_BUCKETS + (39 - 4) * SUB_BUCKETS;
+
+        /**
+         * @brief Finds the bucket \p value is counted in.
+         * @param value The value.
+         * @return Index below BUCKET_COUNT.
+         */
+        static constexpr size_t bucket_index(uint64_t value) {
+            if (value < SUB_BUCKETS) {
+                return static_cast<size_t>(value);
+            }
+            if (value > MAX_VALUE) {
+                value = MAX_VALUE;
+            }
+            // the top bit picks the power of two; the four bits below it pick the bucket within it
+            const auto shift = static_cast<size_t>(std::bit_width(value)) - 5;
+            return SUB_BUCKETS * (shift + 1) + static_cast<size_t>((value >> shift) - SUB_BUCKETS);
+        }
+
+        /**
+         * @brief Gets the highest value counted in bucket \p index.
+         * @param index Bucket index below BUCKET_COUNT.
+         * @return uint64_t
+         */
+        static constexpr uint64_t bucket_upper_bound(size_t index) {
+            if (index < SUB_BUCKETS) {
+                return index;
+            }
+            const size_t shift = index / SUB_BUCKETS - 1;
+            return ((SUB_BUCKETS + index % SUB_BUCKETS + 1) << shift) - 1;
+        }
+
+        /**
+         * @brief Records \p value.
+         * @param value The value.
+         */
+        void record(uint64_t value) {
+            Shard& shard = this->shards[current_shard()];
+            shard.buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+            shard.sum.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Records a duration, in nanoseconds.
+         * @param elapsed The duration; negative durations are recorded as 0.
+         */
+        void record(std::chrono::nanoseconds elapsed) {
+            this->record(static_cast<uint64_t>(std::max(elapsed.count(), std::chrono::nanoseconds::rep{ 0 })));
+        }
+
+        /**
+         * @brief Adds up the shards.
+         * @return HistogramSnapshot
+         */
+        HistogramSnapshot snapshot() const;
+
+    private:
+        struct alignas(64) Shard
+        {
+            std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets{};
+            std::atomic<uint64_t> sum{ 0 };
+        };
+
+        std::array<Shard, METRIC_SHARDS> shards{};
+    };
+
+    /**
+     * @brief Named set of metrics that can be reported together, in the Prometheus text exposition format or
+     * as a summary for the log. Metrics are registered once, usually at startup, and the references returned
+     * are then used to record to them directly.
+     * @note Thread safe. Registering and reporting take a lock; recording to a metric never does.
+     */
+    class MetricsRegistry
+    {
+    public:
+        MetricsRegistry() = default;
+
+        MetricsRegistry(const MetricsRegistry&) = delete;
+
+        MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+        /**
+         * @brief Registers a Counter, or finds the one already registered with the same name and labels.
+         * @param name Metric name; by Prometheus convention, ending in "_total".
+         * @param help One line describing the metric. Only the first registration of a name sets it.
+         * @param labels Labels telling this series apart from others with the same name.
+         * @return Counter, valid for as long as the registry.
+         * @throws std::invalid_argument if \p name is already registered as another kind of metric
+         */
+        Counter& counter(std::string name, std::string help, MetricLabels labels = {});
+
+        /**
+         * @brief Registers a Gauge, or finds the one already registered with the same name and labels.
+         * @param name Metric name.
+         * @param help One line describing the metric.
+         * @param labels Labels telling this series apart from others with the same name.
+         * @return Gauge, valid for as long as the registry.
+         * @throws std::invalid_argument if \p name is already registered as another kind of metric
+         */
+        Gauge& gauge(std::string name, std::string help, MetricLabels labels = {});
+
+        /**
+         * @brief Registers a Histogram, or finds the one already registered with the same name and labels.
+         * @param name Metric name; by Prometheus convention, ending in "_seconds" for durations.
+         * @param help One line describing the metric.
+         * @param unit What the recorded values measure.
+         * @param labels Labels telling this series apart from others with the same name.
+         * @return Histogram, valid for as long as the registry.
+         * @throws std::invalid_argument if \p name is already registered as another kind of metric, or with
+         * another unit
+         */
+        Histogram& histogram(std::string name, std::string help, HistogramUnit unit, MetricLabels labels = {});
+
+        /**
+         * @brief Renders every metric in the Prometheus text exposition format (version 0.0.4). Histograms are
+         * reported with buckets at 1, 2 and 5 times each power of ten: from 1 us to 100 s for durations, and
+         * from 1 to 1,000,000 for counts.
+         * @return std::string
+         */
+        std::string to_prometheus() const;
+
+        /**
+         * @brief Summarizes every metric that has recorded anything, one line each: the value of counters and
+         * gauges, and the count, median, 99th percentile and maximum of histograms.
+         * @return std::vector of lines, in the order the metrics were registered.
+         */
+        std::vector<std::string> summarize() const;
+
+    private:
+        enum class MetricKind
+        {
+            Counter,
+            Gauge,
+            Histogram,
+        };
+
+        struct Series
+        {
+            MetricLabels labels{};
+            std::unique_ptr<Counter> counter{};
+            std::unique_ptr<Gauge> gauge{};
+            std::unique_ptr<Histogram> histogram{};
+        };
+
+        struct Family
+        {
+            std::string name{};
+            std::string help{};
+            MetricKind kind{};
+            HistogramUnit unit{};
+            std::vector<std::unique_ptr<Series>> series{};
+        };
+
+        std::vector<std::unique_ptr<Family>> families{};
+        mutable std::mutex families_mutex{};
+
+        Series& find_or_add(std::string name, std::string help, MetricKind kind, HistogramUnit unit,
+            MetricLabels labels);
+    };
+}
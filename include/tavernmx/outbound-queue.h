@@ -0,0 +1,166 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <vector>
+
+#include "codec.h"
+#include "queue.h"
+
+namespace tavernmx
+{
+    /**
+     * @brief What an OutboundQueue does once its consumer falls so far behind that the queue reaches its limits.
+     */
+    enum class SlowConsumerPolicy
+    {
+        /// Drop the oldest queued chat echoes, then send a CHAT_MISSED marker with how many were dropped.
+        DropOldest,
+        /// Stop queueing chat echoes until the queue has drained to half its limits, then send a CHAT_MISSED marker.
+        Degrade,
+        /// Refuse everything from then on; the consumer should be disconnected.
+        Disconnect,
+    };
+
+    /**
+     * @brief Limits on what an OutboundQueue holds, and what happens when they are reached.
+     */
+    struct OutboundLimits
+    {
+        /// Maximum bytes of frames queued.
+        size_t max_bytes{ 1024 * 1024 };
+        /// Maximum number of frames queued.
+        size_t max_frames{ 1024 };
+        /// What to do once either limit is reached.
+        SlowConsumerPolicy policy{ SlowConsumerPolicy::DropOldest };
+    };
+
+    /**
+     * @brief Snapshot of the state of an OutboundQueue.
+     */
+    struct OutboundStats
+    {
+        /// Number of frames queued.
+        size_t queued_frames{};
+        /// Bytes of frames queued.
+        size_t queued_bytes{};
+        /// Number of chat events dropped so far.
+        uint64_t dropped_events{};
+        /// true while chat echoes are being dropped under SlowConsumerPolicy::Degrade.
+        bool degraded{};
+        /// true once the queue has refused a frame under SlowConsumerPolicy::Disconnect, or any policy's hard limit.
+        bool overflowed{};
+    };
+
+    /**
+     * @brief Bounded queue of encoded frames for one connection, with any number of producers and one consumer.
+     * Chat echoes are queued with the number of events they carry and may be dropped when the consumer falls
+     * behind, as chosen by SlowConsumerPolicy; every other frame is delivered, or the queue overflows.
+     * @note Whatever the policy, the queue never holds more than twice its limits: past that, chat echoes are
+     * dropped on arrival and any other frame overflows the queue. The one exception is a single frame bigger
+     * than the limits, which is accepted if nothing else is queued.
+     */
+    class OutboundQueue
+    {
+    public:
+        /// Result of OutboundQueue::push().
+        enum class PushResult
+        {
+            /// The frame was queued.
+            Queued,
+            /// The frame was a chat echo and was dropped; the consumer will be told it missed it.
+            Dropped,
+            /// The queue is full and refused the frame; the consumer should be disconnected.
+            Overflowed,
+        };
+
+        /**
+         * @brief Creates an empty queue.
+         * @param limits Limits on the frames queued.
+         */
+        explicit OutboundQueue(OutboundLimits limits = {}) : limits{ limits } {
+        }
+
+        OutboundQueue(const OutboundQueue&) = delete;
+
+        OutboundQueue& operator=(const OutboundQueue&) = delete;
+
+        /**
+         * @brief Queues \p frame, subject to the queue's limits.
+         * @param frame The encoded frame.
+         * @param event_count Number of chat events in \p frame if it only holds chat echoes, which makes it
+         * droppable; 0 for anything else.
+         * @return PushResult
+         * @note Thread safe.
+         */
+        PushResult push(messaging::Frame frame, size_t event_count = 0);
+
+        /**
+         * @brief Takes the next frame to send, after a CHAT_MISSED marker if chat events were dropped since the
+         * last one. Trims the queue first if it is over its limits.
+         * @return Frame, or empty if nothing is queued (or chat echoes are still being held back).
+         * @note Consumer only.
+         */
+        std::optional<messaging::Frame> pop();
+
+        /**
+         * @brief Applies the queue's policy to everything pushed so far: under SlowConsumerPolicy::DropOldest,
+         * drops the oldest chat echoes until the queue is back within its limits. Called by pop(), and should
+         * also be called when the consumer can't send, so the queue doesn't wait until it is full.
+         * @note Consumer only.
+         */
+        void trim();
+
+        /**
+         * @brief Checks if anything has been pushed that hasn't been popped.
+         * @return true if the queue is empty, otherwise false.
+         * @note Thread safe.
+         */
+        bool empty() const {
+            return this->frame_count.load(std::memory_order_acquire) == 0 &&
+                this->missed_events.load(std::memory_order_acquire) == 0;
+        }
+
+        /**
+         * @brief Returns a snapshot of the queue's state.
+         * @return OutboundStats
+         * @note Thread safe.
+         */
+        OutboundStats stats() const;
+
+        /**
+         * @brief Gets the queue's limits.
+         * @return const OutboundLimits&
+         */
+        const OutboundLimits& get_limits() const { return this->limits; }
+
+    private:
+        struct Entry
+        {
+            messaging::Frame frame{};
+            size_t event_count{};
+        };
+
+        OutboundLimits limits;
+        MpscQueue<Entry> incoming{};
+        std::atomic<size_t> frame_count{ 0 };
+        std::atomic<size_t> byte_count{ 0 };
+        std::atomic<uint64_t> dropped_events{ 0 };
+        // dropped since the last CHAT_MISSED marker
+        std::atomic<uint64_t> missed_events{ 0 };
+        std::atomic<bool> degraded{ false };
+        std::atomic<bool> overflowed{ false };
+        // consumer only: frames taken from incoming, oldest first
+        std::deque<Entry> pending{};
+        std::vector<Entry> drained{};
+
+        // a lone frame is never over the limits, however big it is
+        bool over_limits(size_t frames, size_t bytes, size_t factor) const {
+            return frames > 1 && (frames > this->limits.max_frames * factor || bytes > this->limits.max_bytes * factor);
+        }
+
+        void drop(size_t event_count);
+        void collect();
+    };
+}
@@ -1,15 +1,144 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <queue>
+#include <vector>
 
 namespace tavernmx
 {
+    /// Assumed size of a CPU cache line, used to keep producer and consumer state from sharing one.
+    constexpr size_t CACHE_LINE_SIZE = 64;
+
+    /**
+     * @brief Wakes a consumer when elements are pushed to any of the queues that share it. Notifications
+     * are sticky: a push that happens while nobody is waiting makes the next wait return immediately, so
+     * a consumer that drains its queues and then waits never misses work.
+     * @note notify() is thread safe and costs a fence and an atomic load when a notification is already
+     * pending. Only one thread at a time should wait on a signal.
+     */
+    class QueueSignal
+    {
+    public:
+        /**
+         * @brief Creates a new signal with no pending notification.
+         */
+        QueueSignal() = default;
+
+        ~QueueSignal();
+
+        QueueSignal(const QueueSignal&) = delete;
+
+        QueueSignal& operator=(const QueueSignal&) = delete;
+
+        /**
+         * @brief Records that work is waiting, waking the consumer if this is the first notification since
+         * it last woke up. Called by the queues after each push.
+         */
+        void notify() {
+            // pairs with the fence in try_acquire(): either the consumer sees the pushed element, or we see
+            // that nothing is pending and wake it
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (this->pending.load(std::memory_order_relaxed) || this->pending.exchange(true)) {
+                return;
+            }
+            {
+                std::lock_guard guard{ this->mutex };
+            }
+            this->ready.notify_all();
+            if (this->fd.load(std::memory_order_acquire) >= 0) {
+                this->write_event();
+            }
+        }
+
+        /**
+         * @brief Takes the pending notification, if there is one, without blocking.
+         * @return true if a notification was pending, otherwise false.
+         * @note If an event descriptor is enabled, this also resets it, so call it whenever the descriptor
+         * is reported readable.
+         */
+        bool try_acquire() {
+            this->read_event();
+            const bool was_pending = this->pending.exchange(false);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            return was_pending;
+        }
+
+        /**
+         * @brief Blocks until notify() is called or \p deadline passes, then takes the notification.
+         * @param deadline Latest time to wait until.
+         * @return true if notified, false if the deadline passed first.
+         */
+        bool wait_until(std::chrono::steady_clock::time_point deadline) {
+            {
+                std::unique_lock lock{ this->mutex };
+                if (!this->ready.wait_until(lock, deadline, [this] { return this->pending.load(); })) {
+                    return false;
+                }
+            }
+            return this->try_acquire();
+        }
+
+        /**
+         * @brief Blocks until notify() is called or \p timeout elapses, then takes the notification.
+         * @param timeout Maximum time to wait.
+         * @return true if notified, false if the timeout elapsed first.
+         */
+        bool wait(std::chrono::milliseconds timeout) {
+            return this->wait_until(std::chrono::steady_clock::now() + timeout);
+        }
+
+        /**
+         * @brief Creates an event descriptor that is readable whenever a notification is pending, so the
+         * signal can be watched by a Reactor or poll() alongside sockets. Does nothing if already enabled.
+         * @return true if the descriptor is available, false if the platform doesn't support it (Linux only).
+         */
+        bool enable_event_fd();
+
+        /**
+         * @brief Gets the descriptor created by enable_event_fd().
+         * @return int32_t descriptor, or -1 if not enabled.
+         */
+        int32_t event_fd() const { return this->fd.load(std::memory_order_acquire); }
+
+    private:
+        std::atomic<bool> pending{ false };
+        std::atomic<int32_t> fd{ -1 };
+        std::mutex mutex{};
+        std::condition_variable ready{};
+
+        void write_event();
+
+        void read_event();
+    };
+
+    namespace detail
+    {
+        /// Shared implementation of wait_pop() for the queue types.
+        template <typename Queue>
+        auto wait_pop(Queue& queue, QueueSignal& signal, std::chrono::milliseconds timeout) {
+            const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+            do {
+                if (auto item = queue.pop()) {
+                    return item;
+                }
+            } while (signal.wait_until(deadline));
+            return queue.pop();
+        }
+    }
+
     /**
      * @brief Thread-safe implementation of FIFO data structure. (Wraps std::queue<T, std::dequeue<T>>.)
      * @tparam T The type of the stored elements.
      * @note All container operations rely on locking a mutex. Copying/moving requires locking
-     * on both containers in the operation.
+     * on both containers in the operation. The QueueSignal is not copied or moved.
      */
     template <typename T>
     class ThreadSafeQueue
@@ -19,15 +148,21 @@ namespace tavernmx
         /**
          * @brief Creates a new, empty container.
          */
-        ThreadSafeQueue() noexcept = default;
+        ThreadSafeQueue() = default;
+
+        /**
+         * @brief Creates a new, empty container that notifies \p signal when elements are pushed.
+         * @param signal QueueSignal, possibly shared with other queues.
+         */
+        explicit ThreadSafeQueue(std::shared_ptr<QueueSignal> signal) : _signal{ std::move(signal) } {}
 
         virtual ~ThreadSafeQueue() = default;
 
-        ThreadSafeQueue(const ThreadSafeQueue& other) noexcept {
+        ThreadSafeQueue(const ThreadSafeQueue& other) {
             *this = other;
         }
 
-        ThreadSafeQueue(ThreadSafeQueue&& other) noexcept {
+        ThreadSafeQueue(ThreadSafeQueue&& other) {
             *this = std::move(other);
         };
 
@@ -57,8 +192,12 @@ namespace tavernmx
          */
         template <class... Args>
         decltype(auto) emplace(Args&&... args) {
-            std::lock_guard guard{ this->_mutex };
-            return this->_queue.emplace(std::forward<Args...>(args...));
+            std::unique_lock lock{ this->_mutex };
+            decltype(auto) result = this->_queue.emplace(std::forward<Args>(args)...);
+            // as in push(), so a woken consumer doesn't go straight back to sleep on the lock
+            lock.unlock();
+            this->_signal->notify();
+            return result;
         }
 
         /**
@@ -103,13 +242,59 @@ namespace tavernmx
             return returned;
         }
 
+        /**
+         * @brief Removes an element from the front of the queue, waiting up to \p timeout for one to be pushed
+         * if the queue is empty.
+         * @param timeout Maximum time to wait.
+         * @return A std::optional<T> containing the element popped off the queue, or nothing if the queue
+         * was still empty when the timeout elapsed.
+         */
+        std::optional<T> wait_pop(std::chrono::milliseconds timeout) {
+            return detail::wait_pop(*this, *this->_signal, timeout);
+        }
+
+        /**
+         * @brief Moves up to \p max_count elements from the front of the queue to the end of \p output,
+         * locking the queue once.
+         * @param output Receives the elements, in queue order.
+         * @param max_count Maximum number of elements to move.
+         * @return The number of elements moved.
+         */
+        size_t drain_into(std::vector<T>& output, size_t max_count = std::numeric_limits<size_t>::max()) {
+            std::lock_guard guard{ this->_mutex };
+            const size_t count = std::min(max_count, this->_queue.size());
+            output.reserve(output.size() + count);
+            for (size_t i = 0; i < count; ++i) {
+                output.push_back(std::move(this->_queue.front()));
+                this->_queue.pop();
+            }
+            return count;
+        }
+
+        /**
+         * @brief Takes every element in the queue at once by swapping out the underlying container. The
+         * lock is held only for the swap.
+         * @return std::queue<T> holding the elements, in queue order. The queue is left empty.
+         */
+        std::queue<T> swap_all() {
+            std::queue<T> taken{};
+            {
+                std::lock_guard guard{ this->_mutex };
+                std::swap(taken, this->_queue);
+            }
+            return taken;
+        }
+
         /**
          * @brief Pushes the given element \p item to the end of the queue.
          * @param item The value of the element to push.
          */
         void push(const T& item) {
-            std::lock_guard guard{ this->_mutex };
-            this->_queue.push(item);
+            {
+                std::lock_guard guard{ this->_mutex };
+                this->_queue.push(item);
+            }
+            this->_signal->notify();
         }
 
         /**
@@ -117,8 +302,31 @@ namespace tavernmx
          * @param item The value of the element to push.
          */
         void push(T&& item) {
-            std::lock_guard guard{ this->_mutex };
-            this->_queue.push(std::move(item));
+            {
+                std::lock_guard guard{ this->_mutex };
+                this->_queue.push(std::move(item));
+            }
+            this->_signal->notify();
+        }
+
+        /**
+         * @brief Pushes each element in the range to the end of the queue, in order, locking the queue once.
+         * @param begin start of range (use std::make_move_iterator to move the elements)
+         * @param end end of range
+         */
+        template <typename Iterator>
+            requires std::input_iterator<Iterator>
+        void push_range(Iterator begin, Iterator end) {
+            if (begin == end) {
+                return;
+            }
+            {
+                std::lock_guard guard{ this->_mutex };
+                for (; begin != end; ++begin) {
+                    this->_queue.push(*begin);
+                }
+            }
+            this->_signal->notify();
         }
 
         /**
@@ -130,8 +338,483 @@ namespace tavernmx
             return this->_queue.size();
         }
 
+        /**
+         * @brief Gets the QueueSignal notified when elements are pushed to this queue.
+         * @return std::shared_ptr<QueueSignal>
+         */
+        const std::shared_ptr<QueueSignal>& signal() const { return this->_signal; }
+
     private:
         mutable std::mutex _mutex{};
         std::queue<T> _queue{};
+        std::shared_ptr<QueueSignal> _signal{ std::make_shared<QueueSignal>() };
     };
+
+    /**
+     * @brief Lock-free, unbounded multi-producer/single-consumer FIFO queue. Offers the same interface as
+     * ThreadSafeQueue<T>, plus drain_into() for batched consumption.
+     * @tparam T The type of the stored elements.
+     * @note Any thread may call push(), emplace(), empty() and size(). Only one thread at a time may
+     * consume (pop(), front(), drain_into()). empty() and size() are snapshots and may be briefly stale
+     * while a push is in progress. Producers only contend on a single atomic exchange.
+     */
+    template <typename T>
+    class MpscQueue
+    {
+        // Based on Dmitry Vyukov's intrusive MPSC node-based queue.
+    public:
+        /**
+         * @brief Creates a new, empty container.
+         * @param signal QueueSignal to notify when elements are pushed, possibly shared with other queues.
+         */
+        explicit MpscQueue(std::shared_ptr<QueueSignal> signal = std::make_shared<QueueSignal>())
+            : head{ new Node{} }, queue_signal{ std::move(signal) } {
+            this->tail.store(this->head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+
+        ~MpscQueue() {
+            Node* node = this->head.load(std::memory_order_relaxed);
+            while (node != nullptr) {
+                Node* next = node->next.load(std::memory_order_relaxed);
+                delete node;
+                node = next;
+            }
+        }
+
+        MpscQueue(const MpscQueue&) = delete;
+
+        MpscQueue& operator=(const MpscQueue&) = delete;
+
+        /**
+         * @brief Pushes a new element to the end of the queue. The element is constructed in-place.
+         * @tparam Args arguments to forward to the constructor of the element
+         * @param args arguments to forward to the constructor of the element
+         */
+        template <class... Args>
+        void emplace(Args&&... args) {
+            std::unique_ptr<Node> node = std::make_unique<Node>();
+            node->value.emplace(std::forward<Args>(args)...);
+            Node* linked = node.release();
+            this->link(linked, linked, 1);
+        }
+
+        /**
+         * @brief Checks if the queue has no elements.
+         * @return true if the queue is empty, otherwise false.
+         */
+        bool empty() const {
+            return this->head.load(std::memory_order_acquire) == this->tail.load(std::memory_order_acquire);
+        }
+
+        /**
+         * @brief Returns a reference to the first element in the queue. The queue must not be empty.
+         * @return Reference to the first element.
+         * @note Consumer only.
+         */
+        T& front() {
+            return *this->head.load(std::memory_order_relaxed)->next.load(std::memory_order_acquire)->value;
+        }
+
+        /**
+         * @brief Removes an element from the front of the queue, if possible, and returns it.
+         * @return A std::optional<T> containing the element popped off the queue, or nothing
+         * if the queue is empty.
+         * @note Consumer only.
+         */
+        std::optional<T> pop() {
+            Node* current = this->head.load(std::memory_order_relaxed);
+            Node* next = current->next.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                return std::nullopt;
+            }
+            std::optional<T> returned{ std::move(next->value) };
+            next->value.reset();
+            this->head.store(next, std::memory_order_release);
+            this->pop_count.store(this->pop_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            delete current;
+            return returned;
+        }
+
+        /**
+         * @brief Removes an element from the front of the queue, waiting up to \p timeout for one to be pushed
+         * if the queue is empty.
+         * @param timeout Maximum time to wait.
+         * @return A std::optional<T> containing the element popped off the queue, or nothing if the queue
+         * was still empty when the timeout elapsed.
+         * @note Consumer only.
+         */
+        std::optional<T> wait_pop(std::chrono::milliseconds timeout) {
+            return detail::wait_pop(*this, *this->queue_signal, timeout);
+        }
+
+        /**
+         * @brief Moves up to \p max_count elements from the front of the queue to the end of \p output.
+         * @param output Receives the elements, in queue order.
+         * @param max_count Maximum number of elements to move.
+         * @return The number of elements moved.
+         * @note Consumer only.
+         */
+        size_t drain_into(std::vector<T>& output, size_t max_count = std::numeric_limits<size_t>::max()) {
+            size_t count = 0;
+            Node* current = this->head.load(std::memory_order_relaxed);
+            Node* next = nullptr;
+            while (count < max_count && (next = current->next.load(std::memory_order_acquire)) != nullptr) {
+                output.push_back(std::move(*next->value));
+                next->value.reset();
+                // move head past each element as it's taken, so if push_back() throws the queue is still intact
+                this->head.store(next, std::memory_order_release);
+                this->pop_count.store(this->pop_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                delete current;
+                current = next;
+                ++count;
+            }
+            return count;
+        }
+
+        /**
+         * @brief Pushes the given element \p item to the end of the queue.
+         * @param item The value of the element to push.
+         */
+        void push(const T& item) {
+            this->emplace(item);
+        }
+
+        /**
+         * @brief Pushes the given element \p item to the end of the queue.
+         * @param item The value of the element to push.
+         */
+        void push(T&& item) {
+            this->emplace(std::move(item));
+        }
+
+        /**
+         * @brief Pushes each element in the range to the end of the queue, in order. The elements are linked
+         * together first and published with a single atomic exchange, so they are never interleaved with
+         * other producers' elements.
+         * @param begin start of range (use std::make_move_iterator to move the elements)
+         * @param end end of range
+         */
+        template <typename Iterator>
+            requires std::input_iterator<Iterator>
+        void push_range(Iterator begin, Iterator end) {
+            Node* first = nullptr;
+            Node* last = nullptr;
+            size_t count = 0;
+            try {
+                for (; begin != end; ++begin, ++count) {
+                    Node* node = new Node{};
+                    if (last == nullptr) {
+                        first = node;
+                    } else {
+                        last->next.store(node, std::memory_order_relaxed);
+                    }
+                    last = node;
+                    node->value.emplace(*begin);
+                }
+            } catch (...) {
+                while (first != nullptr) {
+                    Node* next = first->next.load(std::memory_order_relaxed);
+                    delete first;
+                    first = next;
+                }
+                throw;
+            }
+            if (first != nullptr) {
+                this->link(first, last, count);
+            }
+        }
+
+        /**
+         * @brief Returns the number of elements in the queue.
+         * @return The number of elements in the queue.
+         */
+        size_t size() const {
+            const size_t popped = this->pop_count.load(std::memory_order_relaxed);
+            const size_t pushed = this->push_count.load(std::memory_order_relaxed);
+            return pushed > popped ? pushed - popped : 0;
+        }
+
+        /**
+         * @brief Gets the QueueSignal notified when elements are pushed to this queue.
+         * @return std::shared_ptr<QueueSignal>
+         */
+        const std::shared_ptr<QueueSignal>& signal() const { return this->queue_signal; }
+
+    private:
+        struct Node
+        {
+            std::atomic<Node*> next{ nullptr };
+            std::optional<T> value{};
+        };
+
+        // producer side
+        alignas(CACHE_LINE_SIZE) std::atomic<Node*> tail{ nullptr };
+        std::atomic<size_t> push_count{ 0 };
+        // consumer side
+        alignas(CACHE_LINE_SIZE) std::atomic<Node*> head{ nullptr };
+        std::atomic<size_t> pop_count{ 0 };
+        // shared, read-only after construction
+        alignas(CACHE_LINE_SIZE) std::shared_ptr<QueueSignal> queue_signal{};
+
+        void link(Node* first, Node* last, size_t count) {
+            Node* previous = this->tail.exchange(last, std::memory_order_acq_rel);
+            previous->next.store(first, std::memory_order_release);
+            this->push_count.fetch_add(count, std::memory_order_relaxed);
+            this->queue_signal->notify();
+        }
+    };
+
+    /**
+     * @brief Lock-free, unbounded single-producer/single-consumer FIFO queue. Offers the same interface as
+     * ThreadSafeQueue<T>, plus drain_into() for batched consumption.
+     * @tparam T The type of the stored elements.
+     * @note Only one thread at a time may produce (push(), emplace()) and only one thread at a time may
+     * consume (pop(), front(), drain_into()); empty() and size() may be called from anywhere. Consumed
+     * nodes are recycled by the producer, so a queue in steady state doesn't allocate.
+     */
+    template <typename T>
+    class SpscQueue
+    {
+        // Based on Dmitry Vyukov's unbounded SPSC queue with node cache.
+    public:
+        /**
+         * @brief Creates a new, empty container.
+         * @param signal QueueSignal to notify when elements are pushed, possibly shared with other queues.
+         */
+        explicit SpscQueue(std::shared_ptr<QueueSignal> signal = std::make_shared<QueueSignal>())
+            : queue_signal{ std::move(signal) } {
+            Node* node = new Node{};
+            this->head.store(node, std::memory_order_relaxed);
+            this->tail.store(node, std::memory_order_relaxed);
+            this->first = node;
+            this->head_copy = node;
+        }
+
+        ~SpscQueue() {
+            Node* node = this->first;
+            while (node != nullptr) {
+                Node* next = node->next.load(std::memory_order_relaxed);
+                delete node;
+                node = next;
+            }
+        }
+
+        SpscQueue(const SpscQueue&) = delete;
+
+        SpscQueue& operator=(const SpscQueue&) = delete;
+
+        /**
+         * @brief Pushes a new element to the end of the queue. The element is constructed in-place.
+         * @tparam Args arguments to forward to the constructor of the element
+         * @param args arguments to forward to the constructor of the element
+         * @note Producer only.
+         */
+        template <class... Args>
+        void emplace(Args&&... args) {
+            std::unique_ptr<Node> node{ this->allocate_node() };
+            node->value.emplace(std::forward<Args>(args)...);
+            this->tail.load(std::memory_order_relaxed)->next.store(node.get(), std::memory_order_release);
+            this->tail.store(node.release(), std::memory_order_release);
+            this->push_count.store(this->push_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            this->queue_signal->notify();
+        }
+
+        /**
+         * @brief Checks if the queue has no elements.
+         * @return true if the queue is empty, otherwise false.
+         */
+        bool empty() const {
+            return this->head.load(std::memory_order_acquire) == this->tail.load(std::memory_order_acquire);
+        }
+
+        /**
+         * @brief Returns a reference to the first element in the queue. The queue must not be empty.
+         * @return Reference to the first element.
+         * @note Consumer only.
+         */
+        T& front() {
+            return *this->head.load(std::memory_order_relaxed)->next.load(std::memory_order_acquire)->value;
+        }
+
+        /**
+         * @brief Removes an element from the front of the queue, if possible, and returns it.
+         * @return A std::optional<T> containing the element popped off the queue, or nothing
+         * if the queue is empty.
+         * @note Consumer only.
+         */
+        std::optional<T> pop() {
+            Node* current = this->head.load(std::memory_order_relaxed);
+            Node* next = current->next.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                return std::nullopt;
+            }
+            std::optional<T> returned{ std::move(next->value) };
+            next->value.reset();
+            this->head.store(next, std::memory_order_release);
+            this->pop_count.store(this->pop_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return returned;
+        }
+
+        /**
+         * @brief Removes an element from the front of the queue, waiting up to \p timeout for one to be pushed
+         * if the queue is empty.
+         * @param timeout Maximum time to wait.
+         * @return A std::optional<T> containing the element popped off the queue, or nothing if the queue
+         * was still empty when the timeout elapsed.
+         * @note Consumer only.
+         */
+        std::optional<T> wait_pop(std::chrono::milliseconds timeout) {
+            return detail::wait_pop(*this, *this->queue_signal, timeout);
+        }
+
+        /**
+         * @brief Moves up to \p max_count elements from the front of the queue to the end of \p output.
+         * @param output Receives the elements, in queue order.
+         * @param max_count Maximum number of elements to move.
+         * @return The number of elements moved.
+         * @note Consumer only.
+         */
+        size_t drain_into(std::vector<T>& output, size_t max_count = std::numeric_limits<size_t>::max()) {
+            size_t count = 0;
+            Node* current = this->head.load(std::memory_order_relaxed);
+            Node* next = nullptr;
+            while (count < max_count && (next = current->next.load(std::memory_order_acquire)) != nullptr) {
+                output.push_back(std::move(*next->value));
+                next->value.reset();
+                // as in MpscQueue, so a throwing push_back() never leaves head before an emptied node
+                this->head.store(next, std::memory_order_release);
+                this->pop_count.store(this->pop_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                current = next;
+                ++count;
+            }
+            return count;
+        }
+
+        /**
+         * @brief Pushes the given element \p item to the end of the queue.
+         * @param item The value of the element to push.
+         * @note Producer only.
+         */
+        void push(const T& item) {
+            this->emplace(item);
+        }
+
+        /**
+         * @brief Pushes the given element \p item to the end of the queue.
+         * @param item The value of the element to push.
+         * @note Producer only.
+         */
+        void push(T&& item) {
+            this->emplace(std::move(item));
+        }
+
+        /**
+         * @brief Pushes each element in the range to the end of the queue, in order, publishing them to the
+         * consumer all at once.
+         * @param begin start of range (use std::make_move_iterator to move the elements)
+         * @param end end of range
+         * @note Producer only.
+         */
+        template <typename Iterator>
+            requires std::input_iterator<Iterator>
+        void push_range(Iterator begin, Iterator end) {
+            Node* first = nullptr;
+            Node* last = nullptr;
+            size_t count = 0;
+            try {
+                for (; begin != end; ++begin, ++count) {
+                    Node* node = this->allocate_node();
+                    if (last == nullptr) {
+                        first = node;
+                    } else {
+                        last->next.store(node, std::memory_order_relaxed);
+                    }
+                    last = node;
+                    node->value.emplace(*begin);
+                }
+            } catch (...) {
+                while (first != nullptr) {
+                    Node* next = first->next.load(std::memory_order_relaxed);
+                    delete first;
+                    first = next;
+                }
+                throw;
+            }
+            if (first == nullptr) {
+                return;
+            }
+            this->tail.load(std::memory_order_relaxed)->next.store(first, std::memory_order_release);
+            this->tail.store(last, std::memory_order_release);
+            this->push_count.store(this->push_count.load(std::memory_order_relaxed) + count,
+                std::memory_order_relaxed);
+            this->queue_signal->notify();
+        }
+
+        /**
+         * @brief Returns the number of elements in the queue.
+         * @return The number of elements in the queue.
+         */
+        size_t size() const {
+            const size_t popped = this->pop_count.load(std::memory_order_relaxed);
+            const size_t pushed = this->push_count.load(std::memory_order_relaxed);
+            return pushed > popped ? pushed - popped : 0;
+        }
+
+        /**
+         * @brief Gets the QueueSignal notified when elements are pushed to this queue.
+         * @return std::shared_ptr<QueueSignal>
+         */
+        const std::shared_ptr<QueueSignal>& signal() const { return this->queue_signal; }
+
+    private:
+        struct Node
+        {
+            std::atomic<Node*> next{ nullptr };
+            std::optional<T> value{};
+        };
+
+        // producer side; [first, head_copy) are consumed nodes ready for reuse
+        alignas(CACHE_LINE_SIZE) std::atomic<Node*> tail{ nullptr };
+        Node* first{ nullptr };
+        Node* head_copy{ nullptr };
+        std::atomic<size_t> push_count{ 0 };
+        // consumer side
+        alignas(CACHE_LINE_SIZE) std::atomic<Node*> head{ nullptr };
+        std::atomic<size_t> pop_count{ 0 };
+        // shared, read-only after construction
+        alignas(CACHE_LINE_SIZE) std::shared_ptr<QueueSignal> queue_signal{};
+
+        Node* allocate_node() {
+            if (this->first == this->head_copy) {
+                this->head_copy = this->head.load(std::memory_order_acquire);
+            }
+            if (this->first != this->head_copy) {
+                Node* node = this->first;
+                this->first = node->next.load(std::memory_order_relaxed);
+                node->next.store(nullptr, std::memory_order_relaxed);
+                return node;
+            }
+            return new Node{};
+        }
+    };
+
+    /**
+     * @brief Waits until at least one of the given queues has elements, or \p timeout elapses.
+     * @param timeout Maximum time to wait.
+     * @param first A queue (ThreadSafeQueue, MpscQueue or SpscQueue).
+     * @param rest More queues. All of them must have been created with the same QueueSignal as \p first.
+     * @return true if any of the queues has elements, otherwise false.
+     */
+    template <typename Queue, typename... Queues>
+    bool wait_for_any(std::chrono::milliseconds timeout, const Queue& first, const Queues&... rest) {
+        assert(((first.signal() == rest.signal()) && ...) && "wait_for_any() requires a shared QueueSignal");
+        const auto has_elements = [&first, &rest...] { return !first.empty() || (!rest.empty() || ...); };
+        const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+        do {
+            if (has_elements()) {
+                return true;
+            }
+        } while (first.signal()->wait_until(deadline));
+        return has_elements();
+    }
 }
@@ -0,0 +1,153 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+#include "messaging.h"
+
+namespace tavernmx
+{
+    /**
+     * @brief How fast something may happen: on average \p per_second times a second, and up to \p burst times
+     * at once after a quiet spell.
+     */
+    struct RateLimit
+    {
+        /// Sustained rate allowed; 0 or less means unlimited.
+        double per_second{};
+        /// Number of times allowed back to back (at least 1).
+        double burst{ 1.0 };
+
+        /**
+         * @brief Checks if this limit restricts anything.
+         * @return true if per_second is positive, otherwise false.
+         */
+        bool is_limited() const { return this->per_second > 0.0; }
+    };
+
+    /**
+     * @brief Token bucket enforcing a RateLimit. Holds up to RateLimit::burst tokens, refilled at
+     * RateLimit::per_second; each event takes one.
+     * @note Not thread safe, but never allocates or locks: meant to be owned by whichever thread sees the events.
+     */
+    class TokenBucket
+    {
+    public:
+        /**
+         * @brief Creates a bucket that never runs out.
+         */
+        TokenBucket() = default;
+
+        /**
+         * @brief Creates a full bucket.
+         * @param limit The rate to enforce.
+         * @param now Current time.
+         */
+        TokenBucket(RateLimit limit, std::chrono::steady_clock::time_point now);
+
+        /**
+         * @brief Takes a token, if one is available.
+         * @param now Current time; should not go backwards between calls.
+         * @return Zero if a token was taken, otherwise how long until one will be available (at least 1 ms).
+         */
+        std::chrono::milliseconds try_take(std::chrono::steady_clock::time_point now);
+
+    private:
+        RateLimit limit{};
+        double tokens{};
+        std::chrono::steady_clock::time_point refilled{};
+    };
+
+    /**
+     * @brief A RateLimit for each kind of message a client can send that costs the server work.
+     */
+    class MessageRateLimits
+    {
+    public:
+        /// Message types that can be rate limited.
+        static constexpr std::array LIMITED_TYPES{ messaging::MessageType::ROOM_LIST,
+            messaging::MessageType::ROOM_CREATE, messaging::MessageType::ROOM_DESTROY,
+            messaging::MessageType::ROOM_JOIN, messaging::MessageType::ROOM_HISTORY,
+            messaging::MessageType::CHAT_SEND };
+
+        /**
+         * @brief Finds the position of \p message_type in LIMITED_TYPES.
+         * @param message_type The message type.
+         * @return Index into LIMITED_TYPES, or empty if the type can't be rate limited.
+         */
+        static constexpr std::optional<size_t> index_of(messaging::MessageType message_type) {
+            for (size_t i = 0; i < LIMITED_TYPES.size(); ++i) {
+                if (LIMITED_TYPES[i] == message_type) {
+                    return i;
+                }
+            }
+            return std::nullopt;
+        }
+
+        /**
+         * @brief Sets the limit for \p message_type.
+         * @param message_type One of LIMITED_TYPES; anything else is ignored.
+         * @param limit The limit.
+         */
+        void set(messaging::MessageType message_type, RateLimit limit) {
+            if (const std::optional<size_t> index = index_of(message_type)) {
+                this->limits[index.value()] = limit;
+            }
+        }
+
+        /**
+         * @brief Gets the limit for \p message_type.
+         * @param message_type The message type.
+         * @return RateLimit, which is unlimited if none was set or the type can't be rate limited.
+         */
+        RateLimit get(messaging::MessageType message_type) const {
+            const std::optional<size_t> index = index_of(message_type);
+            return index ? this->limits[index.value()] : RateLimit{};
+        }
+
+    private:
+        std::array<RateLimit, LIMITED_TYPES.size()> limits{};
+    };
+
+    /**
+     * @brief Enforces MessageRateLimits on the messages sent by one client, with a TokenBucket per message type.
+     * @note check() is meant for the one thread receiving the client's messages; it never allocates or locks.
+     * rejected_count() may be called from anywhere.
+     */
+    class MessageRateLimiter
+    {
+    public:
+        /**
+         * @brief Creates a limiter with every bucket full.
+         * @param limits The limits to enforce.
+         * @param now Current time.
+         */
+        explicit MessageRateLimiter(const MessageRateLimits& limits = {},
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+        MessageRateLimiter(const MessageRateLimiter&) = delete;
+
+        MessageRateLimiter& operator=(const MessageRateLimiter&) = delete;
+
+        /**
+         * @brief Checks if the client may send a message of type \p message_type now, and if so counts it.
+         * @param message_type The message type.
+         * @param now Current time.
+         * @return Zero if the message is allowed, otherwise how long until one will be (at least 1 ms).
+         */
+        std::chrono::milliseconds check(messaging::MessageType message_type, std::chrono::steady_clock::time_point now);
+
+        /**
+         * @brief Returns the number of messages refused so far.
+         * @return uint64_t
+         * @note Thread safe.
+         */
+        uint64_t rejected_count() const { return this->rejected.load(std::memory_order_relaxed); }
+
+    private:
+        std::array<TokenBucket, MessageRateLimits::LIMITED_TYPES.size()> buckets{};
+        std::atomic<uint64_t> rejected{ 0 };
+    };
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "connection.h"
+#include "queue.h"
+#include "timer-wheel.h"
+
+namespace tavernmx
+{
+	/// Native socket descriptor, as returned by BIO_get_fd().
+	using SocketHandle = int32_t;
+
+	/// Bit mask of socket readiness events.
+	using ReactorEvents = uint32_t;
+	/// The socket has data waiting to be read.
+	constexpr ReactorEvents REACTOR_READABLE = 0x1;
+	/// The socket can accept more outbound data.
+	constexpr ReactorEvents REACTOR_WRITABLE = 0x2;
+	/// The peer hung up or the socket is in an error state. Always reported, never needs to be requested.
+	constexpr ReactorEvents REACTOR_CLOSED = 0x4;
+
+	/// Callback invoked on the reactor thread when a registered socket becomes ready.
+	using ReactorHandler = std::function<void(ReactorEvents)>;
+
+	/**
+     * @brief Event loop that watches a set of non-blocking sockets and dispatches readiness events
+     * to their handlers. Uses epoll on Linux; other platforms fall back to poll() with a bounded wait.
+     * Also keeps a TimerWheel, for deadlines on the sockets it watches.
+     * @note add(), modify(), remove(), post() and wake() are thread safe. Handlers, posted tasks and timers
+     * are only ever run from inside run_once(), on the thread that calls it.
+     */
+	class Reactor
+	{
+	public:
+		/**
+         * @brief Creates a new Reactor with no registered sockets.
+         * @throws TransportError if the underlying event mechanism can't be created
+         */
+		Reactor();
+
+		~Reactor();
+
+		Reactor(const Reactor&) = delete;
+
+		Reactor& operator=(const Reactor&) = delete;
+
+		Reactor(Reactor&&) = delete;
+
+		Reactor& operator=(Reactor&&) = delete;
+
+		/**
+         * @brief Start watching \p fd for the events in \p interest. If \p fd is already registered,
+         * its interest and handler are replaced.
+         * @param fd non-blocking socket descriptor
+         * @param interest REACTOR_READABLE and/or REACTOR_WRITABLE
+         * @param handler function to call when \p fd becomes ready
+         * @throws TransportError if the socket can't be registered
+         */
+		void add(SocketHandle fd, ReactorEvents interest, ReactorHandler handler);
+
+		/**
+         * @brief Change the set of events watched for \p fd. Does nothing if \p fd isn't registered.
+         * @param fd socket descriptor previously passed to add()
+         * @param interest REACTOR_READABLE and/or REACTOR_WRITABLE
+         */
+		void modify(SocketHandle fd, ReactorEvents interest);
+
+		/**
+         * @brief Stop watching \p fd. Does nothing if \p fd isn't registered.
+         * @param fd socket descriptor previously passed to add()
+         * @note Must be called before the socket is closed, since the descriptor may be reused.
+         */
+		void remove(SocketHandle fd) noexcept;
+
+		/**
+         * @brief Queue \p task to run on the reactor thread and wake it up.
+         * @param task function to run during the next call to run_once()
+         */
+		void post(std::function<void()> task);
+
+		/**
+         * @brief Schedules \p task to run on the reactor thread at \p when. run_once() waits no longer than
+         * that for socket activity.
+         * @param when When to run \p task; it runs during the first call to run_once() after that.
+         * @param task function to run
+         * @return TimerId for cancel_timer().
+         * @note Only call from the reactor thread, e.g. from a handler, task or timer; elsewhere, post() a task
+         * that schedules the timer.
+         */
+		TimerId schedule(std::chrono::steady_clock::time_point when, std::function<void()> task);
+
+		/**
+         * @brief Cancels a timer set by schedule(), if it hasn't run yet.
+         * @param timer TimerId returned by schedule(), or NO_TIMER.
+         * @return true if the timer was cancelled, otherwise false.
+         * @note Only call from the reactor thread.
+         */
+		bool cancel_timer(TimerId timer) { return this->timers.cancel(timer); }
+
+		/**
+         * @brief Interrupts a run_once() call that is currently waiting, or causes the next
+         * one to return immediately.
+         */
+		void wake() noexcept;
+
+		/**
+         * @brief Waits for socket activity (or wake(), or the next timer) and dispatches any ready handlers,
+         * posted tasks and timers that are due.
+         * @param timeout maximum number of milliseconds to wait, or -1 to wait indefinitely
+         * @return the number of handlers, tasks and timers that were run
+         * @throws TransportError if waiting fails
+         */
+		size_t run_once(ssl::Milliseconds timeout);
+
+		/**
+         * @brief Returns the number of sockets currently registered.
+         * @return size_t
+         */
+		size_t size() const;
+
+	private:
+		struct Registration
+		{
+			ReactorEvents interest{};
+			std::shared_ptr<ReactorHandler> handler{};
+		};
+
+		std::unordered_map<SocketHandle, Registration> registrations{};
+		mutable std::mutex registrations_mutex{};
+		MpscQueue<std::function<void()>> tasks{};
+		TimerWheel timers{};
+		std::atomic<bool> wake_pending{ false };
+		SocketHandle poll_fd{ -1 };
+		SocketHandle wake_fd{ -1 };
+
+		std::shared_ptr<ReactorHandler> find_handler(SocketHandle fd) const;
+		size_t run_tasks();
+		ssl::Milliseconds wait_before_timers(ssl::Milliseconds timeout) const;
+	};
+}
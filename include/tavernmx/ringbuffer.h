@@ -1,8 +1,15 @@
 #pragma once
+#include <algorithm>
 #include <array>
+#include <bit>
+#include <compare>
 #include <concepts>
+#include <cstddef>
 #include <iterator>
 #include <memory>
+#include <span>
+#include <type_traits>
+#include <utility>
 
 namespace tavernmx
 {
@@ -12,34 +19,41 @@ namespace tavernmx
      * @tparam T Type to contain. Must be copy-constructible.
      * @tparam Capacity Maximum number of elements in the ring buffer. Note that the maximum
      * accessible elements will be 1 less than this number.
+     * @note Elements are constructed in place in storage embedded in the container, so inserting doesn't
+     * allocate (beyond whatever T itself allocates) and iteration walks contiguous memory. The storage is
+     * rounded up to a power of two so positions can be masked rather than divided.
      */
     template <typename T, size_t Capacity>
-        requires std::copy_constructible<T>
+        requires std::copy_constructible<T> && (Capacity > 1)
     class RingBuffer
     {
+        static constexpr size_t STORAGE_SIZE = std::bit_ceil(Capacity);
+        static constexpr size_t STORAGE_MASK = STORAGE_SIZE - 1;
+
     public:
         /**
-         * @brief Bi-directional iterator for RingBuffer<T, Capacity>.
+         * @brief Random-access iterator for RingBuffer<T, Capacity>. Iterates from the oldest element to the newest.
          */
         struct Iterator
         {
-            using iterator_category = std::bidirectional_iterator_tag;
-            using difference_type = std::size_t;
+            using iterator_category = std::random_access_iterator_tag;
+            using difference_type = std::ptrdiff_t;
             using value_type = T;
             using pointer = value_type*;
             using reference = value_type&;
 
+            Iterator() = default;
+
             Iterator(RingBuffer* buffer, size_t pos)
                 : _buffer{ buffer }, _pos{ pos } {
             };
 
-            reference operator*() const { return *_buffer->_data[_pos]; }
-            pointer operator->() { return _buffer->_data[_pos].get(); }
+            reference operator*() const { return this->_buffer->at_position(this->_pos); }
+            pointer operator->() const { return &this->_buffer->at_position(this->_pos); }
+            reference operator[](difference_type offset) const { return *(*this + offset); }
 
             Iterator& operator++() {
-                if (++this->_pos == this->_buffer->capacity()) {
-                    this->_pos = 0;
-                }
+                ++this->_pos;
                 return *this;
             }
 
@@ -50,11 +64,7 @@ namespace tavernmx
             }
 
             Iterator& operator--() {
-                if (this->_pos == 0) {
-                    this->_pos = this->_buffer->capacity() - 1;
-                } else {
-                    --this->_pos;
-                }
+                --this->_pos;
                 return *this;
             }
 
@@ -64,17 +74,70 @@ namespace tavernmx
                 return tmp;
             }
 
+            Iterator& operator+=(difference_type offset) {
+                this->_pos += static_cast<size_t>(offset);
+                return *this;
+            }
+
+            Iterator& operator-=(difference_type offset) {
+                this->_pos -= static_cast<size_t>(offset);
+                return *this;
+            }
+
+            friend Iterator operator+(Iterator it, difference_type offset) { return it += offset; }
+            friend Iterator operator+(difference_type offset, Iterator it) { return it += offset; }
+            friend Iterator operator-(Iterator it, difference_type offset) { return it -= offset; }
+
+            friend difference_type operator-(const Iterator& a, const Iterator& b) {
+                return static_cast<difference_type>(a._pos - b._pos);
+            }
+
             friend bool operator==(const Iterator& a, const Iterator& b) {
                 return a._buffer == b._buffer && a._pos == b._pos;
             };
 
-            friend bool operator!=(const Iterator& a, const Iterator& b) {
-                return a._buffer != b._buffer || a._pos != b._pos;
-            };
+            friend std::strong_ordering operator<=>(const Iterator& a, const Iterator& b) {
+                // positions never wrap, but compare the distance anyway so it stays correct if they ever do
+                return (a - b) <=> 0;
+            }
 
         private:
-            RingBuffer* _buffer;
-            size_t _pos;
+            RingBuffer* _buffer{ nullptr };
+            // not wrapped; see RingBuffer::_head
+            size_t _pos{ 0 };
+        };
+
+        /**
+         * @brief A run of consecutive elements, oldest first. The run may wrap around the end of the
+         * storage, so it is made of at most two contiguous segments.
+         */
+        struct View
+        {
+            /// The older part of the run.
+            std::span<T> first{};
+            /// The newer part of the run. Empty unless the run wraps.
+            std::span<T> second{};
+
+            /**
+             * @brief Returns the number of elements in the view.
+             * @return size_t
+             */
+            size_t size() const { return this->first.size() + this->second.size(); }
+
+            /**
+             * @brief Checks if the view has no elements.
+             * @return true if the view is empty, otherwise false.
+             */
+            bool empty() const { return this->first.empty() && this->second.empty(); }
+
+            /**
+             * @brief Returns the element at \p index, counting from the oldest element in the view.
+             * @param index Position in the view. Must be less than size().
+             * @return Reference to the element.
+             */
+            T& operator[](size_t index) const {
+                return index < this->first.size() ? this->first[index] : this->second[index - this->first.size()];
+            }
         };
 
         /**
@@ -82,15 +145,59 @@ namespace tavernmx
          */
         RingBuffer() = default;
 
+        ~RingBuffer() { this->reset(); }
+
+        RingBuffer(const RingBuffer& other) { *this = other; }
+
+        RingBuffer(RingBuffer&& other) noexcept(std::is_nothrow_move_constructible_v<T>) {
+            *this = std::move(other);
+        }
+
+        RingBuffer& operator=(const RingBuffer& other) {
+            if (this != &other) {
+                this->reset();
+                this->_head = this->_tail = other._tail;
+                for (size_t pos = other._tail; pos != other._head; ++pos) {
+                    std::construct_at(this->elements() + (pos & STORAGE_MASK), other.at_position(pos));
+                    ++this->_head;
+                }
+            }
+            return *this;
+        }
+
+        RingBuffer& operator=(RingBuffer&& other) noexcept(std::is_nothrow_move_constructible_v<T>) {
+            if (this != &other) {
+                this->reset();
+                this->_head = this->_tail = other._tail;
+                for (size_t pos = other._tail; pos != other._head; ++pos) {
+                    std::construct_at(this->elements() + (pos & STORAGE_MASK), std::move(other.at_position(pos)));
+                    ++this->_head;
+                }
+                other.reset();
+            }
+            return *this;
+        }
+
         /**
          * @brief Return a pointer to the oldest item in the buffer.
          * @return Pointer of type T. This will be nullptr if the container is empty.
          */
-        T* tail() const {
+        T* tail() {
             if (this->empty()) {
                 return nullptr;
             }
-            return this->_data[this->_tail].get();
+            return &this->at_position(this->_tail);
+        }
+
+        /**
+         * @brief Return a pointer to the oldest item in the buffer.
+         * @return Pointer of type T. This will be nullptr if the container is empty.
+         */
+        const T* tail() const {
+            if (this->empty()) {
+                return nullptr;
+            }
+            return &this->at_position(this->_tail);
         }
 
         /**
@@ -115,7 +222,7 @@ namespace tavernmx
          * @return true if the container is full, otherwise false.
          */
         bool full() const {
-            return (this->_head + 1) % this->capacity() == this->_tail;
+            return this->_head - this->_tail == Capacity - 1;
         }
 
         /**
@@ -123,8 +230,7 @@ namespace tavernmx
          * @param value Element value to insert.
          */
         void insert(const T& value) {
-            this->_data[this->_head] = std::make_unique<T>(value);
-            this->increment();
+            this->emplace(value);
         }
 
         /**
@@ -132,45 +238,97 @@ namespace tavernmx
          * @param value Element value to insert.
          */
         void insert(T&& value) {
-            this->_data[this->_head] = std::make_unique<T>(std::move(value));
-            this->increment();
+            this->emplace(std::move(value));
         }
 
         /**
-         * @brief Insert an element at the head of the container. The container takes ownership
-         * of \p pointer.
+         * @brief Insert an element at the head of the container. The value is moved out of \p pointer.
          * @param pointer Pointer to element value to insert.
          */
         void insert(std::unique_ptr<T> pointer) {
-            this->_data[this->_head] = std::move(pointer);
-            this->increment();
+            this->emplace(std::move(*pointer));
+        }
+
+        /**
+         * @brief Insert each element of a range at the head of the container, in order. If the range holds
+         * more elements than the container can, only the newest are kept; for sized ranges the older ones
+         * aren't even constructed.
+         * @param begin start of range (use std::make_move_iterator to move the elements)
+         * @param end end of range
+         */
+        template <typename InputIterator>
+            requires std::input_iterator<InputIterator> &&
+            std::constructible_from<T, std::iter_reference_t<InputIterator>>
+        void insert_range(InputIterator begin, InputIterator end) {
+            if constexpr (std::sized_sentinel_for<InputIterator, InputIterator>) {
+                if (const auto count = end - begin; std::cmp_greater(count, Capacity - 1)) {
+                    begin = std::next(begin, count - static_cast<std::iter_difference_t<InputIterator>>(Capacity - 1));
+                }
+            }
+            for (; begin != end; ++begin) {
+                this->emplace(*begin);
+            }
+        }
+
+        /**
+         * @brief Returns the element \p index places back from the head, i.e. [0] is the newest element.
+         * @param index Distance from the newest element. Must be less than the number of accessible elements.
+         * @return Reference to the element.
+         */
+        T& operator[](size_t index) {
+            return this->at_position(this->_head - 1 - index);
+        }
+
+        /**
+         * @brief Returns the element \p index places back from the head, i.e. [0] is the newest element.
+         * @param index Distance from the newest element. Must be less than the number of accessible elements.
+         * @return Reference to the element.
+         */
+        const T& operator[](size_t index) const {
+            return this->at_position(this->_head - 1 - index);
+        }
+
+        /**
+         * @brief Returns a view of the newest \p count elements (or all of them, if there are fewer), oldest
+         * first. Costs O(1); the view is invalidated by the next insert or reset().
+         * @param count Maximum number of elements in the view.
+         * @return RingBuffer::View
+         */
+        View last(size_t count) {
+            count = std::min(count, this->_head - this->_tail);
+            const size_t start = (this->_head - count) & STORAGE_MASK;
+            T* elements = this->elements();
+            if (start + count <= STORAGE_SIZE) {
+                return View{ .first = std::span<T>{ elements + start, count } };
+            }
+            const size_t first_count = STORAGE_SIZE - start;
+            return View{ .first = std::span<T>{ elements + start, first_count },
+                .second = std::span<T>{ elements, count - first_count } };
         }
 
         /**
          * @brief Erases all elements from the container. After this call, size() returns zero.
          */
         void reset() {
-            for (std::unique_ptr<T>& elem : this->_data) {
-                elem.reset();
+            if constexpr (!std::is_trivially_destructible_v<T>) {
+                for (size_t pos = this->_tail; pos != this->_head; ++pos) {
+                    std::destroy_at(&this->at_position(pos));
+                }
             }
-            this->_head = this->_tail;
+            this->_head = this->_tail = 0;
         }
 
         /**
          * @brief Returns the number of elements in the container.
          * @return
-         * @note size() will return the true number of elements allocated in the container.
-         * However, due to how the tail/head are managed, the true number of accessible elements
-         * will not exceed capacity() - 1.
+         * @note As with full(), a full container reports capacity(), even though the number of accessible
+         * elements will not exceed capacity() - 1.
          */
         size_t size() const {
             if (this->full()) {
                 return this->capacity();
             }
-            if (this->_head >= this->_tail) {
-                return this->_head - this->_tail;
-            }
-            return this->capacity() + this->_head - this->_tail;
+            return this->_head - this->_tail;
         }
 
         /**
@@ -208,19 +366,35 @@ namespace tavernmx
         }
 
     private:
-        std::array<std::unique_ptr<T>, Capacity> _data{};
+        /// Uninitialized storage for STORAGE_SIZE elements.
+        alignas(T) std::array<std::byte, sizeof(T) * STORAGE_SIZE> _data;
+        // _head and _tail count inserts and never wrap; masking them gives the storage position. The live
+        // elements are [_tail, _head).
         size_t _head{ 0 };
         size_t _tail{ 0 };
 
+        T* elements() { return reinterpret_cast<T*>(this->_data.data()); }
+
+        const T* elements() const { return reinterpret_cast<const T*>(this->_data.data()); }
+
+        T& at_position(size_t pos) { return this->elements()[pos & STORAGE_MASK]; }
+
+        const T& at_position(size_t pos) const { return this->elements()[pos & STORAGE_MASK]; }
+
         /**
-         * @brief Increments the head of the container. Increments the tail as well once the
+         * @brief Constructs an element at the head of the container. Destroys the oldest element once the
          * container is full.
          */
-        void increment() {
-            this->_head = (this->_head + 1) % this->capacity();
-            if (this->_tail == this->_head) {
-                this->_tail = (this->_tail + 1) % this->capacity();
+        template <typename... Args>
+        void emplace(Args&&... args) {
+            // storage always has a free slot at the head, so construct before destroying in case args refer
+            // to the element being dropped
+            std::construct_at(this->elements() + (this->_head & STORAGE_MASK), std::forward<Args>(args)...);
+            if (this->full()) {
+                std::destroy_at(&this->at_position(this->_tail));
+                ++this->_tail;
             }
+            ++this->_head;
         };
     };
 }
@@ -0,0 +1,294 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "epoch.h"
+#include "room.h"
+
+namespace tavernmx::rooms
+{
+    /**
+     * @brief Interns strings, so that each distinct one is stored once and can be referred to by a small ID.
+     * @note intern() is thread safe. Looking up an ID never takes a lock: IDs are only handed out once their
+     * string is in place, and strings are never moved or removed.
+     */
+    class SymbolTable
+    {
+    public:
+        /// Number of strings allocated together.
+        static constexpr size_t PAGE_SIZE = 1024;
+        /// Maximum number of pages, which bounds the number of distinct strings.
+        static constexpr size_t MAX_PAGES = 4096;
+
+        SymbolTable() = default;
+
+        ~SymbolTable();
+
+        SymbolTable(const SymbolTable&) = delete;
+
+        SymbolTable& operator=(const SymbolTable&) = delete;
+
+        /**
+         * @brief Returns the ID of \p symbol, adding it to the table if this is its first use.
+         * @param symbol The string.
+         * @return uint32_t
+         * @throws std::length_error if the table is full
+         */
+        uint32_t intern(std::string_view symbol);
+
+        /**
+         * @brief Returns the string with ID \p id.
+         * @param id An ID returned by intern().
+         * @return std::string_view, valid for the lifetime of the table.
+         */
+        std::string_view operator[](uint32_t id) const {
+            return this->pages[id / PAGE_SIZE].load(std::memory_order_acquire)->symbols[id % PAGE_SIZE];
+        }
+
+        /**
+         * @brief Returns the number of distinct strings interned.
+         * @return size_t
+         */
+        size_t size() const;
+
+    private:
+        struct Page
+        {
+            std::array<std::string, PAGE_SIZE> symbols{};
+        };
+
+        struct StringHash : std::hash<std::string_view>
+        {
+            using is_transparent = void;
+        };
+
+        std::array<std::atomic<Page*>, MAX_PAGES> pages{};
+        // views into the pages, which never move
+        std::unordered_map<std::string_view, uint32_t, StringHash, std::equal_to<>> ids{};
+        mutable std::shared_mutex ids_mutex{};
+    };
+
+    /**
+     * @brief A RoomEvent as held by a RoomEventStore, referring to the store's memory instead of owning it.
+     */
+    struct RoomEventView
+    {
+        /// Timestamp of the event.
+        EventTimeStamp timestamp{};
+
+        /// The user that originated the event, if any.
+        std::string_view origin_user_name{};
+
+        /// Event text to be displayed, if any.
+        std::string_view event_text{};
+    };
+
+    /**
+     * @brief Holds the newest events of a chat room, up to a capacity chosen at runtime, with one writer and
+     * any number of concurrent readers. Neither side takes a lock.
+     * @note Events are stored by column in blocks: timestamps in one packed array, user names as IDs into a
+     * SymbolTable shared between rooms, and text back to back in an arena with an end offset per event.
+     * Blocks start small and double in size (up to MAX_BLOCK_EVENTS events) as the room gets busier.
+     * @note Events are immutable once inserted, and a block is only unlinked once all of its events have been
+     * evicted, so readers never see an event change under them. Unlinked blocks are freed by epochs, see
+     * EpochDomain in epoch.h.
+     */
+    class RoomEventStore
+    {
+    public:
+        /// Number of events the first block holds.
+        static constexpr size_t MIN_BLOCK_EVENTS = 8;
+        /// Maximum number of events a block holds.
+        static constexpr size_t MAX_BLOCK_EVENTS = 128;
+        /// Text bytes per event reserved in the first block.
+        static constexpr size_t INITIAL_TEXT_BYTES = 32;
+
+        /**
+         * @brief Create a new RoomEventStore.
+         * @param capacity Number of events kept; the oldest is evicted by each insert once it is full. At least 1.
+         * @param user_names (copied) Table the user names of events are interned in.
+         */
+        RoomEventStore(size_t capacity, std::shared_ptr<SymbolTable> user_names);
+
+        /**
+         * @brief Frees every block. There must be no readers left.
+         */
+        ~RoomEventStore();
+
+        RoomEventStore(const RoomEventStore&) = delete;
+
+        RoomEventStore& operator=(const RoomEventStore&) = delete;
+
+        /**
+         * @brief Returns the maximum number of events that can be held.
+         * @return size_t
+         */
+        size_t capacity() const {
+            return this->max_events;
+        }
+
+        /**
+         * @brief Returns the number of events currently held.
+         * @return size_t
+         * @note Thread safe.
+         */
+        size_t size() const {
+            return std::min<uint64_t>(this->head.load(std::memory_order_acquire), this->max_events);
+        }
+
+        /**
+         * @brief Checks if the container has no events.
+         * @return true if the container is empty, otherwise false.
+         * @note Thread safe.
+         */
+        bool empty() const {
+            return this->head.load(std::memory_order_acquire) == 0;
+        }
+
+        /**
+         * @brief Returns the number of events ever inserted, which changes whenever the contents do.
+         * @return uint64_t
+         * @note Thread safe.
+         */
+        uint64_t insert_count() const {
+            return this->head.load(std::memory_order_acquire);
+        }
+
+        /**
+         * @brief Returns the number of bytes allocated by the container, including event text but not the
+         * shared SymbolTable.
+         * @return size_t
+         * @note Thread safe.
+         */
+        size_t storage_bytes() const;
+
+        /**
+         * @brief Insert an event, evicting the oldest if the container is full.
+         * @param event The event.
+         * @note Only one thread may insert.
+         */
+        void insert(const RoomEvent& event);
+
+        /**
+         * @brief Calls \p visitor with each of the newest \p count events (or all of them, if there are fewer),
+         * oldest first. The events form a consistent snapshot of the container as of some point during the call.
+         * @param count Maximum number of events to visit.
+         * @param visitor Function taking const RoomEventView&, which is only valid during the call. Must not
+         * insert into this container.
+         * @return Number of events visited.
+         * @note Thread safe, and never blocks the writer.
+         */
+        template <typename Visitor>
+        size_t read_last(size_t count, Visitor&& visitor) const {
+            const EpochDomain::ReadGuard guard{ this->epochs };
+            uint64_t begin{};
+            uint64_t end{};
+            std::vector<const Block*> blocks{};
+            for (bool lapped = true; lapped;) {
+                // blocks and their slots are published before head moves into them
+                end = this->head.load(std::memory_order_acquire);
+                begin = end - std::min<uint64_t>({ count, end, this->max_events });
+                blocks.clear();
+                lapped = false;
+                if (begin == end) {
+                    break;
+                }
+                const uint64_t block_end = this->block_count.load(std::memory_order_acquire);
+                const Storage* current = this->storage.load();
+                for (uint64_t number = block_end; number-- != 0;) {
+                    // seq_cst, so it is ordered against the announcement in ReadGuard; see EpochDomain
+                    const Block* block = current->at(number).load();
+                    if (block == nullptr || block->number != number) {
+                        // evicted since end was read; start over from the new head
+                        lapped = true;
+                        break;
+                    }
+                    if (block->first_position < end) {
+                        blocks.push_back(block);
+                    }
+                    if (block->first_position <= begin) {
+                        break;
+                    }
+                }
+            }
+
+            const SymbolTable& names = *this->user_names;
+            for (size_t b = blocks.size(); b-- != 0;) {
+                const Block& events = *blocks[b];
+                // a block ends where the next one starts, which may be before it is full
+                const uint64_t events_end = b == 0 ? end : std::min(end, blocks[b - 1]->first_position);
+                for (uint64_t pos = std::max(begin, events.first_position); pos < events_end; ++pos) {
+                    const uint64_t i = pos - events.first_position;
+                    const uint32_t text_begin = i == 0 ? 0 : events.text_ends[i - 1];
+                    const RoomEventView event{ .timestamp = EventTimeStamp{ std::chrono::seconds{ events.timestamps[i] } },
+                        .origin_user_name = names[events.user_ids[i]],
+                        .event_text = std::string_view{ events.text.get() + text_begin, events.text_ends[i] - text_begin } };
+                    std::invoke(visitor, event);
+                }
+            }
+            return end - begin;
+        }
+
+    private:
+        /// A run of consecutive events, stored by column.
+        struct Block
+        {
+            Block(uint64_t number, uint64_t first_position, size_t event_capacity, size_t text_capacity);
+
+            /// Number of blocks created before this one.
+            uint64_t number;
+            /// Position of the block's first event.
+            uint64_t first_position;
+            size_t event_capacity;
+            size_t text_capacity;
+            /// Writer only: bytes of text used so far.
+            size_t text_size{ 0 };
+            std::unique_ptr<int64_t[]> timestamps;
+            std::unique_ptr<uint32_t[]> user_ids;
+            /// Offset just past each event's text; each event's text starts where the previous one ends.
+            std::unique_ptr<uint32_t[]> text_ends;
+            std::unique_ptr<char[]> text;
+        };
+
+        /// Slot array; block number n is in slot (n & mask).
+        struct Storage
+        {
+            explicit Storage(size_t size) : mask{ size - 1 }, slots{ std::make_unique<std::atomic<Block*>[]>(size) } {
+            }
+
+            size_t size() const { return this->mask + 1; }
+
+            std::atomic<Block*>& at(uint64_t number) const { return this->slots[number & this->mask]; }
+
+            size_t mask;
+            std::unique_ptr<std::atomic<Block*>[]> slots;
+        };
+
+        size_t max_events;
+        std::shared_ptr<SymbolTable> user_names;
+        std::atomic<Storage*> storage{ nullptr };
+        // head counts inserts and never wraps; the live events are [head - size(), head)
+        alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> head{ 0 };
+        // blocks [oldest_block, block_count) are linked in storage
+        std::atomic<uint64_t> block_count{ 0 };
+        EpochDomain epochs{};
+        // writer only
+        uint64_t oldest_block{ 0 };
+        Block* newest_block{ nullptr };
+        RetiredList<Block> retired_blocks{};
+        RetiredList<Storage> retired_storage{};
+
+        Block* start_block(uint64_t position, size_t text_size);
+        void evict_blocks(uint64_t end);
+        void reclaim();
+    };
+}
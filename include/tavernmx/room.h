@@ -5,6 +5,7 @@
 #include <memory>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace tavernmx::rooms
@@ -108,6 +109,8 @@ namespace tavernmx::rooms
     /**
      * @brief Manages a set of chat rooms.
      * @tparam T Type derived from Room and constrained by IsRoom<T>.
+     * @note Rooms are indexed by name for constant-time lookup. rooms() and room_names() list the rooms
+     * in the order they were created and are kept up to date as rooms come and go.
      */
     template <typename T>
         requires IsRoom<T>
@@ -135,15 +138,14 @@ namespace tavernmx::rooms
          * RoomManager and be a valid room name (see is_valid_room_name(std::string)).
          */
         std::shared_ptr<T> create_room(std::string_view room_name) {
-            if (!is_valid_room_name(room_name)) {
-                return nullptr;
-            }
-            if (std::find(std::cbegin(this->_room_names), std::cend(this->_room_names), room_name) !=
-                std::cend(this->_room_names)) {
+            if (!is_valid_room_name(room_name) || this->room_index.contains(room_name)) {
                 return nullptr;
             }
+            std::shared_ptr<T> room = std::make_shared<T>(room_name);
+            // keyed by a view of the room's own name, which lives as long as the room does
+            this->room_index.emplace(room->room_name(), room);
             this->_room_names.emplace_back(room_name);
-            return this->active_rooms.emplace_back(std::move(std::make_shared<T>(room_name)));
+            return this->active_rooms.emplace_back(std::move(room));
         }
 
         /**
@@ -168,12 +170,8 @@ namespace tavernmx::rooms
          * @return A std::shared_ptr<T> if the room is found, otherwise nullptr.
          */
         std::shared_ptr<T> operator[](std::string_view room_name) const {
-            auto it = std::find_if(std::cbegin(this->active_rooms), std::cend(this->active_rooms),
-                [&room_name](const std::shared_ptr<T>& room) {
-                    return room->room_name() == room_name;
-                });
-            if (it != std::cend(this->active_rooms)) {
-                return *it;
+            if (const auto it = this->room_index.find(room_name); it != std::cend(this->room_index)) {
+                return it->second;
             }
             return nullptr;
         }
@@ -182,22 +180,49 @@ namespace tavernmx::rooms
          * @brief Remove all active chat rooms.
          */
         void clear() {
+            this->room_index.clear();
             this->active_rooms.clear();
             this->_room_names.clear();
         }
 
+        /**
+         * @brief Remove the room named \p room_name right away, so a new room can be created with its name.
+         * @param room_name The unique name of the chat room.
+         * @return The removed room, or nullptr if there was no such room.
+         */
+        std::shared_ptr<T> remove_room(std::string_view room_name) {
+            const auto it = this->room_index.find(room_name);
+            if (it == std::end(this->room_index)) {
+                return nullptr;
+            }
+            std::shared_ptr<T> room = std::move(it->second);
+            // the index is keyed by a view of the room's own name, so it goes first
+            this->room_index.erase(it);
+            std::erase(this->_room_names, room->room_name());
+            std::erase(this->active_rooms, room);
+            return room;
+        }
+
         /**
          * @brief Remove all rooms marked for destruction.
          */
         void remove_destroyed_rooms() {
-            if (std::erase_if(this->active_rooms, [](const std::shared_ptr<Room>& room) {
-                return room->is_destroy_requested();
-            }) > 0) {
-                this->_room_names.clear();
-                for (std::shared_ptr<T>& room : this->active_rooms) {
-                    this->_room_names.push_back(room->room_name());
+            size_t removed = 0;
+            for (const std::shared_ptr<T>& room : this->active_rooms) {
+                if (room->is_destroy_requested()) {
+                    this->room_index.erase(room->room_name());
+                    ++removed;
                 }
             }
+            if (removed > 0) {
+                // names are erased before the rooms that own the indexed views
+                std::erase_if(this->_room_names, [this](const std::string& room_name) {
+                    return !this->room_index.contains(room_name);
+                });
+                std::erase_if(this->active_rooms, [](const std::shared_ptr<T>& room) {
+                    return room->is_destroy_requested();
+                });
+            }
         }
 
         /**
@@ -209,6 +234,7 @@ namespace tavernmx::rooms
         }
 
     private:
+        std::unordered_map<std::string_view, std::shared_ptr<T>> room_index{};
         std::vector<std::shared_ptr<T>> active_rooms{};
         std::vector<std::string> _room_names{};
     };
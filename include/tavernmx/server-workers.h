@@ -4,15 +4,50 @@
 namespace tavernmx::server
 {
     /**
-     * @brief Handles sending and receiving messages to a specific client.
+     * @brief Attaches a newly accepted client to its reactor and returns right away. From then on the
+     * connection only runs when its socket is ready: the reactor completes the TLS handshake and HELLO
+     * exchange, then sends and receives messages. ROOM_HISTORY requests are answered on the reactor thread
+     * straight from \p room_histories.
      * @param client (copied) An active client connection.
+     * @param room_histories (copied) Directory of chat room histories.
      */
-    void client_worker(std::shared_ptr<ClientConnection> client);
+    void client_worker(std::shared_ptr<ClientConnection> client, std::shared_ptr<RoomHistoryDirectory> room_histories);
 
     /**
-     * @brief Main server work process that handles distributing messages to all clients.
+     * @brief Runs one of the reactors that service attached client sockets until the server stops
+     * accepting connections.
+     * @param connections (copied) Manager of active client connections.
+     * @param reactor (copied) The reactor to run, one of ClientConnectionManager::get_reactors().
+     */
+    void reactor_worker(std::shared_ptr<ClientConnectionManager> connections, std::shared_ptr<Reactor> reactor);
+
+    /**
+     * @brief Processes the commands routed to one shard of the chat rooms: joins, history requests and
+     * chat lines, plus room creation and destruction. Fans room events out to joined clients.
+     * @param shard (copied) The shard to service. Runs until RoomShard::stop() is called, or until an exception,
+     * which marks the shard failed with RoomShard::fail().
+     * @param room_histories (copied) Directory the shard publishes the history of its rooms to.
+     * @param history_writer (copied) Writer for durable room history logs, or nullptr to keep history in
+     * memory only. Each room's history is recovered from its log when the room is created.
+     * @param config Current server configuration. Must outlive the worker.
+     */
+    void room_worker(std::shared_ptr<RoomShard> shard, std::shared_ptr<RoomHistoryDirectory> room_histories,
+        std::shared_ptr<rooms::HistoryLogWriter> history_writer, const ServerConfiguration& config);
+
+    /**
+     * @brief Main server work process that gathers messages from all clients. Maintains the global room
+     * list and routes room commands to the room workers, one per shard. Stops, releasing server_shutdown_signal,
+     * if a room worker has failed.
      * @param config Current server configuration.
      * @param connections (copied) Manager of active client connections.
      */
     void server_worker(const ServerConfiguration& config, std::shared_ptr<ClientConnectionManager> connections);
+
+    /**
+     * @brief Serves the server's metrics in the Prometheus text format, over HTTP on \p port of 127.0.0.1 only,
+     * until the server stops accepting connections. Each scrape renders server_metrics() afresh.
+     * @param connections (copied) Manager of active client connections.
+     * @param port Local TCP port to listen on.
+     */
+    void metrics_worker(std::shared_ptr<ClientConnectionManager> connections, int32_t port);
 }
\ No newline at end of file
@@ -2,12 +2,24 @@
 #define TMX_SERVER
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <shared_mutex>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 
+#include "history-log.h"
+#include "metrics.h"
+#include "outbound-queue.h"
+#include "rate-limit.h"
 #include "ringbuffer.h"
+#include "room-event-store.h"
 #include "shared.h"
 
 using namespace std::string_literals;
@@ -86,6 +98,11 @@ namespace tavernmx::server
          */
 		std::optional<std::string> log_file{};
 		/**
+         * @brief If specified, a directory where chat room history is logged, so rooms and their history
+         * survive a restart.
+         */
+		std::optional<std::string> history_path{};
+		/**
          * @brief File system path to the server's SSL certificate.
          */
 		std::string host_certificate_path{};
@@ -94,25 +111,278 @@ namespace tavernmx::server
          */
 		std::string host_private_key_path{};
 		/**
-         * @brief Max number of simultaneous client connections to support. Defaults to 10.
+         * @brief Max number of simultaneous client connections admitted. Further connections are turned
+         * away; it has no bearing on the number of threads. Defaults to 10.
          */
 		std::int32_t max_clients{};
 		/**
+         * @brief Number of reactor threads that client connections are spread across. Defaults to the
+         * number of hardware threads.
+         */
+		std::int32_t reactor_threads{};
+		/**
+         * @brief Max number of TLS handshakes in progress at once. Further connections wait in the listen
+         * backlog, so a burst of reconnecting clients is admitted at the rate handshakes complete, rather
+         * than all of them running past their deadline together. Defaults to 256.
+         */
+		std::int32_t max_handshakes{};
+		/**
+         * @brief Seconds an identified client may go without sending anything before the server sends it a
+         * HEARTBEAT to check it is still there. 0 turns server heartbeats off. Defaults to 30.
+         */
+		std::int32_t heartbeat_seconds{};
+		/**
+         * @brief Seconds a client has to answer a server HEARTBEAT (with anything) before it is considered
+         * dead and disconnected. Defaults to 15.
+         */
+		std::int32_t heartbeat_timeout_seconds{};
+		/**
+         * @brief Seconds a client socket may be idle before the operating system starts sending TCP keepalive
+         * probes, which catch peers that vanished even while the server has nothing to send. 0 turns TCP
+         * keepalive off. Defaults to 60.
+         */
+		std::int32_t tcp_keepalive_seconds{};
+		/**
+         * @brief Max number of messages from one client that the server worker processes before moving on to
+         * the next client, in each round of a loop. Defaults to 32.
+         */
+		std::int32_t client_message_budget{};
+		/**
+         * @brief Max number of client messages the server worker processes per loop, shared between clients
+         * round robin. The rest wait for the next loop. Defaults to 2048.
+         */
+		std::int32_t loop_message_budget{};
+		/**
          * @brief Set of chat rooms to create at startup.
          */
 		std::vector<std::string> initial_rooms{};
+		/**
+         * @brief Number of room worker threads that chat rooms are spread across. Defaults to the number
+         * of hardware threads.
+         */
+		std::int32_t room_shards{};
+		/**
+         * @brief Maximum number of events of history kept for each chat room. Defaults to 1000.
+         */
+		std::int32_t room_history_size{};
+		/**
+         * @brief Overrides room_history_size for specific chat rooms, by name.
+         */
+		std::map<std::string, std::int32_t, std::less<>> room_history_sizes{};
+		/**
+         * @brief How much may be queued for each client before it counts as a slow consumer, and what is done
+         * about it. Read from "client_queue_bytes" (default 1 MiB), "client_queue_messages" (default 1024) and
+         * "slow_client_policy" ("drop_oldest", the default, "degrade" or "disconnect").
+         */
+		OutboundLimits outbound_limits{};
+		/**
+         * @brief How fast each client may send each kind of message that costs the server work. Read from
+         * "rate_limits", an object keyed by message type ("CHAT_SEND", "ROOM_CREATE", "ROOM_DESTROY",
+         * "ROOM_JOIN", "ROOM_HISTORY" or "ROOM_LIST"), each holding "per_second" and "burst". Types left out
+         * keep their defaults; a per_second of 0 lifts the limit.
+         */
+		MessageRateLimits rate_limits{};
+		/**
+         * @brief Local TCP port that serves the server's metrics to Prometheus, on 127.0.0.1 only. 0 turns the
+         * endpoint off. Defaults to 0.
+         */
+		std::int32_t metrics_port{};
+		/**
+         * @brief Seconds between summaries of the server's metrics written to the log (at "info"). 0 turns
+         * them off. Defaults to 60.
+         */
+		std::int32_t metrics_log_seconds{};
+
+		/**
+         * @brief Determines how many events of history to keep for \p room_name.
+         * @param room_name The room's unique name.
+         * @return The room's entry in room_history_sizes if it has one, otherwise room_history_size.
+         */
+		size_t room_history_capacity(std::string_view room_name) const {
+			const auto it = this->room_history_sizes.find(room_name);
+			return static_cast<size_t>(it == this->room_history_sizes.end() ? this->room_history_size : it->second);
+		}
+	};
+
+	/**
+     * @brief Stages a client connection goes through before its messages are processed.
+     */
+	enum class ClientConnectionState
+	{
+		/// The TLS handshake is in progress.
+		Handshaking,
+		/// The TLS handshake is done; the client has yet to send HELLO.
+		AwaitingHello,
+		/// The client has sent HELLO and its messages are processed.
+		Identified,
+	};
+
+	/**
+     * @brief How the server checks that identified clients are still there. Each connection keeps a timer on
+     * its Reactor for this, so quiet clients cost nothing until their timer is due.
+     */
+	struct ConnectionLiveness
+	{
+		/// How long a client may send nothing before it is sent a HEARTBEAT; zero turns heartbeats off.
+		std::chrono::seconds heartbeat_interval{};
+		/// How long a client then has to send anything before it is disconnected.
+		std::chrono::seconds heartbeat_timeout{};
+	};
+
+	/**
+     * @brief Counts the TLS handshakes in progress on the server's connections, so the accept loop can hold
+     * new connections back while too many are, and sleep until one finishes.
+     */
+	class HandshakeTracker
+	{
+	public:
+		/**
+         * @brief Records that a connection has started its TLS handshake.
+         * @note Thread safe.
+         */
+		void begin() noexcept { ++this->in_flight; }
+
+		/**
+         * @brief Records that a handshake has completed or been abandoned, waking wait_for_room().
+         * @note Thread safe. Must be called once for each call to begin().
+         */
+		void finish() noexcept {
+			--this->in_flight;
+			this->finished.notify();
+		}
+
+		/**
+         * @brief Returns the number of handshakes in progress.
+         * @return size_t
+         * @note Thread safe.
+         */
+		size_t count() const noexcept { return this->in_flight; }
+
+		/**
+         * @brief Waits until fewer than \p limit handshakes are in progress, or \p deadline passes.
+         * @param limit Maximum number of handshakes in progress.
+         * @param deadline Latest time to wait until.
+         * @return The number of handshakes in progress, which is \p limit or more if the deadline passed.
+         * @note Only one thread at a time should wait.
+         */
+		size_t wait_for_room(size_t limit, std::chrono::steady_clock::time_point deadline) {
+			// a handshake that finished while nobody was waiting is already counted
+			this->finished.try_acquire();
+			size_t handshakes = this->count();
+			while (handshakes >= limit && this->finished.wait_until(deadline)) {
+				handshakes = this->count();
+			}
+			return handshakes;
+		}
+
+	private:
+		std::atomic<size_t> in_flight{ 0 };
+		QueueSignal finished{};
+	};
+
+	/**
+     * @brief Closed connections released by one call to ClientConnectionManager::release_connections().
+     */
+	struct ReapedConnections
+	{
+		/// Connections that were disconnected for not completing the TLS handshake, or sending HELLO, in time.
+		size_t expired{};
+		/// Connections that were disconnected for not answering a HEARTBEAT.
+		size_t unresponsive{};
+		/// Closed connections released, along with their queues and room memberships, for any reason.
+		size_t released{};
+	};
+
+	/**
+     * @brief Metrics recorded by the server as it runs, all registered in one MetricsRegistry. Recording to
+     * them is a relaxed atomic increment, cheap enough for every message.
+     */
+	class ServerMetrics
+	{
+	public:
+		/// Every metric below, and any registered elsewhere in the server, such as per room shard.
+		metrics::MetricsRegistry registry{};
+		/// Time taken by a whole server worker loop, not counting its sleep.
+		metrics::Histogram& loop_time;
+		/// Time taken by Step 1 of the server worker loop: gathering and routing client messages.
+		metrics::Histogram& gather_time;
+		/// Time taken by Step 2: announcing new and destroyed rooms.
+		metrics::Histogram& announce_time;
+		/// Time taken by Step 3: handing routed commands to the room workers.
+		metrics::Histogram& route_time;
+		/// Time taken by Step 4: waking reactors to flush client queues.
+		metrics::Histogram& notify_time;
+		/// Time taken by Step 5: housekeeping.
+		metrics::Histogram& housekeeping_time;
+		/// Time from accepting a connection to completing its TLS handshake.
+		metrics::Histogram& handshake_time;
+		/// Number of clients each frame of chat echoes is queued for.
+		metrics::Histogram& fanout;
+		/// Bytes of message blocks received from clients.
+		metrics::Counter& bytes_received;
+		/// Bytes of frames handed to client sockets.
+		metrics::Counter& bytes_sent;
+		/// ROOM_HISTORY requests answered by a reactor, from the published history.
+		metrics::Counter& history_from_reactor;
+		/// ROOM_HISTORY requests answered by a room worker, because the reactor couldn't.
+		metrics::Counter& history_from_room_worker;
+		/// Number of client connections being tracked.
+		metrics::Gauge& active_connections;
+		/// Number of client connections in their TLS handshake.
+		metrics::Gauge& handshakes;
+		/// Frames queued for all clients.
+		metrics::Gauge& queued_frames;
+		/// Bytes queued for all clients.
+		metrics::Gauge& queued_bytes;
+		/// Bytes queued for the client furthest behind.
+		metrics::Gauge& deepest_queue_bytes;
+
+		/**
+         * @brief Registers the server's metrics.
+         */
+		ServerMetrics();
+
+		ServerMetrics(const ServerMetrics&) = delete;
+
+		ServerMetrics& operator=(const ServerMetrics&) = delete;
+
+		/**
+         * @brief Counts a message of type \p message_type received from a client.
+         * @param message_type MessageType
+         */
+		void count_received(messaging::MessageType message_type) {
+			const auto it = std::find(messaging::ALL_MESSAGE_TYPES.begin(), messaging::ALL_MESSAGE_TYPES.end(),
+				message_type);
+			if (it != messaging::ALL_MESSAGE_TYPES.end()) {
+				this->messages_received[it - messaging::ALL_MESSAGE_TYPES.begin()]->add();
+			}
+		}
+
+	private:
+		std::array<metrics::Counter*, messaging::ALL_MESSAGE_TYPES.size()> messages_received{};
 	};
 
+	/**
+     * @brief Gets the metrics of this server process.
+     * @return ServerMetrics
+     * @note Thread safe.
+     */
+	ServerMetrics& server_metrics();
+
+	class ClientConnection;
+
+	/// Clients with messages waiting that the server worker hasn't picked up yet, each listed once.
+	using ReadyClients = MpscQueue<std::weak_ptr<ClientConnection>>;
+
 	/**
      * @brief Manages an individual connection to a tavernmx client.
      */
-	class ClientConnection : public BaseConnection
+	class ClientConnection : public BaseConnection, public std::enable_shared_from_this<ClientConnection>
 	{
 	public:
-		/// Queue of messages received from the client.
-		ThreadSafeQueue<messaging::Message> messages_in{};
-		/// Queue of messages to be sent to the client.
-		ThreadSafeQueue<messaging::Message> messages_out{};
+		/// Queue of messages received from the client. Filled by push_inbound() on the reactor thread, drained by
+		/// the server worker.
+		SpscQueue<messaging::Message> messages_in{};
 		/// User name utilizing this connection.
 		std::string connected_user_name{};
 
@@ -120,16 +390,467 @@ namespace tavernmx::server
          * @brief Creates a ClientConnection representing the given \p client_bio.
          * @param client_bio An active BIO generated by the server's accept BIO. This class
          * takes ownership of it.
+         * @param reactor The Reactor that will service this connection's socket once attach() is called.
+         * @param ready_clients Where the client lists itself when it has messages waiting, usually shared by
+         * every client so the server worker only visits those, and can sleep until any of them sends something.
+         * @param outbound_limits Limits on the frames queued for the client, see queue_frame().
+         * @param rate_limits How fast the client may send each kind of message, see check_rate().
+         * @param liveness How long the client may be quiet once identified.
+         * @param handshakes Tracker the connection's TLS handshake is counted in until it completes or the
+         * connection closes, or nullptr.
          */
-		explicit ClientConnection(ssl::ssl_unique_ptr<BIO> client_bio) { this->bio = std::move(client_bio); };
+		ClientConnection(ssl::ssl_unique_ptr<BIO> client_bio, std::shared_ptr<Reactor> reactor,
+			std::shared_ptr<ReadyClients> ready_clients = std::make_shared<ReadyClients>(),
+			OutboundLimits outbound_limits = {}, const MessageRateLimits& rate_limits = {},
+			ConnectionLiveness liveness = {}, std::shared_ptr<HandshakeTracker> handshakes = nullptr)
+			: reactor{ std::move(reactor) },
+			  ready_clients{ std::move(ready_clients) },
+			  handshakes{ std::move(handshakes) },
+			  outbound_frames{ outbound_limits },
+			  rate_limiter{ rate_limits },
+			  liveness{ liveness },
+			  deadline{ std::chrono::steady_clock::now() + std::chrono::milliseconds{ ssl::SSL_TIMEOUT_MILLISECONDS } },
+			  last_received{ std::chrono::steady_clock::now() } {
+			this->bio = std::move(client_bio);
+			if (this->handshakes) {
+				this->handshakes->begin();
+				this->handshake_counted = true;
+			}
+		};
+
+		~ClientConnection() override { this->finish_handshake(); }
 
 		ClientConnection(const ClientConnection&) = delete;
 
 		ClientConnection& operator=(const ClientConnection& other) = delete;
 
-		ClientConnection(ClientConnection&&) = default;
+		ClientConnection(ClientConnection&&) = delete;
+
+		ClientConnection& operator=(ClientConnection&&) = delete;
+
+		/**
+         * @brief Registers this connection's socket with its Reactor. From this point on, \p handler
+         * is called on the reactor thread whenever the socket becomes readable or is closed, and the client
+         * is disconnected if it doesn't complete the TLS handshake in time.
+         * @param handler function to handle socket events
+         * @throws TransportError if the socket can't be registered
+         */
+		void attach(ReactorHandler handler);
+
+		/**
+         * @brief Unregisters this connection's socket from its Reactor. Safe to call more than once.
+         */
+		void detach() noexcept;
+
+		/**
+         * @brief Detaches the connection, shuts it down and marks it closed, which is how every connection ends.
+         * @note Should only be called on the reactor thread once attached; the BIO is only touched there.
+         */
+		void close() noexcept;
+
+		/**
+         * @brief Checks if close() has been called. Unlike is_connected(), this doesn't touch the BIO.
+         * @return true if the connection is closed, otherwise false.
+         * @note Thread safe.
+         */
+		bool is_closed() const { return this->closed; }
+
+		/**
+         * @brief Queues \p message for the server worker. The first message since the worker last ran out of
+         * the client's messages also puts the client on the ready list, which wakes the worker.
+         * @param message (moved) Message received from the client.
+         * @note Should only be called on the reactor thread.
+         */
+		void push_inbound(messaging::Message message);
+
+		/**
+         * @brief Takes the client off the ready list once the server worker has drained messages_in. If more
+         * messages arrived meanwhile, the client goes straight back on it instead.
+         * @note Should only be called by the server worker.
+         */
+		void end_turn();
+
+		/**
+         * @brief Queues an encoded \p frame to be sent to the client. Frames may be shared with other clients.
+         * If the client has fallen so far behind that its queue overflows, it is disconnected instead.
+         * @param frame The encoded frame; must not hold chat echoes, which go to queue_chat_echoes().
+         * @note Thread safe. Nothing is sent until notify_outbound() or flush_messages() is called.
+         */
+		void queue_frame(messaging::Frame frame) { this->queue_outbound(std::move(frame), 0); }
+
+		/**
+         * @brief Queues an encoded \p frame of CHAT_ECHO messages to be sent to the client. If the client has
+         * fallen behind, the echoes may be dropped according to its SlowConsumerPolicy, in which case it is
+         * sent a CHAT_MISSED message in their place.
+         * @param frame The encoded frame.
+         * @param event_count Number of chat events in \p frame.
+         * @note Thread safe. Nothing is sent until notify_outbound() or flush_messages() is called.
+         */
+		void queue_chat_echoes(messaging::Frame frame, size_t event_count) {
+			this->queue_outbound(std::move(frame), std::max<size_t>(event_count, 1));
+		}
+
+		/**
+         * @brief Checks if there are frames queued that haven't been handed to the socket yet.
+         * @return true if anything is queued, otherwise false.
+         * @note Thread safe.
+         */
+		bool has_queued_frames() const { return !this->outbound_frames.empty(); }
+
+		/**
+         * @brief Returns a snapshot of the frames queued for the client, and of any dropped for it.
+         * @return OutboundStats
+         * @note Thread safe.
+         */
+		OutboundStats outbound_stats() const { return this->outbound_frames.stats(); }
+
+		/**
+         * @brief Lets the Reactor know that new frames are queued. The queue will be flushed to the socket
+         * on the reactor thread.
+         * @note Thread safe. Multiple notifications before the flush runs are coalesced.
+         */
+		void notify_outbound();
+
+		/**
+         * @brief Writes queued frames to the socket for as long as it accepts them all. Small frames are
+         * copied together and written in batches, so a run of them costs one TLS record and syscall; big ones
+         * are written straight from their shared buffer. If the socket backs up, the rest stay queued, where
+         * the client's SlowConsumerPolicy applies to them, and the reactor is asked to report when it is
+         * writable again so they can be flushed without blocking.
+         * @throws TransportError if a network error occurs
+         * @note Should only be called on the reactor thread once the connection is attached.
+         */
+		void flush_messages();
+
+		/**
+         * @brief Advances the TLS handshake as far as the socket allows, without blocking. Once it completes,
+         * the client has SSL_TIMEOUT_MILLISECONDS to send HELLO, or it is disconnected.
+         * @return true if the handshake is complete, otherwise false; the reactor will report when the
+         * socket is ready for it to continue.
+         * @throws TransportError if the handshake fails
+         * @note Should only be called on the reactor thread once the connection is attached.
+         */
+		bool continue_handshake();
+
+		/**
+         * @brief Records that the client has sent HELLO as \p user_name. Its other messages are only
+         * processed from this point on, and from now on it is sent a HEARTBEAT whenever it goes quiet.
+         * @param user_name (moved) User name utilizing this connection.
+         * @note Should only be called on the reactor thread.
+         */
+		void identify(std::string user_name);
+
+		/**
+         * @brief Gets the stage the connection is in.
+         * @return ClientConnectionState
+         * @note Thread safe.
+         */
+		ClientConnectionState state() const { return this->connection_state; }
+
+		/**
+         * @brief Checks if the client has sent HELLO yet.
+         * @return true if identify() has been called, otherwise false.
+         * @note Thread safe.
+         */
+		bool is_identified() const { return this->connection_state == ClientConnectionState::Identified; }
+
+		/**
+         * @brief Records that the client sent something at \p now, which shows it is still there.
+         * @param now Current time.
+         * @note Should only be called on the reactor thread. Doesn't touch the liveness timer, which checks
+         * this when it's due instead, so a busy client costs nothing extra.
+         */
+		void record_activity(std::chrono::steady_clock::time_point now) { this->last_received = now; }
+
+		/**
+         * @brief Checks if the client was disconnected for missing a deadline: for the TLS handshake or HELLO
+         * if it never identified itself, otherwise for answering a HEARTBEAT.
+         * @return true if the connection timed out, otherwise false.
+         * @note Thread safe.
+         */
+		bool has_timed_out() const { return this->timed_out; }
+
+		/**
+         * @brief Turns the client away: once it sends HELLO, it is sent a NAK with \p reason and disconnected.
+         * @param reason (moved) Text of the NAK.
+         * @note Must be called before attach().
+         */
+		void reject(std::string reason) { this->rejection = std::move(reason); }
+
+		/**
+         * @brief Gets the reason the client is being turned away, if reject() was called.
+         * @return Text of the NAK to send, or empty if the client is admitted.
+         */
+		const std::string& rejection_reason() const { return this->rejection; }
+
+		/**
+         * @brief Checks if the client may send a message of type \p message_type now, and if so counts it
+         * against the client's rate limit for that type.
+         * @param message_type Type of the message received.
+         * @param now Current time.
+         * @return Zero if the message should be processed, otherwise how long the client should wait before
+         * sending another of that type.
+         * @note Should only be called on the reactor thread. Never allocates or locks.
+         */
+		std::chrono::milliseconds check_rate(messaging::MessageType message_type,
+			std::chrono::steady_clock::time_point now) {
+			return this->rate_limiter.check(message_type, now);
+		}
+
+		/**
+         * @brief Returns the number of messages refused so far for exceeding a rate limit.
+         * @return uint64_t
+         * @note Thread safe.
+         */
+		uint64_t rate_limited_count() const { return this->rate_limiter.rejected_count(); }
+
+		/**
+         * @brief Gets the Reactor that services this connection's socket.
+         * @return std::shared_ptr<Reactor>
+         */
+		std::shared_ptr<Reactor> get_reactor() const { return this->reactor; }
+
+	private:
+		std::shared_ptr<Reactor> reactor{};
+		std::shared_ptr<ReadyClients> ready_clients{};
+		// whether the client is on the ready list, or being served from it
+		std::atomic<bool> ready{ false };
+		// counts this connection until its handshake completes or it closes, whichever comes first
+		std::shared_ptr<HandshakeTracker> handshakes{};
+		std::atomic<bool> handshake_counted{ false };
+		// set on attach and cleared on detach by the reactor thread, read by room workers queueing frames
+		std::atomic<SocketHandle> attached_fd{ -1 };
+		OutboundQueue outbound_frames;
+		MessageRateLimiter rate_limiter;
+		std::atomic<bool> flush_pending{ false };
+		std::atomic<bool> disconnect_pending{ false };
+		std::atomic<ClientConnectionState> connection_state{ ClientConnectionState::Handshaking };
+		std::atomic<bool> timed_out{ false };
+		// set by close() on the reactor thread once the BIO is shut down, read by the manager releasing it
+		std::atomic<bool> closed{ false };
+		ConnectionLiveness liveness{};
+		// the rest are only touched on the reactor thread, once attached
+		// when the current stage must be done by, if the client hasn't identified itself
+		std::chrono::steady_clock::time_point deadline{};
+		std::chrono::steady_clock::time_point last_received{};
+		// when the last HEARTBEAT was sent; one is outstanding while this is after last_received
+		std::chrono::steady_clock::time_point heartbeat_sent{};
+		// the deadline or liveness timer currently set on the reactor
+		TimerId timer{ NO_TIMER };
+		std::chrono::steady_clock::time_point accepted_at{ std::chrono::steady_clock::now() };
+		std::string rejection{};
+
+		void queue_outbound(messaging::Frame frame, size_t event_count);
+		void finish_handshake() noexcept;
+		void set_timer(std::chrono::steady_clock::time_point when);
+		void on_timer();
+	};
+
+	/// History of a chat room. Written by the room worker that owns the room, readable from any thread.
+	using RoomHistory = rooms::RoomEventStore;
+
+	/**
+     * @brief Encodes the newest events of a chat room's history as a ROOM_HISTORY message.
+     * @param history The room's history.
+     * @param room_name The room's unique name.
+     * @param max_event_count Maximum number of events to include.
+     * @return Frame holding the ROOM_HISTORY message, with events oldest first.
+     * @note Thread safe; never blocks the room worker writing \p history.
+     */
+	messaging::Frame encode_room_history(const RoomHistory& history, std::string_view room_name,
+		size_t max_event_count);
+
+	/**
+     * @brief Encoded ROOM_HISTORY responses for one chat room, one per event count requested, each reused
+     * until the room's history changes. A burst of identical requests costs one encoding.
+     */
+	class RoomHistoryFrameCache
+	{
+	public:
+		/**
+         * @brief Returns the ROOM_HISTORY response for the newest \p max_event_count events of \p history,
+         * encoding it only if the history has changed since it was last encoded.
+         * @param history The room's history.
+         * @param room_name The room's unique name.
+         * @param max_event_count Maximum number of events to include.
+         * @return Frame
+         * @note Thread safe.
+         */
+		messaging::Frame get(const RoomHistory& history, std::string_view room_name, size_t max_event_count);
+
+		/**
+         * @brief Returns the number of responses encoded so far.
+         * @return uint64_t
+         */
+		uint64_t encoded_count() const { return this->encoded.load(); }
+
+		/**
+         * @brief Returns the number of responses handed out so far, encoded or not.
+         * @return uint64_t
+         */
+		uint64_t served_count() const { return this->served.load(); }
+
+	private:
+		struct CachedFrame
+		{
+			size_t event_count{};
+			/// RoomHistory::insert_count() when the frame was encoded.
+			uint64_t version{};
+			messaging::Frame frame{};
+		};
+
+		std::vector<CachedFrame> frames{};
+		std::mutex frames_mutex{};
+		std::atomic<uint64_t> encoded{ 0 };
+		std::atomic<uint64_t> served{ 0 };
+	};
+
+	/**
+     * @brief Memory used by the history of one chat room, and the ROOM_HISTORY responses served from it.
+     */
+	struct RoomHistoryUsage
+	{
+		/// The room's unique name.
+		std::string room_name{};
+		/// Number of events held.
+		size_t event_count{};
+		/// Maximum number of events that will be held.
+		size_t capacity{};
+		/// Approximate bytes used by the history, including the text of its events.
+		size_t bytes{};
+		/// Number of ROOM_HISTORY responses encoded.
+		uint64_t frames_encoded{};
+		/// Number of ROOM_HISTORY responses sent, including those reused from the cache.
+		uint64_t frames_served{};
+	};
+
+	/**
+     * @brief Finds the history of every chat room by name, so ROOM_HISTORY requests can be answered
+     * without going through the room workers.
+     */
+	class RoomHistoryDirectory
+	{
+	public:
+		/**
+         * @brief Publishes \p history as the history of \p room_name, replacing any existing one.
+         * @param room_name The room's unique name.
+         * @param history (copied) The room's history.
+         * @note Thread safe.
+         */
+		void publish(std::string_view room_name, std::shared_ptr<RoomHistory> history) {
+			PublishedHistory published{ .history = std::move(history),
+				.frames = std::make_shared<RoomHistoryFrameCache>() };
+			std::unique_lock lock{ this->histories_mutex };
+			this->histories.insert_or_assign(std::string{ room_name }, std::move(published));
+		}
+
+		/**
+         * @brief Removes the history of \p room_name, if any. Readers still holding it can finish.
+         * @param room_name The room's unique name.
+         * @note Thread safe.
+         */
+		void erase(std::string_view room_name) {
+			std::unique_lock lock{ this->histories_mutex };
+			if (const auto it = this->histories.find(room_name); it != this->histories.end()) {
+				this->histories.erase(it);
+			}
+		}
+
+		/**
+         * @brief Looks up the history of \p room_name.
+         * @param room_name The room's unique name.
+         * @return std::shared_ptr<RoomHistory>, or nullptr if the room has no history (yet).
+         * @note Thread safe.
+         */
+		std::shared_ptr<RoomHistory> find(std::string_view room_name) const {
+			std::shared_lock lock{ this->histories_mutex };
+			const auto it = this->histories.find(room_name);
+			return it == this->histories.end() ? nullptr : it->second.history;
+		}
+
+		/**
+         * @brief Gets the ROOM_HISTORY response for the newest \p max_event_count events of \p room_name,
+         * reusing the last one encoded if the room's history hasn't changed since.
+         * @param room_name The room's unique name.
+         * @param max_event_count Maximum number of events to include.
+         * @return Frame, or nullptr if the room has no history (yet).
+         * @note Thread safe.
+         */
+		messaging::Frame find_frame(std::string_view room_name, size_t max_event_count) const {
+			PublishedHistory published{};
+			{
+				std::shared_lock lock{ this->histories_mutex };
+				const auto it = this->histories.find(room_name);
+				if (it == this->histories.end()) {
+					return nullptr;
+				}
+				published = it->second;
+			}
+			return published.frames->get(*published.history, room_name, max_event_count);
+		}
+
+		/**
+         * @brief Measures the memory used by, and responses served from, the history of every room.
+         * @return std::vector of RoomHistoryUsage, one per room, in no particular order.
+         * @note Thread safe.
+         */
+		std::vector<RoomHistoryUsage> usage() const {
+			std::shared_lock lock{ this->histories_mutex };
+			std::vector<RoomHistoryUsage> usage{};
+			for (const auto& [room_name, published] : this->histories) {
+				usage.push_back(RoomHistoryUsage{ .room_name = room_name,
+					.event_count = published.history->size(),
+					.capacity = published.history->capacity(),
+					.bytes = published.history->storage_bytes(),
+					.frames_encoded = published.frames->encoded_count(),
+					.frames_served = published.frames->served_count() });
+			}
+			return usage;
+		}
+
+		/**
+         * @brief Returns the table that user names in every room's history are interned in.
+         * @return std::shared_ptr<rooms::SymbolTable>
+         */
+		const std::shared_ptr<rooms::SymbolTable>& user_names() const { return this->history_user_names; }
+
+	private:
+		struct StringHash : std::hash<std::string_view>
+		{
+			using is_transparent = void;
+		};
+
+		struct PublishedHistory
+		{
+			std::shared_ptr<RoomHistory> history{};
+			std::shared_ptr<RoomHistoryFrameCache> frames{};
+		};
+
+		std::unordered_map<std::string, PublishedHistory, StringHash, std::equal_to<>> histories{};
+		mutable std::shared_mutex histories_mutex{};
+		std::shared_ptr<rooms::SymbolTable> history_user_names{ std::make_shared<rooms::SymbolTable>() };
+	};
 
-		ClientConnection& operator=(ClientConnection&&) = default;
+	/**
+     * @brief Frames queued for every client connection, what slow consumers have cost, and how many messages
+     * rate limits have refused.
+     */
+	struct OutboundUsage
+	{
+		/// Number of frames queued across all clients.
+		size_t queued_frames{};
+		/// Bytes of frames queued across all clients.
+		size_t queued_bytes{};
+		/// Bytes queued for the client furthest behind.
+		size_t deepest_queue_bytes{};
+		/// Number of clients currently having chat echoes dropped under SlowConsumerPolicy::Degrade.
+		size_t degraded_clients{};
+		/// Number of chat events dropped for slow clients since the server started.
+		uint64_t dropped_events{};
+		/// Number of clients disconnected for falling too far behind since the server started.
+		uint64_t slow_disconnects{};
+		/// Number of messages refused for exceeding a rate limit since the server started.
+		uint64_t rate_limited_messages{};
 	};
 
 	/**
@@ -142,8 +863,16 @@ namespace tavernmx::server
          * @brief Create a new ClientConnectionManager that will accept connections
          * on the given TCP \p accept_port.
          * @param accept_port TCP port to listen for new connections.
+         * @param reactor_count Number of Reactors that accepted connections are spread across (at least 1).
+         * @param outbound_limits Limits on the frames queued for each client.
+         * @param rate_limits How fast each client may send each kind of message.
+         * @param tcp_keepalive_seconds Seconds a client socket may be idle before TCP keepalive probes start,
+         * or 0 to leave keepalive off.
+         * @param liveness How long identified clients may be quiet.
          */
-		explicit ClientConnectionManager(int32_t accept_port);
+		explicit ClientConnectionManager(int32_t accept_port, size_t reactor_count = 1,
+			OutboundLimits outbound_limits = {}, const MessageRateLimits& rate_limits = {},
+			int32_t tcp_keepalive_seconds = 0, ConnectionLiveness liveness = {});
 
 		ClientConnectionManager(const ClientConnectionManager&) = delete;
 
@@ -157,6 +886,18 @@ namespace tavernmx::server
 			this->accept_port = other.accept_port;
 			this->ctx = std::move(other.ctx);
 			this->accept_bio = std::move(other.accept_bio);
+			this->accepting = other.accepting.exchange(false);
+			this->reactors = std::move(other.reactors);
+			this->next_reactor = other.next_reactor.load();
+			this->outbound_limits = other.outbound_limits;
+			this->rate_limits = other.rate_limits;
+			this->tcp_keepalive_seconds = other.tcp_keepalive_seconds;
+			this->liveness = other.liveness;
+			this->closed_usage = other.closed_usage;
+			this->handshakes = std::move(other.handshakes);
+			this->inbound_signal = std::move(other.inbound_signal);
+			this->ready_clients = std::move(other.ready_clients);
+			this->room_histories = std::move(other.room_histories);
 			this->active_connections = std::move(other.active_connections);
 			return *this;
 		};
@@ -167,7 +908,7 @@ namespace tavernmx::server
 		~ClientConnectionManager();
 
 		/**
-         * @brief Loads the server SSL certificate. Should be called prior to await_next_connection().
+         * @brief Loads the server SSL certificate. Should be called prior to accept_connections().
          * @param cert_path File system path to the server SSL certificate.
          * @param private_key_path File system path to the server SSL private key.
          * @throws ServerError if the certificate/private key pair cannot be loaded
@@ -181,21 +922,42 @@ namespace tavernmx::server
 		void begin_accept();
 
 		/**
-         * @brief Blocks until a new client connects to the server. If the accept port is not created yet,
-         * it will be created the first time this method is called.
-         * @return A std::shared_ptr<ClientConnection> for the newly connected client. If the accept port
-         * is no longer listening, it will return empty.
-         * @note The returned ClientConnection should be passed to a worker thread for further processing.
-         * If no connection is waiting, this will sleep for tavernmx::ssl::SSL_RETRY_MILLISECONDS to avoid
-         * tight loops.
+         * @brief Gets the TCP port connections are accepted on, which is only known once accepting has begun
+         * if the manager was created with port 0.
+         * @return The bound port, or the port the manager was created with if begin_accept() hasn't been called.
          */
-		std::optional<std::shared_ptr<ClientConnection>> await_next_connection();
+		int32_t get_accept_port() const;
 
 		/**
-         * @brief Attempts to shutdown the accept port and all active client connections.
+         * @brief Waits for clients to connect to the server, then accepts every connection waiting, as long
+         * as there are fewer than \p max_handshakes TLS handshakes in progress. If the accept port is not
+         * created yet, it will be created the first time this method is called.
+         * @param timeout Maximum number of milliseconds to wait for a connection.
+         * @param max_handshakes Maximum number of connections still in their TLS handshake. Once reached,
+         * this waits up to \p timeout for one of them to finish instead, leaving new connections in the
+         * listen backlog.
+         * @return std::vector of zero or more newly connected clients, each still to complete its TLS handshake.
+         * @note The returned connections should be passed to client_worker(), which attaches them to their
+         * Reactor. Nothing here waits on a client.
+         */
+		std::vector<std::shared_ptr<ClientConnection>> accept_connections(ssl::Milliseconds timeout,
+			size_t max_handshakes);
+
+		/**
+         * @brief Attempts to shutdown the accept port and all active client connections. Each connection is
+         * detached and shut down by its own reactor, which is woken to do so.
+         * @note Thread safe.
          */
 		void shutdown() noexcept;
 
+		/**
+         * @brief Releases connections that are no longer active. Dead connections are found and closed by
+         * timers on their reactors; this only lets go of them.
+         * @return What was released.
+         * @note Thread safe. Should be called periodically.
+         */
+		ReapedConnections release_connections();
+
 		/**
          * @brief Retrieves all of the active client connections.
          * @return std::vector containing zero or more pointers to ClientConnection.
@@ -203,23 +965,83 @@ namespace tavernmx::server
          */
 		std::vector<std::shared_ptr<ClientConnection>> get_active_connections();
 
+		/**
+         * @brief Returns the number of client connections currently tracked by the manager.
+         * @return size_t
+         * @note Thread safe.
+         */
+		size_t active_connection_count() const;
+
+		/**
+         * @brief Returns the number of client connections still in their TLS handshake.
+         * @return size_t
+         * @note Thread safe. Never locks.
+         */
+		size_t handshake_count() const { return this->handshakes->count(); }
+
+		/**
+         * @brief Measures the frames queued for every client connection, including totals carried over from
+         * connections that have since closed.
+         * @return OutboundUsage
+         * @note Thread safe.
+         */
+		OutboundUsage outbound_usage() const;
+
 		/**
          * @brief Determines if this ClientConnectionManager's accept socket is active.
          * @return true if the manager is currently accepting connections, otherwise false.
+         * @note Thread safe; polled by every worker to know when to stop.
          */
-		bool is_accepting_connections();
+		bool is_accepting_connections() const { return this->accepting; }
+
+		/**
+         * @brief Gets the Reactors that service the sockets of accepted client connections. Each connection
+         * is assigned to one of them, in turn, when it is accepted.
+         * @return std::vector of std::shared_ptr<Reactor>, each of which should be run by its own thread.
+         */
+		const std::vector<std::shared_ptr<Reactor>>& get_reactors() const { return this->reactors; }
+
+		/**
+         * @brief Gets the QueueSignal of the ready list. It is notified whenever a client that had no messages
+         * waiting sends one.
+         * @return std::shared_ptr<QueueSignal>
+         */
+		std::shared_ptr<QueueSignal> get_inbound_signal() const { return this->inbound_signal; }
+
+		/**
+         * @brief Gets the list every client connection puts itself on when it has messages waiting, for the
+         * server worker to pick up.
+         * @return std::shared_ptr<ReadyClients>
+         */
+		std::shared_ptr<ReadyClients> get_ready_clients() const { return this->ready_clients; }
+
+		/**
+         * @brief Gets the directory of chat room histories, shared by the room workers that write them and
+         * the reactor that answers ROOM_HISTORY requests from them.
+         * @return std::shared_ptr<RoomHistoryDirectory>
+         */
+		std::shared_ptr<RoomHistoryDirectory> get_room_histories() const { return this->room_histories; }
 
 	private:
 		int32_t accept_port{};
 		ssl::ssl_unique_ptr<SSL_CTX> ctx{ nullptr };
 		ssl::ssl_unique_ptr<BIO> accept_bio{ nullptr };
+		// set once accept_bio is listening, and cleared by shutdown() before it releases it
+		std::atomic<bool> accepting{ false };
+		std::vector<std::shared_ptr<Reactor>> reactors{};
+		std::atomic<size_t> next_reactor{ 0 };
+		OutboundLimits outbound_limits{};
+		MessageRateLimits rate_limits{};
+		int32_t tcp_keepalive_seconds{};
+		ConnectionLiveness liveness{};
+		// dropped events, slow disconnects and rate limited messages of connections already cleaned up
+		OutboundUsage closed_usage{};
+		std::shared_ptr<HandshakeTracker> handshakes{ std::make_shared<HandshakeTracker>() };
+		std::shared_ptr<QueueSignal> inbound_signal{ std::make_shared<QueueSignal>() };
+		std::shared_ptr<ReadyClients> ready_clients{ std::make_shared<ReadyClients>(this->inbound_signal) };
+		std::shared_ptr<RoomHistoryDirectory> room_histories{ std::make_shared<RoomHistoryDirectory>() };
 		std::vector<std::shared_ptr<ClientConnection>> active_connections{};
 		mutable std::mutex active_connections_mutex{};
-
-		/**
-         * @brief Removes client connections that are no longer active.
-         */
-		void cleanup_connections();
 	};
 
 }
@@ -236,6 +1058,10 @@ namespace tavernmx::rooms
 		ThreadSafeQueue<RoomEvent> events{};
 		/// List of clients that are joined to this chat room.
 		std::vector<std::weak_ptr<server::ClientConnection>> joined_clients{};
+		/// Events that occurred in this chat room, as published in the server's RoomHistoryDirectory.
+		std::shared_ptr<server::RoomHistory> history{};
+		/// Durable log of the events in this chat room, if the server keeps one.
+		std::shared_ptr<RoomHistoryLog> history_log{};
 
 		/**
          * @brief Creates a ServerRoom.
@@ -277,3 +1103,99 @@ namespace tavernmx::rooms
 		}
 	};
 }
+
+namespace tavernmx::server
+{
+	/**
+     * @brief A client request routed to the room shard that owns the room it refers to.
+     */
+	struct RoomCommand
+	{
+		/// The client that sent the request, or nullptr for requests made by the server itself.
+		std::shared_ptr<ClientConnection> client{};
+		/// The request.
+		messaging::Message message{};
+	};
+
+	/**
+     * @brief Mailbox for one shard of the server's chat rooms. Each shard's rooms and history are owned
+     * by a single room worker thread; everything else talks to it through this object.
+     */
+	class RoomShard
+	{
+	public:
+		/// Requests for rooms owned by this shard, processed in order by its room worker.
+		SpscQueue<RoomCommand> commands{};
+
+		/**
+         * @brief Creates a RoomShard.
+         * @param shard_index Position of this shard among all shards, used for logging.
+         */
+		explicit RoomShard(size_t shard_index) : shard_index{ shard_index } {};
+
+		RoomShard(const RoomShard&) = delete;
+
+		RoomShard& operator=(const RoomShard&) = delete;
+
+		/**
+         * @brief Gets the position of this shard among all shards.
+         * @return size_t
+         */
+		size_t index() const { return this->shard_index; }
+
+		/**
+         * @brief Wakes the room worker so it processes commands right away.
+         * @note Thread safe. Multiple notifications before the worker wakes up are coalesced.
+         */
+		void notify() { this->commands.signal()->notify(); }
+
+		/**
+         * @brief Blocks the room worker until a command is pushed, notify() or stop() is called, or
+         * \p timeout elapses.
+         * @param timeout Maximum time to wait.
+         */
+		void wait(std::chrono::milliseconds timeout) { this->commands.signal()->wait(timeout); }
+
+		/**
+         * @brief Asks the room worker to exit.
+         */
+		void stop() {
+			this->running = false;
+			this->notify();
+		}
+
+		/**
+         * @brief Checks if the room worker should keep running.
+         * @return true until stop() is called.
+         */
+		bool is_running() const { return this->running; }
+
+		/**
+         * @brief Records that the room worker exited with an exception, so nothing will process its commands.
+         * @note Thread safe.
+         */
+		void fail() { this->failed = true; }
+
+		/**
+         * @brief Checks if the room worker exited with an exception.
+         * @return true once fail() is called, otherwise false.
+         * @note Thread safe.
+         */
+		bool has_failed() const { return this->failed; }
+
+	private:
+		size_t shard_index{};
+		std::atomic<bool> running{ true };
+		std::atomic<bool> failed{ false };
+	};
+
+	/**
+     * @brief Determines which shard owns \p room_name.
+     * @param room_name The room's unique name.
+     * @param shard_count Total number of shards (at least 1).
+     * @return Index of the owning shard, less than \p shard_count.
+     */
+	inline size_t room_shard_index(std::string_view room_name, size_t shard_count) {
+		return std::hash<std::string_view>{}(room_name) % shard_count;
+	}
+}
@@ -3,8 +3,10 @@
 #include "platform.h"
 #include "logging.h"
 #include "messaging.h"
+#include "codec.h"
 #include "ssl.h"
 #include "connection.h"
 #include "queue.h"
+#include "reactor.h"
 #include "room.h"
 #include "util.h"
\ No newline at end of file
@@ -18,6 +18,8 @@ namespace tavernmx::ssl
 	constexpr Milliseconds SSL_RETRY_MILLISECONDS = 20;
 	/// Number of milliseconds to wait for an expected response
 	constexpr Milliseconds SSL_TIMEOUT_MILLISECONDS = 3000;
+	/// SSL_CTX modes required by send_bytes(), so a write can stop partway and resume from a buffer that has moved
+	constexpr long SSL_WRITE_MODES = SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER;
 
 	/**
      * @brief Base template for openssl deleters.
@@ -110,28 +112,52 @@ namespace tavernmx::ssl
 	};
 
 	/**
-     * @brief Sends a message over the SSL socket.
+     * @brief Writes as many of \p bytes to the SSL socket as it will currently accept, without blocking.
      * @param bio pointer to BIO
-     * @param block block of data to send
+     * @param bytes data to send
+     * @return the number of bytes written, which may be less than the size of \p bytes (or 0)
      * @throws SslError if any network errors occur
+     * @note Requires SSL_MODE_ENABLE_PARTIAL_WRITE and SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER (see SSL_WRITE_MODES).
+     * After a partial write, the next call must start with the unsent remainder.
      */
-	void send_message(BIO* bio, const messaging::MessageBlock& block);
+	size_t send_bytes(BIO* bio, std::span<const messaging::CharType> bytes);
 
 	/**
-     * @brief Attempts to read a message from the SSL socket.
+     * @brief Reads all bytes currently waiting on the SSL socket into \p decoder.
      * @param bio pointer to BIO
-     * @return a tavernmx::messaging::MessageBlock if a well-formed message block was read, otherwise empty
+     * @param decoder receives the bytes; complete MessageBlocks can then be taken from it
+     * @return the number of bytes read, which may be 0 if no data is waiting
      * @throws SslError if any network errors occur
-     * @note Automatically sleeps for SSL_RETRY_MILLISECONDS when no data is waiting in order
-     * to prevent tight loops.
+     * @note Returns immediately when no data is waiting. Callers that poll should wait on the
+     * socket (see tavernmx::Reactor) or sleep between calls. Reads a bounded amount per call, but never
+     * stops with decrypted bytes left in OpenSSL's buffer, so whatever is left is still on the socket.
      */
-	std::optional<messaging::MessageBlock> receive_message(BIO* bio);
+	size_t receive_bytes(BIO* bio, messaging::MessageBlockDecoder& decoder);
+
+	/// Progress of a non-blocking TLS handshake, see continue_handshake().
+	enum class HandshakeStatus
+	{
+		/// The handshake is done; application data can flow.
+		Complete,
+		/// The handshake is waiting for the peer; call again when the socket is readable.
+		WantRead,
+		/// The socket couldn't take the handshake's output; call again when the socket is writable.
+		WantWrite,
+	};
+
+	/**
+     * @brief Advances the TLS handshake on \p bio as far as the socket allows, without blocking.
+     * @param bio pointer to a BIO from BIO_new_ssl(), over a non-blocking socket
+     * @return HandshakeStatus
+     * @throws SslError if the handshake fails
+     */
+	HandshakeStatus continue_handshake(BIO* bio);
 
 	/**
-     * @brief Blocks until a new client connections to \p accept_bio.
+     * @brief Accepts a new client connection on \p accept_bio, if one is waiting.
      * @param accept_bio pointer to the server's accept BIO
-     * @return pointer to a new client connection BIO
-     * @throws SslError if any network errors occur
+     * @return pointer to a new client connection BIO, or nullptr if no connection is waiting (or
+     * \p accept_bio blocks and was interrupted)
      */
 	ssl_unique_ptr<BIO> accept_new_tcp_connection(BIO* accept_bio);
 
@@ -143,6 +169,25 @@ namespace tavernmx::ssl
      */
 	SSL* get_ssl(BIO* bio);
 
+	/**
+     * @brief Gets the underlying socket descriptor of \p bio.
+     * @param bio pointer to BIO
+     * @return socket descriptor, or -1 if \p bio isn't backed by a socket
+     */
+	int32_t get_fd(BIO* bio);
+
+	/**
+     * @brief Turns on TCP keepalive for the socket underlying \p bio, so the operating system notices a peer
+     * that vanished without closing the connection, even while nothing is being sent.
+     * @param bio pointer to BIO
+     * @param idle_seconds Seconds the connection must be idle before the first probe.
+     * @param interval_seconds Seconds between unanswered probes.
+     * @param probe_count Number of unanswered probes before the connection is dropped.
+     * @return true if keepalive was turned on, otherwise false. Where the platform doesn't support them,
+     * the timings are left at the system defaults.
+     */
+	bool set_tcp_keepalive(BIO* bio, int32_t idle_seconds, int32_t interval_seconds, int32_t probe_count);
+
 	/**
      * @brief Validates the certificate attached to the \p ssl connection.
      * @param ssl pointer to SSL
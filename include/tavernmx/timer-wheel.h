@@ -0,0 +1,135 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace tavernmx
+{
+    /// Identifies a timer scheduled on a TimerWheel.
+    using TimerId = uint64_t;
+
+    /// A TimerId that never identifies a timer.
+    constexpr TimerId NO_TIMER = 0;
+
+    /**
+     * @brief Hierarchical timer wheel. Timers are kept in slots by how many ticks away they are due, with
+     * each level of the wheel covering SLOTS_PER_LEVEL times the span of the level below it; as time advances,
+     * the timers in a higher level slot are moved down to where they can fire. Scheduling and cancelling a
+     * timer are O(1), and advancing only touches the timers that are due or being moved down, so tens of
+     * thousands of timers cost nothing until they fire.
+     * @note Timers fire at the first call to advance() on or after the tick they are due, so never early,
+     * but up to a tick late. Timers due further away than the wheel spans (2^24 ticks) are parked at its
+     * far edge and rescheduled from there.
+     * @note Not thread safe: meant to be owned by one thread, such as a worker loop or a Reactor, which calls
+     * schedule(), cancel() and advance(). Callbacks run on that thread, from inside advance(), and may
+     * schedule or cancel timers themselves.
+     */
+    class TimerWheel
+    {
+    public:
+        /// Clock the wheel keeps time by.
+        using Clock = std::chrono::steady_clock;
+        /// Function to call when a timer fires.
+        using Callback = std::function<void()>;
+
+        /// Number of slots in each level of the wheel.
+        static constexpr size_t SLOTS_PER_LEVEL = 64;
+        /// Number of levels in the wheel.
+        static constexpr size_t LEVELS = 4;
+
+        /**
+         * @brief Creates an empty TimerWheel.
+         * @param tick Resolution of the wheel (at least 1 ns).
+         * @param now Current time, which becomes the wheel's tick 0.
+         */
+        explicit TimerWheel(Clock::duration tick = std::chrono::milliseconds{ 10 }, Clock::time_point now = Clock::now());
+
+        TimerWheel(const TimerWheel&) = delete;
+
+        TimerWheel& operator=(const TimerWheel&) = delete;
+
+        /**
+         * @brief Schedules \p callback to be called at \p when.
+         * @param when When the timer is due. If that's already passed, it fires on the next tick.
+         * @param callback (moved) Function to call.
+         * @return TimerId identifying the timer until it fires or is cancelled.
+         */
+        TimerId schedule(Clock::time_point when, Callback callback);
+
+        /**
+         * @brief Cancels \p timer, if it hasn't fired yet.
+         * @param timer TimerId returned by schedule(), or NO_TIMER.
+         * @return true if the timer was pending and is now cancelled, otherwise false.
+         */
+        bool cancel(TimerId timer);
+
+        /**
+         * @brief Checks if \p timer has yet to fire or be cancelled.
+         * @param timer TimerId returned by schedule(), or NO_TIMER.
+         * @return true if the timer is pending, otherwise false.
+         */
+        bool is_pending(TimerId timer) const;
+
+        /**
+         * @brief Advances the wheel to \p now, calling back every timer that has come due, a tick at a time.
+         * Timers due in the same tick fire in no particular order.
+         * @param now Current time; going backwards does nothing.
+         * @return Number of timers that fired.
+         * @note An exception thrown by a callback is passed on, leaving the timers not yet called for the next
+         * call to advance().
+         */
+        size_t advance(Clock::time_point now);
+
+        /**
+         * @brief Gets the earliest time advance() might next have anything to do: either a timer is due then,
+         * or timers further away have to be moved down the wheel. Waiting until then never misses a timer.
+         * @return Clock::time_point, or Clock::time_point::max() if no timers are pending.
+         */
+        Clock::time_point next_expiry() const;
+
+        /**
+         * @brief Returns the number of pending timers.
+         * @return size_t
+         */
+        size_t size() const { return this->pending_count; }
+
+        /**
+         * @brief Gets the resolution of the wheel.
+         * @return Clock::duration
+         */
+        Clock::duration get_tick() const { return this->tick; }
+
+    private:
+        static constexpr uint32_t NONE = UINT32_MAX;
+
+        struct Node
+        {
+            Callback callback{};
+            uint64_t due_tick{};
+            uint32_t generation{ 1 };
+            uint32_t prev{ NONE };
+            uint32_t next{ NONE };
+            uint32_t slot{ NONE };
+        };
+
+        Clock::duration tick;
+        Clock::time_point origin;
+        // last tick advance() has processed; timers are always due after it
+        uint64_t current_tick{};
+        std::vector<Node> nodes{};
+        std::vector<uint32_t> free_nodes{};
+        // head of each slot's list of timers, level by level
+        std::array<uint32_t, SLOTS_PER_LEVEL * LEVELS> slots{};
+        // bit per slot, set while the slot holds any timers
+        std::array<uint64_t, LEVELS> occupied{};
+        size_t pending_count{};
+
+        uint64_t next_busy_tick() const;
+        void link(uint32_t index);
+        void unlink(uint32_t index);
+        void release(uint32_t index);
+        void cascade(size_t level);
+    };
+}
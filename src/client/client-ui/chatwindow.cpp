@@ -110,23 +110,27 @@ namespace tavernmx::client
 		std::lock_guard lock_guard{ this->chat_history_mutex };
 		if (const auto history = this->chat_room_history.find(this->current_room_name);
 			history != this->chat_room_history.end()) {
-			for (ClientRoomEvent& event : history->second) {
-				ImGui::PushStyleColor(ImGuiCol_Text, chat_name_to_color(event.origin_user_name));
-				ImGui::Text("%s", event.origin_user_name.c_str());
-				ImGui::SameLine();
-				ImGui::Text("at %s", event.timestamp_text.c_str());
-				ImGui::PopStyleColor();
-				ImGui::Text("%s", event.event_text.c_str());
-				ImGui::Spacing();
+			// every event is the same height (name line, text line, spacing), so only submit the visible ones
+			const auto events = history->second.last(CHAT_ROOM_HISTORY_SIZE);
+			ImGuiListClipper clipper{};
+			clipper.Begin(static_cast<int32_t>(events.size()));
+			while (clipper.Step()) {
+				for (int32_t i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+					const ClientRoomEvent& event = events[static_cast<size_t>(i)];
+					ImGui::PushStyleColor(ImGuiCol_Text, chat_name_to_color(event.origin_user_name));
+					ImGui::Text("%s", event.origin_user_name.c_str());
+					ImGui::SameLine();
+					ImGui::Text("at %s", event.timestamp_text.c_str());
+					ImGui::PopStyleColor();
+					ImGui::Text("%s", event.event_text.c_str());
+					ImGui::Spacing();
+				}
 			}
 		}
 	}
 
 	void ChatWindowScreen::insert_chat_history_event(std::string_view room_name, ClientRoomEvent event) {
 		std::lock_guard lock_guard{ this->chat_history_mutex };
-		if (!this->chat_room_history.contains(room_name)) {
-			this->chat_room_history[std::string{ room_name }] = {};
-		}
 		this->chat_room_history[std::string{ room_name }].insert(std::move(event));
 		this->reset_scroll_pos = room_name == this->current_room_name;
 	}
@@ -23,7 +23,7 @@ namespace
      * @param messages_out Outbound message queue.
      * @note Will not do anything if \p room_name is empty or if we're already joined to \p room_name.
      */
-	void issue_room_join_if_needed(std::string_view room_name, tavernmx::ThreadSafeQueue<Message>* messages_out) {
+	void issue_room_join_if_needed(std::string_view room_name, tavernmx::MpscQueue<Message>* messages_out) {
 		if (room_name.empty()) {
 			return;
 		}
@@ -78,8 +78,8 @@ namespace
 namespace tavernmx::client
 {
 	void chat_window_worker(std::unique_ptr<ServerConnection> connection, ChatWindowScreen* screen) {
-		std::shared_ptr<ThreadSafeQueue<Message>> messages_in = connection->messages_in,
-												  messages_out = connection->messages_out;
+		std::shared_ptr<SpscQueue<Message>> messages_in = connection->messages_in;
+		std::shared_ptr<MpscQueue<Message>> messages_out = connection->messages_out;
 
 		// update loop to handle incoming messages
 		screen->add_handler(ChatWindowScreen::MSG_UPDATE, [messages_in, messages_out](
@@ -159,6 +159,16 @@ namespace tavernmx::client
 					const auto room_name = message_value_or<std::string>(*msg, "room_name");
 					chat_screen->insert_chat_history_event(room_name, event_json_to_room_event(msg->values));
 				} break;
+				case MessageType::CHAT_MISSED:
+					// we fell behind and the server dropped some echoes; resync every joined room from its history
+					TMX_WARN("Missed {} chat event(s), requesting room history.",
+						message_value_or<int32_t>(*msg, "event_count"));
+					for (const std::shared_ptr<ClientRoom>& room : client_rooms.rooms()) {
+						if (room->is_joined) {
+							messages_out->push(create_room_history(room->room_name()));
+						}
+					}
+					break;
 				default:
 					TMX_WARN("Unhandled UI message type: {}", static_cast<int32_t>(msg->message_type));
 					break;
@@ -13,27 +13,59 @@ bool waiting_on_server{ false };
 
 namespace
 {
-	/// Target maximum ms for loop processing. This is based off of SSL_RETRY_MILLISECONDS since there's
-	/// a built-in wait in tavernmx::ssl::receive_message(BIO*).
+	/// Target maximum ms for loop processing.
 	constexpr std::chrono::milliseconds TARGET_SERVER_LOOP_MS{ tavernmx::ssl::SSL_RETRY_MILLISECONDS * 2 };
+	/// Maximum ms to wait for socket or UI activity before checking for shutdown requests again.
+	constexpr tavernmx::ssl::Milliseconds IDLE_WAIT_MS = 100;
 }
 
 namespace tavernmx::client
 {
 	void server_message_worker(std::unique_ptr<ServerConnection> server) {
 		try {
-			std::chrono::time_point<std::chrono::system_clock> last_message_received = std::chrono::system_clock::now();
-			std::optional<std::chrono::time_point<std::chrono::system_clock>> heartbeat_sent{};
-
 			// send initial request for rooms list
 			server->send_message(create_room_list());
 
+			// Sleep until the server sends something or the UI queues a message, instead of polling
+			Reactor io{};
+			io.add(server->get_socket(), REACTOR_READABLE, [](ReactorEvents) {});
+			const std::shared_ptr<QueueSignal> outbound_signal = server->messages_out->signal();
+			const bool outbound_watched = outbound_signal->enable_event_fd();
+			if (outbound_watched) {
+				io.add(outbound_signal->event_fd(), REACTOR_READABLE,
+					[outbound_signal](ReactorEvents) { outbound_signal->try_acquire(); });
+			}
+
+			// Once the server has been quiet for QUIET_TIMEOUT it is sent a HEARTBEAT, and has as long again to
+			// answer. Receiving only records the time; the timer checks it when due and pushes itself back.
+			std::chrono::steady_clock::time_point last_message_received = std::chrono::steady_clock::now();
+			bool heartbeat_sent = false;
+			bool heartbeat_due = false;
+			bool server_unresponsive = false;
+			std::function<void()> check_quiet{};
+			check_quiet = [&]() {
+				const auto now = std::chrono::steady_clock::now();
+				if (heartbeat_sent) {
+					server_unresponsive = true;
+				} else if (now - last_message_received < QUIET_TIMEOUT) {
+					io.schedule(last_message_received + QUIET_TIMEOUT, check_quiet);
+				} else {
+					heartbeat_sent = heartbeat_due = waiting_on_server = true;
+					io.schedule(now + QUIET_TIMEOUT, check_quiet);
+				}
+			};
+			io.schedule(last_message_received + QUIET_TIMEOUT, check_quiet);
+
 			while (server->is_connected()) {
 				if (shutdown_connection_signal.try_acquire()) {
 					TMX_INFO("Connection worker shutting down by request.");
 					server->shutdown();
 					return;
 				}
+				if (server_unresponsive) {
+					TMX_INFO("Server did not respond to heartbeat.");
+					break;
+				}
 
 				const std::chrono::time_point<std::chrono::high_resolution_clock> loop_start =
 					std::chrono::high_resolution_clock::now();
@@ -41,9 +73,10 @@ namespace tavernmx::client
 				std::vector<Message> send_messages{};
 
 				// 1. Read waiting messages on socket
-				if (std::optional<MessageBlock> block = server->receive_message()) {
-					TMX_INFO("Receive message block: {} bytes", block->payload_size);
-					for (Message& msg : unpack_messages(block.value())) {
+				const std::vector<MessageBlock> blocks = server->receive_messages();
+				for (const MessageBlock& block : blocks) {
+					TMX_INFO("Receive message block: {} bytes", block.payload_size);
+					for (Message& msg : unpack_messages(block)) {
 						TMX_INFO("Receive message: {}", static_cast<int32_t>(msg.message_type));
 						switch (msg.message_type) {
 						case MessageType::HEARTBEAT:
@@ -51,8 +84,13 @@ namespace tavernmx::client
 							send_messages.push_back(create_ack());
 							break;
 						case MessageType::ACK:
+							// outside of connection handshake, ACK can be ignored
+							break;
 						case MessageType::NAK:
-							// outside of connection handshake, ACK/NAK can be ignored
+							// outside of connection handshake, a NAK only means the server refused a message
+							TMX_WARN("Server refused message type {}: {} (retry after {} ms)",
+								message_value_or<int32_t>(msg, "message_type"), message_value_or<std::string>(msg, "error"),
+								message_value_or<int32_t>(msg, "retry_after_ms"));
 							break;
 						case MessageType::Invalid:
 							// programming error?
@@ -64,21 +102,17 @@ namespace tavernmx::client
 							break;
 						}
 					};
-					last_message_received = std::chrono::system_clock::now();
-					heartbeat_sent.reset();
+				}
+				if (!blocks.empty()) {
+					last_message_received = std::chrono::steady_clock::now();
+					heartbeat_sent = false;
 					waiting_on_server = false;
 				}
 
-				// 2. Have we heard from the server lately? If not, send heartbeat.
-				if ((std::chrono::system_clock::now() - last_message_received > QUIET_TIMEOUT)) {
-					if (!heartbeat_sent.has_value()) {
-						send_messages.push_back(create_heartbeat());
-						heartbeat_sent = std::chrono::system_clock::now();
-						waiting_on_server = true;
-					} else if (std::chrono::system_clock::now() - heartbeat_sent.value() > QUIET_TIMEOUT) {
-						TMX_INFO("Server did not respond to heartbeat.");
-						break;
-					}
+				// 2. Send the heartbeat the quiet timer asked for
+				if (heartbeat_due) {
+					send_messages.push_back(create_heartbeat());
+					heartbeat_due = false;
 				}
 
 				// 3. Send queued messages to socket
@@ -88,15 +122,17 @@ namespace tavernmx::client
 				}
 				server->send_messages(std::cbegin(send_messages), std::cend(send_messages));
 
-				// 3. Sleep
 				const std::chrono::time_point<std::chrono::high_resolution_clock>::duration loop_elapsed =
 					std::chrono::high_resolution_clock::now() - loop_start;
-				if (loop_elapsed < TARGET_SERVER_LOOP_MS) {
-					std::this_thread::sleep_for(TARGET_SERVER_LOOP_MS - loop_elapsed);
-				} else {
+				if (loop_elapsed >= TARGET_SERVER_LOOP_MS) {
 					TMX_WARN("Server connection loop took too long to process: {}ms",
 						duration_cast<std::chrono::milliseconds>(loop_elapsed).count());
 				}
+
+				// 4. Wait for activity or the quiet timer. Outbound data the socket couldn't take yet (or a queue we
+				// can't watch) needs a short retry instead.
+				const bool must_retry = server->outbound_size() > 0 || !outbound_watched;
+				io.run_once(must_retry ? ssl::SSL_RETRY_MILLISECONDS : IDLE_WAIT_MS);
 			}
 			TMX_INFO("Connection worker exiting.");
 			connection_ended_signal.release();
@@ -7,14 +7,48 @@
 #include <WinSock2.h>
 #elif defined(TMX_MACOS)
 #include <libc.h>
+#include <poll.h>
 #else
+#include <poll.h>
 #include <unistd.h>
 #endif
 
 using namespace tavernmx::ssl;
+using tavernmx::metrics::Counter;
 
 namespace
 {
+	/// Seconds between unanswered TCP keepalive probes.
+	constexpr int32_t TCP_KEEPALIVE_INTERVAL_SECONDS = 10;
+	/// Number of unanswered TCP keepalive probes before the operating system drops the connection.
+	constexpr int32_t TCP_KEEPALIVE_PROBES = 3;
+	/// Frames up to this size are copied and written together with their neighbours; bigger ones are written
+	/// straight from their shared buffer.
+	constexpr size_t COALESCE_FRAME_BYTES = 4 * 1024;
+	/// Bytes of small frames gathered before they are written, a full TLS record.
+	constexpr size_t COALESCE_BATCH_BYTES = 16 * 1024;
+
+	/// Waits up to \p timeout ms for \p fd to become readable. Returns true if it did.
+	bool wait_readable(tavernmx::SocketHandle fd, Milliseconds timeout) {
+		if (fd < 0) {
+			return false;
+		}
+#if defined(TMX_WINDOWS)
+		WSAPOLLFD poll_fd{ .fd = static_cast<SOCKET>(fd), .events = POLLRDNORM, .revents = 0 };
+		return WSAPoll(&poll_fd, 1, static_cast<INT>(timeout)) > 0;
+#else
+		pollfd poll_fd{ .fd = fd, .events = POLLIN, .revents = 0 };
+		return poll(&poll_fd, 1, static_cast<int32_t>(timeout)) > 0;
+#endif
+	}
+
+	/// Every server HEARTBEAT is the same, so it only needs to be encoded once.
+	const tavernmx::messaging::Frame& heartbeat_frame() {
+		static const tavernmx::messaging::Frame frame =
+			tavernmx::messaging::make_frame(tavernmx::messaging::create_heartbeat());
+		return frame;
+	}
+
 	tavernmx::server::ServerError ssl_errors_to_exception(const char* message) {
 		std::string msg{ message };
 		while (const unsigned long err = ERR_get_error() != 0) {
@@ -29,11 +63,212 @@ namespace
 
 namespace tavernmx::server
 {
-	ClientConnectionManager::ClientConnectionManager(int32_t accept_port) : accept_port{ accept_port } {
+	void ClientConnection::attach(ReactorHandler handler) {
+		const SocketHandle fd = ssl::get_fd(this->bio.get());
+		if (fd < 0) {
+			throw TransportError{ "Client connection has no socket to attach" };
+		}
+		this->reactor->add(fd, REACTOR_READABLE, std::move(handler));
+		this->attached_fd = fd;
+		// timers live on the reactor thread; the handshake may already be done by the time this runs
+		this->reactor->post([weak_self = this->weak_from_this()]() {
+			if (const std::shared_ptr<ClientConnection> self = weak_self.lock();
+				self && self->state() == ClientConnectionState::Handshaking) {
+				self->set_timer(self->deadline);
+			}
+		});
+	}
+
+	void ClientConnection::detach() noexcept {
+		if (const SocketHandle fd = this->attached_fd.exchange(-1); fd >= 0) {
+			this->reactor->remove(fd);
+		}
+		// every way a connection closes detaches it first
+		this->finish_handshake();
+	}
+
+	void ClientConnection::close() noexcept {
+		this->detach();
+		this->shutdown();
+		this->closed = true;
+	}
+
+	void ClientConnection::notify_outbound() {
+		if (this->attached_fd < 0 || this->flush_pending.exchange(true)) {
+			return;
+		}
+		this->reactor->post([weak_self = this->weak_from_this()]() {
+			if (const std::shared_ptr<ClientConnection> self = weak_self.lock()) {
+				self->flush_pending = false;
+				if (self->is_connected()) {
+					self->flush_messages();
+				}
+			}
+		});
+	}
+
+	void ClientConnection::push_inbound(messaging::Message message) {
+		this->messages_in.push(std::move(message));
+		// pairs with the fence in end_turn(): either the worker sees this message, or we see the client is off
+		// the list and put it back on
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!this->ready.load(std::memory_order_relaxed) && !this->ready.exchange(true)) {
+			this->ready_clients->push(this->weak_from_this());
+		}
+	}
+
+	void ClientConnection::end_turn() {
+		this->ready = false;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!this->messages_in.empty() && !this->ready.exchange(true)) {
+			this->ready_clients->push(this->weak_from_this());
+		}
+	}
+
+	void ClientConnection::queue_outbound(messaging::Frame frame, size_t event_count) {
+		if (this->outbound_frames.push(std::move(frame), event_count) != OutboundQueue::PushResult::Overflowed ||
+			this->disconnect_pending.exchange(true)) {
+			return;
+		}
+		this->reactor->post([weak_self = this->weak_from_this()]() {
+			if (const std::shared_ptr<ClientConnection> self = weak_self.lock(); self && self->is_connected()) {
+				TMX_WARN("Client {} fell too far behind ({} bytes unsent), disconnecting.", self->connected_user_name,
+					self->outbound_stats().queued_bytes + self->outbound_size());
+				self->close();
+			}
+		});
+	}
+
+	bool ClientConnection::continue_handshake() {
+		HandshakeStatus status{};
+		try {
+			status = ssl::continue_handshake(this->bio.get());
+		} catch (SslError& ex) {
+			throw TransportError{ "TLS handshake failed", ex };
+		}
+		if (const SocketHandle fd = this->attached_fd; fd >= 0) {
+			this->reactor->modify(fd,
+				status == HandshakeStatus::WantWrite ? REACTOR_READABLE | REACTOR_WRITABLE : REACTOR_READABLE);
+		}
+		if (status != HandshakeStatus::Complete) {
+			return false;
+		}
+		this->finish_handshake();
+		const auto now = std::chrono::steady_clock::now();
+		server_metrics().handshake_time.record(now - this->accepted_at);
+		this->deadline = now + std::chrono::milliseconds{ SSL_TIMEOUT_MILLISECONDS };
+		this->connection_state = ClientConnectionState::AwaitingHello;
+		this->set_timer(this->deadline);
+		return true;
+	}
+
+	void ClientConnection::identify(std::string user_name) {
+		this->connected_user_name = std::move(user_name);
+		this->connection_state = ClientConnectionState::Identified;
+		this->reactor->cancel_timer(this->timer);
+		this->timer = NO_TIMER;
+		if (this->liveness.heartbeat_interval.count() > 0) {
+			this->set_timer(this->last_received + this->liveness.heartbeat_interval);
+		}
+	}
+
+	void ClientConnection::finish_handshake() noexcept {
+		if (this->handshake_counted.exchange(false)) {
+			this->handshakes->finish();
+		}
+	}
+
+	void ClientConnection::set_timer(std::chrono::steady_clock::time_point when) {
+		this->reactor->cancel_timer(this->timer);
+		this->timer = this->reactor->schedule(when, [weak_self = this->weak_from_this()]() {
+			if (const std::shared_ptr<ClientConnection> self = weak_self.lock()) {
+				self->on_timer();
+			}
+		});
+	}
+
+	void ClientConnection::on_timer() {
+		this->timer = NO_TIMER;
+		if (!this->is_connected()) {
+			return;
+		}
+		const auto now = std::chrono::steady_clock::now();
+		if (!this->is_identified()) {
+			if (this->state() == ClientConnectionState::Handshaking) {
+				TMX_INFO("TLS handshake not completed in time, disconnecting.");
+			} else {
+				TMX_INFO("No HELLO sent by client, disconnecting.");
+			}
+		} else if (this->heartbeat_sent > this->last_received) {
+			// nothing since the HEARTBEAT, and its answer was due by now
+			TMX_INFO("Client {} did not answer HEARTBEAT, disconnecting.", this->connected_user_name);
+		} else if (now - this->last_received < this->liveness.heartbeat_interval) {
+			// heard from since the timer was set, so it only needs to be pushed back
+			this->set_timer(this->last_received + this->liveness.heartbeat_interval);
+			return;
+		} else {
+			this->heartbeat_sent = now;
+			this->set_timer(now + this->liveness.heartbeat_timeout);
+			this->queue_frame(heartbeat_frame());
+			try {
+				this->flush_messages();
+				return;
+			} catch (const std::exception& ex) {
+				TMX_ERR("Client connection closed with exception: {}", ex.what());
+			}
+		}
+		this->timed_out = true;
+		this->close();
+	}
+
+	void ClientConnection::flush_messages() {
+		// frames only leave the queue while the socket keeps up, so a backlog stays where it can be trimmed
+		if (this->flush_outbound()) {
+			Counter& bytes_sent = server_metrics().bytes_sent;
+			while (std::optional<messaging::Frame> frame = this->outbound_frames.pop()) {
+				const size_t frame_size = frame.value()->size();
+				bytes_sent.add(frame_size);
+				if (frame_size <= COALESCE_FRAME_BYTES) {
+					// ACKs, NAKs and echoes share TLS records and writes instead of costing one each
+					this->buffer_frame(frame.value());
+					if (this->outbound_size() < COALESCE_BATCH_BYTES || this->flush_outbound()) {
+						continue;
+					}
+					break;
+				}
+				// what was gathered goes first, so a big frame can usually skip the copy
+				this->flush_outbound();
+				this->send_frame(frame.value());
+				if (this->outbound_size() > 0) {
+					break;
+				}
+			}
+			this->flush_outbound();
+		}
+		this->outbound_frames.trim();
+
+		// only ask for writable events while the socket is backed up
+		if (const SocketHandle fd = this->attached_fd; fd >= 0) {
+			this->reactor->modify(fd,
+				this->outbound_size() > 0 ? REACTOR_READABLE | REACTOR_WRITABLE : REACTOR_READABLE);
+		}
+	}
+
+	ClientConnectionManager::ClientConnectionManager(int32_t accept_port, size_t reactor_count,
+		OutboundLimits outbound_limits, const MessageRateLimits& rate_limits, int32_t tcp_keepalive_seconds,
+		ConnectionLiveness liveness)
+		: accept_port{ accept_port },
+		  outbound_limits{ outbound_limits },
+		  rate_limits{ rate_limits },
+		  tcp_keepalive_seconds{ tcp_keepalive_seconds },
+		  liveness{ liveness } {
+		for (size_t i = 0; i < std::max<size_t>(reactor_count, 1); ++i) {
+			this->reactors.push_back(std::make_shared<Reactor>());
+		}
 		SSL_load_error_strings();
 		this->ctx = ssl_unique_ptr<SSL_CTX>(SSL_CTX_new(TLS_method()));
 		SSL_CTX_set_min_proto_version(this->ctx.get(), TLS1_2_VERSION);
-		SSL_CTX_set_mode(this->ctx.get(), SSL_MODE_AUTO_RETRY);
+		SSL_CTX_set_mode(this->ctx.get(), SSL_MODE_AUTO_RETRY | SSL_WRITE_MODES);
 	}
 
 	ClientConnectionManager::~ClientConnectionManager() {
@@ -59,35 +294,75 @@ namespace tavernmx::server
 			if (BIO_do_accept(this->accept_bio.get()) != 1) {
 				throw ssl_errors_to_exception("Error in BIO_do_accept");
 			}
+			this->accepting = true;
 		}
 	}
 
-	std::optional<std::shared_ptr<ClientConnection>> ClientConnectionManager::await_next_connection() {
-		this->begin_accept();
-
-		ssl_unique_ptr<BIO> bio = accept_new_tcp_connection(this->accept_bio.get());
-		if (bio == nullptr) {
-			std::this_thread::sleep_for(std::chrono::milliseconds{ SSL_RETRY_MILLISECONDS });
-			return std::nullopt;
+	int32_t ClientConnectionManager::get_accept_port() const {
+		if (this->accept_bio == nullptr) {
+			return this->accept_port;
 		}
-		bio = std::move(bio) | ssl_unique_ptr<BIO>(BIO_new_ssl(this->ctx.get(), NEWSSL_SERVER));
-
-		this->cleanup_connections();
+		// asked of the socket, as port 0 lets the system choose one
+		int32_t port = this->accept_port;
+		BIO_ADDR* address = BIO_ADDR_new();
+		BIO_sock_info_u info{ .addr = address };
+		if (BIO_sock_info(static_cast<int32_t>(BIO_get_fd(this->accept_bio.get(), nullptr)), BIO_SOCK_INFO_ADDRESS,
+				&info) == 1) {
+			if (char* service = BIO_ADDR_service_string(address, 1)) {
+				port = std::stoi(service);
+				OPENSSL_free(service);
+			}
+		}
+		BIO_ADDR_free(address);
+		return port;
+	}
 
-		auto connection = std::make_shared<ClientConnection>(std::move(bio));
+	std::vector<std::shared_ptr<ClientConnection>> ClientConnectionManager::accept_connections(Milliseconds timeout,
+		size_t max_handshakes) {
+		this->begin_accept();
 
-		{
-			std::lock_guard guard{ this->active_connections_mutex };
-			this->active_connections.push_back(connection);
+		std::vector<std::shared_ptr<ClientConnection>> accepted{};
+		// the backlog is still readable while it's held back, so wait for a handshake to finish instead
+		size_t handshakes = this->handshakes->wait_for_room(max_handshakes,
+			std::chrono::steady_clock::now() + std::chrono::milliseconds{ timeout });
+		if (handshakes >= max_handshakes) {
+			return accepted;
+		}
+		if (!wait_readable(get_fd(this->accept_bio.get()), timeout)) {
+			return accepted;
+		}
+		// take everything waiting in the backlog, so a burst of reconnecting clients clears in one wakeup
+		for (; handshakes < max_handshakes; ++handshakes) {
+			ssl_unique_ptr<BIO> bio = accept_new_tcp_connection(this->accept_bio.get());
+			if (bio == nullptr) {
+				break;
+			}
+			if (this->tcp_keepalive_seconds > 0) {
+				set_tcp_keepalive(bio.get(), this->tcp_keepalive_seconds, TCP_KEEPALIVE_INTERVAL_SECONDS,
+					TCP_KEEPALIVE_PROBES);
+			}
+			bio = std::move(bio) | ssl_unique_ptr<BIO>(BIO_new_ssl(this->ctx.get(), NEWSSL_SERVER));
+			const std::shared_ptr<Reactor>& reactor = this->reactors[this->next_reactor++ % this->reactors.size()];
+			accepted.push_back(std::make_shared<ClientConnection>(std::move(bio), reactor, this->ready_clients,
+				this->outbound_limits, this->rate_limits, this->liveness, this->handshakes));
 		}
 
-		return connection;
+		std::lock_guard guard{ this->active_connections_mutex };
+		this->active_connections.insert(std::end(this->active_connections), std::cbegin(accepted), std::cend(accepted));
+		return accepted;
 	}
 
 	void ClientConnectionManager::shutdown() noexcept {
+		// workers stop polling the accept socket before it goes away
+		this->accepting = false;
 		std::lock_guard guard{ this->active_connections_mutex };
 		for (const std::shared_ptr<ClientConnection>& connection : this->active_connections) {
-			connection->shutdown();
+			// the reactor may be in the middle of servicing the connection, so it closes it too
+			try {
+				connection->get_reactor()->post([connection]() { connection->close(); });
+			} catch (const std::exception& ex) {
+				TMX_ERR("Unable to shut down client connection: {}", ex.what());
+			}
 		}
 		this->active_connections.clear();
 		if (this->accept_bio) {
@@ -99,6 +374,9 @@ namespace tavernmx::server
 #endif
 			this->accept_bio.reset();
 		}
+		for (const std::shared_ptr<Reactor>& reactor : this->reactors) {
+			reactor->wake();
+		}
 	}
 
 	std::vector<std::shared_ptr<ClientConnection>> ClientConnectionManager::get_active_connections() {
@@ -107,14 +385,46 @@ namespace tavernmx::server
 		return this->active_connections;
 	}
 
-	bool ClientConnectionManager::is_accepting_connections() {
-		return this->accept_bio != nullptr;
+	size_t ClientConnectionManager::active_connection_count() const {
+		std::lock_guard guard{ this->active_connections_mutex };
+		return this->active_connections.size();
+	}
+
+	OutboundUsage ClientConnectionManager::outbound_usage() const {
+		std::lock_guard guard{ this->active_connections_mutex };
+		OutboundUsage usage = this->closed_usage;
+		for (const std::shared_ptr<ClientConnection>& connection : this->active_connections) {
+			const OutboundStats stats = connection->outbound_stats();
+			usage.queued_frames += stats.queued_frames;
+			usage.queued_bytes += stats.queued_bytes;
+			usage.deepest_queue_bytes = std::max(usage.deepest_queue_bytes, stats.queued_bytes);
+			usage.degraded_clients += stats.degraded ? 1 : 0;
+			usage.dropped_events += stats.dropped_events;
+			usage.slow_disconnects += stats.overflowed ? 1 : 0;
+			usage.rate_limited_messages += connection->rate_limited_count();
+		}
+		return usage;
 	}
 
-	void ClientConnectionManager::cleanup_connections() {
+	ReapedConnections ClientConnectionManager::release_connections() {
+		ReapedConnections reaped{};
 		std::lock_guard guard{ this->active_connections_mutex };
-		std::erase_if(this->active_connections,
-			[](const std::shared_ptr<ClientConnection>& connection) { return !connection->is_connected(); });
+		reaped.released = std::erase_if(this->active_connections,
+			[this, &reaped](const std::shared_ptr<ClientConnection>& connection) {
+				// is_connected() would read the BIO, which belongs to the reactor thread
+				if (!connection->is_closed()) {
+					return false;
+				}
+				const OutboundStats stats = connection->outbound_stats();
+				this->closed_usage.dropped_events += stats.dropped_events;
+				this->closed_usage.slow_disconnects += stats.overflowed ? 1 : 0;
+				this->closed_usage.rate_limited_messages += connection->rate_limited_count();
+				if (connection->has_timed_out()) {
+					++(connection->is_identified() ? reaped.unresponsive : reaped.expired);
+				}
+				return true;
+			});
+		return reaped;
 	}
 
 }
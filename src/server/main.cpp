@@ -3,9 +3,9 @@
 #include <iostream>
 #include <semaphore>
 #include <thread>
+#include <utility>
 #include <vector>
 
-#include "thread-pool/BS_thread_pool.hpp"
 #include "tavernmx/server.h"
 #include "tavernmx/server-workers.h"
 
@@ -17,6 +17,12 @@ extern std::binary_semaphore server_ready_signal;
 extern std::binary_semaphore server_accept_signal;
 extern std::binary_semaphore server_shutdown_signal;
 
+namespace
+{
+	/// Maximum ms the accept loop waits for new connections before checking for shutdown.
+	constexpr tavernmx::ssl::Milliseconds ACCEPT_WAIT_MS = 250;
+}
+
 int main() {
 	try {
 #ifndef TMX_WINDOWS
@@ -31,7 +37,11 @@ int main() {
 
 		TMX_INFO("Configuration loaded. Server starting ...");
 
-		const auto connections = std::make_shared<ClientConnectionManager>(config.host_port);
+		const auto connections = std::make_shared<ClientConnectionManager>(config.host_port,
+			static_cast<size_t>(config.reactor_threads), config.outbound_limits, config.rate_limits,
+			config.tcp_keepalive_seconds,
+			ConnectionLiveness{ .heartbeat_interval = std::chrono::seconds{ config.heartbeat_seconds },
+				.heartbeat_timeout = std::chrono::seconds{ config.heartbeat_timeout_seconds } });
 		connections->load_certificate(config.host_certificate_path, config.host_private_key_path);
 		std::weak_ptr wk_connections = connections;
 		static auto sigint_handler = [&wk_connections]() {
@@ -50,27 +60,51 @@ int main() {
 		connections->begin_accept();
 		server_accept_signal.release();
 
+		// start reactors to service client sockets; every connection runs on one of them
+		std::vector<std::thread> reactor_threads{};
+		for (const std::shared_ptr<tavernmx::Reactor>& reactor : connections->get_reactors()) {
+			reactor_threads.emplace_back(reactor_worker, connections, reactor);
+		}
+
+		// serve metrics to a local Prometheus, if configured
+		std::thread metrics_thread{};
+		if (config.metrics_port > 0) {
+			metrics_thread = std::thread{ metrics_worker, connections, config.metrics_port };
+		}
+
 		TMX_INFO("Accepting connections ...");
-		BS::thread_pool client_thread_pool{ static_cast<BS::concurrency_t>(config.max_clients) };
 		while (!server_shutdown_signal.try_acquire() && connections->is_accepting_connections()) {
-			if (std::optional<std::shared_ptr<ClientConnection>> client = connections->await_next_connection()) {
-				TMX_INFO("Running threads: {} / {}", client_thread_pool.get_tasks_running(),
-					client_thread_pool.get_thread_count());
-				if (client_thread_pool.get_tasks_running() >= client_thread_pool.get_thread_count()) {
+			const std::vector<std::shared_ptr<ClientConnection>> clients =
+				connections->accept_connections(ACCEPT_WAIT_MS, static_cast<size_t>(config.max_handshakes));
+			if (clients.empty()) {
+				continue;
+			}
+			// connections accepted before this batch are admitted first
+			size_t position = connections->active_connection_count() - clients.size();
+			TMX_INFO("Accepted {} connection(s), active connections: {} / {}", clients.size(),
+				position + clients.size(), config.max_clients);
+			for (const std::shared_ptr<ClientConnection>& client : clients) {
+				if (std::cmp_greater(++position, config.max_clients)) {
 					TMX_WARN("Too many connections.");
-					(*client)->send_message(create_nak("Too many connections."));
-					(*client)->shutdown();
-
-					// slight delay before trying to accept another client
-					std::this_thread::sleep_for(std::chrono::seconds{ 1 });
-				} else {
-					client_thread_pool.detach_task(std::bind(client_worker, client.value()));
+					client->reject("Too many connections.");
 				}
+				client_worker(client, connections->get_room_histories());
 			}
 		}
 
+		// the server worker may have asked to stop, in which case the reactors still need telling
+		connections->shutdown();
 		TMX_INFO("Waiting for server worker thread ...");
 		server_thread.join();
+		TMX_INFO("Waiting for reactor threads ...");
+		for (std::thread& reactor_thread : reactor_threads) {
+			reactor_thread.join();
+		}
+
+		if (metrics_thread.joinable()) {
+			TMX_INFO("Waiting for metrics thread ...");
+			metrics_thread.join();
+		}
 
 		TMX_INFO("Server shutdown.");
 		return 0;
@@ -0,0 +1,38 @@
+#include <algorithm>
+#include "tavernmx/server.h"
+
+using namespace tavernmx::messaging;
+using namespace tavernmx::rooms;
+
+namespace tavernmx::server
+{
+	Frame encode_room_history(const RoomHistory& history, std::string_view room_name, size_t max_event_count) {
+		messaging::RoomHistory response{ .room_name = std::string{ room_name } };
+		response.events.reserve(std::min(max_event_count, history.size()));
+		history.read_last(max_event_count, [&response](const RoomEventView& event) {
+			response.events.push_back(RoomHistoryEvent{ .text = std::string{ event.event_text },
+				.timestamp = static_cast<int32_t>(event.timestamp.time_since_epoch().count()),
+				.user_name = std::string{ event.origin_user_name } });
+		});
+		response.event_count = static_cast<int32_t>(response.events.size());
+		return make_frame(response);
+	}
+
+	Frame RoomHistoryFrameCache::get(const RoomHistory& history, std::string_view room_name, size_t max_event_count) {
+		++this->served;
+		std::lock_guard lock{ this->frames_mutex };
+		// read under the lock, so a frame is never stored with a newer version than the events it holds
+		const uint64_t version = history.insert_count();
+		auto it = std::find_if(std::begin(this->frames), std::end(this->frames),
+			[max_event_count](const CachedFrame& cached) { return cached.event_count == max_event_count; });
+		if (it == std::end(this->frames)) {
+			it = this->frames.insert(it, CachedFrame{ .event_count = max_event_count });
+		} else if (it->frame && it->version == version) {
+			return it->frame;
+		}
+		it->version = version;
+		it->frame = encode_room_history(history, room_name, max_event_count);
+		++this->encoded;
+		return it->frame;
+	}
+}
@@ -1,8 +1,33 @@
+#include <algorithm>
+#include <array>
 #include <fstream>
+#include <thread>
 #include <nlohmann/json.hpp>
 #include "tavernmx/server.h"
 
 using json = nlohmann::json;
+using tavernmx::messaging::MessageType;
+
+namespace
+{
+	/// A rate limited message type, by its name in the config file, and its default limit.
+	struct DefaultRateLimit
+	{
+		std::string_view name{};
+		MessageType message_type{};
+		tavernmx::RateLimit limit{};
+	};
+
+	/// Generous enough for a person typing, or clicking through rooms, but not for a runaway bot.
+	constexpr std::array DEFAULT_RATE_LIMITS{
+		DefaultRateLimit{ "ROOM_LIST", MessageType::ROOM_LIST, { .per_second = 2.0, .burst = 10.0 } },
+		DefaultRateLimit{ "ROOM_CREATE", MessageType::ROOM_CREATE, { .per_second = 1.0, .burst = 10.0 } },
+		DefaultRateLimit{ "ROOM_DESTROY", MessageType::ROOM_DESTROY, { .per_second = 1.0, .burst = 10.0 } },
+		DefaultRateLimit{ "ROOM_JOIN", MessageType::ROOM_JOIN, { .per_second = 10.0, .burst = 50.0 } },
+		DefaultRateLimit{ "ROOM_HISTORY", MessageType::ROOM_HISTORY, { .per_second = 5.0, .burst = 20.0 } },
+		DefaultRateLimit{ "CHAT_SEND", MessageType::CHAT_SEND, { .per_second = 10.0, .burst = 50.0 } },
+	};
+}
 
 namespace tavernmx::server
 {
@@ -19,6 +44,10 @@ namespace tavernmx::server
 			if (!log_file.empty()) {
 				this->log_file = { std::move(log_file) };
 			}
+			std::string history_path = config_data.value("history_path", ""s);
+			if (!history_path.empty()) {
+				this->history_path = { std::move(history_path) };
+			}
 			if (!config_data["host_certificate"].is_string()) {
 				throw ServerError{ "host_certificate is required" };
 			}
@@ -28,8 +57,55 @@ namespace tavernmx::server
 			}
 			this->host_private_key_path = config_data["host_private_key"];
 			this->max_clients = config_data.value("max_clients", 10);
-			if (config_data["initial_rooms"].is_array()) {
-				for (const auto& room : config_data["initial_rooms"].items()) {
+			this->reactor_threads = std::max(config_data.value("reactor_threads",
+												 static_cast<int32_t>(std::thread::hardware_concurrency())), 1);
+			this->max_handshakes = std::max(config_data.value("max_handshakes", 256), 1);
+			this->heartbeat_seconds = std::max(config_data.value("heartbeat_seconds", 30), 0);
+			this->heartbeat_timeout_seconds = std::max(config_data.value("heartbeat_timeout_seconds", 15), 1);
+			this->tcp_keepalive_seconds = std::max(config_data.value("tcp_keepalive_seconds", 60), 0);
+			this->client_message_budget = std::max(config_data.value("client_message_budget", 32), 1);
+			this->loop_message_budget = std::max(config_data.value("loop_message_budget", 2048), 1);
+			this->outbound_limits.max_bytes = static_cast<size_t>(std::max(config_data.value("client_queue_bytes",
+				static_cast<int64_t>(this->outbound_limits.max_bytes)), int64_t{ 1 }));
+			this->outbound_limits.max_frames = static_cast<size_t>(std::max(config_data.value("client_queue_messages",
+				static_cast<int64_t>(this->outbound_limits.max_frames)), int64_t{ 1 }));
+			const std::string slow_client_policy = config_data.value("slow_client_policy", "drop_oldest"s);
+			if (slow_client_policy == "drop_oldest") {
+				this->outbound_limits.policy = SlowConsumerPolicy::DropOldest;
+			} else if (slow_client_policy == "degrade") {
+				this->outbound_limits.policy = SlowConsumerPolicy::Degrade;
+			} else if (slow_client_policy == "disconnect") {
+				this->outbound_limits.policy = SlowConsumerPolicy::Disconnect;
+			} else {
+				throw ServerError{ "slow_client_policy must be \"drop_oldest\", \"degrade\" or \"disconnect\"" };
+			}
+			for (const DefaultRateLimit& rate_limit : DEFAULT_RATE_LIMITS) {
+				this->rate_limits.set(rate_limit.message_type, rate_limit.limit);
+			}
+			if (const auto limits = config_data.find("rate_limits"); limits != config_data.end() && limits->is_object()) {
+				for (const auto& [type_name, limit] : limits->items()) {
+					const auto it = std::find_if(std::begin(DEFAULT_RATE_LIMITS), std::end(DEFAULT_RATE_LIMITS),
+						[&type_name](const DefaultRateLimit& rate_limit) { return rate_limit.name == type_name; });
+					if (it == std::end(DEFAULT_RATE_LIMITS) || !limit.is_object()) {
+						throw ServerError{ "Invalid rate_limits entry: " + type_name };
+					}
+					this->rate_limits.set(it->message_type,
+						RateLimit{ .per_second = limit.value("per_second", it->limit.per_second),
+							.burst = std::max(limit.value("burst", it->limit.burst), 1.0) });
+				}
+			}
+			this->metrics_port = std::clamp(config_data.value("metrics_port", 0), 0, 65535);
+			this->metrics_log_seconds = std::max(config_data.value("metrics_log_seconds", 60), 0);
+			this->room_shards = std::max(config_data.value("room_shards",
+											 static_cast<int32_t>(std::thread::hardware_concurrency())), 1);
+			this->room_history_size = std::max(config_data.value("room_history_size", 1000), 1);
+			if (const auto sizes = config_data.find("room_history_sizes"); sizes != config_data.end() && sizes->is_object()) {
+				for (const auto& [room_name, history_size] : sizes->items()) {
+					this->room_history_sizes.insert_or_assign(room_name, std::max(history_size.get<int32_t>(), 1));
+				}
+			}
+			if (const auto rooms = config_data.find("initial_rooms"); rooms != config_data.end() && rooms->is_array()) {
+				for (const auto& room : rooms->items()) {
 					this->initial_rooms.push_back(room.value());
 				}
 			}
@@ -0,0 +1,58 @@
+#include "tavernmx/server.h"
+
+using tavernmx::metrics::HistogramUnit;
+
+namespace
+{
+	constexpr std::string_view STEP_SECONDS = "tavernmx_server_worker_step_seconds";
+	constexpr std::string_view STEP_HELP = "Time taken by each step of the server worker loop.";
+	constexpr std::string_view HISTORY_REQUESTS = "tavernmx_room_history_requests_total";
+	constexpr std::string_view HISTORY_HELP = "ROOM_HISTORY requests answered, by who answered them.";
+}
+
+namespace tavernmx::server
+{
+	ServerMetrics::ServerMetrics()
+		: loop_time{ this->registry.histogram("tavernmx_server_worker_loop_seconds",
+			  "Time taken by a server worker loop, not counting its sleep.", HistogramUnit::Nanoseconds) },
+		  gather_time{ this->registry.histogram(std::string{ STEP_SECONDS }, std::string{ STEP_HELP },
+			  HistogramUnit::Nanoseconds, { { "step", "gather" } }) },
+		  announce_time{ this->registry.histogram(std::string{ STEP_SECONDS }, std::string{ STEP_HELP },
+			  HistogramUnit::Nanoseconds, { { "step", "announce" } }) },
+		  route_time{ this->registry.histogram(std::string{ STEP_SECONDS }, std::string{ STEP_HELP },
+			  HistogramUnit::Nanoseconds, { { "step", "route" } }) },
+		  notify_time{ this->registry.histogram(std::string{ STEP_SECONDS }, std::string{ STEP_HELP },
+			  HistogramUnit::Nanoseconds, { { "step", "notify" } }) },
+		  housekeeping_time{ this->registry.histogram(std::string{ STEP_SECONDS }, std::string{ STEP_HELP },
+			  HistogramUnit::Nanoseconds, { { "step", "housekeeping" } }) },
+		  handshake_time{ this->registry.histogram("tavernmx_tls_handshake_seconds",
+			  "Time from accepting a client connection to completing its TLS handshake.",
+			  HistogramUnit::Nanoseconds) },
+		  fanout{ this->registry.histogram("tavernmx_chat_fanout_clients",
+			  "Number of clients each frame of chat echoes is queued for.", HistogramUnit::Count) },
+		  bytes_received{ this->registry.counter("tavernmx_received_bytes_total",
+			  "Bytes of message blocks received from clients.") },
+		  bytes_sent{ this->registry.counter("tavernmx_sent_bytes_total", "Bytes of frames sent to clients.") },
+		  history_from_reactor{ this->registry.counter(std::string{ HISTORY_REQUESTS }, std::string{ HISTORY_HELP },
+			  { { "answered_by", "reactor" } }) },
+		  history_from_room_worker{ this->registry.counter(std::string{ HISTORY_REQUESTS },
+			  std::string{ HISTORY_HELP }, { { "answered_by", "room_worker" } }) },
+		  active_connections{ this->registry.gauge("tavernmx_active_connections",
+			  "Client connections being tracked, including those still in their handshake.") },
+		  handshakes{ this->registry.gauge("tavernmx_tls_handshakes", "Client connections in their TLS handshake.") },
+		  queued_frames{ this->registry.gauge("tavernmx_client_queue_frames", "Frames queued for all clients.") },
+		  queued_bytes{ this->registry.gauge("tavernmx_client_queue_bytes", "Bytes queued for all clients.") },
+		  deepest_queue_bytes{ this->registry.gauge("tavernmx_client_queue_deepest_bytes",
+			  "Bytes queued for the client furthest behind.") } {
+		for (size_t i = 0; i < messaging::ALL_MESSAGE_TYPES.size(); ++i) {
+			this->messages_received[i] = &this->registry.counter("tavernmx_received_messages_total",
+				"Messages received from clients, by type.",
+				{ { "type", std::string{ messaging::message_type_name(messaging::ALL_MESSAGE_TYPES[i]) } } });
+		}
+	}
+
+	ServerMetrics& server_metrics() {
+		static ServerMetrics metrics{};
+		return metrics;
+	}
+}
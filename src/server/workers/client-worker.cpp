@@ -4,81 +4,162 @@ using namespace tavernmx::messaging;
 
 namespace
 {
-    /// Target maximum ms for loop processing. This is based off of SSL_RETRY_MILLISECONDS since there's
-    /// a built-in wait in tavernmx::ssl::receive_message(BIO*).
-    constexpr std::chrono::milliseconds TARGET_CLIENT_LOOP_MS{ tavernmx::ssl::SSL_RETRY_MILLISECONDS * 2 };
-}
+    /// Maximum ms the reactor thread will wait for socket activity before checking if the server is still running.
+    constexpr tavernmx::ssl::Milliseconds REACTOR_WAIT_MS = 1000;
 
-namespace tavernmx::server
-{
-    void client_worker(std::shared_ptr<ClientConnection> client) {
+    /// Bytes on the wire ahead of each MessageBlock's payload: the header and the payload size.
+    constexpr size_t BLOCK_HEADER_SIZE = sizeof(MessageBlock::HEADER) + sizeof(MessageBlock::payload_size);
+
+    /// Every HEARTBEAT gets the same reply, so it only needs to be encoded once.
+    const Frame& ack_frame() {
+        static const Frame frame = make_frame(create_ack());
+        return frame;
+    }
+
+    /**
+     * @brief Handles socket events for a client connection attached to the reactor. The TLS handshake is
+     * completed first, without blocking. Until the client then sends HELLO, anything else it sends is discarded.
+     * @param client The client connection.
+     * @param room_histories Directory of chat room histories, for answering ROOM_HISTORY requests.
+     * @param events Events reported by the reactor.
+     */
+    void service_client(const std::shared_ptr<tavernmx::server::ClientConnection>& client,
+        const tavernmx::server::RoomHistoryDirectory& room_histories, tavernmx::ReactorEvents events) {
         try {
-            // Expect client to send HELLO as the first message
-            if (const std::optional<Message> hello = client->wait_for(MessageType::HELLO)) {
-                client->connected_user_name = message_value_or<std::string>(*hello, "user_name");
-                TMX_INFO("Client connected: {}", client->connected_user_name);
-                // TODO: validate user name
-                client->send_message(create_ack());
-            } else {
-                TMX_INFO("No HELLO sent by client, disconnecting.");
-                TMX_INFO("Client worker exiting.");
+            // 0. Finish the TLS handshake; the reactor calls back when the socket is ready for the next step
+            if (client->state() == tavernmx::server::ClientConnectionState::Handshaking &&
+                !client->continue_handshake()) {
+                if ((events & tavernmx::REACTOR_CLOSED) != 0) {
+                    TMX_INFO("Client disconnected during TLS handshake.");
+                    client->close();
+                }
                 return;
             }
 
-            // Serialize messages back and forth from client
-            while (client->is_connected()) {
-                const std::chrono::time_point<std::chrono::high_resolution_clock> loop_start =
-                    std::chrono::high_resolution_clock::now();
-
-                std::vector<Message> send_messages{};
-
-                // 1. Read waiting messages on socket
-                if (std::optional<MessageBlock> block = client->receive_message()) {
-                    TMX_INFO("Receive message block: {} bytes", block->payload_size);
-                    for (Message& msg : unpack_messages(block.value())) {
-                        TMX_INFO("Receive message: {}", static_cast<int32_t>(msg.message_type));
-                        switch (msg.message_type) {
-                        case MessageType::HEARTBEAT:
-                            // if client requests a HEARTBEAT, we can respond immediately
-                            send_messages.push_back(create_ack());
-                            break;
-                        case MessageType::ACK:
-                        case MessageType::NAK:
-                            // outside of connection handshake, ACK/NAK can be ignored
-                            break;
-                        case MessageType::Invalid:
-                            // programming error?
-                            assert(false && "Received Invalid message type");
-                            break;
-                        default:
-                            // anything else, queue it for processing
-                            client->messages_in.push(std::move(msg));
-                            break;
+            // 1. Read all waiting messages on socket
+            const auto now = std::chrono::steady_clock::now();
+            const std::vector<MessageBlock> blocks = client->receive_messages();
+            if (!blocks.empty()) {
+                client->record_activity(now);
+            }
+            tavernmx::server::ServerMetrics& metrics = tavernmx::server::server_metrics();
+            for (const MessageBlock& block : blocks) {
+                TMX_INFO("Receive message block: {} bytes", block.payload_size);
+                metrics.bytes_received.add(BLOCK_HEADER_SIZE + block.payload_size);
+                for (Message& msg : unpack_messages(block)) {
+                    TMX_INFO("Receive message: {}", static_cast<int32_t>(msg.message_type));
+                    metrics.count_received(msg.message_type);
+                    if (!client->is_identified()) {
+                        // Expect client to send HELLO as the first message
+                        if (msg.message_type == MessageType::HELLO && !client->rejection_reason().empty()) {
+                            TMX_INFO("Turning client away: {}", client->rejection_reason());
+                            client->queue_frame(make_frame(create_nak(client->rejection_reason())));
+                            client->flush_messages();
+                            client->close();
+                            return;
+                        }
+                        if (msg.message_type == MessageType::HELLO) {
+                            client->identify(message_value_or<std::string>(msg, "user_name"));
+                            TMX_INFO("Client connected: {}", client->connected_user_name);
+                            // TODO: validate user name
+                            client->queue_frame(ack_frame());
+                        }
+                        continue;
+                    }
+                    // refuse anything the client is sending too fast, before it costs the server any work
+                    if (const std::chrono::milliseconds retry_after = client->check_rate(msg.message_type, now);
+                        retry_after.count() > 0) {
+                        client->queue_frame(make_frame(
+                            create_rate_limited_nak(msg.message_type, static_cast<int32_t>(retry_after.count()))));
+                        continue;
+                    }
+                    switch (msg.message_type) {
+                    case MessageType::HEARTBEAT:
+                        // if client requests a HEARTBEAT, we can respond immediately
+                        client->queue_frame(ack_frame());
+                        break;
+                    case MessageType::ROOM_HISTORY: {
+                        // answered here from a snapshot of the history rather than queued behind room events,
+                        // unless the room's worker hasn't published it yet (or the request is invalid)
+                        const auto room_name = message_value_or<std::string>(msg, "room_name");
+                        const auto event_count = message_value_or<std::int32_t>(msg, "event_count");
+                        tavernmx::messaging::Frame frame{};
+                        if (event_count >= 0 && event_count <= ROOM_HISTORY_MAX_ENTRIES) {
+                            // identical requests between chat lines share one encoded response
+                            frame = room_histories.find_frame(room_name, event_count);
                         }
-                    };
+                        if (frame) {
+                            metrics.history_from_reactor.add();
+                            client->queue_frame(std::move(frame));
+                        } else {
+                            client->push_inbound(std::move(msg));
+                        }
+                    } break;
+                    case MessageType::ACK:
+                    case MessageType::NAK:
+                        // outside of connection handshake, ACK/NAK can be ignored
+                        break;
+                    case MessageType::Invalid:
+                        // programming error?
+                        assert(false && "Received Invalid message type");
+                        break;
+                    default:
+                        // anything else, queue it for processing
+                        client->push_inbound(std::move(msg));
+                        break;
+                    }
                 }
+            }
 
-                // 2. Send queued messages to socket
-                while (std::optional<Message> msg = client->messages_out.pop()) {
-                    TMX_INFO("Send message: {}", static_cast<int32_t>(msg->message_type));
-                    send_messages.push_back(std::move(msg.value()));
-                }
-                client->send_messages(std::cbegin(send_messages), std::cend(send_messages));
+            // 2. Send queued messages to socket
+            if (client->is_connected()) {
+                client->flush_messages();
+            }
+        } catch (const std::exception& ex) {
+            TMX_ERR("Client connection closed with exception: {}", ex.what());
+            client->close();
+            return;
+        }
+
+        if ((events & tavernmx::REACTOR_CLOSED) != 0 || !client->is_connected()) {
+            TMX_INFO("Client disconnected: {}", client->connected_user_name);
+            client->close();
+        }
+    }
+}
 
-                // 3. Sleep
-                const std::chrono::high_resolution_clock::duration loop_elapsed =
-                    std::chrono::high_resolution_clock::now() - loop_start;
-                if (loop_elapsed < TARGET_CLIENT_LOOP_MS) {
-                    std::this_thread::sleep_for(TARGET_CLIENT_LOOP_MS - loop_elapsed);
-                } else {
-                    TMX_WARN("Client worker loop took too long to process: {}ms",
-                        duration_cast<std::chrono::milliseconds>(loop_elapsed).count());
+namespace tavernmx::server
+{
+    void client_worker(std::shared_ptr<ClientConnection> client, std::shared_ptr<RoomHistoryDirectory> room_histories) {
+        try {
+            // The reactor drives the connection from here on, including the TLS handshake and HELLO exchange
+            client->attach([weak_client = std::weak_ptr{ client }, room_histories = std::move(room_histories)](
+                               ReactorEvents events) {
+                if (const std::shared_ptr<ClientConnection> connection = weak_client.lock()) {
+                    service_client(connection, *room_histories, events);
                 }
+            });
+            // anything queued by the server worker before we attached
+            client->notify_outbound();
+        } catch (const std::exception& ex) {
+            TMX_ERR("Unable to service client connection: {}", ex.what());
+            client->close();
+        }
+    }
+
+    void reactor_worker(std::shared_ptr<ClientConnectionManager> connections, std::shared_ptr<Reactor> reactor) {
+        try {
+            TMX_INFO("Reactor worker starting.");
+            while (connections->is_accepting_connections()) {
+                reactor->run_once(REACTOR_WAIT_MS);
             }
-            TMX_INFO("Client worker exiting.");
+            // the shutdown posted by the manager may have raced the check above
+            reactor->run_once(0);
+            TMX_INFO("Reactor worker exiting.");
         } catch (const std::exception& ex) {
-            TMX_ERR("Client worker exited with exception: {}", ex.what());
+            TMX_ERR("Reactor worker exited with exception: {}", ex.what());
+            connections->shutdown();
         }
     }
 
-}
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "tavernmx/server-workers.h"
+
+namespace
+{
+	/// Maximum ms the metrics worker waits for a request before checking if the server is still running.
+	constexpr tavernmx::ssl::Milliseconds METRICS_WAIT_MS = 250;
+	/// How long a scraper has to send its request and take the response before it is disconnected.
+	constexpr std::chrono::seconds SCRAPE_TIMEOUT{ 5ll };
+	/// Largest request accepted; Prometheus sends a few hundred bytes of headers.
+	constexpr size_t MAX_REQUEST_SIZE = 8 * 1024;
+
+	/// A connection from a scraper, from reading its request to sending the response.
+	struct Scrape
+	{
+		tavernmx::ssl::ssl_unique_ptr<BIO> bio{};
+		std::string request{};
+		std::string response{};
+		size_t sent{};
+		tavernmx::TimerId timer{ tavernmx::NO_TIMER };
+	};
+
+	/// Open scrapes by socket. Only touched on the metrics worker's reactor thread.
+	using Scrapes = std::unordered_map<tavernmx::SocketHandle, std::shared_ptr<Scrape>>;
+
+	/// Builds the HTTP response to \p request.
+	std::string respond_to(std::string_view request, const tavernmx::metrics::MetricsRegistry& registry) {
+		if (!request.starts_with("GET /metrics ") && !request.starts_with("GET / ")) {
+			return "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+		}
+		const std::string body = registry.to_prometheus();
+		return fmt::format("HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+						   "Content-Length: {}\r\nConnection: close\r\n\r\n{}",
+			body.size(), body);
+	}
+
+	/// Stops watching \p fd and closes its connection.
+	void close_scrape(tavernmx::Reactor& reactor, Scrapes& scrapes, tavernmx::SocketHandle fd) {
+		const auto it = scrapes.find(fd);
+		if (it == scrapes.end()) {
+			return;
+		}
+		reactor.remove(fd);
+		reactor.cancel_timer(it->second->timer);
+		scrapes.erase(it);
+	}
+
+	/// Reads the request on \p fd once it has all arrived, then sends the response as fast as the socket takes it.
+	void service_scrape(tavernmx::Reactor& reactor, Scrapes& scrapes, tavernmx::SocketHandle fd,
+		const tavernmx::metrics::MetricsRegistry& registry, tavernmx::ReactorEvents events) {
+		const auto it = scrapes.find(fd);
+		if (it == scrapes.end()) {
+			return;
+		}
+		Scrape& scrape = *it->second;
+		try {
+			if (scrape.response.empty()) {
+				char buffer[1024];
+				int32_t read = 0;
+				while ((read = BIO_read(scrape.bio.get(), buffer, sizeof(buffer))) > 0) {
+					scrape.request.append(buffer, static_cast<size_t>(read));
+				}
+				if (scrape.request.find("\r\n\r\n") == std::string::npos) {
+					// the scraper hung up, or is sending something other than an HTTP request
+					if (!BIO_should_retry(scrape.bio.get()) || (events & tavernmx::REACTOR_CLOSED) != 0 ||
+						scrape.request.size() > MAX_REQUEST_SIZE) {
+						close_scrape(reactor, scrapes, fd);
+					}
+					return;
+				}
+				scrape.response = respond_to(scrape.request, registry);
+			}
+			const auto bytes = reinterpret_cast<const tavernmx::messaging::CharType*>(scrape.response.data());
+			while (scrape.sent < scrape.response.size()) {
+				const size_t written = tavernmx::ssl::send_bytes(scrape.bio.get(),
+					std::span{ bytes + scrape.sent, scrape.response.size() - scrape.sent });
+				if (written == 0) {
+					reactor.modify(fd, tavernmx::REACTOR_WRITABLE);
+					return;
+				}
+				scrape.sent += written;
+			}
+		} catch (const std::exception& ex) {
+			TMX_WARN("Metrics request failed: {}", ex.what());
+		}
+		close_scrape(reactor, scrapes, fd);
+	}
+}
+
+namespace tavernmx::server
+{
+	void metrics_worker(std::shared_ptr<ClientConnectionManager> connections, int32_t port) {
+		try {
+			const std::string host_port = fmt::format("127.0.0.1:{}", port);
+			const ssl::ssl_unique_ptr<BIO> accept_bio{ BIO_new_accept(host_port.c_str()) };
+			BIO_set_nbio(accept_bio.get(), 1);
+			BIO_set_nbio_accept(accept_bio.get(), 1);
+			if (BIO_do_accept(accept_bio.get()) != 1) {
+				throw ServerError{ "Unable to listen on " + host_port };
+			}
+
+			Reactor reactor{};
+			Scrapes scrapes{};
+			const metrics::MetricsRegistry& registry = server_metrics().registry;
+			const SocketHandle accept_fd = ssl::get_fd(accept_bio.get());
+			reactor.add(accept_fd, REACTOR_READABLE, [&](ReactorEvents) {
+				while (ssl::ssl_unique_ptr<BIO> bio = ssl::accept_new_tcp_connection(accept_bio.get())) {
+					const SocketHandle fd = ssl::get_fd(bio.get());
+					auto scrape = std::make_shared<Scrape>(Scrape{ .bio = std::move(bio) });
+					scrape->timer = reactor.schedule(std::chrono::steady_clock::now() + SCRAPE_TIMEOUT,
+						[&reactor, &scrapes, fd]() { close_scrape(reactor, scrapes, fd); });
+					scrapes.emplace(fd, std::move(scrape));
+					reactor.add(fd, REACTOR_READABLE, [&reactor, &scrapes, &registry, fd](ReactorEvents events) {
+						service_scrape(reactor, scrapes, fd, registry, events);
+					});
+				}
+			});
+
+			TMX_INFO("Metrics worker serving http://{}/metrics", host_port);
+			while (connections->is_accepting_connections()) {
+				reactor.run_once(METRICS_WAIT_MS);
+			}
+			for (const auto& [fd, scrape] : scrapes) {
+				reactor.remove(fd);
+			}
+			reactor.remove(accept_fd);
+			TMX_INFO("Metrics worker exiting.");
+		} catch (const std::exception& ex) {
+			TMX_ERR("Metrics worker exited with exception: {}", ex.what());
+		}
+	}
+}
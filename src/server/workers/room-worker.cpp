@@ -0,0 +1,175 @@
+#include "tavernmx/server-workers.h"
+
+using namespace tavernmx::messaging;
+using namespace tavernmx::rooms;
+
+namespace
+{
+	/// Maximum ms a room worker sleeps when it isn't notified of new commands.
+	constexpr std::chrono::milliseconds ROOM_WORKER_WAIT_MS{ 20ll };
+
+	/// Encode the pending RoomEvents in \p room into a single frame of CHAT_ECHO messages, or nullptr if there are
+	/// none. \p event_count receives the number of events encoded.
+	Frame room_events_to_frame(ServerRoom* room, size_t& event_count) {
+		MessagePacker packer{};
+		std::queue<RoomEvent> events = room->events.swap_all();
+		event_count = events.size();
+		for (; !events.empty(); events.pop()) {
+			RoomEvent& event = events.front();
+			packer.add(ChatEcho{ .room_name = room->room_name(),
+				.text = std::move(event.event_text),
+				.timestamp = static_cast<int32_t>(event.timestamp.time_since_epoch().count()),
+				.user_name = std::move(event.origin_user_name) });
+		}
+		return packer.empty() ? nullptr : packer.finish_frame();
+	}
+
+	/// Open the history log of \p room and load its newest events into the room's history, or nullptr on failure.
+	std::shared_ptr<RoomHistoryLog> open_history_log(const HistoryLogWriter& writer, const ServerRoom& room) {
+		try {
+			std::shared_ptr<RoomHistoryLog> log = writer.open(room.room_name());
+			const auto start = std::chrono::steady_clock::now();
+			const size_t recovered = log->read_last(room.history->capacity(),
+				[&room](RoomEvent event) { room.history->insert(std::move(event)); });
+			if (recovered > 0) {
+				TMX_INFO("Recovered {} event(s) of history for #{} in {} ms", recovered, room.room_name(),
+					std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start)
+					.count());
+			}
+			return log;
+		} catch (HistoryLogError& ex) {
+			TMX_ERR("Unable to open history log for #{}: {}", room.room_name(), ex.what());
+			return nullptr;
+		}
+	}
+
+	/// Queue \p frame for \p client and let its reactor know.
+	void send_to_client(const std::shared_ptr<tavernmx::server::ClientConnection>& client, Frame frame) {
+		client->queue_frame(std::move(frame));
+		client->notify_outbound();
+	}
+
+	/// Queue \p frame of \p event_count chat echoes for \p client, which may drop them if it has fallen behind.
+	void echo_to_client(const std::shared_ptr<tavernmx::server::ClientConnection>& client, Frame frame,
+		size_t event_count) {
+		client->queue_chat_echoes(std::move(frame), event_count);
+		client->notify_outbound();
+	}
+
+	/// Send the pending events of \p room to its joined clients, encoded once and shared by all of them.
+	void fan_out_events(ServerRoom* room) {
+		room->clean_expired_clients();
+		size_t event_count = 0;
+		const Frame frame = room_events_to_frame(room, event_count);
+		if (!frame) {
+			return;
+		}
+		size_t recipients = 0;
+		for (const std::weak_ptr<tavernmx::server::ClientConnection>& client_ptr : room->joined_clients) {
+			if (const std::shared_ptr<tavernmx::server::ClientConnection> client = client_ptr.lock()) {
+				echo_to_client(client, frame, event_count);
+				++recipients;
+			}
+		}
+		tavernmx::server::server_metrics().fanout.record(recipients);
+	}
+}
+
+namespace tavernmx::server
+{
+	void room_worker(std::shared_ptr<RoomShard> shard, std::shared_ptr<RoomHistoryDirectory> room_histories,
+		std::shared_ptr<HistoryLogWriter> history_writer, const ServerConfiguration& config) {
+		try {
+			RoomManager<ServerRoom> rooms{};
+			std::vector<RoomCommand> commands{};
+
+			TMX_INFO("Room worker {} starting.", shard->index());
+			while (shard->is_running()) {
+				shard->wait(ROOM_WORKER_WAIT_MS);
+
+				// Step 1. Process commands routed to this shard
+				commands.clear();
+				shard->commands.drain_into(commands);
+				for (const RoomCommand& command : commands) {
+					const Message& msg = command.message;
+					const std::shared_ptr<ClientConnection>& client = command.client;
+					auto room_name = message_value_or<std::string>(msg, "room_name");
+					const std::shared_ptr<ServerRoom> room = rooms[room_name];
+					switch (msg.message_type) {
+					case MessageType::ROOM_CREATE:
+						// name was already validated and reserved by the server worker
+						if (const std::shared_ptr<ServerRoom> new_room = rooms.create_room(room_name)) {
+							new_room->history = std::make_shared<RoomHistory>(
+								config.room_history_capacity(room_name), room_histories->user_names());
+							if (history_writer) {
+								new_room->history_log = open_history_log(*history_writer, *new_room);
+							}
+							room_histories->publish(room_name, new_room->history);
+							if (client) {
+								new_room->joined_clients.emplace_back(client);
+							}
+						}
+						break;
+					case MessageType::ROOM_JOIN:
+						if (room && client) {
+							room->join(client);
+						} else {
+							TMX_WARN("Room does not exist (client join request): #{}", room_name);
+						}
+						break;
+					case MessageType::ROOM_DESTROY:
+						// removed right away, as the server worker may already have reused the name further
+						// down this batch
+						if (room) {
+							fan_out_events(room.get());
+							if (room->history_log) {
+								room->history_log->remove();
+							}
+							room_histories->erase(room_name);
+							rooms.remove_room(room_name);
+						}
+						break;
+					case MessageType::ROOM_HISTORY: {
+						// usually answered by the reactor; this only sees requests for rooms created after the
+						// history directory was checked
+						auto event_count = message_value_or<std::int32_t>(msg, "event_count");
+						if (event_count >= 0 && event_count <= ROOM_HISTORY_MAX_ENTRIES && room && client) {
+							server_metrics().history_from_room_worker.add();
+							send_to_client(client, room_histories->find_frame(room->room_name(), event_count));
+						} else {
+							TMX_WARN("Invalid room history request: name '{}', count {}", room_name, event_count);
+						}
+					} break;
+					case MessageType::CHAT_SEND:
+						if (room && client) {
+							RoomEvent room_event{ .origin_user_name = client->connected_user_name,
+								.event_text = message_value_or<std::string>(msg, "text") };
+							room->history->insert(room_event);
+							if (room->history_log) {
+								history_writer->append(room->history_log, room_event);
+							}
+							room->events.push(std::move(room_event));
+						} else {
+							TMX_WARN("Client sent message to unknown room: {}", room_name);
+						}
+						break;
+					default:
+						TMX_WARN("Room worker {} received unhandled message type: {}", shard->index(),
+							static_cast<int32_t>(msg.message_type));
+						break;
+					}
+				}
+
+				// Step 2. Distribute room events to joined clients
+				for (const std::shared_ptr<ServerRoom>& room : rooms.rooms()) {
+					fan_out_events(room.get());
+				}
+			}
+			TMX_INFO("Room worker {} exiting.", shard->index());
+		} catch (std::exception& ex) {
+			TMX_ERR("Room worker {} exited with exception: {}", shard->index(), ex.what());
+			// the server worker shuts the server down rather than keep queueing commands nobody will process
+			shard->fail();
+		}
+	}
+}
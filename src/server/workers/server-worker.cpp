@@ -1,5 +1,8 @@
 #include "tavernmx/server-workers.h"
+#include "tavernmx/deficit-round-robin.h"
+#include "tavernmx/timer-wheel.h"
 #include <semaphore>
+#include <stdexcept>
 
 using namespace tavernmx::messaging;
 using namespace tavernmx::rooms;
@@ -13,48 +16,84 @@ std::binary_semaphore server_shutdown_signal{ 0 };
 
 namespace
 {
-	/// Maximum amount of chat room history to track.
-	constexpr size_t CHAT_ROOM_HISTORY_SIZE = 1000;
-	struct StringHash : std::hash<std::string_view>
-	{
-		using is_transparent = void;
-	};
-	using RoomHistory = std::unordered_map<std::string, tavernmx::RingBuffer<RoomEvent, CHAT_ROOM_HISTORY_SIZE>,
-		StringHash, std::equal_to<>>;
-
-	/// Target maximum ms for loop processing.
+	/// Maximum ms between loops when no client sends anything.
 	constexpr std::chrono::milliseconds TARGET_SERVER_LOOP_MS{ 20ll };
+	/// How often the memory used by room history, and by client queues, is logged.
+	constexpr std::chrono::seconds HISTORY_REPORT_INTERVAL{ 60ll };
+	/// How often closed client connections are released.
+	constexpr std::chrono::seconds RELEASE_CONNECTIONS_INTERVAL{ 1ll };
+	/// Resolution of the server worker's housekeeping timers.
+	constexpr std::chrono::milliseconds HOUSEKEEPING_TICK{ 100ll };
+	/// How often gauges of connections and queue depths are refreshed.
+	constexpr std::chrono::seconds GAUGE_REFRESH_INTERVAL{ 1ll };
 
-	/// Convert RoomEvents in \p room into Message objects.
-	std::vector<Message> room_events_to_messages(ServerRoom* room) {
-		std::vector<Message> messages{};
-		while (const std::optional<RoomEvent> event = room->events.pop()) {
-			messages.push_back(create_chat_echo(room->room_name(), event->event_text, event->origin_user_name,
-				static_cast<int32_t>(event->timestamp.time_since_epoch().count())));
-		}
-		return messages;
+	/// Runs \p job on \p timers every \p interval, starting one interval from now.
+	void schedule_every(tavernmx::TimerWheel& timers, std::chrono::steady_clock::duration interval,
+		std::function<void()> job) {
+		timers.schedule(std::chrono::steady_clock::now() + interval, [&timers, interval, job = std::move(job)]() mutable {
+			job();
+			schedule_every(timers, interval, std::move(job));
+		});
 	}
 
-	/// Record \p room_event as part of the history of \p room_name.
-	void insert_event_into_room_history(RoomHistory& room_history, const std::string& room_name, RoomEvent room_event) {
-		if (!room_history.contains(room_name)) {
-			room_history[room_name] = {};
-		}
-		room_history[room_name].insert(std::move(room_event));
+	/// Records the time since \p mark in \p histogram, then moves \p mark to now.
+	void record_lap(tavernmx::metrics::Histogram& histogram, std::chrono::steady_clock::time_point& mark) {
+		const auto now = std::chrono::steady_clock::now();
+		histogram.record(now - mark);
+		mark = now;
 	}
 
-	/// Pack the history for \p room_name into a Message.
-	Message get_room_history(RoomHistory& room_history, const std::string& room_name, size_t max_event_count) {
-		Message history_msg = create_room_history(room_name, 0);
-		if (room_history.contains(room_name)) {
-			for (auto& [timestamp, origin_user_name, event_text] : room_history[room_name]) {
-				if (add_room_history_event(history_msg, static_cast<int32_t>(timestamp.time_since_epoch().count()),
-						origin_user_name, event_text) == max_event_count) {
-					break;
-				}
+	/// Room shards and the room worker threads servicing them. Workers are stopped and joined on destruction.
+	class RoomShardPool
+	{
+	public:
+		RoomShardPool(size_t shard_count, const std::shared_ptr<tavernmx::server::RoomHistoryDirectory>& room_histories,
+			const std::shared_ptr<tavernmx::rooms::HistoryLogWriter>& history_writer,
+			const tavernmx::server::ServerConfiguration& config) {
+			for (size_t i = 0; i < shard_count; ++i) {
+				this->shards.push_back(std::make_shared<tavernmx::server::RoomShard>(i));
+			}
+			for (const std::shared_ptr<tavernmx::server::RoomShard>& shard : this->shards) {
+				this->threads.emplace_back(tavernmx::server::room_worker, shard, room_histories, history_writer,
+					std::cref(config));
 			}
 		}
-		return history_msg;
+
+		~RoomShardPool() {
+			for (const std::shared_ptr<tavernmx::server::RoomShard>& shard : this->shards) {
+				shard->stop();
+			}
+			for (std::thread& thread : this->threads) {
+				thread.join();
+			}
+		}
+
+		RoomShardPool(const RoomShardPool&) = delete;
+
+		RoomShardPool& operator=(const RoomShardPool&) = delete;
+
+		size_t size() const { return this->shards.size(); }
+
+		/// The shard that owns \p room_name.
+		tavernmx::server::RoomShard& shard_for(std::string_view room_name) const {
+			return *this->shards[tavernmx::server::room_shard_index(room_name, this->shards.size())];
+		}
+
+		tavernmx::server::RoomShard& operator[](size_t index) const { return *this->shards[index]; }
+
+	private:
+		std::vector<std::shared_ptr<tavernmx::server::RoomShard>> shards{};
+		std::vector<std::thread> threads{};
+	};
+
+	/// Commands waiting to be handed to each shard at the end of a loop.
+	using RoutedCommands = std::vector<std::vector<tavernmx::server::RoomCommand>>;
+
+	/// Queue \p msg for the shard that owns \p room_name.
+	void route_command(const RoomShardPool& shards, RoutedCommands& routed, std::string_view room_name,
+		std::shared_ptr<tavernmx::server::ClientConnection> client, Message msg) {
+		routed[shards.shard_for(room_name).index()].push_back(
+			tavernmx::server::RoomCommand{ .client = std::move(client), .message = std::move(msg) });
 	}
 }
 
@@ -62,21 +101,113 @@ namespace tavernmx::server
 {
 	void server_worker(const ServerConfiguration& config, std::shared_ptr<ClientConnectionManager> connections) {
 		try {
-			RoomManager<ServerRoom> rooms{};
-			RoomHistory room_history{};
+			// The directory of room names is kept here so the room list and create/destroy stay globally
+			// consistent; everything else about a room lives on the shard that owns it.
+			RoomManager<Room> room_directory{};
+			const std::shared_ptr<RoomHistoryDirectory> room_histories = connections->get_room_histories();
+			// declared before the shards so it outlives them, and flushes their last events on exit
+			std::shared_ptr<HistoryLogWriter> history_writer{};
+			if (config.history_path.has_value()) {
+				history_writer = std::make_shared<HistoryLogWriter>(config.history_path.value());
+			}
+			const RoomShardPool shards{
+				static_cast<size_t>(std::max(config.room_shards, 1)), room_histories, history_writer, config };
+			RoutedCommands routed(shards.size());
+			const std::shared_ptr<QueueSignal> inbound_signal = connections->get_inbound_signal();
+			const std::shared_ptr<ReadyClients> ready_clients = connections->get_ready_clients();
+			std::vector<std::weak_ptr<ClientConnection>> newly_ready{};
+			std::vector<std::shared_ptr<ClientConnection>> clients_to_notify{};
+			std::vector<Message> inbound{};
+			// only clients with messages waiting are on it, for as long as they have some
+			DeficitRoundRobin<std::shared_ptr<ClientConnection>> client_turns{
+				static_cast<size_t>(config.client_message_budget), static_cast<size_t>(config.loop_message_budget) };
 
-			TMX_INFO("Server worker starting.");
+			TMX_INFO("Server worker starting with {} room shard(s).", shards.size());
 
 			TMX_INFO("Creating initial rooms ...");
 			for (const std::string& room_name : config.initial_rooms) {
-				if (const std::shared_ptr<ServerRoom> room = rooms.create_room(room_name)) {
+				if (const std::shared_ptr<Room> room = room_directory.create_room(room_name)) {
 					TMX_INFO("Room created: #{}", room->room_name());
+					route_command(shards, routed, room_name, nullptr, create_room_create(room_name));
 				} else {
 					TMX_WARN("Room already exists or invalid name: #{}", room_name);
 				}
 			}
+			if (history_writer) {
+				// rooms created by clients before the last shutdown still have their history on disk
+				for (const std::string& room_name : history_writer->room_names()) {
+					if (room_directory.create_room(room_name)) {
+						TMX_INFO("Room restored from history: #{}", room_name);
+						route_command(shards, routed, room_name, nullptr, create_room_create(room_name));
+					}
+				}
+			}
 			TMX_INFO("All rooms created.");
 
+			ServerMetrics& metrics = server_metrics();
+			std::vector<tavernmx::metrics::Gauge*> shard_queue_depths{};
+			for (size_t i = 0; i < shards.size(); ++i) {
+				shard_queue_depths.push_back(&metrics.registry.gauge("tavernmx_room_shard_commands_queued",
+					"Commands waiting for each room worker.", { { "shard", std::to_string(i) } }));
+			}
+
+			// Housekeeping runs on timers, checked once per loop
+			TimerWheel housekeeping{ HOUSEKEEPING_TICK };
+			ReapedConnections reaped_total{};
+			schedule_every(housekeeping, RELEASE_CONNECTIONS_INTERVAL, [&connections, &reaped_total]() {
+				const ReapedConnections reaped = connections->release_connections();
+				if (reaped.released == 0) {
+					return;
+				}
+				reaped_total.expired += reaped.expired;
+				reaped_total.unresponsive += reaped.unresponsive;
+				reaped_total.released += reaped.released;
+				TMX_INFO("Released {} closed connection(s), {} for missing the handshake or HELLO deadline and {} for "
+						 "not answering HEARTBEAT ({} / {} / {} in total)",
+					reaped.released, reaped.expired, reaped.unresponsive, reaped_total.released, reaped_total.expired,
+					reaped_total.unresponsive);
+			});
+			// Report how much memory room history and client queues are using
+			schedule_every(housekeeping, HISTORY_REPORT_INTERVAL, [&connections, &room_histories]() {
+				size_t total_bytes = 0;
+				for (const RoomHistoryUsage& usage : room_histories->usage()) {
+					TMX_INFO("Room #{} history: {} / {} events, {} bytes, {} response(s) served from {} encoding(s)",
+						usage.room_name, usage.event_count, usage.capacity, usage.bytes, usage.frames_served,
+						usage.frames_encoded);
+					total_bytes += usage.bytes;
+				}
+				TMX_INFO("Room history total: {} bytes, {} user name(s) interned", total_bytes,
+					room_histories->user_names()->size());
+				const OutboundUsage outbound = connections->outbound_usage();
+				TMX_INFO("Client queues: {} frame(s), {} bytes, deepest {} bytes; {} client(s) degraded, {} chat "
+						 "event(s) dropped, {} slow client(s) disconnected, {} message(s) rate limited",
+					outbound.queued_frames, outbound.queued_bytes, outbound.deepest_queue_bytes,
+					outbound.degraded_clients, outbound.dropped_events, outbound.slow_disconnects,
+					outbound.rate_limited_messages);
+			});
+
+			// Refresh the gauges scraped with the rest of the metrics
+			schedule_every(housekeeping, GAUGE_REFRESH_INTERVAL,
+				[&connections, &metrics, &shards, &shard_queue_depths]() {
+				const OutboundUsage outbound = connections->outbound_usage();
+				metrics.active_connections.set(static_cast<int64_t>(connections->active_connection_count()));
+				metrics.handshakes.set(static_cast<int64_t>(connections->handshake_count()));
+				metrics.queued_frames.set(static_cast<int64_t>(outbound.queued_frames));
+				metrics.queued_bytes.set(static_cast<int64_t>(outbound.queued_bytes));
+				metrics.deepest_queue_bytes.set(static_cast<int64_t>(outbound.deepest_queue_bytes));
+				for (size_t i = 0; i < shards.size(); ++i) {
+					shard_queue_depths[i]->set(static_cast<int64_t>(shards[i].commands.size()));
+				}
+			});
+			// Summarize the metrics in the log; unlike TMX_INFO, kept in release builds
+			if (config.metrics_log_seconds > 0) {
+				schedule_every(housekeeping, std::chrono::seconds{ config.metrics_log_seconds }, [&metrics]() {
+					for (const std::string& line : metrics.registry.summarize()) {
+						log_info("Metrics: {}", line);
+					}
+				});
+			}
+
 			// Server work thread is ready, wait for main thread to start accepting connections.
 			server_ready_signal.release();
 			server_accept_signal.acquire();
@@ -85,27 +216,44 @@ namespace tavernmx::server
 			while (connections->is_accepting_connections()) {
 				std::chrono::time_point<std::chrono::high_resolution_clock> loop_start =
 					std::chrono::high_resolution_clock::now();
+				auto step_start = std::chrono::steady_clock::now();
 
-				// Step 1. Gather all messages from clients and distribute room events
+				// Step 1. Gather messages from clients and route room commands to their shards. Clients that have
+				// sent something take turns, each up to its budget per round, so one flooding client can't hold up
+				// the rest; whatever is left over once the loop's budget is spent waits for the next loop.
 				std::vector<std::string> new_rooms{};
 				std::vector<std::string> destroyed_rooms{};
-				const std::vector<std::shared_ptr<ClientConnection>> clients = connections->get_active_connections();
+				clients_to_notify.clear();
+				newly_ready.clear();
+				ready_clients->drain_into(newly_ready);
+				for (const std::weak_ptr<ClientConnection>& client_ptr : newly_ready) {
+					if (std::shared_ptr<ClientConnection> client = client_ptr.lock()) {
+						client_turns.activate(std::move(client));
+					}
+				}
 
-				for (const std::shared_ptr<ClientConnection>& client : clients) {
-					while (const std::optional<Message> msg = client->messages_in.pop()) {
-						switch (msg->message_type) {
+				client_turns.run([&](const std::shared_ptr<ClientConnection>& client, size_t max_count) {
+					inbound.clear();
+					const size_t count = client->messages_in.drain_into(inbound, max_count);
+					if (count < max_count) {
+						// off the scheduler until it sends something else
+						client->end_turn();
+					}
+					for (Message& msg : inbound) {
+						switch (msg.message_type) {
 						case MessageType::ROOM_LIST:
 							// Client requested the room list, send it back
-							client->messages_out.push(
-								create_room_list(std::cbegin(rooms.room_names()), std::cend(rooms.room_names())));
+							client->queue_frame(make_frame(create_room_list(
+								std::cbegin(room_directory.room_names()), std::cend(room_directory.room_names()))));
+							clients_to_notify.push_back(client);
 							break;
 						case MessageType::ROOM_CREATE: {
 							// Client wants to create a new room.
-							auto room_name = message_value_or<std::string>(*msg, "room_name");
+							auto room_name = message_value_or<std::string>(msg, "room_name");
 							if (!room_name.empty()) {
-								if (const std::shared_ptr<ServerRoom> room = rooms.create_room(room_name)) {
+								if (const std::shared_ptr<Room> room = room_directory.create_room(room_name)) {
 									TMX_INFO("Room created (client request): #{}", room->room_name());
-									room->joined_clients.emplace_back(client);
+									route_command(shards, routed, room_name, client, std::move(msg));
 									new_rooms.push_back(std::move(room_name));
 								} else {
 									TMX_WARN(
@@ -113,94 +261,88 @@ namespace tavernmx::server
 								}
 							}
 						} break;
-						case MessageType::ROOM_JOIN: {
-							auto room_name = message_value_or<std::string>(*msg, "room_name");
-							if (const std::shared_ptr<ServerRoom> room = rooms[room_name]) {
-								room->join(client);
-							} else {
-								TMX_WARN("Room does not exist (client join request): #{}", room_name);
-							}
-						} break;
 						case MessageType::ROOM_DESTROY: {
-							auto room_name = message_value_or<std::string>(*msg, "room_name");
-							if (const std::shared_ptr<ServerRoom> room = rooms[room_name]) {
+							auto room_name = message_value_or<std::string>(msg, "room_name");
+							if (const std::shared_ptr<Room> room = room_directory[room_name]) {
 								room->request_destroy();
+								route_command(shards, routed, room_name, client, std::move(msg));
 								destroyed_rooms.push_back(std::move(room_name));
 							} else {
 								TMX_WARN("Room does not exist (client destroy request): #{}", room_name);
 							}
 						} break;
-						case MessageType::ROOM_HISTORY: {
-							auto room_name = message_value_or<std::string>(*msg, "room_name");
-							auto event_count = message_value_or<std::int32_t>(*msg, "event_count");
-
-							if (const std::shared_ptr<ServerRoom> room = rooms[room_name];
-								event_count >= 0 && event_count <= ROOM_HISTORY_MAX_ENTRIES && room) {
-								client->messages_out.push(
-									get_room_history(room_history, room->room_name(), event_count));
-							} else {
-								TMX_WARN("Invalid room history request: name '{}', count {}", room_name, event_count);
-							}
-						} break;
+						case MessageType::ROOM_JOIN:
+						case MessageType::ROOM_HISTORY:
 						case MessageType::CHAT_SEND: {
-							auto room_name = message_value_or<std::string>(*msg, "room_name");
-							if (const std::shared_ptr<ServerRoom> room = rooms[room_name]) {
-								RoomEvent room_event{ .origin_user_name = client->connected_user_name,
-									.event_text = message_value_or<std::string>(*msg, "text") };
-								insert_event_into_room_history(room_history, room->room_name(), room_event);
-								room->events.push(std::move(room_event));
-							} else {
-								TMX_WARN("Client sent message to unknown room: {}", room_name);
-							}
+							// The owning shard checks that the room exists
+							const auto room_name = message_value_or<std::string>(msg, "room_name");
+							route_command(shards, routed, room_name, client, std::move(msg));
 						} break;
 						default:
-							TMX_WARN("Client sent unhandled message type: {}", static_cast<int32_t>(msg->message_type));
+							TMX_WARN("Client sent unhandled message type: {}", static_cast<int32_t>(msg.message_type));
 							break;
 						}
 					}
-				}
+					return count;
+				});
+				room_directory.remove_destroyed_rooms();
+				record_lap(metrics.gather_time, step_start);
 
-				// Step 2. Gather events from rooms and distribute to clients
-				// Step 2a. For new & destroyed rooms, notify everyone of its creation/destruction
+				// Step 2. For new & destroyed rooms, notify everyone of its creation/destruction. This happens
+				// before the shards see the commands, so clients hear about a room before any of its events.
+				if (!new_rooms.empty() || !destroyed_rooms.empty()) {
+					// everyone is notified, which covers the clients sent a room list
+					clients_to_notify = connections->get_active_connections();
+				}
 				for (const std::string& room_name : new_rooms) {
-					Message msg = create_room_create(room_name);
-					for (const std::shared_ptr<ClientConnection>& client : clients) {
-						client->messages_out.push(msg);
+					const Frame frame = make_frame(RoomCreate{ .room_name = room_name });
+					for (const std::shared_ptr<ClientConnection>& client : clients_to_notify) {
+						client->queue_frame(frame);
 					}
 				}
 				for (const std::string& room_name : destroyed_rooms) {
-					Message msg = create_room_destroy(room_name);
-					for (const std::shared_ptr<ClientConnection>& client : clients) {
-						client->messages_out.push(msg);
+					const Frame frame = make_frame(RoomDestroy{ .room_name = room_name });
+					for (const std::shared_ptr<ClientConnection>& client : clients_to_notify) {
+						client->queue_frame(frame);
 					}
 				}
+				record_lap(metrics.announce_time, step_start);
 
-				// Step 2b. For existing rooms, only distribute events to joined clients
-				for (const std::shared_ptr<ServerRoom>& room : rooms.rooms()) {
-					room->clean_expired_clients();
-					std::vector<Message> messages = room_events_to_messages(room.get());
-					for (const std::weak_ptr<ClientConnection>& client_ptr : room->joined_clients) {
-						if (const std::shared_ptr<ClientConnection> client = client_ptr.lock()) {
-							for (const Message& message : messages) {
-								client->messages_out.push(message);
-							}
-						}
+				// Step 3. Hand routed commands to the room workers (pushing wakes them). A shard whose worker died
+				// would leave its rooms silent and its queue growing, so the server shuts down instead.
+				for (size_t i = 0; i < routed.size(); ++i) {
+					if (shards[i].has_failed()) {
+						throw std::runtime_error{ "Room worker " + std::to_string(i) + " has failed" };
 					}
+					shards[i].commands.push_range(
+						std::make_move_iterator(std::begin(routed[i])), std::make_move_iterator(std::end(routed[i])));
+					routed[i].clear();
 				}
+				record_lap(metrics.route_time, step_start);
 
-				// Step 3. Clean up
-				for (const std::string& room_name : destroyed_rooms) {
-					if (auto it = room_history.find(room_name); it != room_history.end()) {
-						room_history.erase(it);
+				// Step 4. Wake the reactor to flush anything queued for clients
+				for (const std::shared_ptr<ClientConnection>& client : clients_to_notify) {
+					if (client->has_queued_frames()) {
+						client->notify_outbound();
 					}
 				}
-				rooms.remove_destroyed_rooms();
+				record_lap(metrics.notify_time, step_start);
+
+				// Step 5. Run housekeeping that has come due
+				housekeeping.advance(std::chrono::steady_clock::now());
+				record_lap(metrics.housekeeping_time, step_start);
 
-				// Step 4. Sleep
+				// Step 6. Sleep until any client sends something, or at most until the next loop is due; don't
+				// sleep at all while clients have messages left over from this loop
 				const std::chrono::high_resolution_clock::duration loop_elapsed =
 					std::chrono::high_resolution_clock::now() - loop_start;
+				metrics.loop_time.record(loop_elapsed);
+				if (client_turns.has_backlog()) {
+					continue;
+				}
 				if (loop_elapsed < TARGET_SERVER_LOOP_MS) {
-					std::this_thread::sleep_for(TARGET_SERVER_LOOP_MS - loop_elapsed);
+					inbound_signal->wait(
+						duration_cast<std::chrono::milliseconds>(TARGET_SERVER_LOOP_MS - loop_elapsed));
 				} else {
 					TMX_WARN("Server worker loop took too long to process: {}ms",
 						duration_cast<std::chrono::milliseconds>(loop_elapsed).count());
@@ -0,0 +1,321 @@
+#include <limits>
+#include "tavernmx/codec.h"
+
+namespace
+{
+	using tavernmx::messaging::CharType;
+
+	void write_big_endian(std::vector<CharType>& output, uint64_t value, size_t size) {
+		for (size_t i = size; i > 0; --i) {
+			output.push_back(static_cast<CharType>(value >> ((i - 1) * 8)));
+		}
+	}
+
+	void write_header(std::vector<CharType>& output, size_t count, CharType fix_marker, size_t fix_max,
+		CharType marker8, CharType marker16, CharType marker32) {
+		if (count <= fix_max) {
+			output.push_back(static_cast<CharType>(fix_marker | count));
+		} else if (marker8 != 0 && count <= std::numeric_limits<uint8_t>::max()) {
+			output.push_back(marker8);
+			write_big_endian(output, count, 1);
+		} else if (count <= std::numeric_limits<uint16_t>::max()) {
+			output.push_back(marker16);
+			write_big_endian(output, count, 2);
+		} else {
+			output.push_back(marker32);
+			write_big_endian(output, count, 4);
+		}
+	}
+}
+
+namespace tavernmx::messaging
+{
+	namespace msgpack
+	{
+		void write_int(std::vector<CharType>& output, int64_t value) {
+			if (value >= 0) {
+				const auto unsigned_value = static_cast<uint64_t>(value);
+				if (unsigned_value < 0x80) {
+					output.push_back(static_cast<CharType>(unsigned_value));
+				} else if (unsigned_value <= std::numeric_limits<uint8_t>::max()) {
+					output.push_back(0xcc);
+					write_big_endian(output, unsigned_value, 1);
+				} else if (unsigned_value <= std::numeric_limits<uint16_t>::max()) {
+					output.push_back(0xcd);
+					write_big_endian(output, unsigned_value, 2);
+				} else if (unsigned_value <= std::numeric_limits<uint32_t>::max()) {
+					output.push_back(0xce);
+					write_big_endian(output, unsigned_value, 4);
+				} else {
+					output.push_back(0xcf);
+					write_big_endian(output, unsigned_value, 8);
+				}
+			} else if (value >= -32) {
+				output.push_back(static_cast<CharType>(value));
+			} else if (value >= std::numeric_limits<int8_t>::min()) {
+				output.push_back(0xd0);
+				write_big_endian(output, static_cast<uint64_t>(value), 1);
+			} else if (value >= std::numeric_limits<int16_t>::min()) {
+				output.push_back(0xd1);
+				write_big_endian(output, static_cast<uint64_t>(value), 2);
+			} else if (value >= std::numeric_limits<int32_t>::min()) {
+				output.push_back(0xd2);
+				write_big_endian(output, static_cast<uint64_t>(value), 4);
+			} else {
+				output.push_back(0xd3);
+				write_big_endian(output, static_cast<uint64_t>(value), 8);
+			}
+		}
+
+		void write_string(std::vector<CharType>& output, std::string_view value) {
+			write_header(output, value.size(), 0xa0, 31, 0xd9, 0xda, 0xdb);
+			output.insert(std::end(output), std::cbegin(value), std::cend(value));
+		}
+
+		void write_array_header(std::vector<CharType>& output, size_t count) {
+			write_header(output, count, 0x90, 15, 0, 0xdc, 0xdd);
+		}
+
+		void write_map_header(std::vector<CharType>& output, size_t count) {
+			write_header(output, count, 0x80, 15, 0, 0xde, 0xdf);
+		}
+
+		bool Reader::read_int(int64_t& value) {
+			if (this->at_end()) {
+				return false;
+			}
+			const CharType marker = this->data[this->pos++];
+			uint64_t raw = 0;
+			if (marker < 0x80) {
+				value = marker;
+			} else if (marker >= 0xe0) {
+				value = static_cast<int8_t>(marker);
+			} else if (marker >= 0xcc && marker <= 0xcf) {
+				if (!this->read_uint(size_t{ 1 } << (marker - 0xcc), raw) ||
+					raw > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+					return false;
+				}
+				value = static_cast<int64_t>(raw);
+			} else if (marker >= 0xd0 && marker <= 0xd3) {
+				const size_t size = size_t{ 1 } << (marker - 0xd0);
+				if (!this->read_uint(size, raw)) {
+					return false;
+				}
+				// sign-extend from the encoded width
+				const uint32_t shift = static_cast<uint32_t>(64 - size * 8);
+				value = static_cast<int64_t>(raw << shift) >> shift;
+			} else {
+				return false;
+			}
+			return true;
+		}
+
+		bool Reader::read_string(std::string_view& value) {
+			if (this->at_end()) {
+				return false;
+			}
+			const CharType marker = this->data[this->pos++];
+			uint64_t size = 0;
+			if (marker >= 0xa0 && marker <= 0xbf) {
+				size = marker & 0x1f;
+			} else if (marker >= 0xd9 && marker <= 0xdb) {
+				if (!this->read_uint(size_t{ 1 } << (marker - 0xd9), size)) {
+					return false;
+				}
+			} else {
+				return false;
+			}
+			std::span<const CharType> bytes{};
+			if (!this->read_bytes(size, bytes)) {
+				return false;
+			}
+			value = std::string_view{ reinterpret_cast<const char*>(bytes.data()), bytes.size() };
+			return true;
+		}
+
+		bool Reader::read_array_header(size_t& count) {
+			if (this->at_end()) {
+				return false;
+			}
+			const CharType marker = this->data[this->pos++];
+			uint64_t raw = 0;
+			if (marker >= 0x90 && marker <= 0x9f) {
+				raw = marker & 0x0f;
+			} else if (marker == 0xdc || marker == 0xdd) {
+				if (!this->read_uint(marker == 0xdc ? 2 : 4, raw)) {
+					return false;
+				}
+			} else {
+				return false;
+			}
+			count = static_cast<size_t>(raw);
+			// every element takes at least one byte
+			return count <= this->data.size() - this->pos;
+		}
+
+		bool Reader::read_map_header(size_t& count) {
+			if (this->at_end()) {
+				return false;
+			}
+			const CharType marker = this->data[this->pos++];
+			uint64_t raw = 0;
+			if (marker >= 0x80 && marker <= 0x8f) {
+				raw = marker & 0x0f;
+			} else if (marker == 0xde || marker == 0xdf) {
+				if (!this->read_uint(marker == 0xde ? 2 : 4, raw)) {
+					return false;
+				}
+			} else {
+				return false;
+			}
+			count = static_cast<size_t>(raw);
+			// every key and value takes at least one byte
+			return count <= (this->data.size() - this->pos) / 2;
+		}
+
+		bool Reader::skip() {
+			return this->skip_values(1);
+		}
+
+		bool Reader::read_raw(std::span<const CharType>& value) {
+			const size_t start = this->pos;
+			if (!this->skip()) {
+				return false;
+			}
+			value = this->data.subspan(start, this->pos - start);
+			return true;
+		}
+
+		bool Reader::read_bytes(size_t count, std::span<const CharType>& bytes) {
+			if (count > this->data.size() - this->pos) {
+				return false;
+			}
+			bytes = this->data.subspan(this->pos, count);
+			this->pos += count;
+			return true;
+		}
+
+		bool Reader::read_uint(size_t size, uint64_t& value) {
+			std::span<const CharType> bytes{};
+			if (!this->read_bytes(size, bytes)) {
+				return false;
+			}
+			value = 0;
+			for (const CharType byte : bytes) {
+				value = (value << 8) | byte;
+			}
+			return true;
+		}
+
+		bool Reader::skip_values(size_t count) {
+			// iterative, so deeply nested input can't exhaust the stack
+			uint64_t remaining = count;
+			while (remaining > 0) {
+				--remaining;
+				if (this->at_end()) {
+					return false;
+				}
+				const CharType marker = this->data[this->pos++];
+				uint64_t length = 0;
+				uint64_t children = 0;
+				if (marker < 0x80 || marker >= 0xe0 || marker == 0xc0 || marker == 0xc2 || marker == 0xc3) {
+					// fixint, nil, bool
+				} else if (marker <= 0x8f) {
+					children = 2 * static_cast<uint64_t>(marker & 0x0f);
+				} else if (marker <= 0x9f) {
+					children = marker & 0x0f;
+				} else if (marker <= 0xbf) {
+					length = marker & 0x1f;
+				} else if (marker >= 0xc4 && marker <= 0xc6) {
+					if (!this->read_uint(size_t{ 1 } << (marker - 0xc4), length)) {
+						return false;
+					}
+				} else if (marker >= 0xc7 && marker <= 0xc9) {
+					if (!this->read_uint(size_t{ 1 } << (marker - 0xc7), length)) {
+						return false;
+					}
+					++length; // ext type byte
+				} else if (marker == 0xca) {
+					length = 4;
+				} else if (marker == 0xcb) {
+					length = 8;
+				} else if (marker >= 0xcc && marker <= 0xcf) {
+					length = uint64_t{ 1 } << (marker - 0xcc);
+				} else if (marker >= 0xd0 && marker <= 0xd3) {
+					length = uint64_t{ 1 } << (marker - 0xd0);
+				} else if (marker >= 0xd4 && marker <= 0xd8) {
+					length = (uint64_t{ 1 } << (marker - 0xd4)) + 1;
+				} else if (marker >= 0xd9 && marker <= 0xdb) {
+					if (!this->read_uint(size_t{ 1 } << (marker - 0xd9), length)) {
+						return false;
+					}
+				} else if (marker == 0xdc || marker == 0xdd) {
+					if (!this->read_uint(marker == 0xdc ? 2 : 4, children)) {
+						return false;
+					}
+				} else if (marker == 0xde || marker == 0xdf) {
+					if (!this->read_uint(marker == 0xde ? 2 : 4, children)) {
+						return false;
+					}
+					children *= 2;
+				} else {
+					return false;
+				}
+				if (length > this->data.size() - this->pos) {
+					return false;
+				}
+				this->pos += static_cast<size_t>(length);
+				remaining += children;
+				if (remaining > this->data.size() - this->pos) {
+					return false;
+				}
+			}
+			return true;
+		}
+	}
+
+	std::vector<MessageView> view_messages(const MessageBlock& block) {
+		std::vector<MessageView> views{};
+		msgpack::Reader reader{ block.payload };
+		size_t count = 0;
+		if (block.payload.empty() || !reader.read_array_header(count)) {
+			return views;
+		}
+		views.reserve(count);
+		for (size_t i = 0; i < count; ++i) {
+			size_t fields = 0;
+			if (!reader.read_map_header(fields)) {
+				break;
+			}
+			MessageView view{};
+			bool ok = true;
+			for (size_t f = 0; ok && f < fields; ++f) {
+				std::string_view key{};
+				if (!reader.read_string(key)) {
+					ok = false;
+				} else if (key == "message_type") {
+					int64_t message_type = 0;
+					ok = reader.read_int(message_type);
+					view.message_type = static_cast<MessageType>(message_type);
+				} else if (key == "values") {
+					ok = reader.read_raw(view.values);
+				} else {
+					ok = reader.skip();
+				}
+			}
+			if (!ok) {
+				break;
+			}
+			views.push_back(view);
+		}
+		return views;
+	}
+
+	Message to_message(const MessageView& view) {
+		Message message{ .message_type = view.message_type };
+		if (!view.values.empty()) {
+			message.values = json::from_msgpack(std::cbegin(view.values), std::cend(view.values));
+		}
+		return message;
+	}
+}
@@ -1,4 +1,5 @@
 #include <chrono>
+#include <thread>
 #include "tavernmx/connection.h"
 
 using namespace tavernmx::messaging;
@@ -6,14 +7,48 @@ using namespace tavernmx::messaging;
 namespace tavernmx
 {
 	void BaseConnection::send_message_block(const MessageBlock& block) {
+		this->outbound.append(block);
+		this->flush_outbound();
+	}
+
+	void BaseConnection::send_frame(const Frame& frame) {
+		std::span<const CharType> remaining{ *frame };
+		if (this->outbound.empty() && !remaining.empty()) {
+			if (!this->is_connected()) {
+				throw TransportError{ "Connection lost" };
+			}
+			try {
+				size_t written = 0;
+				while (!remaining.empty() && (written = ssl::send_bytes(this->bio.get(), remaining)) > 0) {
+					remaining = remaining.subspan(written);
+				}
+			} catch (ssl::SslError& ex) {
+				throw TransportError{ "send_frame failed", ex };
+			}
+		}
+		if (!remaining.empty()) {
+			this->outbound.append(remaining);
+			this->flush_outbound();
+		}
+	}
+
+	bool BaseConnection::flush_outbound() {
+		if (this->outbound.empty()) {
+			return true;
+		}
 		if (!this->is_connected()) {
 			throw TransportError{ "Connection lost" };
 		}
 		try {
-			ssl::send_message(this->bio.get(), block);
+			size_t written = 0;
+			while (!this->outbound.empty() &&
+				   (written = ssl::send_bytes(this->bio.get(), this->outbound.pending())) > 0) {
+				this->outbound.consume(written);
+			}
 		} catch (ssl::SslError& ex) {
-			throw TransportError{ "send_message_block failed", ex };
+			throw TransportError{ "flush_outbound failed", ex };
 		}
+		return this->outbound.empty();
 	}
 
 	void BaseConnection::send_message(const Message& message) {
@@ -22,11 +57,28 @@ namespace tavernmx
 	}
 
 	std::optional<MessageBlock> BaseConnection::receive_message() {
+		if (std::optional<MessageBlock> block = this->decoder.next()) {
+			return block;
+		}
+		this->receive_bytes();
+		return this->decoder.next();
+	}
+
+	std::vector<MessageBlock> BaseConnection::receive_messages() {
+		this->receive_bytes();
+		std::vector<MessageBlock> blocks{};
+		while (std::optional<MessageBlock> block = this->decoder.next()) {
+			blocks.push_back(std::move(block.value()));
+		}
+		return blocks;
+	}
+
+	void BaseConnection::receive_bytes() {
 		if (!this->is_connected()) {
 			throw TransportError{ "Connection lost" };
 		}
 		try {
-			return ssl::receive_message(this->bio.get());
+			ssl::receive_bytes(this->bio.get(), this->decoder);
 		} catch (ssl::SslError& ex) {
 			throw TransportError{ "receive_message failed", ex };
 		}
@@ -41,6 +93,8 @@ namespace tavernmx
 			BIO_ssl_shutdown(this->bio.get());
 			this->bio.reset();
 		}
+		this->decoder.reset();
+		this->outbound.reset();
 	}
 
 	std::optional<Message> BaseConnection::wait_for(MessageType message_type, ssl::Milliseconds milliseconds) {
@@ -49,12 +103,15 @@ namespace tavernmx
 		ssl::Milliseconds elapsed = 0;
 
 		do {
+			this->flush_outbound();
 			if (std::optional<MessageBlock> message_block = this->receive_message()) {
 				for (Message& message : unpack_messages(message_block.value())) {
 					if (message.message_type == message_type) {
 						return std::move(message);
 					}
 				}
+			} else {
+				std::this_thread::sleep_for(std::chrono::milliseconds{ ssl::SSL_RETRY_MILLISECONDS });
 			}
 
 			elapsed =
@@ -71,12 +128,15 @@ namespace tavernmx
 		ssl::Milliseconds elapsed = 0;
 
 		do {
+			this->flush_outbound();
 			if (const std::optional<MessageBlock> message_block = this->receive_message()) {
 				for (Message& message : unpack_messages(message_block.value())) {
 					if (message.message_type == MessageType::ACK || message.message_type == MessageType::NAK) {
 						return std::move(message);
 					}
 				}
+			} else {
+				std::this_thread::sleep_for(std::chrono::milliseconds{ ssl::SSL_RETRY_MILLISECONDS });
 			}
 			elapsed =
 				std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start)
@@ -0,0 +1,575 @@
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include "tavernmx/history-log.h"
+#include "tavernmx/logging.h"
+#include "tavernmx/platform.h"
+
+#if defined(TMX_WINDOWS)
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace std::string_literals;
+
+namespace
+{
+	/// Maximum ms the writer sleeps when no events are queued.
+	constexpr std::chrono::milliseconds HISTORY_WRITER_WAIT_MS{ 100ll };
+
+	/// Each record is a header (payload size and checksum) followed by its payload.
+	constexpr size_t RECORD_HEADER_SIZE = 2 * sizeof(uint32_t);
+	/// Each payload starts with the timestamp and the size of the user name, followed by the user name and text.
+	constexpr size_t PAYLOAD_HEADER_SIZE = sizeof(int64_t) + sizeof(uint32_t);
+
+	/// FNV-1a hash of \p size bytes at \p data, used to detect torn or corrupt records.
+	uint32_t checksum(const char* data, size_t size) {
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < size; ++i) {
+			hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+		}
+		return hash;
+	}
+
+	template <typename T>
+	void append_value(std::vector<char>& output, T value) {
+		const size_t offset = output.size();
+		output.resize(offset + sizeof(T));
+		std::memcpy(output.data() + offset, &value, sizeof(T));
+	}
+
+	template <typename T>
+	T read_value(const char* data) {
+		T value{};
+		std::memcpy(&value, data, sizeof(T));
+		return value;
+	}
+
+	/// Number of bytes taken by the record holding \p event.
+	size_t record_size(const tavernmx::rooms::RoomEvent& event) {
+		return RECORD_HEADER_SIZE + PAYLOAD_HEADER_SIZE + event.origin_user_name.size() + event.event_text.size();
+	}
+
+	/// Appends the record holding \p event to \p output.
+	void encode_event(const tavernmx::rooms::RoomEvent& event, std::vector<char>& output) {
+		const size_t offset = output.size();
+		append_value(output, static_cast<uint32_t>(record_size(event) - RECORD_HEADER_SIZE));
+		append_value(output, uint32_t{ 0 });
+		append_value(output, static_cast<int64_t>(event.timestamp.time_since_epoch().count()));
+		append_value(output, static_cast<uint32_t>(event.origin_user_name.size()));
+		output.insert(std::cend(output), std::cbegin(event.origin_user_name), std::cend(event.origin_user_name));
+		output.insert(std::cend(output), std::cbegin(event.event_text), std::cend(event.event_text));
+		const uint32_t hash = checksum(output.data() + offset + RECORD_HEADER_SIZE, output.size() - offset - RECORD_HEADER_SIZE);
+		std::memcpy(output.data() + offset + sizeof(uint32_t), &hash, sizeof(hash));
+	}
+
+	/**
+	 * @brief Decodes the record at \p data into \p event.
+	 * @return Size of the record, or 0 if the \p available bytes don't hold a complete, intact record.
+	 */
+	size_t decode_event(const char* data, size_t available, tavernmx::rooms::RoomEvent& event) {
+		if (available < RECORD_HEADER_SIZE + PAYLOAD_HEADER_SIZE) {
+			return 0;
+		}
+		const auto payload_size = read_value<uint32_t>(data);
+		if (payload_size < PAYLOAD_HEADER_SIZE || payload_size > available - RECORD_HEADER_SIZE) {
+			return 0;
+		}
+		const char* payload = data + RECORD_HEADER_SIZE;
+		if (read_value<uint32_t>(data + sizeof(uint32_t)) != checksum(payload, payload_size)) {
+			return 0;
+		}
+		const auto user_size = read_value<uint32_t>(payload + sizeof(int64_t));
+		if (user_size > payload_size - PAYLOAD_HEADER_SIZE) {
+			return 0;
+		}
+		event.timestamp = tavernmx::rooms::EventTimeStamp{ std::chrono::seconds{ read_value<int64_t>(payload) } };
+		event.origin_user_name.assign(payload + PAYLOAD_HEADER_SIZE, user_size);
+		event.event_text.assign(payload + PAYLOAD_HEADER_SIZE + user_size, payload_size - PAYLOAD_HEADER_SIZE - user_size);
+		return RECORD_HEADER_SIZE + payload_size;
+	}
+
+	tavernmx::rooms::HistoryLogError file_error(const char* action, const std::filesystem::path& path) {
+		return tavernmx::rooms::HistoryLogError{ "Unable to "s + action + " " + path.string() + ": " + std::strerror(errno) };
+	}
+
+	/// Opens \p path for appending, creating it if needed.
+	int32_t open_append(const std::filesystem::path& path) {
+#if defined(TMX_WINDOWS)
+		const int32_t fd = ::_wopen(path.c_str(), _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+		const int32_t fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+#endif
+		if (fd < 0) {
+			throw file_error("open", path);
+		}
+		return fd;
+	}
+
+	void write_all(int32_t fd, const void* data, size_t size, const std::filesystem::path& path) {
+		const char* bytes = static_cast<const char*>(data);
+		while (size > 0) {
+#if defined(TMX_WINDOWS)
+			const auto written = ::_write(fd, bytes, static_cast<unsigned int>(std::min<size_t>(size, INT32_MAX)));
+#else
+			const auto written = ::write(fd, bytes, size);
+#endif
+			if (written < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				throw file_error("write", path);
+			}
+			bytes += written;
+			size -= static_cast<size_t>(written);
+		}
+	}
+
+	/// Waits for everything written to \p fd to reach the disk.
+	void sync_file(int32_t fd, const std::filesystem::path& path) {
+#if defined(TMX_WINDOWS)
+		const int32_t result = ::_commit(fd);
+#elif defined(TMX_LINUX)
+		const int32_t result = ::fdatasync(fd);
+#else
+		const int32_t result = ::fsync(fd);
+#endif
+		if (result != 0) {
+			throw file_error("sync", path);
+		}
+	}
+
+	/// Makes newly created files in \p path durable. Not needed on Windows.
+	void sync_directory(const std::filesystem::path& path) {
+#if !defined(TMX_WINDOWS)
+		const int32_t fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			throw file_error("open", path);
+		}
+		const int32_t result = ::fsync(fd);
+		::close(fd);
+		if (result != 0) {
+			throw file_error("sync", path);
+		}
+#endif
+	}
+
+	void close_file(int32_t fd) {
+#if defined(TMX_WINDOWS)
+		::_close(fd);
+#else
+		::close(fd);
+#endif
+	}
+
+	/// Read-only view of the first \p size bytes of a file, mapped into memory where supported.
+	class MappedFile
+	{
+	public:
+		MappedFile(const std::filesystem::path& path, size_t size) : mapped_size{ size } {
+#if defined(TMX_WINDOWS)
+			std::ifstream file{ path, std::ios::binary };
+			this->buffer.resize(size);
+			if (!file.read(this->buffer.data(), static_cast<std::streamsize>(size))) {
+				throw file_error("read", path);
+			}
+			this->mapped = this->buffer.data();
+#else
+			const int32_t fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd < 0) {
+				throw file_error("open", path);
+			}
+			void* address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd);
+			if (address == MAP_FAILED) {
+				throw file_error("map", path);
+			}
+			this->mapped = static_cast<const char*>(address);
+#endif
+		}
+
+		~MappedFile() {
+#if !defined(TMX_WINDOWS)
+			::munmap(const_cast<char*>(this->mapped), this->mapped_size);
+#endif
+		}
+
+		MappedFile(const MappedFile&) = delete;
+
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const char* data() const { return this->mapped; }
+
+	private:
+		const char* mapped{ nullptr };
+		size_t mapped_size{};
+#if defined(TMX_WINDOWS)
+		std::vector<char> buffer{};
+#endif
+	};
+}
+
+namespace tavernmx::rooms
+{
+	RoomHistoryLog::RoomHistoryLog(std::filesystem::path directory, size_t segment_size)
+		: directory{ std::move(directory) }, segment_size{ segment_size } {
+		static_assert(sizeof(IndexEntry) == 24, "index entries are stored as they are laid out in memory");
+		try {
+			std::filesystem::create_directories(this->directory);
+			for (const auto& entry : std::filesystem::directory_iterator{ this->directory }) {
+				const std::string stem = entry.path().stem().string();
+				uint64_t base_sequence{};
+				const auto [end, error] = std::from_chars(stem.data(), stem.data() + stem.size(), base_sequence);
+				if (entry.is_regular_file() && entry.path().extension() == ".log" && error == std::errc{} &&
+					end == stem.data() + stem.size()) {
+					this->segments.push_back(Segment{ .base_sequence = base_sequence, .size = entry.file_size() });
+				}
+			}
+		} catch (std::filesystem::filesystem_error& ex) {
+			throw HistoryLogError{ "Unable to open history log " + this->directory.string(), ex };
+		}
+		std::ranges::sort(this->segments, {}, &Segment::base_sequence);
+
+		for (Segment& segment : this->segments) {
+			std::ifstream index_file{ this->segment_path(segment.base_sequence, ".idx"), std::ios::binary };
+			IndexEntry entry{};
+			while (index_file.read(reinterpret_cast<char*>(&entry), sizeof(entry))) {
+				segment.index.push_back(entry);
+			}
+		}
+		if (this->segments.empty()) {
+			this->start_segment(0);
+		} else {
+			this->recover_last_segment();
+		}
+	}
+
+	RoomHistoryLog::~RoomHistoryLog() {
+		this->close_files();
+	}
+
+	uint64_t RoomHistoryLog::event_count() const {
+		std::lock_guard lock{ this->log_mutex };
+		return this->next_sequence;
+	}
+
+	size_t RoomHistoryLog::segment_count() const {
+		std::lock_guard lock{ this->log_mutex };
+		return this->segments.size();
+	}
+
+	size_t RoomHistoryLog::read_last(size_t count, const std::function<void(RoomEvent)>& visitor) const {
+		std::lock_guard lock{ this->log_mutex };
+		if (this->removed) {
+			return 0;
+		}
+		const uint64_t first = this->synced_sequence -
+			std::min<uint64_t>(count, this->synced_sequence - this->segments.front().base_sequence);
+		if (first == this->synced_sequence) {
+			return 0;
+		}
+		// the last segment starting at or before first
+		const auto segment = std::ranges::upper_bound(this->segments, first, {}, &Segment::base_sequence);
+		return this->read_from(std::distance(std::cbegin(this->segments), segment) - 1, first,
+			EventTimeStamp::min(), visitor);
+	}
+
+	size_t RoomHistoryLog::read_since(EventTimeStamp since, const std::function<void(RoomEvent)>& visitor) const {
+		std::lock_guard lock{ this->log_mutex };
+		if (this->removed) {
+			return 0;
+		}
+		// every index starts with the segment's first event, so the wanted events begin in the last
+		// segment whose first event is older than since (or the first segment)
+		const int64_t since_count = since.time_since_epoch().count();
+		const auto older = std::ranges::partition_point(this->segments, [since_count](const Segment& segment) {
+			return !segment.index.empty() && segment.index.front().timestamp < since_count;
+		});
+		const size_t segment = std::max<ptrdiff_t>(std::distance(std::cbegin(this->segments), older), 1) - 1;
+		const std::vector<IndexEntry>& index = this->segments[segment].index;
+		const auto entry = std::ranges::partition_point(
+			index, [since_count](const IndexEntry& index_entry) { return index_entry.timestamp < since_count; });
+		const uint64_t sequence =
+			entry == std::cbegin(index) ? this->segments[segment].base_sequence : std::prev(entry)->sequence;
+		return this->read_from(segment, sequence, since, visitor);
+	}
+
+	void RoomHistoryLog::append(const RoomEvent& event) {
+		std::lock_guard lock{ this->log_mutex };
+		if (this->removed) {
+			return;
+		}
+		const size_t size = record_size(event);
+		const uint64_t end = this->segments.back().size + this->pending_events.size();
+		if (end > 0 && end + size > this->segment_size) {
+			this->write_pending();
+			sync_file(this->index_fd, this->segment_path(this->segments.back().base_sequence, ".idx"));
+			this->start_segment(this->next_sequence);
+		}
+		if (this->bytes_since_index >= HISTORY_INDEX_INTERVAL) {
+			this->pending_index.push_back(IndexEntry{ .sequence = this->next_sequence,
+				.timestamp = event.timestamp.time_since_epoch().count(),
+				.offset = this->segments.back().size + this->pending_events.size() });
+			this->bytes_since_index = 0;
+		}
+		encode_event(event, this->pending_events);
+		this->bytes_since_index += size;
+		++this->next_sequence;
+	}
+
+	void RoomHistoryLog::sync() {
+		std::lock_guard lock{ this->log_mutex };
+		if (!this->removed) {
+			this->write_pending();
+		}
+	}
+
+	void RoomHistoryLog::remove() noexcept {
+		std::lock_guard lock{ this->log_mutex };
+		this->removed = true;
+		this->close_files();
+		this->pending_events.clear();
+		this->pending_index.clear();
+		std::error_code error{};
+		std::filesystem::remove_all(this->directory, error);
+		if (error) {
+			TMX_WARN("Unable to remove history log {}: {}", this->directory.string(), error.message());
+		}
+	}
+
+	void RoomHistoryLog::recover_last_segment() {
+		Segment& last = this->segments.back();
+		// index entries past the end of the log were written ahead of events that never made it
+		std::erase_if(last.index, [&last](const IndexEntry& entry) { return entry.offset >= last.size; });
+		// scan forward from the last indexed event, rebuilding index entries as appending would have
+		uint64_t offset = 0;
+		uint64_t sequence = last.base_sequence;
+		if (!last.index.empty()) {
+			offset = last.index.back().offset;
+			sequence = last.index.back().sequence;
+			last.index.pop_back();
+		}
+		this->bytes_since_index = HISTORY_INDEX_INTERVAL;
+		const std::filesystem::path log_path = this->segment_path(last.base_sequence, ".log");
+		if (offset < last.size) {
+			const MappedFile mapped{ log_path, last.size };
+			RoomEvent event{};
+			while (offset < last.size) {
+				const size_t size = decode_event(mapped.data() + offset, last.size - offset, event);
+				if (size == 0) {
+					break;
+				}
+				if (this->bytes_since_index >= HISTORY_INDEX_INTERVAL) {
+					last.index.push_back(IndexEntry{ .sequence = sequence,
+						.timestamp = event.timestamp.time_since_epoch().count(),
+						.offset = offset });
+					this->bytes_since_index = 0;
+				}
+				this->bytes_since_index += size;
+				offset += size;
+				++sequence;
+			}
+		}
+		if (offset < last.size) {
+			TMX_WARN("Truncating {} byte(s) of partially written history from {}", last.size - offset, log_path.string());
+			try {
+				std::filesystem::resize_file(log_path, offset);
+			} catch (std::filesystem::filesystem_error& ex) {
+				throw HistoryLogError{ "Unable to truncate " + log_path.string(), ex };
+			}
+			last.size = offset;
+		}
+		const std::filesystem::path index_path = this->segment_path(last.base_sequence, ".idx");
+		std::ofstream index_file{ index_path, std::ios::binary | std::ios::trunc };
+		index_file.write(reinterpret_cast<const char*>(last.index.data()),
+			static_cast<std::streamsize>(last.index.size() * sizeof(IndexEntry)));
+		if (!index_file.flush()) {
+			throw file_error("write", index_path);
+		}
+		this->next_sequence = sequence;
+		this->synced_sequence = sequence;
+		this->open_files();
+	}
+
+	void RoomHistoryLog::start_segment(uint64_t base_sequence) {
+		this->close_files();
+		this->segments.push_back(Segment{ .base_sequence = base_sequence });
+		this->bytes_since_index = HISTORY_INDEX_INTERVAL;
+		this->open_files();
+		sync_directory(this->directory);
+	}
+
+	void RoomHistoryLog::open_files() {
+		const uint64_t base_sequence = this->segments.back().base_sequence;
+		this->log_fd = open_append(this->segment_path(base_sequence, ".log"));
+		this->index_fd = open_append(this->segment_path(base_sequence, ".idx"));
+	}
+
+	void RoomHistoryLog::write_pending() {
+		if (this->pending_events.empty()) {
+			return;
+		}
+		Segment& last = this->segments.back();
+		write_all(this->log_fd, this->pending_events.data(), this->pending_events.size(),
+			this->segment_path(last.base_sequence, ".log"));
+		if (!this->pending_index.empty()) {
+			// the index isn't synced here: recovery rebuilds the newest entries from the log
+			write_all(this->index_fd, this->pending_index.data(), this->pending_index.size() * sizeof(IndexEntry),
+				this->segment_path(last.base_sequence, ".idx"));
+		}
+		sync_file(this->log_fd, this->segment_path(last.base_sequence, ".log"));
+		last.size += this->pending_events.size();
+		last.index.insert(std::cend(last.index), std::cbegin(this->pending_index), std::cend(this->pending_index));
+		this->pending_events.clear();
+		this->pending_index.clear();
+		this->synced_sequence = this->next_sequence;
+	}
+
+	void RoomHistoryLog::close_files() noexcept {
+		if (this->log_fd >= 0) {
+			close_file(this->log_fd);
+			this->log_fd = -1;
+		}
+		if (this->index_fd >= 0) {
+			close_file(this->index_fd);
+			this->index_fd = -1;
+		}
+	}
+
+	std::filesystem::path RoomHistoryLog::segment_path(uint64_t base_sequence, const char* extension) const {
+		// zero padded so segments sort by name
+		std::string name = std::to_string(base_sequence);
+		name.insert(0, 20 - std::min<size_t>(name.size(), 20), '0');
+		return this->directory / (name + extension);
+	}
+
+	size_t RoomHistoryLog::read_from(size_t segment, uint64_t sequence, EventTimeStamp since,
+		const std::function<void(RoomEvent)>& visitor) const {
+		size_t count = 0;
+		for (; segment < this->segments.size(); ++segment) {
+			const Segment& current = this->segments[segment];
+			if (current.size == 0) {
+				continue;
+			}
+			// start from the last indexed event at or before sequence
+			uint64_t offset = 0;
+			uint64_t position = current.base_sequence;
+			const auto entry = std::ranges::partition_point(
+				current.index, [sequence](const IndexEntry& index_entry) { return index_entry.sequence <= sequence; });
+			if (entry != std::cbegin(current.index)) {
+				offset = std::prev(entry)->offset;
+				position = std::prev(entry)->sequence;
+			}
+			const std::filesystem::path log_path = this->segment_path(current.base_sequence, ".log");
+			const MappedFile mapped{ log_path, current.size };
+			while (offset < current.size) {
+				RoomEvent event{};
+				const size_t size = decode_event(mapped.data() + offset, current.size - offset, event);
+				if (size == 0) {
+					throw HistoryLogError{ "Corrupt history log segment " + log_path.string() };
+				}
+				offset += size;
+				if (position++ >= sequence && event.timestamp >= since) {
+					visitor(std::move(event));
+					++count;
+				}
+			}
+		}
+		return count;
+	}
+
+	HistoryLogWriter::HistoryLogWriter(std::filesystem::path root, size_t segment_size)
+		: root{ std::move(root) }, segment_size{ segment_size } {
+		try {
+			std::filesystem::create_directories(this->root);
+		} catch (std::filesystem::filesystem_error& ex) {
+			throw HistoryLogError{ "Unable to create history directory " + this->root.string(), ex };
+		}
+		this->thread = std::thread{ &HistoryLogWriter::run, this };
+	}
+
+	HistoryLogWriter::~HistoryLogWriter() {
+		this->running = false;
+		this->entries.signal()->notify();
+		this->thread.join();
+	}
+
+	std::vector<std::string> HistoryLogWriter::room_names() const {
+		std::vector<std::string> names{};
+		std::error_code error{};
+		for (const auto& entry : std::filesystem::directory_iterator{ this->root, error }) {
+			std::string name = entry.path().filename().string();
+			if (entry.is_directory() && is_valid_room_name(name)) {
+				names.push_back(std::move(name));
+			}
+		}
+		std::ranges::sort(names);
+		return names;
+	}
+
+	std::shared_ptr<RoomHistoryLog> HistoryLogWriter::open(std::string_view room_name) const {
+		return std::make_shared<RoomHistoryLog>(this->root / std::string{ room_name }, this->segment_size);
+	}
+
+	void HistoryLogWriter::append(std::shared_ptr<RoomHistoryLog> log, RoomEvent event) {
+		++this->appended;
+		this->entries.push(Entry{ .log = std::move(log), .event = std::move(event) });
+	}
+
+	void HistoryLogWriter::flush() {
+		const uint64_t target = this->appended.load();
+		std::unique_lock lock{ this->synced_mutex };
+		this->synced_cv.wait(lock, [this, target] { return this->synced.load() >= target; });
+	}
+
+	void HistoryLogWriter::run() {
+		std::vector<Entry> batch{};
+		std::vector<std::shared_ptr<RoomHistoryLog>> touched_logs{};
+		for (;;) {
+			batch.clear();
+			this->entries.drain_into(batch);
+			if (batch.empty()) {
+				if (!this->running) {
+					break;
+				}
+				this->entries.signal()->wait(HISTORY_WRITER_WAIT_MS);
+				continue;
+			}
+
+			// everything queued so far shares one sync per log
+			touched_logs.clear();
+			for (const Entry& entry : batch) {
+				try {
+					entry.log->append(entry.event);
+				} catch (HistoryLogError& ex) {
+					TMX_ERR("Unable to append room history: {}", ex.what());
+				}
+				if (std::ranges::find(touched_logs, entry.log) == std::cend(touched_logs)) {
+					touched_logs.push_back(entry.log);
+				}
+			}
+			for (const std::shared_ptr<RoomHistoryLog>& log : touched_logs) {
+				try {
+					log->sync();
+				} catch (HistoryLogError& ex) {
+					TMX_ERR("Unable to sync room history: {}", ex.what());
+				}
+			}
+
+			++this->batches;
+			{
+				std::lock_guard lock{ this->synced_mutex };
+				this->synced += batch.size();
+			}
+			this->synced_cv.notify_all();
+		}
+	}
+}
@@ -3,6 +3,7 @@
 #include <cassert>
 #include <functional>
 #include <utility>
+#include "tavernmx/codec.h"
 #include "tavernmx/messaging.h"
 #include "tavernmx/platform.h"
 
@@ -63,6 +64,112 @@ namespace tavernmx::messaging
         return 0;
     }
 
+    std::span<CharType> MessageBlockDecoder::prepare(size_t min_size) {
+        // compact consumed bytes before growing
+        if (this->read_pos > 0 && (this->read_pos == this->buffer_end ||
+                                      this->buffer.size() - this->buffer_end < min_size)) {
+            std::copy(std::begin(this->buffer) + this->read_pos, std::begin(this->buffer) + this->buffer_end,
+                std::begin(this->buffer));
+            this->buffer_end -= this->read_pos;
+            this->read_pos = 0;
+        }
+        if (this->buffer.size() - this->buffer_end < min_size) {
+            this->buffer.resize(std::max(this->buffer_end + min_size, this->buffer.size() * 2));
+        }
+        return std::span{ this->buffer }.subspan(this->buffer_end);
+    }
+
+    void MessageBlockDecoder::commit(size_t size) {
+        assert(this->buffer_end + size <= this->buffer.size());
+        this->buffer_end += size;
+    }
+
+    void MessageBlockDecoder::feed(std::span<const CharType> bytes) {
+        std::span<CharType> region = this->prepare(bytes.size());
+        std::copy(std::cbegin(bytes), std::cend(bytes), std::begin(region));
+        this->commit(bytes.size());
+    }
+
+    std::optional<MessageBlock> MessageBlockDecoder::next() {
+        constexpr size_t header_size = sizeof(MessageBlock::HEADER) + sizeof(MessageBlock::payload_size);
+        while (this->resync()) {
+            if (this->buffered() < header_size) {
+                return std::nullopt;
+            }
+            const auto size_it = std::cbegin(this->buffer) + this->read_pos + sizeof(MessageBlock::HEADER);
+            const uint32_t payload_size = (static_cast<uint32_t>(size_it[0]) << 24) |
+                                          (static_cast<uint32_t>(size_it[1]) << 16) |
+                                          (static_cast<uint32_t>(size_it[2]) << 8) |
+                                          static_cast<uint32_t>(size_it[3]);
+            if (payload_size == 0 || payload_size > MAX_BLOCK_PAYLOAD_SIZE) {
+                // not a usable block, skip past this header and look for the next one
+                ++this->read_pos;
+                continue;
+            }
+            if (this->buffered() < header_size + payload_size) {
+                return std::nullopt;
+            }
+            MessageBlock block{};
+            block.payload_size = payload_size;
+            block.payload.assign(size_it + sizeof(MessageBlock::payload_size),
+                size_it + sizeof(MessageBlock::payload_size) + payload_size);
+            this->read_pos += header_size + payload_size;
+            return block;
+        }
+        return std::nullopt;
+    }
+
+    bool MessageBlockDecoder::resync() {
+        const auto begin = std::cbegin(this->buffer) + this->read_pos;
+        const auto end = std::cbegin(this->buffer) + this->buffer_end;
+        const auto header_it = std::search(begin, end, std::cbegin(MessageBlock::HEADER), std::cend(MessageBlock::HEADER));
+        if (header_it != end) {
+            this->read_pos += header_it - begin;
+            return true;
+        }
+        // no complete header; keep any trailing bytes that could be the start of one
+        size_t keep = std::min(this->buffered(), sizeof(MessageBlock::HEADER) - 1);
+        while (keep > 0 && !std::equal(end - keep, end, std::cbegin(MessageBlock::HEADER))) {
+            --keep;
+        }
+        this->read_pos = this->buffer_end - keep;
+        return false;
+    }
+
+    void OutboundBuffer::append(const MessageBlock& block) {
+        this->compact();
+        const uint32_t payload_size = block.payload_size;
+        const CharType payload_size_bytes[sizeof(payload_size)] = {
+            static_cast<CharType>(payload_size >> 24), static_cast<CharType>(payload_size >> 16),
+            static_cast<CharType>(payload_size >> 8), static_cast<CharType>(payload_size)
+        };
+        this->buffer.reserve(this->buffer.size() + sizeof(block.HEADER) + sizeof(payload_size) + block.payload.size());
+        this->buffer.insert(std::end(this->buffer), std::cbegin(block.HEADER), std::cend(block.HEADER));
+        this->buffer.insert(std::end(this->buffer), std::cbegin(payload_size_bytes), std::cend(payload_size_bytes));
+        this->buffer.insert(std::end(this->buffer), std::cbegin(block.payload), std::cend(block.payload));
+    }
+
+    void OutboundBuffer::append(std::span<const CharType> bytes) {
+        this->compact();
+        this->buffer.insert(std::end(this->buffer), std::cbegin(bytes), std::cend(bytes));
+    }
+
+    void OutboundBuffer::consume(size_t size) {
+        assert(size <= this->size());
+        this->read_pos += size;
+        if (this->empty()) {
+            this->reset();
+        }
+    }
+
+    void OutboundBuffer::compact() {
+        // only worth moving the unsent remainder once it's the smaller part of the buffer
+        if (this->read_pos > 0 && this->read_pos >= this->size()) {
+            this->buffer.erase(std::begin(this->buffer), std::begin(this->buffer) + this->read_pos);
+            this->read_pos = 0;
+        }
+    }
+
     std::vector<CharType> pack_block(const MessageBlock& block) {
         std::vector<CharType> block_data{};
         block_data.reserve(sizeof(block.HEADER) + sizeof(block.payload_size) + block.payload.size());
@@ -75,48 +182,72 @@ namespace tavernmx::messaging
         return block_data;
     }
 
-    MessageBlock pack_message(const Message& message) {
+    void MessagePacker::add(const Message& message) {
+        this->begin_message(message.message_type);
+        json::to_msgpack(message.values, this->body);
+    }
+
+    MessageBlock MessagePacker::finish() {
+        std::vector<CharType> payload{};
+        payload.reserve(this->body.size() + 5);
+        msgpack::write_array_header(payload, this->count);
+        payload.insert(std::end(payload), std::cbegin(this->body), std::cend(this->body));
+        this->body.clear();
+        this->count = 0;
+
         MessageBlock block{};
-        json group_json = json::array();
-        group_json.push_back(message_to_json(message));
-        block.set_payload(json::to_msgpack(group_json));
+        block.set_payload(std::move(payload));
         return block;
     }
 
-    std::vector<MessageBlock> pack_messages(const std::vector<Message>& messages) {
-        std::vector<MessageBlock> blocks{};
-        if (messages.empty()) {
-            return blocks;
-        }
+    Frame MessagePacker::finish_frame() {
+        // frame the payload in place rather than building a MessageBlock and copying it
+        std::vector<CharType> frame{};
+        frame.reserve(sizeof(MessageBlock::HEADER) + sizeof(MessageBlock::payload_size) + this->body.size() + 5);
+        frame.insert(std::end(frame), std::cbegin(MessageBlock::HEADER), std::cend(MessageBlock::HEADER));
+        frame.resize(frame.size() + sizeof(MessageBlock::payload_size));
+        msgpack::write_array_header(frame, this->count);
+        frame.insert(std::end(frame), std::cbegin(this->body), std::cend(this->body));
+        this->body.clear();
+        this->count = 0;
 
-        json group_json = json::array();
-        for (const Message& message : messages) {
-            group_json.push_back(message_to_json(message));
+        const size_t payload_size = frame.size() - sizeof(MessageBlock::HEADER) - sizeof(MessageBlock::payload_size);
+        for (size_t i = 0; i < sizeof(MessageBlock::payload_size); ++i) {
+            frame[sizeof(MessageBlock::HEADER) + i] = static_cast<CharType>(payload_size >> ((3 - i) * 8));
         }
+        return std::make_shared<const std::vector<CharType>>(std::move(frame));
+    }
 
-        MessageBlock block{};
-        block.set_payload(json::to_msgpack(group_json));
-        blocks.push_back(std::move(block));
+    void MessagePacker::begin_message(MessageType message_type) {
+        // same layout as message_to_json(): a map with its keys in sorted order
+        msgpack::write_map_header(this->body, 2);
+        msgpack::write_string(this->body, "message_type");
+        msgpack::write_int(this->body, static_cast<int32_t>(message_type));
+        msgpack::write_string(this->body, "values");
+        ++this->count;
+    }
+
+    MessageBlock pack_message(const Message& message) {
+        MessagePacker packer{};
+        packer.add(message);
+        return packer.finish();
+    }
 
-        return blocks;
+    Frame make_frame(const MessageBlock& block) {
+        return std::make_shared<const std::vector<CharType>>(pack_block(block));
+    }
+
+    Frame make_frame(const Message& message) {
+        MessagePacker packer{};
+        packer.add(message);
+        return packer.finish_frame();
     }
 
     std::vector<Message> unpack_messages(const MessageBlock& block) {
         std::vector<Message> messages{};
-        if (std::cmp_less(block.payload_size, 1)) {
-            return messages;
+        for (const MessageView& view : view_messages(block)) {
+            messages.push_back(to_message(view));
         }
-
-        const json group_json = json::from_msgpack(block.payload);
-        if (group_json.is_array()) {
-            for (const json& message_json : group_json) {
-                Message message{};
-                message.message_type = message_json["message_type"].get<MessageType>();
-                message.values = message_json["values"];
-                messages.push_back(std::move(message));
-            }
-        }
-
         return messages;
     }
 
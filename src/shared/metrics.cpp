@@ -0,0 +1,267 @@
+#include <cmath>
+#include <stdexcept>
+#include <spdlog/fmt/fmt.h>
+#include "tavernmx/metrics.h"
+
+namespace
+{
+	using namespace tavernmx::metrics;
+
+	/// Next shard to hand out to a thread.
+	std::atomic<size_t> next_shard{ 0 };
+
+	/// Upper bounds of the histogram buckets reported to Prometheus: 1, 2 and 5 times each power of ten from
+	/// \p lowest up to \p highest.
+	std::vector<uint64_t> exported_bounds(uint64_t lowest, uint64_t highest) {
+		std::vector<uint64_t> bounds{};
+		for (uint64_t decade = lowest; decade <= highest; decade *= 10) {
+			for (const uint64_t multiple : { 1, 2, 5 }) {
+				if (decade * multiple <= highest) {
+					bounds.push_back(decade * multiple);
+				}
+			}
+		}
+		return bounds;
+	}
+
+	/// Renders \p value in the unit a histogram is reported in.
+	std::string format_value(uint64_t value, HistogramUnit unit) {
+		if (unit == HistogramUnit::Nanoseconds) {
+			return fmt::format("{:g}", static_cast<double>(value) / 1e9);
+		}
+		return fmt::format("{}", value);
+	}
+
+	/// Renders a duration in nanoseconds for people to read.
+	std::string format_duration(uint64_t nanoseconds) {
+		if (nanoseconds < 1'000) {
+			return fmt::format("{}ns", nanoseconds);
+		}
+		if (nanoseconds < 1'000'000) {
+			return fmt::format("{:.1f}us", static_cast<double>(nanoseconds) / 1e3);
+		}
+		if (nanoseconds < 1'000'000'000) {
+			return fmt::format("{:.1f}ms", static_cast<double>(nanoseconds) / 1e6);
+		}
+		return fmt::format("{:.2f}s", static_cast<double>(nanoseconds) / 1e9);
+	}
+
+	/// Escapes \p text for use as a label value (\p in_label) or help text.
+	std::string escape(std::string_view text, bool in_label) {
+		std::string escaped{};
+		escaped.reserve(text.size());
+		for (const char c : text) {
+			if (c == '\\') {
+				escaped += "\\\\";
+			} else if (c == '\n') {
+				escaped += "\\n";
+			} else if (c == '"' && in_label) {
+				escaped += "\\\"";
+			} else {
+				escaped += c;
+			}
+		}
+		return escaped;
+	}
+
+	/// Renders \p labels, plus an optional extra one, as "{name="value",...}", or nothing if there are none.
+	std::string format_labels(const MetricLabels& labels, std::string_view extra_name = {},
+		std::string_view extra_value = {}) {
+		if (labels.empty() && extra_name.empty()) {
+			return {};
+		}
+		std::string rendered{ "{" };
+		for (const auto& [name, value] : labels) {
+			if (rendered.size() > 1) {
+				rendered += ',';
+			}
+			rendered += fmt::format("{}=\"{}\"", name, escape(value, true));
+		}
+		if (!extra_name.empty()) {
+			if (rendered.size() > 1) {
+				rendered += ',';
+			}
+			rendered += fmt::format("{}=\"{}\"", extra_name, extra_value);
+		}
+		rendered += '}';
+		return rendered;
+	}
+}
+
+namespace tavernmx::metrics
+{
+	size_t assign_shard() {
+		return next_shard.fetch_add(1, std::memory_order_relaxed) % METRIC_SHARDS;
+	}
+
+	uint64_t HistogramSnapshot::value_at_quantile(double quantile) const {
+		if (this->count == 0) {
+			return 0;
+		}
+		const auto rank = std::max(uint64_t{ 1 },
+			static_cast<uint64_t>(std::ceil(std::clamp(quantile, 0.0, 1.0) * static_cast<double>(this->count))));
+		uint64_t seen = 0;
+		for (size_t index = 0; index < this->buckets.size(); ++index) {
+			seen += this->buckets[index];
+			if (seen >= rank) {
+				return Histogram::bucket_upper_bound(index);
+			}
+		}
+		return Histogram::MAX_VALUE;
+	}
+
+	uint64_t HistogramSnapshot::count_at_or_below(uint64_t value) const {
+		uint64_t seen = 0;
+		for (size_t index = 0; index < this->buckets.size() && Histogram::bucket_upper_bound(index) <= value;
+			 ++index) {
+			seen += this->buckets[index];
+		}
+		return seen;
+	}
+
+	HistogramSnapshot Histogram::snapshot() const {
+		HistogramSnapshot snapshot{ .buckets = std::vector<uint64_t>(BUCKET_COUNT) };
+		for (const Shard& shard : this->shards) {
+			for (size_t index = 0; index < BUCKET_COUNT; ++index) {
+				const uint64_t in_bucket = shard.buckets[index].load(std::memory_order_relaxed);
+				snapshot.buckets[index] += in_bucket;
+				snapshot.count += in_bucket;
+			}
+			snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+		}
+		return snapshot;
+	}
+
+	Counter& MetricsRegistry::counter(std::string name, std::string help, MetricLabels labels) {
+		return *this->find_or_add(std::move(name), std::move(help), MetricKind::Counter, HistogramUnit::Count,
+			std::move(labels)).counter;
+	}
+
+	Gauge& MetricsRegistry::gauge(std::string name, std::string help, MetricLabels labels) {
+		return *this->find_or_add(std::move(name), std::move(help), MetricKind::Gauge, HistogramUnit::Count,
+			std::move(labels)).gauge;
+	}
+
+	Histogram& MetricsRegistry::histogram(std::string name, std::string help, HistogramUnit unit,
+		MetricLabels labels) {
+		return *this->find_or_add(std::move(name), std::move(help), MetricKind::Histogram, unit,
+			std::move(labels)).histogram;
+	}
+
+	MetricsRegistry::Series& MetricsRegistry::find_or_add(std::string name, std::string help, MetricKind kind,
+		HistogramUnit unit, MetricLabels labels) {
+		std::lock_guard guard{ this->families_mutex };
+		auto family_it = std::find_if(this->families.begin(), this->families.end(),
+			[&name](const auto& family) { return family->name == name; });
+		if (family_it == this->families.end()) {
+			this->families.push_back(std::make_unique<Family>(Family{
+				.name = std::move(name), .help = std::move(help), .kind = kind, .unit = unit }));
+			family_it = std::prev(this->families.end());
+		} else if ((*family_it)->kind != kind || (*family_it)->unit != unit) {
+			throw std::invalid_argument{ fmt::format("Metric {} is already registered as another kind", name) };
+		}
+
+		Family& family = **family_it;
+		for (const auto& series : family.series) {
+			if (series->labels == labels) {
+				return *series;
+			}
+		}
+		auto series = std::make_unique<Series>(Series{ .labels = std::move(labels) });
+		switch (kind) {
+		case MetricKind::Counter:
+			series->counter = std::make_unique<Counter>();
+			break;
+		case MetricKind::Gauge:
+			series->gauge = std::make_unique<Gauge>();
+			break;
+		case MetricKind::Histogram:
+			series->histogram = std::make_unique<Histogram>();
+			break;
+		}
+		family.series.push_back(std::move(series));
+		return *family.series.back();
+	}
+
+	std::string MetricsRegistry::to_prometheus() const {
+		static const std::vector<uint64_t> duration_bounds = exported_bounds(1'000, 100'000'000'000);
+		static const std::vector<uint64_t> count_bounds = exported_bounds(1, 1'000'000);
+
+		std::lock_guard guard{ this->families_mutex };
+		std::string text{};
+		for (const auto& family : this->families) {
+			text += fmt::format("# HELP {} {}\n", family->name, escape(family->help, false));
+			switch (family->kind) {
+			case MetricKind::Counter:
+				text += fmt::format("# TYPE {} counter\n", family->name);
+				for (const auto& series : family->series) {
+					text += fmt::format("{}{} {}\n", family->name, format_labels(series->labels),
+						series->counter->value());
+				}
+				break;
+			case MetricKind::Gauge:
+				text += fmt::format("# TYPE {} gauge\n", family->name);
+				for (const auto& series : family->series) {
+					text += fmt::format("{}{} {}\n", family->name, format_labels(series->labels),
+						series->gauge->value());
+				}
+				break;
+			case MetricKind::Histogram:
+				text += fmt::format("# TYPE {} histogram\n", family->name);
+				for (const auto& series : family->series) {
+					const HistogramSnapshot snapshot = series->histogram->snapshot();
+					for (const uint64_t bound : family->unit == HistogramUnit::Nanoseconds
+							 ? duration_bounds
+							 : count_bounds) {
+						text += fmt::format("{}_bucket{} {}\n", family->name,
+							format_labels(series->labels, "le", format_value(bound, family->unit)),
+							snapshot.count_at_or_below(bound));
+					}
+					text += fmt::format("{}_bucket{} {}\n", family->name,
+						format_labels(series->labels, "le", "+Inf"), snapshot.count);
+					text += fmt::format("{}_sum{} {}\n", family->name, format_labels(series->labels),
+						format_value(snapshot.sum, family->unit));
+					text += fmt::format("{}_count{} {}\n", family->name, format_labels(series->labels),
+						snapshot.count);
+				}
+				break;
+			}
+		}
+		return text;
+	}
+
+	std::vector<std::string> MetricsRegistry::summarize() const {
+		std::lock_guard guard{ this->families_mutex };
+		std::vector<std::string> lines{};
+		for (const auto& family : this->families) {
+			for (const auto& series : family->series) {
+				const std::string name = family->name + format_labels(series->labels);
+				switch (family->kind) {
+				case MetricKind::Counter:
+					if (const uint64_t value = series->counter->value(); value != 0) {
+						lines.push_back(fmt::format("{} {}", name, value));
+					}
+					break;
+				case MetricKind::Gauge:
+					if (const int64_t value = series->gauge->value(); value != 0) {
+						lines.push_back(fmt::format("{} {}", name, value));
+					}
+					break;
+				case MetricKind::Histogram: {
+					const HistogramSnapshot snapshot = series->histogram->snapshot();
+					if (snapshot.count == 0) {
+						break;
+					}
+					const auto format = [unit = family->unit](uint64_t value) {
+						return unit == HistogramUnit::Nanoseconds ? format_duration(value) : fmt::format("{}", value);
+					};
+					lines.push_back(fmt::format("{} count {} p50 {} p99 {} max {}", name, snapshot.count,
+						format(snapshot.value_at_quantile(0.5)), format(snapshot.value_at_quantile(0.99)),
+						format(snapshot.value_at_quantile(1.0))));
+				} break;
+				}
+			}
+		}
+		return lines;
+	}
+}
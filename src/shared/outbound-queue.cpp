@@ -0,0 +1,118 @@
+#include <limits>
+#include "tavernmx/outbound-queue.h"
+
+namespace tavernmx
+{
+	OutboundQueue::PushResult OutboundQueue::push(messaging::Frame frame, size_t event_count) {
+		if (this->overflowed.load(std::memory_order_acquire)) {
+			return PushResult::Overflowed;
+		}
+		// reserve space first, so concurrent producers can't all slip under the limits together
+		const size_t frame_bytes = frame ? frame->size() : 0;
+		const size_t frames = this->frame_count.fetch_add(1, std::memory_order_acq_rel) + 1;
+		const size_t bytes = this->byte_count.fetch_add(frame_bytes, std::memory_order_acq_rel) + frame_bytes;
+		const bool droppable = event_count > 0;
+
+		bool refuse = this->over_limits(frames, bytes, 2);
+		if (!refuse && this->over_limits(frames, bytes, 1)) {
+			switch (this->limits.policy) {
+			case SlowConsumerPolicy::Disconnect:
+				refuse = true;
+				break;
+			case SlowConsumerPolicy::Degrade:
+				if (droppable) {
+					this->degraded.store(true, std::memory_order_release);
+					refuse = true;
+				}
+				break;
+			case SlowConsumerPolicy::DropOldest:
+				// the consumer trims the oldest echoes
+				break;
+			}
+		} else if (!refuse && droppable && this->degraded.load(std::memory_order_acquire)) {
+			refuse = true;
+		}
+
+		if (!refuse) {
+			this->incoming.push(Entry{ .frame = std::move(frame), .event_count = event_count });
+			return PushResult::Queued;
+		}
+		this->frame_count.fetch_sub(1, std::memory_order_acq_rel);
+		this->byte_count.fetch_sub(frame_bytes, std::memory_order_acq_rel);
+		if (droppable && this->limits.policy != SlowConsumerPolicy::Disconnect) {
+			this->drop(event_count);
+			return PushResult::Dropped;
+		}
+		this->overflowed.store(true, std::memory_order_release);
+		return PushResult::Overflowed;
+	}
+
+	std::optional<messaging::Frame> OutboundQueue::pop() {
+		this->trim();
+		if (!this->degraded.load(std::memory_order_acquire) && this->missed_events.load(std::memory_order_acquire) > 0) {
+			const uint64_t missed = this->missed_events.exchange(0, std::memory_order_acq_rel);
+			return messaging::make_frame(messaging::ChatMissed{ .event_count = static_cast<int32_t>(
+				std::min<uint64_t>(missed, std::numeric_limits<int32_t>::max())) });
+		}
+		if (this->pending.empty()) {
+			return std::nullopt;
+		}
+		Entry entry = std::move(this->pending.front());
+		this->pending.pop_front();
+		this->frame_count.fetch_sub(1, std::memory_order_acq_rel);
+		this->byte_count.fetch_sub(entry.frame ? entry.frame->size() : 0, std::memory_order_acq_rel);
+		return std::move(entry.frame);
+	}
+
+	void OutboundQueue::trim() {
+		this->collect();
+		switch (this->limits.policy) {
+		case SlowConsumerPolicy::DropOldest:
+			for (auto it = this->pending.begin(); it != this->pending.end() &&
+				this->over_limits(this->frame_count.load(std::memory_order_acquire),
+					this->byte_count.load(std::memory_order_acquire), 1);) {
+				if (it->event_count == 0) {
+					++it;
+					continue;
+				}
+				this->frame_count.fetch_sub(1, std::memory_order_acq_rel);
+				this->byte_count.fetch_sub(it->frame ? it->frame->size() : 0, std::memory_order_acq_rel);
+				this->drop(it->event_count);
+				it = this->pending.erase(it);
+			}
+			break;
+		case SlowConsumerPolicy::Degrade:
+			// resume once drained to half the limits, so a client hovering at the limit doesn't flap
+			if (this->degraded.load(std::memory_order_acquire) &&
+				this->frame_count.load(std::memory_order_acquire) * 2 <= this->limits.max_frames &&
+				this->byte_count.load(std::memory_order_acquire) * 2 <= this->limits.max_bytes) {
+				this->degraded.store(false, std::memory_order_release);
+			}
+			break;
+		case SlowConsumerPolicy::Disconnect:
+			break;
+		}
+	}
+
+	OutboundStats OutboundQueue::stats() const {
+		return OutboundStats{ .queued_frames = this->frame_count.load(std::memory_order_acquire),
+			.queued_bytes = this->byte_count.load(std::memory_order_acquire),
+			.dropped_events = this->dropped_events.load(std::memory_order_acquire),
+			.degraded = this->degraded.load(std::memory_order_acquire),
+			.overflowed = this->overflowed.load(std::memory_order_acquire) };
+	}
+
+	void OutboundQueue::drop(size_t event_count) {
+		this->dropped_events.fetch_add(event_count, std::memory_order_acq_rel);
+		this->missed_events.fetch_add(event_count, std::memory_order_acq_rel);
+	}
+
+	void OutboundQueue::collect() {
+		this->drained.clear();
+		this->incoming.drain_into(this->drained);
+		for (Entry& entry : this->drained) {
+			this->pending.push_back(std::move(entry));
+		}
+		this->drained.clear();
+	}
+}
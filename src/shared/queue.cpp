@@ -0,0 +1,60 @@
+#include "tavernmx/platform.h"
+#include "tavernmx/queue.h"
+
+#if defined(TMX_LINUX)
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+namespace tavernmx
+{
+	QueueSignal::~QueueSignal() {
+#if defined(TMX_LINUX)
+		if (const int32_t event_fd = this->fd.load(); event_fd >= 0) {
+			close(event_fd);
+		}
+#endif
+	}
+
+	bool QueueSignal::enable_event_fd() {
+#if defined(TMX_LINUX)
+		if (this->fd.load() >= 0) {
+			return true;
+		}
+		const int32_t event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (event_fd < 0) {
+			return false;
+		}
+		int32_t expected = -1;
+		if (!this->fd.compare_exchange_strong(expected, event_fd)) {
+			// enabled concurrently by someone else
+			close(event_fd);
+			return true;
+		}
+		// a notification that arrived before the descriptor existed still has to make it readable
+		if (this->pending.load()) {
+			this->write_event();
+		}
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	void QueueSignal::write_event() {
+#if defined(TMX_LINUX)
+		const uint64_t one = 1;
+		// can only fail if the counter would overflow, in which case it's readable anyway
+		[[maybe_unused]] const ssize_t written = write(this->fd.load(std::memory_order_acquire), &one, sizeof(one));
+#endif
+	}
+
+	void QueueSignal::read_event() {
+#if defined(TMX_LINUX)
+		if (const int32_t event_fd = this->fd.load(std::memory_order_acquire); event_fd >= 0) {
+			uint64_t count = 0;
+			[[maybe_unused]] const ssize_t result = read(event_fd, &count, sizeof(count));
+		}
+#endif
+	}
+}
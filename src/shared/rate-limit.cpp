@@ -0,0 +1,47 @@
+#include <algorithm>
+#include <cmath>
+#include "tavernmx/rate-limit.h"
+
+namespace tavernmx
+{
+	TokenBucket::TokenBucket(RateLimit limit, std::chrono::steady_clock::time_point now)
+		: limit{ limit.per_second, std::max(limit.burst, 1.0) }, tokens{ this->limit.burst }, refilled{ now } {
+	}
+
+	std::chrono::milliseconds TokenBucket::try_take(std::chrono::steady_clock::time_point now) {
+		if (!this->limit.is_limited()) {
+			return std::chrono::milliseconds{ 0 };
+		}
+		if (now > this->refilled) {
+			const double elapsed = std::chrono::duration<double>(now - this->refilled).count();
+			this->tokens = std::min(this->limit.burst, this->tokens + elapsed * this->limit.per_second);
+			this->refilled = now;
+		}
+		if (this->tokens >= 1.0) {
+			this->tokens -= 1.0;
+			return std::chrono::milliseconds{ 0 };
+		}
+		const double wait_ms = std::ceil((1.0 - this->tokens) * 1000.0 / this->limit.per_second);
+		return std::chrono::milliseconds{ std::max(static_cast<int64_t>(wait_ms), int64_t{ 1 }) };
+	}
+
+	MessageRateLimiter::MessageRateLimiter(const MessageRateLimits& limits,
+		std::chrono::steady_clock::time_point now) {
+		for (size_t i = 0; i < this->buckets.size(); ++i) {
+			this->buckets[i] = TokenBucket{ limits.get(MessageRateLimits::LIMITED_TYPES[i]), now };
+		}
+	}
+
+	std::chrono::milliseconds MessageRateLimiter::check(messaging::MessageType message_type,
+		std::chrono::steady_clock::time_point now) {
+		const std::optional<size_t> index = MessageRateLimits::index_of(message_type);
+		if (!index) {
+			return std::chrono::milliseconds{ 0 };
+		}
+		const std::chrono::milliseconds retry_after = this->buckets[index.value()].try_take(now);
+		if (retry_after.count() > 0) {
+			this->rejected.fetch_add(1, std::memory_order_relaxed);
+		}
+		return retry_after;
+	}
+}
@@ -0,0 +1,287 @@
+#include <algorithm>
+#include <cerrno>
+#include <vector>
+#include "tavernmx/logging.h"
+#include "tavernmx/platform.h"
+#include "tavernmx/reactor.h"
+
+#if defined(TMX_LINUX)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#elif defined(TMX_WINDOWS)
+#include <winsock2.h>
+#else
+#include <poll.h>
+#endif
+
+namespace
+{
+	/// Maximum number of events collected from a single wait.
+	constexpr size_t MAX_EVENTS = 256;
+
+#if defined(TMX_LINUX)
+	uint32_t to_native_events(tavernmx::ReactorEvents interest) {
+		uint32_t events = EPOLLRDHUP;
+		if ((interest & tavernmx::REACTOR_READABLE) != 0) {
+			events |= EPOLLIN;
+		}
+		if ((interest & tavernmx::REACTOR_WRITABLE) != 0) {
+			events |= EPOLLOUT;
+		}
+		return events;
+	}
+
+	tavernmx::ReactorEvents from_native_events(uint32_t events) {
+		tavernmx::ReactorEvents result = 0;
+		if ((events & EPOLLIN) != 0) {
+			result |= tavernmx::REACTOR_READABLE;
+		}
+		if ((events & EPOLLOUT) != 0) {
+			result |= tavernmx::REACTOR_WRITABLE;
+		}
+		if ((events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0) {
+			result |= tavernmx::REACTOR_CLOSED;
+		}
+		return result;
+	}
+#else
+	short to_native_events(tavernmx::ReactorEvents interest) {
+		short events = 0;
+		if ((interest & tavernmx::REACTOR_READABLE) != 0) {
+			events |= POLLIN;
+		}
+		if ((interest & tavernmx::REACTOR_WRITABLE) != 0) {
+			events |= POLLOUT;
+		}
+		return events;
+	}
+
+	tavernmx::ReactorEvents from_native_events(short events) {
+		tavernmx::ReactorEvents result = 0;
+		if ((events & POLLIN) != 0) {
+			result |= tavernmx::REACTOR_READABLE;
+		}
+		if ((events & POLLOUT) != 0) {
+			result |= tavernmx::REACTOR_WRITABLE;
+		}
+		if ((events & (POLLHUP | POLLERR | POLLNVAL)) != 0) {
+			result |= tavernmx::REACTOR_CLOSED;
+		}
+		return result;
+	}
+#endif
+}
+
+namespace tavernmx
+{
+	Reactor::Reactor() {
+#if defined(TMX_LINUX)
+		this->poll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (this->poll_fd < 0) {
+			throw TransportError{ "epoll_create1 failed" };
+		}
+		this->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (this->wake_fd < 0) {
+			close(this->poll_fd);
+			throw TransportError{ "eventfd failed" };
+		}
+		epoll_event event{ .events = EPOLLIN, .data = { .fd = this->wake_fd } };
+		if (epoll_ctl(this->poll_fd, EPOLL_CTL_ADD, this->wake_fd, &event) != 0) {
+			close(this->wake_fd);
+			close(this->poll_fd);
+			throw TransportError{ "epoll_ctl failed to register wake descriptor" };
+		}
+#endif
+	}
+
+	Reactor::~Reactor() {
+#if defined(TMX_LINUX)
+		close(this->wake_fd);
+		close(this->poll_fd);
+#endif
+	}
+
+	void Reactor::add(SocketHandle fd, ReactorEvents interest, ReactorHandler handler) {
+		std::lock_guard guard{ this->registrations_mutex };
+#if defined(TMX_LINUX)
+		epoll_event event{ .events = to_native_events(interest), .data = { .fd = fd } };
+		if (epoll_ctl(this->poll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+			if (errno != EEXIST || epoll_ctl(this->poll_fd, EPOLL_CTL_MOD, fd, &event) != 0) {
+				throw TransportError{ "epoll_ctl failed to register socket" };
+			}
+		}
+#endif
+		this->registrations[fd] = Registration{
+			.interest = interest, .handler = std::make_shared<ReactorHandler>(std::move(handler))
+		};
+	}
+
+	void Reactor::modify(SocketHandle fd, ReactorEvents interest) {
+		std::lock_guard guard{ this->registrations_mutex };
+		const auto it = this->registrations.find(fd);
+		if (it == this->registrations.end() || it->second.interest == interest) {
+			return;
+		}
+		it->second.interest = interest;
+#if defined(TMX_LINUX)
+		epoll_event event{ .events = to_native_events(interest), .data = { .fd = fd } };
+		epoll_ctl(this->poll_fd, EPOLL_CTL_MOD, fd, &event);
+#endif
+	}
+
+	void Reactor::remove(SocketHandle fd) noexcept {
+		std::lock_guard guard{ this->registrations_mutex };
+		if (this->registrations.erase(fd) > 0) {
+#if defined(TMX_LINUX)
+			epoll_ctl(this->poll_fd, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+		}
+	}
+
+	void Reactor::post(std::function<void()> task) {
+		this->tasks.push(std::move(task));
+		this->wake();
+	}
+
+	TimerId Reactor::schedule(std::chrono::steady_clock::time_point when, std::function<void()> task) {
+		return this->timers.schedule(when, [task = std::move(task)]() {
+			try {
+				task();
+			} catch (const std::exception& ex) {
+				TMX_ERR("Reactor timer threw exception: {}", ex.what());
+			}
+		});
+	}
+
+	void Reactor::wake() noexcept {
+		if (this->wake_pending.exchange(true)) {
+			return;
+		}
+#if defined(TMX_LINUX)
+		const uint64_t one = 1;
+		[[maybe_unused]] const ssize_t written = write(this->wake_fd, &one, sizeof(one));
+#endif
+	}
+
+	size_t Reactor::run_once(ssl::Milliseconds timeout) {
+		size_t dispatched = 0;
+#if defined(TMX_LINUX)
+		epoll_event events[MAX_EVENTS];
+		const int32_t count = epoll_wait(this->poll_fd, events, static_cast<int32_t>(MAX_EVENTS),
+			this->wake_pending ? 0 : static_cast<int32_t>(this->wait_before_timers(timeout)));
+		if (count < 0) {
+			if (errno == EINTR) {
+				return 0;
+			}
+			throw TransportError{ "epoll_wait failed" };
+		}
+
+		for (int32_t i = 0; i < count; ++i) {
+			if (events[i].data.fd == this->wake_fd) {
+				uint64_t value = 0;
+				[[maybe_unused]] const ssize_t rcvd = read(this->wake_fd, &value, sizeof(value));
+				continue;
+			}
+			if (const std::shared_ptr<ReactorHandler> handler = this->find_handler(events[i].data.fd)) {
+				try {
+					(*handler)(from_native_events(events[i].events));
+				} catch (const std::exception& ex) {
+					TMX_ERR("Reactor handler threw exception: {}", ex.what());
+				}
+				++dispatched;
+			}
+		}
+#else
+		// Without a portable wake descriptor, cap the wait so wake() and post() are still honored promptly.
+		std::vector<std::pair<SocketHandle, ReactorEvents>> watched{};
+		{
+			std::lock_guard guard{ this->registrations_mutex };
+			watched.reserve(this->registrations.size());
+			for (const auto& [fd, registration] : this->registrations) {
+				watched.emplace_back(fd, registration.interest);
+			}
+		}
+		std::vector<pollfd> poll_fds{};
+		poll_fds.reserve(watched.size());
+		for (const auto& [fd, interest] : watched) {
+			poll_fds.push_back(pollfd{ .fd = fd, .events = to_native_events(interest), .revents = 0 });
+		}
+		ssl::Milliseconds wait = ssl::SSL_RETRY_MILLISECONDS;
+		if (this->wake_pending) {
+			wait = 0;
+		} else if (const ssl::Milliseconds timer_wait = this->wait_before_timers(timeout); timer_wait >= 0) {
+			wait = std::min(timer_wait, ssl::SSL_RETRY_MILLISECONDS);
+		}
+#if defined(TMX_WINDOWS)
+		int32_t count = 0;
+		if (poll_fds.empty()) {
+			Sleep(static_cast<DWORD>(wait));
+		} else {
+			count = WSAPoll(poll_fds.data(), static_cast<ULONG>(poll_fds.size()), static_cast<INT>(wait));
+		}
+#else
+		const int32_t count = poll(poll_fds.data(), static_cast<nfds_t>(poll_fds.size()), static_cast<int32_t>(wait));
+#endif
+		if (count < 0) {
+			if (errno == EINTR) {
+				return 0;
+			}
+			throw TransportError{ "poll failed" };
+		}
+		for (const pollfd& ready : poll_fds) {
+			if (ready.revents == 0) {
+				continue;
+			}
+			if (const std::shared_ptr<ReactorHandler> handler = this->find_handler(ready.fd)) {
+				try {
+					(*handler)(from_native_events(ready.revents));
+				} catch (const std::exception& ex) {
+					TMX_ERR("Reactor handler threw exception: {}", ex.what());
+				}
+				++dispatched;
+			}
+		}
+#endif
+		return dispatched + this->run_tasks() + this->timers.advance(std::chrono::steady_clock::now());
+	}
+
+	size_t Reactor::size() const {
+		std::lock_guard guard{ this->registrations_mutex };
+		return this->registrations.size();
+	}
+
+	std::shared_ptr<ReactorHandler> Reactor::find_handler(SocketHandle fd) const {
+		std::lock_guard guard{ this->registrations_mutex };
+		if (const auto it = this->registrations.find(fd); it != this->registrations.end()) {
+			return it->second.handler;
+		}
+		return nullptr;
+	}
+
+	ssl::Milliseconds Reactor::wait_before_timers(ssl::Milliseconds timeout) const {
+		const std::chrono::steady_clock::time_point next_timer = this->timers.next_expiry();
+		if (next_timer == std::chrono::steady_clock::time_point::max()) {
+			return timeout;
+		}
+		const auto until_timer = std::chrono::ceil<std::chrono::milliseconds>(
+			next_timer - std::chrono::steady_clock::now());
+		const ssl::Milliseconds timer_wait = std::max<ssl::Milliseconds>(
+			static_cast<ssl::Milliseconds>(until_timer.count()), 0);
+		return timeout < 0 ? timer_wait : std::min(timeout, timer_wait);
+	}
+
+	size_t Reactor::run_tasks() {
+		this->wake_pending = false;
+		size_t count = 0;
+		while (std::optional<std::function<void()>> task = this->tasks.pop()) {
+			try {
+				(*task)();
+			} catch (const std::exception& ex) {
+				TMX_ERR("Reactor task threw exception: {}", ex.what());
+			}
+			++count;
+		}
+		return count;
+	}
+}
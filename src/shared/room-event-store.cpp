@@ -0,0 +1,177 @@
+#include <bit>
+#include <stdexcept>
+#include "tavernmx/room-event-store.h"
+
+namespace
+{
+	/// Number of block slots allocated by the first insert.
+	constexpr size_t INITIAL_STORAGE_SIZE = 4;
+}
+
+namespace tavernmx::rooms
+{
+	SymbolTable::~SymbolTable() {
+		for (const std::atomic<Page*>& page : this->pages) {
+			delete page.load(std::memory_order_relaxed);
+		}
+	}
+
+	uint32_t SymbolTable::intern(std::string_view symbol) {
+		{
+			std::shared_lock lock{ this->ids_mutex };
+			if (const auto it = this->ids.find(symbol); it != this->ids.end()) {
+				return it->second;
+			}
+		}
+		std::unique_lock lock{ this->ids_mutex };
+		// another thread may have added it in the meantime
+		if (const auto it = this->ids.find(symbol); it != this->ids.end()) {
+			return it->second;
+		}
+		const size_t id = this->ids.size();
+		if (id >= PAGE_SIZE * MAX_PAGES) {
+			throw std::length_error{ "Symbol table is full" };
+		}
+		std::atomic<Page*>& page = this->pages[id / PAGE_SIZE];
+		if (page.load(std::memory_order_relaxed) == nullptr) {
+			page.store(new Page{}, std::memory_order_release);
+		}
+		std::string& stored = page.load(std::memory_order_relaxed)->symbols[id % PAGE_SIZE];
+		stored.assign(symbol);
+		this->ids.emplace(stored, static_cast<uint32_t>(id));
+		return static_cast<uint32_t>(id);
+	}
+
+	size_t SymbolTable::size() const {
+		std::shared_lock lock{ this->ids_mutex };
+		return this->ids.size();
+	}
+
+	RoomEventStore::Block::Block(uint64_t number, uint64_t first_position, size_t event_capacity, size_t text_capacity)
+		: number{ number },
+		  first_position{ first_position },
+		  event_capacity{ event_capacity },
+		  text_capacity{ text_capacity },
+		  timestamps{ std::make_unique_for_overwrite<int64_t[]>(event_capacity) },
+		  user_ids{ std::make_unique_for_overwrite<uint32_t[]>(event_capacity) },
+		  text_ends{ std::make_unique_for_overwrite<uint32_t[]>(event_capacity) },
+		  text{ std::make_unique_for_overwrite<char[]>(text_capacity) } {
+	}
+
+	RoomEventStore::RoomEventStore(size_t capacity, std::shared_ptr<SymbolTable> user_names)
+		: max_events{ std::max<size_t>(capacity, 1) }, user_names{ std::move(user_names) } {
+	}
+
+	RoomEventStore::~RoomEventStore() {
+		if (const Storage* current = this->storage.load(std::memory_order_relaxed)) {
+			const uint64_t block_end = this->block_count.load(std::memory_order_relaxed);
+			for (uint64_t number = this->oldest_block; number != block_end; ++number) {
+				delete current->at(number).load(std::memory_order_relaxed);
+			}
+			delete current;
+		}
+	}
+
+	size_t RoomEventStore::storage_bytes() const {
+		const EpochDomain::ReadGuard guard{ this->epochs };
+		size_t bytes = sizeof(*this);
+		const uint64_t block_end = this->block_count.load(std::memory_order_acquire);
+		if (const Storage* current = this->storage.load()) {
+			bytes += sizeof(Storage) + current->size() * sizeof(std::atomic<Block*>);
+			for (uint64_t number = block_end; number-- != 0;) {
+				const Block* block = current->at(number).load();
+				if (block == nullptr || block->number != number) {
+					break;
+				}
+				bytes += sizeof(Block) + block->event_capacity * (sizeof(int64_t) + 2 * sizeof(uint32_t)) +
+					block->text_capacity;
+			}
+		}
+		return bytes;
+	}
+
+	void RoomEventStore::insert(const RoomEvent& event) {
+		const uint64_t position = this->head.load(std::memory_order_relaxed);
+		const uint32_t user_id = this->user_names->intern(event.origin_user_name);
+		const std::string& text = event.event_text;
+		Block* block = this->newest_block;
+		if (block == nullptr || position - block->first_position == block->event_capacity ||
+			block->text_size + text.size() > block->text_capacity) {
+			block = this->start_block(position, text.size());
+		}
+		const uint64_t i = position - block->first_position;
+		block->timestamps[i] = event.timestamp.time_since_epoch().count();
+		block->user_ids[i] = user_id;
+		std::copy(std::cbegin(text), std::cend(text), block->text.get() + block->text_size);
+		block->text_size += text.size();
+		block->text_ends[i] = static_cast<uint32_t>(block->text_size);
+		this->head.store(position + 1);
+		this->evict_blocks(position + 1);
+	}
+
+	RoomEventStore::Block* RoomEventStore::start_block(uint64_t position, size_t text_size) {
+		// busier rooms get bigger blocks, with room for as much text per event as they have been sending
+		size_t event_capacity = MIN_BLOCK_EVENTS;
+		size_t text_per_event = INITIAL_TEXT_BYTES;
+		if (const Block* previous = this->newest_block) {
+			const size_t previous_events = position - previous->first_position;
+			const size_t max_block_events = std::clamp(std::bit_ceil(this->max_events), MIN_BLOCK_EVENTS, MAX_BLOCK_EVENTS);
+			event_capacity = previous_events == previous->event_capacity
+				? std::min(previous->event_capacity * 2, max_block_events)
+				: previous->event_capacity;
+			const size_t average = (previous->text_size + previous_events - 1) / previous_events;
+			text_per_event = average + average / 4;
+		}
+		const uint64_t number = this->block_count.load(std::memory_order_relaxed);
+		auto block = std::make_unique<Block>(number, position, event_capacity,
+			std::max(text_size, event_capacity * text_per_event));
+
+		Storage* current = this->storage.load(std::memory_order_relaxed);
+		if (current == nullptr || number - this->oldest_block >= current->size()) {
+			auto grown = std::make_unique<Storage>(current == nullptr ? INITIAL_STORAGE_SIZE : current->size() * 2);
+			if (current != nullptr) {
+				for (uint64_t live = this->oldest_block; live != number; ++live) {
+					grown->at(live).store(current->at(live).load(std::memory_order_relaxed), std::memory_order_relaxed);
+				}
+			}
+			// published before block_count moves past number, so readers that see the new block see these slots
+			this->storage.store(grown.get());
+			if (current != nullptr) {
+				this->retired_storage.retire(this->epochs, std::unique_ptr<Storage>{ current });
+				this->reclaim();
+			}
+			current = grown.release();
+		}
+		current->at(number).store(block.get());
+		this->block_count.store(number + 1);
+		this->newest_block = block.release();
+		return this->newest_block;
+	}
+
+	void RoomEventStore::evict_blocks(uint64_t end) {
+		if (end <= this->max_events) {
+			return;
+		}
+		const uint64_t oldest_position = end - this->max_events;
+		const Storage* current = this->storage.load(std::memory_order_relaxed);
+		const uint64_t block_end = this->block_count.load(std::memory_order_relaxed);
+		bool evicted = false;
+		// a block has no events left once the next one starts at or before the oldest event kept
+		while (this->oldest_block + 1 != block_end &&
+			current->at(this->oldest_block + 1).load(std::memory_order_relaxed)->first_position <= oldest_position) {
+			Block* block = current->at(this->oldest_block).exchange(nullptr);
+			this->retired_blocks.retire(this->epochs, std::unique_ptr<Block>{ block });
+			++this->oldest_block;
+			evicted = true;
+		}
+		if (evicted) {
+			this->reclaim();
+		}
+	}
+
+	void RoomEventStore::reclaim() {
+		const uint64_t oldest_reader = this->epochs.advance();
+		this->retired_blocks.free_before(oldest_reader);
+		this->retired_storage.free_before(oldest_reader);
+	}
+}
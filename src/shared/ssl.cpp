@@ -1,21 +1,33 @@
-#include <chrono>
+#include <algorithm>
+#include <limits>
 #include <string>
-#include <thread>
 #include <utility>
 #include <vector>
 #include <openssl/x509v3.h>
 #include <openssl/x509.h>
 #include <openssl/x509_vfy.h>
 #include <openssl/pem.h>
+#include "tavernmx/platform.h"
 #include "tavernmx/ssl.h"
 
+#if defined(TMX_WINDOWS)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
 using namespace tavernmx::messaging;
 using namespace std::string_literals;
 
 namespace
 {
-	// receive buffer size here roughly matches typical ethernet MTU
+	// minimum receive buffer space per read, roughly matches typical ethernet MTU
 	constexpr size_t BUFFER_SIZE = 1500;
+	// upper bound on bytes read per receive_bytes() call, so one busy peer can't monopolize the caller
+	constexpr size_t MAX_RECEIVE_SIZE = BUFFER_SIZE * 64;
 
 	/**
      * @brief Returns an exception containing current queued openssl error messages.
@@ -42,7 +54,7 @@ namespace
      * @return the number of bytes read
      * @throws tavernmx::ssl::SslError if there's an underlying socket error
      */
-	size_t receive_bytes(SSL* ssl, BIO* bio, CharType* buffer, size_t bufsize) {
+	size_t read_bytes(SSL* ssl, BIO* bio, CharType* buffer, size_t bufsize) {
 		if ((SSL_get_shutdown(ssl) & SSL_RECEIVED_SHUTDOWN) == SSL_RECEIVED_SHUTDOWN) {
 			return 0;
 		}
@@ -57,44 +69,60 @@ namespace
 		if (SSL_get_error(ssl, len) == SSL_ERROR_ZERO_RETURN) {
 			return 0;
 		}
-		throw ssl_errors_to_exception("receive_bytes read error");
+		throw ssl_errors_to_exception("read_bytes read error");
 	}
 }
 
 namespace tavernmx::ssl
 {
-	void send_message(BIO* bio, const MessageBlock& block) {
-		const std::vector<CharType> block_data = pack_block(block);
-		while (BIO_write(bio, block_data.data(), static_cast<int32_t>(block_data.size())) < 0) {
-			if (BIO_should_retry(bio)) {
-				std::this_thread::sleep_for(std::chrono::milliseconds{ SSL_RETRY_MILLISECONDS });
-				continue;
-			}
-			throw ssl_errors_to_exception("send_message BIO_write failed");
+	size_t send_bytes(BIO* bio, std::span<const CharType> bytes) {
+		if (bytes.empty()) {
+			return 0;
 		}
-		BIO_flush(bio);
+		ERR_clear_error();
+		const int32_t len = BIO_write(bio, bytes.data(),
+			static_cast<int32_t>(std::min<size_t>(bytes.size(), std::numeric_limits<int32_t>::max())));
+		if (len > 0) {
+			return static_cast<size_t>(len);
+		}
+		if (BIO_should_retry(bio)) {
+			return 0;
+		}
+		throw ssl_errors_to_exception("send_bytes BIO_write failed");
 	}
 
-	std::optional<MessageBlock> receive_message(BIO* bio) {
+	size_t receive_bytes(BIO* bio, MessageBlockDecoder& decoder) {
 		SSL* ssl = get_ssl(bio);
-		CharType buffer[BUFFER_SIZE];
-		size_t rcvd = receive_bytes(ssl, bio, buffer, sizeof(buffer));
-		if (rcvd == 0) {
-			std::this_thread::sleep_for(std::chrono::milliseconds{ SSL_RETRY_MILLISECONDS });
-			return std::nullopt;
-		}
-
-		MessageBlock block{};
-		size_t applied = apply_buffer_to_block(std::span{ buffer, rcvd }, block);
-		while (std::cmp_greater(applied, 0) && std::cmp_less(applied, block.payload_size)) {
-			rcvd = receive_bytes(ssl, bio, buffer, sizeof(buffer));
-			applied += apply_buffer_to_block(std::span{ buffer, rcvd }, block, applied);
+		size_t total = 0;
+		// past the cap, finish off any record OpenSSL already decrypted: the socket won't be reported readable
+		// for bytes that have left it, so they'd sit there until the peer sent something else
+		while (total < MAX_RECEIVE_SIZE || SSL_pending(ssl) > 0) {
+			const std::span<CharType> region = decoder.prepare(BUFFER_SIZE);
+			const size_t rcvd = read_bytes(ssl, bio, region.data(), region.size());
+			if (rcvd == 0) {
+				break;
+			}
+			decoder.commit(rcvd);
+			total += rcvd;
 		}
+		return total;
+	}
 
-		if (block.payload_size == 0) {
-			return std::nullopt;
+	HandshakeStatus continue_handshake(BIO* bio) {
+		SSL* ssl = get_ssl(bio);
+		ERR_clear_error();
+		const int32_t result = SSL_do_handshake(ssl);
+		if (result == 1) {
+			return HandshakeStatus::Complete;
+		}
+		switch (SSL_get_error(ssl, result)) {
+		case SSL_ERROR_WANT_READ:
+			return HandshakeStatus::WantRead;
+		case SSL_ERROR_WANT_WRITE:
+			return HandshakeStatus::WantWrite;
+		default:
+			throw ssl_errors_to_exception("SSL_do_handshake failed");
 		}
-		return block;
 	}
 
 	ssl_unique_ptr<BIO> accept_new_tcp_connection(BIO* accept_bio) {
@@ -113,6 +141,45 @@ namespace tavernmx::ssl
 		return ssl;
 	}
 
+	int32_t get_fd(BIO* bio) {
+		if (bio == nullptr) {
+			return -1;
+		}
+		return static_cast<int32_t>(BIO_get_fd(bio, nullptr));
+	}
+
+	bool set_tcp_keepalive(BIO* bio, int32_t idle_seconds, int32_t interval_seconds, int32_t probe_count) {
+		const int32_t fd = get_fd(bio);
+		if (fd < 0) {
+			return false;
+		}
+#if defined(TMX_WINDOWS)
+		const auto socket = static_cast<SOCKET>(fd);
+		const auto set_option = [socket](int32_t level, int32_t option, int32_t value) {
+			return setsockopt(socket, level, option, reinterpret_cast<const char*>(&value), sizeof(value)) == 0;
+		};
+#else
+		const auto set_option = [fd](int32_t level, int32_t option, int32_t value) {
+			return setsockopt(fd, level, option, &value, sizeof(value)) == 0;
+		};
+#endif
+		if (!set_option(SOL_SOCKET, SO_KEEPALIVE, 1)) {
+			return false;
+		}
+#if defined(TCP_KEEPIDLE)
+		set_option(IPPROTO_TCP, TCP_KEEPIDLE, idle_seconds);
+#elif defined(TCP_KEEPALIVE)
+		set_option(IPPROTO_TCP, TCP_KEEPALIVE, idle_seconds);
+#endif
+#if defined(TCP_KEEPINTVL)
+		set_option(IPPROTO_TCP, TCP_KEEPINTVL, interval_seconds);
+#endif
+#if defined(TCP_KEEPCNT)
+		set_option(IPPROTO_TCP, TCP_KEEPCNT, probe_count);
+#endif
+		return true;
+	}
+
 	void verify_certificate(SSL* ssl, bool allow_self_signed, std::string_view expected_hostname) {
 		const long err = SSL_get_verify_result(ssl);
 		if (err == X509_V_ERR_SELF_SIGNED_CERT_IN_CHAIN || err == X509_V_ERR_DEPTH_ZERO_SELF_SIGNED_CERT) {
@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <bit>
+#include "tavernmx/timer-wheel.h"
+
+namespace
+{
+	/// Bits of a tick number that pick the slot within a level.
+	constexpr uint64_t SLOT_BITS = 6;
+	static_assert(uint64_t{ 1 } << SLOT_BITS == tavernmx::TimerWheel::SLOTS_PER_LEVEL);
+
+	/// Number of ticks spanned by a slot at \p level.
+	constexpr uint64_t slot_span(size_t level) {
+		return uint64_t{ 1 } << (SLOT_BITS * level);
+	}
+
+	/// Number of ticks spanned by the whole wheel.
+	constexpr uint64_t WHEEL_SPAN = slot_span(tavernmx::TimerWheel::LEVELS);
+}
+
+namespace tavernmx
+{
+	TimerWheel::TimerWheel(Clock::duration tick, Clock::time_point now)
+		: tick{ std::max(tick, Clock::duration{ 1 }) }, origin{ now } {
+		this->slots.fill(NONE);
+	}
+
+	TimerId TimerWheel::schedule(Clock::time_point when, Callback callback) {
+		uint64_t due_tick = 0;
+		if (when > this->origin) {
+			const Clock::duration since_origin = when - this->origin;
+			due_tick = static_cast<uint64_t>(since_origin / this->tick);
+			if (since_origin % this->tick != Clock::duration::zero()) {
+				++due_tick;
+			}
+		}
+
+		uint32_t index = 0;
+		if (this->free_nodes.empty()) {
+			index = static_cast<uint32_t>(this->nodes.size());
+			this->nodes.emplace_back();
+		} else {
+			index = this->free_nodes.back();
+			this->free_nodes.pop_back();
+		}
+		Node& node = this->nodes[index];
+		node.callback = std::move(callback);
+		node.due_tick = std::max(due_tick, this->current_tick + 1);
+		this->link(index);
+		++this->pending_count;
+		return (static_cast<TimerId>(node.generation) << 32) | index;
+	}
+
+	bool TimerWheel::cancel(TimerId timer) {
+		if (!this->is_pending(timer)) {
+			return false;
+		}
+		const auto index = static_cast<uint32_t>(timer);
+		this->unlink(index);
+		this->release(index);
+		return true;
+	}
+
+	bool TimerWheel::is_pending(TimerId timer) const {
+		const auto index = static_cast<uint32_t>(timer);
+		return timer != NO_TIMER && index < this->nodes.size() &&
+			this->nodes[index].generation == static_cast<uint32_t>(timer >> 32) && this->nodes[index].slot != NONE;
+	}
+
+	size_t TimerWheel::advance(Clock::time_point now) {
+		if (now <= this->origin) {
+			return 0;
+		}
+		const auto target_tick = static_cast<uint64_t>((now - this->origin) / this->tick);
+		size_t fired = 0;
+		while (this->current_tick < target_tick) {
+			// skip straight to the next tick with anything to do
+			const uint64_t next_tick = this->next_busy_tick();
+			if (next_tick > target_tick) {
+				this->current_tick = target_tick;
+				break;
+			}
+			this->current_tick = next_tick;
+
+			// move timers down from any higher level slot that starts this tick, highest first
+			for (size_t level = LEVELS - 1; level > 0; --level) {
+				if (next_tick % slot_span(level) == 0) {
+					this->cascade(level);
+				}
+			}
+
+			const size_t slot = next_tick % SLOTS_PER_LEVEL;
+			while (this->slots[slot] != NONE) {
+				const uint32_t index = this->slots[slot];
+				this->unlink(index);
+				if (this->nodes[index].due_tick > next_tick) {
+					// parked at the edge of the wheel, not due yet
+					this->link(index);
+					continue;
+				}
+				const Callback callback = std::move(this->nodes[index].callback);
+				this->release(index);
+				++fired;
+				try {
+					callback();
+				} catch (...) {
+					// the rest of this tick's timers fire on the next call
+					--this->current_tick;
+					throw;
+				}
+			}
+		}
+		return fired;
+	}
+
+	TimerWheel::Clock::time_point TimerWheel::next_expiry() const {
+		const uint64_t next_tick = this->next_busy_tick();
+		if (next_tick == UINT64_MAX) {
+			return Clock::time_point::max();
+		}
+		return this->origin + this->tick * static_cast<int64_t>(next_tick);
+	}
+
+	uint64_t TimerWheel::next_busy_tick() const {
+		uint64_t next_tick = UINT64_MAX;
+		for (size_t level = 0; level < LEVELS; ++level) {
+			if (this->occupied[level] == 0) {
+				continue;
+			}
+			// a level 0 slot is busy when it's due; a higher one when its timers have to move down
+			const uint64_t first_slot = (this->current_tick >> (SLOT_BITS * level)) + 1;
+			const uint64_t ahead = static_cast<uint64_t>(
+				std::countr_zero(std::rotr(this->occupied[level], static_cast<int32_t>(first_slot % SLOTS_PER_LEVEL))));
+			next_tick = std::min(next_tick, (first_slot + ahead) << (SLOT_BITS * level));
+		}
+		return next_tick;
+	}
+
+	void TimerWheel::link(uint32_t index) {
+		Node& node = this->nodes[index];
+		uint64_t place_tick = node.due_tick;
+		if (place_tick - this->current_tick >= WHEEL_SPAN) {
+			place_tick = this->current_tick + WHEEL_SPAN - 1;
+		}
+		const uint64_t ticks_away = place_tick - this->current_tick;
+		size_t level = 0;
+		while (level < LEVELS - 1 && ticks_away >= slot_span(level + 1)) {
+			++level;
+		}
+		const uint64_t slot_in_level = (place_tick >> (SLOT_BITS * level)) % SLOTS_PER_LEVEL;
+		const auto slot = static_cast<uint32_t>(level * SLOTS_PER_LEVEL + slot_in_level);
+
+		node.slot = slot;
+		node.prev = NONE;
+		node.next = this->slots[slot];
+		if (node.next != NONE) {
+			this->nodes[node.next].prev = index;
+		}
+		this->slots[slot] = index;
+		this->occupied[level] |= uint64_t{ 1 } << slot_in_level;
+	}
+
+	void TimerWheel::unlink(uint32_t index) {
+		Node& node = this->nodes[index];
+		if (node.prev != NONE) {
+			this->nodes[node.prev].next = node.next;
+		} else {
+			this->slots[node.slot] = node.next;
+			if (node.next == NONE) {
+				this->occupied[node.slot / SLOTS_PER_LEVEL] &= ~(uint64_t{ 1 } << (node.slot % SLOTS_PER_LEVEL));
+			}
+		}
+		if (node.next != NONE) {
+			this->nodes[node.next].prev = node.prev;
+		}
+		node.prev = NONE;
+		node.next = NONE;
+		node.slot = NONE;
+	}
+
+	void TimerWheel::release(uint32_t index) {
+		Node& node = this->nodes[index];
+		node.callback = nullptr;
+		// a new generation, so stale TimerIds for this node can't cancel its next timer
+		if (++node.generation == 0) {
+			node.generation = 1;
+		}
+		this->free_nodes.push_back(index);
+		--this->pending_count;
+	}
+
+	void TimerWheel::cascade(size_t level) {
+		const uint64_t slot_in_level = (this->current_tick >> (SLOT_BITS * level)) % SLOTS_PER_LEVEL;
+		const auto slot = static_cast<uint32_t>(level * SLOTS_PER_LEVEL + slot_in_level);
+		uint32_t index = this->slots[slot];
+		this->slots[slot] = NONE;
+		this->occupied[level] &= ~(uint64_t{ 1 } << slot_in_level);
+		while (index != NONE) {
+			const uint32_t next = this->nodes[index].next;
+			this->link(index);
+			index = next;
+		}
+	}
+}
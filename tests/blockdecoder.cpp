@@ -0,0 +1,188 @@
+#include <utility>
+#include <catch.hpp>
+#include "tavernmx/messaging.h"
+
+using namespace tavernmx::messaging;
+using Catch::Matchers::RangeEquals;
+
+namespace
+{
+	/// Builds a byte stream containing \p count packed blocks, each with a distinct payload.
+	std::vector<CharType> make_stream(size_t count, std::vector<MessageBlock>& blocks) {
+		std::vector<CharType> stream{};
+		for (size_t i = 0; std::cmp_less(i, count); ++i) {
+			MessageBlock block = pack_message(create_chat_send("test", std::string(10 + i * 7, 'a' + i)));
+			const std::vector<CharType> bytes = pack_block(block);
+			stream.insert(std::end(stream), std::cbegin(bytes), std::cend(bytes));
+			blocks.push_back(std::move(block));
+		}
+		return stream;
+	}
+
+	/// Takes every complete block out of \p decoder.
+	void drain(MessageBlockDecoder& decoder, std::vector<MessageBlock>& output) {
+		while (std::optional<MessageBlock> block = decoder.next()) {
+			output.push_back(std::move(block.value()));
+		}
+	}
+
+	/// Checks that \p actual contains the same payloads as \p expected.
+	void require_same_blocks(const std::vector<MessageBlock>& actual, const std::vector<MessageBlock>& expected) {
+		REQUIRE(actual.size() == expected.size());
+		for (size_t i = 0; std::cmp_less(i, actual.size()); ++i) {
+			REQUIRE(actual[i].payload_size == expected[i].payload_size);
+			REQUIRE_THAT(actual[i].payload, RangeEquals(expected[i].payload));
+		}
+	}
+}
+
+TEST_CASE("MessageBlockDecoder: empty decoder has no blocks") {
+	MessageBlockDecoder decoder{};
+	REQUIRE_FALSE(decoder.next().has_value());
+	REQUIRE(std::cmp_equal(decoder.buffered(), 0));
+}
+
+TEST_CASE("MessageBlockDecoder: all blocks from a single read") {
+	std::vector<MessageBlock> expected{};
+	const std::vector<CharType> stream = make_stream(3, expected);
+
+	MessageBlockDecoder decoder{};
+	decoder.feed(stream);
+	std::vector<MessageBlock> actual{};
+	drain(decoder, actual);
+
+	require_same_blocks(actual, expected);
+	REQUIRE(std::cmp_equal(decoder.buffered(), 0));
+}
+
+TEST_CASE("MessageBlockDecoder: stream split at every offset") {
+	std::vector<MessageBlock> expected{};
+	const std::vector<CharType> stream = make_stream(3, expected);
+	const std::span<const CharType> bytes{ stream };
+
+	for (size_t split = 0; std::cmp_less_equal(split, stream.size()); ++split) {
+		MessageBlockDecoder decoder{};
+		std::vector<MessageBlock> actual{};
+		decoder.feed(bytes.first(split));
+		drain(decoder, actual);
+		decoder.feed(bytes.subspan(split));
+		drain(decoder, actual);
+		require_same_blocks(actual, expected);
+		REQUIRE(std::cmp_equal(decoder.buffered(), 0));
+	}
+}
+
+TEST_CASE("MessageBlockDecoder: stream fed one byte at a time") {
+	std::vector<MessageBlock> expected{};
+	const std::vector<CharType> stream = make_stream(4, expected);
+
+	MessageBlockDecoder decoder{};
+	std::vector<MessageBlock> actual{};
+	for (const CharType c : stream) {
+		const std::span<CharType> region = decoder.prepare(1);
+		region[0] = c;
+		decoder.commit(1);
+		drain(decoder, actual);
+	}
+	require_same_blocks(actual, expected);
+}
+
+TEST_CASE("MessageBlockDecoder: resync on header after garbage") {
+	std::vector<MessageBlock> expected{};
+	const std::vector<CharType> stream = make_stream(2, expected);
+	const std::vector<CharType> garbage{ 'x', 't', 'm', 0x01, 't', 'm' };
+
+	std::vector<CharType> corrupted{ garbage };
+	corrupted.insert(std::end(corrupted), std::cbegin(stream), std::cend(stream));
+	corrupted.insert(std::end(corrupted), std::cbegin(garbage), std::cend(garbage));
+
+	// feed split at every offset so the garbage's partial header lands on a read boundary
+	const std::span<const CharType> bytes{ corrupted };
+	for (size_t split = 0; std::cmp_less_equal(split, corrupted.size()); ++split) {
+		MessageBlockDecoder decoder{};
+		std::vector<MessageBlock> actual{};
+		decoder.feed(bytes.first(split));
+		drain(decoder, actual);
+		decoder.feed(bytes.subspan(split));
+		drain(decoder, actual);
+		require_same_blocks(actual, expected);
+	}
+}
+
+TEST_CASE("MessageBlockDecoder: corrupt payload size is skipped") {
+	std::vector<MessageBlock> expected{};
+	const std::vector<CharType> stream = make_stream(1, expected);
+
+	// a header claiming an oversized payload, followed by a valid block
+	std::vector<CharType> corrupted{ std::cbegin(MessageBlock::HEADER), std::cend(MessageBlock::HEADER) };
+	corrupted.insert(std::end(corrupted), { 0xff, 0xff, 0xff, 0xff });
+	corrupted.insert(std::end(corrupted), std::cbegin(stream), std::cend(stream));
+
+	MessageBlockDecoder decoder{};
+	decoder.feed(corrupted);
+	std::vector<MessageBlock> actual{};
+	drain(decoder, actual);
+	require_same_blocks(actual, expected);
+}
+
+TEST_CASE("OutboundBuffer: framing matches pack_block") {
+	std::vector<MessageBlock> blocks{};
+	const std::vector<CharType> expected = make_stream(3, blocks);
+
+	OutboundBuffer outbound{};
+	for (const MessageBlock& block : blocks) {
+		outbound.append(block);
+	}
+	REQUIRE(std::cmp_equal(outbound.size(), expected.size()));
+	REQUIRE_THAT(outbound.pending(), RangeEquals(expected));
+}
+
+TEST_CASE("Frame: framing matches pack_block") {
+	const std::vector<Message> messages = { create_chat_send("test", "one"), create_heartbeat(),
+		create_chat_send("test", std::string(300, 'b')) };
+	MessagePacker packer{};
+	for (const Message& message : messages) {
+		packer.add(message);
+	}
+	const Frame frame = packer.finish_frame();
+	REQUIRE(packer.empty());
+	REQUIRE_THAT(*frame, RangeEquals(pack_block(pack_messages(std::cbegin(messages), std::cend(messages)))));
+	REQUIRE_THAT(*make_frame(messages[0]), RangeEquals(pack_block(pack_message(messages[0]))));
+
+	MessageBlockDecoder decoder{};
+	decoder.feed(*frame);
+	const std::optional<MessageBlock> block = decoder.next();
+	REQUIRE(block.has_value());
+	REQUIRE(unpack_messages(block.value()).size() == messages.size());
+}
+
+TEST_CASE("OutboundBuffer: partial writes resume where they stopped") {
+	std::vector<MessageBlock> blocks{};
+	const std::vector<CharType> expected = make_stream(3, blocks);
+
+	OutboundBuffer outbound{};
+	outbound.append(blocks[0]);
+	outbound.append(blocks[1]);
+
+	// simulate a socket that accepts a few bytes at a time while more blocks are queued
+	std::vector<CharType> written{};
+	MessageBlockDecoder decoder{};
+	std::vector<MessageBlock> decoded{};
+	size_t step = 1;
+	while (!outbound.empty()) {
+		const std::span<const CharType> pending = outbound.pending();
+		const size_t count = std::min(step, pending.size());
+		written.insert(std::end(written), std::cbegin(pending), std::cbegin(pending) + count);
+		decoder.feed(pending.first(count));
+		drain(decoder, decoded);
+		outbound.consume(count);
+		if (step == 5) {
+			outbound.append(blocks[2]);
+		}
+		++step;
+	}
+
+	REQUIRE(outbound.empty());
+	REQUIRE_THAT(written, RangeEquals(expected));
+	require_same_blocks(decoded, blocks);
+}
@@ -0,0 +1,90 @@
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <catch.hpp>
+#include "tavernmx/server.h"
+#include "tls-loopback.h"
+
+#if defined(TMX_LINUX)
+using namespace tavernmx::messaging;
+using tavernmx::server::ClientConnection;
+using tavernmx::testing::PeerConnection;
+
+namespace
+{
+	/// SSL message callback counting the TLS records written, into the size_t at \p arg.
+	void count_records(int32_t write_p, int32_t, int32_t content_type, const void*, size_t, SSL*, void* arg) {
+		if (write_p == 1 && content_type == SSL3_RT_HEADER) {
+			++*static_cast<size_t*>(arg);
+		}
+	}
+}
+
+TEST_CASE("ClientConnection: small frames are written together") {
+	const auto server_ctx = tavernmx::testing::make_server_context();
+	const auto client_ctx = tavernmx::testing::make_client_context();
+	size_t records = 0;
+	SSL_CTX_set_num_tickets(server_ctx.get(), 0);
+	SSL_CTX_set_msg_callback(server_ctx.get(), count_records);
+	SSL_CTX_set_msg_callback_arg(server_ctx.get(), &records);
+	tavernmx::testing::TlsPair pair = tavernmx::testing::make_tls_pair(server_ctx.get(), client_ctx.get());
+	const auto connection = std::make_shared<ClientConnection>(std::move(pair.server),
+		std::make_shared<tavernmx::Reactor>());
+	PeerConnection peer{ std::move(pair.client) };
+	const Frame ack = make_frame(create_ack());
+
+	SECTION("A run of small frames goes out in one record") {
+		records = 0;
+		for (size_t i = 0; i < 64; ++i) {
+			connection->queue_frame(ack);
+		}
+		connection->flush_messages();
+		REQUIRE(records == 1);
+		REQUIRE(peer.receive_blocks(64) == 64);
+	}
+
+	SECTION("Small frames gathered ahead of a big one are written before it") {
+		records = 0;
+		connection->queue_frame(ack);
+		connection->queue_frame(ack);
+		connection->queue_frame(make_frame(create_chat_send("room", std::string(8000, 'x'))));
+		connection->queue_frame(ack);
+		connection->flush_messages();
+		REQUIRE(records == 3);
+		REQUIRE(peer.receive_blocks(4) == 4);
+	}
+}
+
+TEST_CASE("ClientConnection: a client is on the ready list once until its turn ends") {
+	const auto server_ctx = tavernmx::testing::make_server_context();
+	const auto client_ctx = tavernmx::testing::make_client_context();
+	tavernmx::testing::TlsPair pair = tavernmx::testing::make_tls_pair(server_ctx.get(), client_ctx.get());
+	const auto ready_clients = std::make_shared<tavernmx::server::ReadyClients>();
+	const auto connection = std::make_shared<ClientConnection>(std::move(pair.server),
+		std::make_shared<tavernmx::Reactor>(), ready_clients);
+	std::vector<std::weak_ptr<ClientConnection>> ready{};
+	std::vector<Message> inbound{};
+
+	connection->push_inbound(create_room_list());
+	connection->push_inbound(create_room_list());
+	REQUIRE(ready_clients->drain_into(ready) == 1);
+	REQUIRE(ready.front().lock() == connection);
+
+	SECTION("A client that was drained leaves the list, and rejoins it with its next message") {
+		REQUIRE(connection->messages_in.drain_into(inbound) == 2);
+		connection->end_turn();
+		REQUIRE(ready_clients->empty());
+		connection->push_inbound(create_room_list());
+		REQUIRE(ready_clients->size() == 1);
+	}
+
+	SECTION("A client that sent more before its turn ended goes straight back on the list") {
+		REQUIRE(connection->messages_in.drain_into(inbound, 1) == 1);
+		connection->end_turn();
+		REQUIRE(ready_clients->size() == 1);
+		connection->push_inbound(create_room_list());
+		REQUIRE(ready_clients->size() == 1);
+	}
+}
+#endif
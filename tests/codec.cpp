@@ -0,0 +1,154 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <limits>
+#include <utility>
+#include <catch.hpp>
+#include "tavernmx/codec.h"
+
+using namespace tavernmx::messaging;
+using Catch::Matchers::RangeEquals;
+
+namespace
+{
+	ChatEcho make_echo(size_t i) {
+		return ChatEcho{ .room_name = "general",
+			.text = "line of chat number " + std::to_string(i),
+			.timestamp = 1700000000 + static_cast<int32_t>(i),
+			.user_name = "test_user" };
+	}
+}
+
+TEST_CASE("Typed messages encode identically to JSON messages") {
+	SECTION("CHAT_ECHO") {
+		const ChatEcho echo = make_echo(1);
+		const MessageBlock typed = pack_message(echo);
+		const MessageBlock untyped =
+			pack_message(create_chat_echo(echo.room_name, echo.text, echo.user_name, echo.timestamp));
+		REQUIRE_THAT(typed.payload, RangeEquals(untyped.payload));
+	}
+
+	SECTION("Integer widths") {
+		for (const int32_t timestamp : { 0, 1, 127, 128, 255, 256, 65535, 65536, -1, -32, -33, -128, -129, -32768,
+				 -32769, std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max() }) {
+			const RoomHistoryEvent event{ .text = "a", .timestamp = timestamp, .user_name = "b" };
+			std::vector<CharType> typed{};
+			detail::write_record(typed, event);
+			const json event_json = { { "text", "a" }, { "timestamp", timestamp }, { "user_name", "b" } };
+			REQUIRE_THAT(typed, RangeEquals(json::to_msgpack(event_json)));
+		}
+	}
+
+	SECTION("String and array widths") {
+		RoomHistory history{ .event_count = 0, .room_name = std::string(300, 'r') };
+		Message history_message = create_room_history(history.room_name, 0);
+		for (size_t i = 0; i < 20; ++i) {
+			const std::string text(i * 20, 't');
+			history.events.push_back(RoomHistoryEvent{ .text = text, .timestamp = 10, .user_name = "u" });
+			history.event_count = add_room_history_event(history_message, 10, "u", text);
+		}
+		REQUIRE_THAT(pack_message(history).payload, RangeEquals(pack_message(history_message).payload));
+	}
+}
+
+TEST_CASE("Typed messages round trip") {
+	SECTION("Through MessageView") {
+		MessagePacker packer{};
+		packer.add(ChatSend{ .room_name = "general", .text = "hi" });
+		packer.add(create_heartbeat());
+		packer.add(make_echo(2));
+		const MessageBlock block = packer.finish();
+		REQUIRE(packer.empty());
+
+		const std::vector<MessageView> views = view_messages(block);
+		REQUIRE(views.size() == 3);
+		const std::optional<ChatSend> send = decode_message<ChatSend>(views[0]);
+		REQUIRE(send.has_value());
+		REQUIRE(send->room_name == "general");
+		REQUIRE(send->text == "hi");
+		REQUIRE(views[1].message_type == MessageType::HEARTBEAT);
+		REQUIRE_FALSE(decode_message<ChatSend>(views[2]).has_value());
+		const std::optional<ChatEcho> echo = decode_message<ChatEcho>(views[2]);
+		REQUIRE(echo.has_value());
+		REQUIRE(echo->text == make_echo(2).text);
+		REQUIRE(echo->timestamp == make_echo(2).timestamp);
+		REQUIRE(echo->user_name == "test_user");
+	}
+
+	SECTION("Through JSON Message") {
+		const Message message = create_chat_echo("general", "hello", "someone", -5);
+		const std::optional<ChatEcho> echo = from_message<ChatEcho>(message);
+		REQUIRE(echo.has_value());
+		REQUIRE(echo->timestamp == -5);
+		const Message converted = to_message(echo.value());
+		REQUIRE(converted.message_type == MessageType::CHAT_ECHO);
+		REQUIRE(converted.values == message.values);
+	}
+
+	SECTION("Unknown keys are skipped and missing keys keep defaults") {
+		const Message message{ .message_type = MessageType::CHAT_SEND,
+			.values = { { "extra", { { "nested", json::array({ 1, 2.5, nullptr, true }) } } }, { "text", "x" } } };
+		const std::optional<ChatSend> send = from_message<ChatSend>(message);
+		REQUIRE(send.has_value());
+		REQUIRE(send->room_name.empty());
+		REQUIRE(send->text == "x");
+	}
+}
+
+TEST_CASE("Malformed message blocks are rejected") {
+	MessageBlock block = pack_message(make_echo(3));
+	SECTION("Truncated values") {
+		block.payload.resize(block.payload.size() - 4);
+		const std::vector<MessageView> views = view_messages(block);
+		REQUIRE(views.empty());
+	}
+
+	SECTION("Wrong value type") {
+		const Message message{ .message_type = MessageType::CHAT_ECHO, .values = { { "timestamp", "soon" } } };
+		REQUIRE_FALSE(from_message<ChatEcho>(message).has_value());
+	}
+
+	SECTION("Oversized container counts") {
+		const std::vector<CharType> bogus = { 0xdd, 0xff, 0xff, 0xff, 0xff, 0x80 };
+		msgpack::Reader reader{ bogus };
+		size_t count = 0;
+		REQUIRE_FALSE(reader.read_array_header(count));
+		msgpack::Reader skipper{ bogus };
+		REQUIRE_FALSE(skipper.skip());
+	}
+}
+
+TEST_CASE("Codec benchmarks", "[!benchmark]") {
+	constexpr size_t MESSAGE_COUNT = 100;
+	std::vector<ChatEcho> echoes{};
+	for (size_t i = 0; i < MESSAGE_COUNT; ++i) {
+		echoes.push_back(make_echo(i));
+	}
+	const MessageBlock block = pack_messages(std::cbegin(echoes), std::cend(echoes));
+
+	BENCHMARK("Encode CHAT_ECHO x100 (JSON)") {
+		std::vector<Message> messages{};
+		for (const ChatEcho& echo : echoes) {
+			messages.push_back(create_chat_echo(echo.room_name, echo.text, echo.user_name, echo.timestamp));
+		}
+		json group_json = json::array();
+		for (const Message& message : messages) {
+			group_json.push_back(message_to_json(message));
+		}
+		return json::to_msgpack(group_json);
+	};
+
+	BENCHMARK("Encode CHAT_ECHO x100 (typed)") {
+		return pack_messages(std::cbegin(echoes), std::cend(echoes));
+	};
+
+	BENCHMARK("Decode CHAT_ECHO x100 (JSON)") {
+		return unpack_messages(block);
+	};
+
+	BENCHMARK("Decode CHAT_ECHO x100 (typed)") {
+		std::vector<ChatEcho> decoded{};
+		for (const MessageView& view : view_messages(block)) {
+			decoded.push_back(decode_message<ChatEcho>(view).value());
+		}
+		return decoded;
+	};
+}
@@ -0,0 +1,47 @@
+#include <string>
+#include <vector>
+#include <catch.hpp>
+#include "tls-loopback.h"
+
+#if defined(TMX_LINUX)
+#include <poll.h>
+
+using namespace tavernmx::messaging;
+using tavernmx::testing::PeerConnection;
+
+namespace
+{
+	/// Checks if the kernel has bytes waiting on \p fd.
+	bool socket_readable(int32_t fd) {
+		pollfd poll_fd{ .fd = fd, .events = POLLIN, .revents = 0 };
+		return poll(&poll_fd, 1, 0) > 0;
+	}
+}
+
+TEST_CASE("BaseConnection: a burst bigger than one read is received without waiting for more") {
+	const auto server_ctx = tavernmx::testing::make_server_context();
+	const auto client_ctx = tavernmx::testing::make_client_context();
+	const std::string text(1000, 'x');
+
+	// bursts of ~80-120 KB: around the most one receive reads, in 16 KB TLS records that don't line up with it
+	for (size_t block_count = 80; block_count <= 120; ++block_count) {
+		INFO("Burst of " << block_count << " blocks");
+		tavernmx::testing::TlsPair pair = tavernmx::testing::make_tls_pair(server_ctx.get(), client_ctx.get());
+		PeerConnection server{ std::move(pair.server) };
+		PeerConnection client{ std::move(pair.client) };
+		std::vector<MessageBlock> blocks{};
+		for (size_t i = 0; i < block_count; ++i) {
+			blocks.push_back(pack_message(create_chat_send("room", text)));
+		}
+		client.send_message_blocks(std::cbegin(blocks), std::cend(blocks));
+		REQUIRE(client.outbound_size() == 0);
+
+		// read only while the socket says there is something to read, as the reactor does
+		size_t received = 0;
+		while (socket_readable(server.get_socket())) {
+			received += server.receive_messages().size();
+		}
+		REQUIRE(received == block_count);
+	}
+}
+#endif
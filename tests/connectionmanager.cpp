@@ -0,0 +1,265 @@
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+#include <catch.hpp>
+#include "test-server.h"
+
+#if defined(TMX_LINUX)
+#include <poll.h>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+using tavernmx::server::ClientConnection;
+using tavernmx::server::ClientConnectionManager;
+using tavernmx::server::ConnectionLiveness;
+using tavernmx::testing::PeerConnection;
+
+namespace
+{
+	/// A ClientConnectionManager accepting on a port of 127.0.0.1 chosen by the system, with a fresh certificate.
+	class TestManager
+	{
+	public:
+		explicit TestManager(ConnectionLiveness liveness = {})
+			: manager{ 0, 1, tavernmx::OutboundLimits{}, tavernmx::MessageRateLimits{}, 0, liveness } {
+			const tavernmx::server::ServerConfiguration config = tavernmx::testing::write_test_config(this->directory);
+			this->manager.load_certificate(config.host_certificate_path, config.host_private_key_path);
+			this->manager.begin_accept();
+		}
+
+		~TestManager() {
+			for (std::jthread& thread : this->threads) {
+				thread.request_stop();
+				thread.join();
+			}
+			this->manager.shutdown();
+			for (const int32_t fd : this->sockets) {
+				close(fd);
+			}
+			std::filesystem::remove_all(this->directory);
+		}
+
+		TestManager(const TestManager&) = delete;
+
+		TestManager& operator=(const TestManager&) = delete;
+
+		/// Opens \p count TCP connections to the manager, which wait in its listen backlog.
+		void connect(size_t count) {
+			for (size_t i = 0; i < count; ++i) {
+				this->sockets.push_back(tavernmx::testing::connect_tcp(this->manager.get_accept_port()));
+			}
+		}
+
+		/// Accepts and services clients as the server does, but with no server worker releasing closed ones.
+		void serve() {
+			this->threads.emplace_back([this](const std::stop_token& stop) {
+				while (!stop.stop_requested()) {
+					for (const std::shared_ptr<ClientConnection>& client : this->manager.accept_connections(20, 256)) {
+						tavernmx::server::client_worker(client, this->manager.get_room_histories());
+					}
+				}
+			});
+			this->threads.emplace_back([reactor = this->manager.get_reactors().front()](const std::stop_token& stop) {
+				while (!stop.stop_requested()) {
+					reactor->run_once(20);
+				}
+			});
+		}
+
+		/// Connects a client that identifies as \p user_name, once the manager has acknowledged its HELLO.
+		PeerConnection connect_client(std::string_view user_name) {
+			PeerConnection client{ tavernmx::testing::connect_tls(this->manager.get_accept_port(), this->client_ctx.get()) };
+			client.send_message(tavernmx::messaging::create_hello(user_name));
+			REQUIRE(client.receive_until(tavernmx::messaging::MessageType::ACK));
+			return client;
+		}
+
+		std::filesystem::path directory{ tavernmx::testing::make_test_directory() };
+		ClientConnectionManager manager;
+		std::vector<int32_t> sockets{};
+		tavernmx::ssl::ssl_unique_ptr<SSL_CTX> client_ctx{ tavernmx::testing::make_client_context() };
+		std::vector<std::jthread> threads{};
+	};
+
+	/// Receives until the server closes \p client, or \p timeout passes.
+	bool wait_for_close(PeerConnection& client, std::chrono::milliseconds timeout) {
+		const auto deadline = std::chrono::steady_clock::now() + timeout;
+		try {
+			while (client.is_connected() && std::chrono::steady_clock::now() < deadline) {
+				client.receive_messages();
+			}
+		} catch (const tavernmx::TransportError&) {
+			return true;
+		}
+		return !client.is_connected();
+	}
+}
+
+TEST_CASE("ClientConnectionManager: one accept takes the whole backlog") {
+	TestManager test{};
+	test.connect(20);
+
+	const std::vector<std::shared_ptr<ClientConnection>> accepted = test.manager.accept_connections(1000, 256);
+	REQUIRE(accepted.size() == 20);
+	REQUIRE(test.manager.active_connection_count() == 20);
+	REQUIRE(test.manager.handshake_count() == 20);
+	REQUIRE(test.manager.accept_connections(0, 256).empty());
+}
+
+TEST_CASE("ClientConnectionManager: no more than max_handshakes are accepted at once") {
+	TestManager test{};
+	test.connect(10);
+
+	std::vector<std::shared_ptr<ClientConnection>> accepted = test.manager.accept_connections(1000, 4);
+	REQUIRE(accepted.size() == 4);
+	REQUIRE(test.manager.handshake_count() == 4);
+
+	SECTION("The rest wait in the backlog until a handshake finishes") {
+		const auto start = std::chrono::steady_clock::now();
+		REQUIRE(test.manager.accept_connections(100, 4).empty());
+		REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds{ 100 });
+	}
+
+	SECTION("A waiting accept wakes as soon as a handshake is abandoned") {
+		std::jthread closer{ [connection = accepted.front()]() {
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 50 });
+			connection->close();
+		} };
+		const auto start = std::chrono::steady_clock::now();
+		const std::vector<std::shared_ptr<ClientConnection>> more = test.manager.accept_connections(5000, 4);
+		REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds{ 1 });
+		REQUIRE(more.size() == 1);
+		REQUIRE(test.manager.handshake_count() == 4);
+	}
+}
+
+TEST_CASE("ClientConnection: a handshake counts until it completes or the connection closes") {
+	const auto server_ctx = tavernmx::testing::make_server_context();
+	const auto client_ctx = tavernmx::testing::make_client_context();
+	const auto handshakes = std::make_shared<tavernmx::server::HandshakeTracker>();
+	tavernmx::testing::TlsPair completed = tavernmx::testing::make_tls_pair(server_ctx.get(), client_ctx.get(), false);
+	tavernmx::testing::TlsPair abandoned = tavernmx::testing::make_tls_pair(server_ctx.get(), client_ctx.get(), false);
+	const auto connection = std::make_shared<ClientConnection>(std::move(completed.server),
+		std::make_shared<tavernmx::Reactor>(), std::make_shared<tavernmx::server::ReadyClients>(),
+		tavernmx::OutboundLimits{}, tavernmx::MessageRateLimits{},
+		tavernmx::server::ConnectionLiveness{}, handshakes);
+	auto other = std::make_shared<ClientConnection>(std::move(abandoned.server), connection->get_reactor(),
+		std::make_shared<tavernmx::server::ReadyClients>(), tavernmx::OutboundLimits{},
+		tavernmx::MessageRateLimits{}, tavernmx::server::ConnectionLiveness{}, handshakes);
+	REQUIRE(handshakes->count() == 2);
+
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 5 };
+	while (!connection->continue_handshake() && std::chrono::steady_clock::now() < deadline) {
+		tavernmx::ssl::continue_handshake(completed.client.get());
+	}
+	REQUIRE(handshakes->count() == 1);
+	// closing afterwards doesn't count it twice
+	connection->detach();
+	REQUIRE(handshakes->count() == 1);
+
+	other.reset();
+	REQUIRE(handshakes->count() == 0);
+}
+
+TEST_CASE("ClientConnectionManager: a stalled TLS handshake is dropped at its deadline") {
+	const tavernmx::testing::TestServer server{};
+	// connects, but never starts the handshake
+	const int32_t fd = tavernmx::testing::connect_tcp(server.port());
+	const auto start = std::chrono::steady_clock::now();
+
+	pollfd poll_fd{ .fd = fd, .events = POLLIN, .revents = 0 };
+	REQUIRE(poll(&poll_fd, 1, tavernmx::ssl::SSL_TIMEOUT_MILLISECONDS + 2000) == 1);
+	char buffer[16]{};
+	REQUIRE(read(fd, buffer, sizeof(buffer)) <= 0);
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+	REQUIRE(elapsed >= std::chrono::milliseconds{ tavernmx::ssl::SSL_TIMEOUT_MILLISECONDS - 100 });
+	REQUIRE(server.client_connections()->handshake_count() == 0);
+	close(fd);
+}
+
+TEST_CASE("ClientConnection: a quiet client is sent a HEARTBEAT, and disconnected if it doesn't answer") {
+	TestManager test{ ConnectionLiveness{ .heartbeat_interval = 1s, .heartbeat_timeout = 1s } };
+	test.serve();
+	PeerConnection client = test.connect_client("quiet");
+	const auto start = std::chrono::steady_clock::now();
+
+	REQUIRE(client.receive_until(tavernmx::messaging::MessageType::HEARTBEAT, 3s));
+	REQUIRE(std::chrono::steady_clock::now() - start >= 900ms);
+
+	SECTION("An answer keeps it connected, and it is probed again once it goes quiet") {
+		client.send_message(tavernmx::messaging::create_heartbeat());
+		REQUIRE(client.receive_until(tavernmx::messaging::MessageType::HEARTBEAT, 3s));
+		REQUIRE(client.is_connected());
+	}
+
+	SECTION("Without an answer it is disconnected once the timeout passes") {
+		const auto probed = std::chrono::steady_clock::now();
+		REQUIRE(wait_for_close(client, 3s));
+		REQUIRE(std::chrono::steady_clock::now() - probed >= 900ms);
+	}
+}
+
+TEST_CASE("ClientConnectionManager: releasing closed connections counts why they were closed") {
+	TestManager test{ ConnectionLiveness{ .heartbeat_interval = 1s, .heartbeat_timeout = 1s } };
+	test.serve();
+	// never starts the TLS handshake
+	test.connect(1);
+	PeerConnection unresponsive = test.connect_client("unresponsive");
+	PeerConnection leaving = test.connect_client("leaving");
+	PeerConnection answering = test.connect_client("answering");
+	leaving.shutdown();
+
+	// the stalled handshake's deadline is the last to pass
+	const auto deadline = std::chrono::steady_clock::now() +
+		std::chrono::milliseconds{ tavernmx::ssl::SSL_TIMEOUT_MILLISECONDS + 500 };
+	while (std::chrono::steady_clock::now() < deadline) {
+		if (answering.receive_until(tavernmx::messaging::MessageType::HEARTBEAT, 100ms)) {
+			answering.send_message(tavernmx::messaging::create_heartbeat());
+		}
+	}
+	REQUIRE(wait_for_close(unresponsive, 100ms));
+	REQUIRE(answering.is_connected());
+
+	const tavernmx::server::ReapedConnections reaped = test.manager.release_connections();
+	REQUIRE(reaped.released == 3);
+	REQUIRE(reaped.expired == 1);
+	REQUIRE(reaped.unresponsive == 1);
+	REQUIRE(test.manager.active_connection_count() == 1);
+
+	const tavernmx::server::ReapedConnections again = test.manager.release_connections();
+	REQUIRE(again.released == 0);
+	REQUIRE(again.expired == 0);
+	REQUIRE(again.unresponsive == 0);
+}
+
+TEST_CASE("ClientConnectionManager: connections are released while their reactor is closing them") {
+	// the server worker releases connections on its own thread; a ThreadSanitizer build checks it never touches
+	// what the reactor thread is tearing down
+	TestManager test{ ConnectionLiveness{ .heartbeat_interval = 1s, .heartbeat_timeout = 1s } };
+	test.serve();
+	std::vector<PeerConnection> clients{};
+	for (int32_t i = 0; i < 8; ++i) {
+		clients.push_back(test.connect_client("user-" + std::to_string(i)));
+	}
+	for (size_t i = 0; i < clients.size(); i += 2) {
+		clients[i].shutdown();
+	}
+
+	// the rest never answer their HEARTBEAT, so their timers close them
+	tavernmx::server::ReapedConnections reaped{};
+	const auto deadline = std::chrono::steady_clock::now() + 5s;
+	while (reaped.released < clients.size() && std::chrono::steady_clock::now() < deadline) {
+		const tavernmx::server::ReapedConnections more = test.manager.release_connections();
+		reaped.released += more.released;
+		reaped.unresponsive += more.unresponsive;
+		std::this_thread::sleep_for(1ms);
+	}
+	REQUIRE(reaped.released == clients.size());
+	REQUIRE(reaped.unresponsive == clients.size() / 2);
+	REQUIRE(test.manager.active_connection_count() == 0);
+}
+#endif
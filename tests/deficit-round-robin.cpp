@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+#include <catch.hpp>
+#include "tavernmx/deficit-round-robin.h"
+
+using tavernmx::DeficitRoundRobin;
+
+namespace
+{
+	/// A client's inbound messages, each stamped with the amount of work done before it arrived.
+	struct Flow
+	{
+		std::deque<size_t> messages{};
+		size_t served{};
+		std::vector<size_t> latencies{};
+		/// On the scheduler's active list, as the server worker tracks its clients.
+		bool active{};
+	};
+
+	/// Simulates a server worker processing flows[0..n) with \p scheduler, one unit of work per message.
+	class Simulation
+	{
+	public:
+		explicit Simulation(size_t flow_count) : flows(flow_count) {}
+
+		void send(DeficitRoundRobin<size_t>& scheduler, size_t flow, size_t count) {
+			for (size_t i = 0; i < count; ++i) {
+				this->flows[flow].messages.push_back(this->work_done);
+			}
+			if (count > 0 && !this->flows[flow].active) {
+				this->flows[flow].active = true;
+				scheduler.activate(flow);
+			}
+		}
+
+		size_t tick(DeficitRoundRobin<size_t>& scheduler) {
+			return scheduler.run([this](size_t key, size_t max_count) {
+				Flow& flow = this->flows[key];
+				size_t count = 0;
+				for (; count < max_count && !flow.messages.empty(); ++count) {
+					// latency is the work done on other messages between this one arriving and being processed
+					flow.latencies.push_back(this->work_done - flow.messages.front());
+					flow.messages.pop_front();
+					++flow.served;
+					++this->work_done;
+				}
+				flow.active = count == max_count;
+				return count;
+			});
+		}
+
+		std::vector<Flow> flows;
+		size_t work_done{};
+	};
+
+	size_t p99(std::vector<size_t> latencies) {
+		REQUIRE_FALSE(latencies.empty());
+		std::sort(latencies.begin(), latencies.end());
+		return latencies[latencies.size() * 99 / 100];
+	}
+}
+
+TEST_CASE("DeficitRoundRobin serves every flow up to its quantum per round") {
+	DeficitRoundRobin<size_t> scheduler{ 4, 1000 };
+	Simulation sim{ 3 };
+	sim.send(scheduler, 0, 10);
+	sim.send(scheduler, 1, 2);
+	sim.send(scheduler, 2, 10);
+
+	std::vector<size_t> order{};
+	scheduler.run([&](size_t key, size_t max_count) {
+		const size_t count = std::min(max_count, sim.flows[key].messages.size());
+		sim.flows[key].messages.erase(sim.flows[key].messages.begin(), sim.flows[key].messages.begin() + count);
+		order.insert(order.end(), count, key);
+		return count;
+	});
+	REQUIRE(order == std::vector<size_t>{ 0, 0, 0, 0, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 2, 2, 2, 2, 0, 0, 2, 2 });
+	REQUIRE_FALSE(scheduler.has_backlog());
+	// idle flows don't bank credit
+	REQUIRE(scheduler.deficit(0) == 0);
+	REQUIRE(scheduler.deficit(1) == 0);
+}
+
+TEST_CASE("DeficitRoundRobin shares the tick budget evenly between busy flows over time") {
+	DeficitRoundRobin<size_t> scheduler{ 8, 100 };
+	Simulation sim{ 7 };
+	for (size_t flow = 0; flow < sim.flows.size(); ++flow) {
+		sim.send(scheduler, flow, 100000);
+	}
+
+	// 7 flows x 8 doesn't divide the budget, so every tick cuts a flow short
+	for (size_t tick = 0; tick < 700; ++tick) {
+		REQUIRE(sim.tick(scheduler) == 100);
+		REQUIRE(scheduler.has_backlog());
+	}
+	for (const Flow& flow : sim.flows) {
+		INFO("served " << flow.served);
+		REQUIRE(flow.served >= 10000 - 8);
+		REQUIRE(flow.served <= 10000 + 8);
+	}
+}
+
+TEST_CASE("DeficitRoundRobin drops flows that run out of work") {
+	DeficitRoundRobin<std::string> scheduler{ 4, 6 };
+	scheduler.activate("alice");
+	scheduler.activate("bob");
+	scheduler.run([](const std::string&, size_t max_count) { return max_count; });
+	REQUIRE(scheduler.has_backlog());
+	REQUIRE(scheduler.deficit("bob") == 2);
+
+	// the next tick starts after bob, who was cut short
+	std::vector<std::string> order{};
+	scheduler.run([&order](const std::string& flow, size_t) {
+		order.push_back(flow);
+		return size_t{ 0 };
+	});
+	REQUIRE(order == std::vector<std::string>{ "alice", "bob" });
+	REQUIRE_FALSE(scheduler.has_backlog());
+	REQUIRE(scheduler.size() == 0);
+	REQUIRE(scheduler.deficit("bob") == 0);
+}
+
+TEST_CASE("DeficitRoundRobin only serves flows with work waiting") {
+	DeficitRoundRobin<size_t> scheduler{ 4, 100 };
+	Simulation sim{ 10000 };
+	sim.send(scheduler, 17, 6);
+	sim.send(scheduler, 9001, 3);
+
+	std::vector<size_t> served{};
+	scheduler.run([&](size_t key, size_t max_count) {
+		served.push_back(key);
+		const size_t count = std::min(max_count, sim.flows[key].messages.size());
+		sim.flows[key].messages.erase(sim.flows[key].messages.begin(), sim.flows[key].messages.begin() + count);
+		return count;
+	});
+	REQUIRE(served == std::vector<size_t>{ 17, 9001, 17 });
+	REQUIRE_FALSE(scheduler.has_backlog());
+	REQUIRE(scheduler.run([](size_t, size_t) -> size_t { FAIL("No flow is active"); return 0; }) == 0);
+}
+
+TEST_CASE("DeficitRoundRobin bounds the latency a flooding client adds to a quiet one") {
+	constexpr size_t QUANTUM = 32;
+	constexpr size_t TICK_BUDGET = 2048;
+	constexpr size_t TICKS = 2000;
+
+	// quiet clients send a message now and then, at the start of a tick
+	const auto run = [](size_t flooders) {
+		DeficitRoundRobin<size_t> scheduler{ QUANTUM, TICK_BUDGET };
+		Simulation sim{ flooders + 4 };
+		for (size_t tick = 0; tick < TICKS; ++tick) {
+			for (size_t flooder = 0; flooder < flooders; ++flooder) {
+				sim.send(scheduler, flooder, TICK_BUDGET * 4);
+			}
+			for (size_t quiet = flooders; quiet < sim.flows.size(); ++quiet) {
+				if ((tick + quiet) % 3 == 0) {
+					sim.send(scheduler, quiet, 1 + tick % 2);
+				}
+			}
+			sim.tick(scheduler);
+		}
+		std::vector<size_t> latencies{};
+		for (size_t quiet = flooders; quiet < sim.flows.size(); ++quiet) {
+			REQUIRE(sim.flows[quiet].messages.empty());
+			latencies.insert(latencies.end(), sim.flows[quiet].latencies.begin(), sim.flows[quiet].latencies.end());
+		}
+		return p99(latencies);
+	};
+
+	const size_t baseline = run(0);
+	for (const size_t flooders : { 1, 3 }) {
+		// each flooder can get at most one quantum ahead of a quiet client, however much it sends
+		const size_t flooded = run(flooders);
+		INFO(flooders << " flooder(s): p99 " << flooded << " vs " << baseline << " units of work");
+		REQUIRE(flooded <= baseline + flooders * QUANTUM);
+	}
+}
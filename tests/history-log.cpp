@@ -0,0 +1,166 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <catch.hpp>
+#include "tavernmx/history-log.h"
+
+using namespace tavernmx::rooms;
+
+namespace
+{
+	/// Directory under the system temp directory, removed on destruction.
+	class TempDirectory
+	{
+	public:
+		TempDirectory()
+			: path{ std::filesystem::temp_directory_path() / ("tavernmx-history-" + std::to_string(std::random_device{}())) } {
+			std::filesystem::remove_all(this->path);
+		}
+
+		~TempDirectory() {
+			std::error_code error{};
+			std::filesystem::remove_all(this->path, error);
+		}
+
+		std::filesystem::path path{};
+	};
+
+	RoomEvent make_event(int64_t timestamp, size_t i) {
+		return RoomEvent{ .timestamp = EventTimeStamp{ std::chrono::seconds{ timestamp } },
+			.origin_user_name = "user" + std::to_string(i % 7),
+			.event_text = "chat line " + std::to_string(i) };
+	}
+
+	/// Collects the newest \p count events of \p log, oldest first.
+	std::vector<RoomEvent> read_last(const RoomHistoryLog& log, size_t count) {
+		std::vector<RoomEvent> events{};
+		log.read_last(count, [&events](RoomEvent event) { events.push_back(std::move(event)); });
+		return events;
+	}
+
+	/// Writes \p count events to a new log in \p directory, syncing in batches as the writer would.
+	void fill_log(const std::filesystem::path& directory, size_t count) {
+		RoomHistoryLog log{ directory };
+		for (size_t i = 0; i < count; ++i) {
+			log.append(make_event(static_cast<int64_t>(i), i));
+			if (i % 10000 == 9999) {
+				log.sync();
+			}
+		}
+		log.sync();
+	}
+}
+
+TEST_CASE("RoomHistoryLog: synced events survive reopening") {
+	const TempDirectory temp{};
+	{
+		RoomHistoryLog log{ temp.path };
+		REQUIRE(log.event_count() == 0);
+		REQUIRE(read_last(log, 10).empty());
+		for (size_t i = 0; i < 5; ++i) {
+			log.append(make_event(1000, i));
+		}
+		// not readable until synced
+		REQUIRE(read_last(log, 10).empty());
+		log.sync();
+		REQUIRE(log.event_count() == 5);
+	}
+
+	const RoomHistoryLog log{ temp.path };
+	REQUIRE(log.event_count() == 5);
+	const std::vector<RoomEvent> events = read_last(log, 3);
+	REQUIRE(events.size() == 3);
+	REQUIRE(events.front().event_text == "chat line 2");
+	REQUIRE(events.back().event_text == "chat line 4");
+	REQUIRE(events.back().origin_user_name == "user4");
+	REQUIRE(events.back().timestamp.time_since_epoch().count() == 1000);
+}
+
+TEST_CASE("RoomHistoryLog: a partially written event is truncated on open") {
+	const TempDirectory temp{};
+	{
+		RoomHistoryLog log{ temp.path };
+		for (size_t i = 0; i < 3; ++i) {
+			log.append(make_event(1000, i));
+		}
+		log.sync();
+	}
+	// simulate a crash partway through writing the next event
+	std::ofstream{ temp.path / "00000000000000000000.log", std::ios::binary | std::ios::app } << "\x20\0\0\0torn";
+
+	{
+		RoomHistoryLog log{ temp.path };
+		REQUIRE(log.event_count() == 3);
+		log.append(make_event(1001, 3));
+		log.sync();
+	}
+	const RoomHistoryLog log{ temp.path };
+	REQUIRE(log.event_count() == 4);
+	const std::vector<RoomEvent> events = read_last(log, 10);
+	REQUIRE(events.size() == 4);
+	REQUIRE(events.back().event_text == "chat line 3");
+}
+
+TEST_CASE("RoomHistoryLog: segments roll over and reads span them") {
+	const TempDirectory temp{};
+	{
+		RoomHistoryLog log{ temp.path, 4096 };
+		for (size_t i = 0; i < 1000; ++i) {
+			log.append(make_event(static_cast<int64_t>(i), i));
+			if (i % 100 == 99) {
+				log.sync();
+			}
+		}
+		REQUIRE(log.segment_count() > 1);
+	}
+
+	const RoomHistoryLog log{ temp.path, 4096 };
+	REQUIRE(log.event_count() == 1000);
+	const std::vector<RoomEvent> events = read_last(log, 500);
+	REQUIRE(events.size() == 500);
+	REQUIRE(events.front().event_text == "chat line 500");
+	REQUIRE(events.back().event_text == "chat line 999");
+
+	std::vector<RoomEvent> since{};
+	REQUIRE(log.read_since(EventTimeStamp{ std::chrono::seconds{ 990 } },
+		[&since](RoomEvent event) { since.push_back(std::move(event)); }) == 10);
+	REQUIRE(since.front().event_text == "chat line 990");
+	REQUIRE(log.read_since(EventTimeStamp{ std::chrono::seconds{ 0 } }, [](RoomEvent) {}) == 1000);
+}
+
+TEST_CASE("HistoryLogWriter: events are synced in batches") {
+	const TempDirectory temp{};
+	HistoryLogWriter writer{ temp.path };
+	const std::shared_ptr<RoomHistoryLog> log = writer.open("general");
+	for (size_t i = 0; i < 100; ++i) {
+		writer.append(log, make_event(1000, i));
+	}
+	writer.flush();
+	REQUIRE(writer.batch_count() >= 1);
+	REQUIRE(writer.batch_count() <= 100);
+	REQUIRE(read_last(*log, 1000).size() == 100);
+	REQUIRE(writer.room_names() == std::vector<std::string>{ "general" });
+
+	log->remove();
+	REQUIRE(writer.room_names().empty());
+}
+
+TEST_CASE("RoomHistoryLog recovery benchmarks", "[!benchmark]") {
+	const TempDirectory small{};
+	const TempDirectory large{};
+	fill_log(small.path, 10000);
+	fill_log(large.path, 1000000);
+
+	BENCHMARK("Open and read newest 1000 of 10k events") {
+		const RoomHistoryLog log{ small.path };
+		return log.read_last(1000, [](RoomEvent) {});
+	};
+
+	BENCHMARK("Open and read newest 1000 of 1M events") {
+		const RoomHistoryLog log{ large.path };
+		return log.read_last(1000, [](RoomEvent) {});
+	};
+}
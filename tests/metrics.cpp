@@ -0,0 +1,131 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <catch.hpp>
+#include "tavernmx/metrics.h"
+
+using namespace std::chrono_literals;
+using tavernmx::metrics::Counter;
+using tavernmx::metrics::Histogram;
+using tavernmx::metrics::HistogramSnapshot;
+using tavernmx::metrics::HistogramUnit;
+using tavernmx::metrics::MetricsRegistry;
+
+TEST_CASE("Counter adds up increments from many threads") {
+	Counter counter{};
+	std::vector<std::thread> threads{};
+	for (int32_t t = 0; t < 12; ++t) {
+		threads.emplace_back([&counter]() {
+			for (int32_t i = 0; i < 10000; ++i) {
+				counter.add();
+			}
+			counter.add(5);
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	REQUIRE(counter.value() == 12 * 10005);
+}
+
+TEST_CASE("Histogram buckets are contiguous and within 1/16 of their values") {
+	REQUIRE(Histogram::bucket_index(0) == 0);
+	REQUIRE(Histogram::bucket_index(15) == 15);
+	REQUIRE(Histogram::bucket_index(Histogram::MAX_VALUE) == Histogram::BUCKET_COUNT - 1);
+	REQUIRE(Histogram::bucket_index(UINT64_MAX) == Histogram::BUCKET_COUNT - 1);
+	for (size_t index = 0; index < Histogram::BUCKET_COUNT; ++index) {
+		const uint64_t upper = Histogram::bucket_upper_bound(index);
+		const uint64_t lower = index == 0 ? 0 : Histogram::bucket_upper_bound(index - 1) + 1;
+		REQUIRE(Histogram::bucket_index(lower) == index);
+		REQUIRE(Histogram::bucket_index(upper) == index);
+		REQUIRE(upper - lower <= lower / Histogram::SUB_BUCKETS);
+	}
+}
+
+TEST_CASE("Histogram snapshot reports quantiles") {
+	Histogram histogram{};
+	REQUIRE(histogram.snapshot().value_at_quantile(0.5) == 0);
+	for (uint64_t value = 1; value <= 1000; ++value) {
+		histogram.record(value);
+	}
+	histogram.record(-5ms);
+	const HistogramSnapshot snapshot = histogram.snapshot();
+	REQUIRE(snapshot.count == 1001);
+	REQUIRE(snapshot.sum == 500500);
+
+	const auto within = [](uint64_t actual, uint64_t expected) {
+		return actual >= expected && actual <= expected + expected / Histogram::SUB_BUCKETS;
+	};
+	REQUIRE(within(snapshot.value_at_quantile(0.5), 500));
+	REQUIRE(within(snapshot.value_at_quantile(0.99), 990));
+	REQUIRE(within(snapshot.value_at_quantile(1.0), 1000));
+	REQUIRE(snapshot.value_at_quantile(0.0) == 0);
+	REQUIRE(snapshot.count_at_or_below(15) == 16);
+	REQUIRE(snapshot.count_at_or_below(UINT64_MAX) == 1001);
+}
+
+TEST_CASE("MetricsRegistry registers each metric once") {
+	MetricsRegistry registry{};
+	Counter& sent = registry.counter("sent_total", "Messages sent", { { "type", "CHAT" } });
+	REQUIRE(&registry.counter("sent_total", "ignored", { { "type", "CHAT" } }) == &sent);
+	REQUIRE(&registry.counter("sent_total", "Messages sent", { { "type", "ACK" } }) != &sent);
+	REQUIRE_THROWS_AS(registry.gauge("sent_total", "Messages sent"), std::invalid_argument);
+	registry.histogram("wait_seconds", "Wait", HistogramUnit::Nanoseconds);
+	REQUIRE_THROWS_AS(registry.histogram("wait_seconds", "Wait", HistogramUnit::Count), std::invalid_argument);
+}
+
+TEST_CASE("MetricsRegistry renders Prometheus text") {
+	MetricsRegistry registry{};
+	registry.counter("sent_total", "Messages sent", { { "type", "say \"hi\"" } }).add(3);
+	registry.gauge("connections", "Open connections").set(-2);
+	Histogram& wait = registry.histogram("wait_seconds", "Wait", HistogramUnit::Nanoseconds, { { "step", "a" } });
+	wait.record(1500us);
+	wait.record(3s);
+	registry.histogram("fanout", "Fan-out", HistogramUnit::Count).record(7);
+
+	const std::string text = registry.to_prometheus();
+	REQUIRE(text.find("# HELP sent_total Messages sent\n# TYPE sent_total counter\n") != std::string::npos);
+	REQUIRE(text.find("sent_total{type=\"say \\\"hi\\\"\"} 3\n") != std::string::npos);
+	REQUIRE(text.find("# TYPE connections gauge\nconnections -2\n") != std::string::npos);
+	REQUIRE(text.find("# TYPE wait_seconds histogram\n") != std::string::npos);
+	REQUIRE(text.find("wait_seconds_bucket{step=\"a\",le=\"0.001\"} 0\n") != std::string::npos);
+	REQUIRE(text.find("wait_seconds_bucket{step=\"a\",le=\"0.002\"} 1\n") != std::string::npos);
+	REQUIRE(text.find("wait_seconds_bucket{step=\"a\",le=\"5\"} 2\n") != std::string::npos);
+	REQUIRE(text.find("wait_seconds_bucket{step=\"a\",le=\"+Inf\"} 2\n") != std::string::npos);
+	REQUIRE(text.find("wait_seconds_sum{step=\"a\"} 3.0015\n") != std::string::npos);
+	REQUIRE(text.find("wait_seconds_count{step=\"a\"} 2\n") != std::string::npos);
+	REQUIRE(text.find("fanout_bucket{le=\"5\"} 0\nfanout_bucket{le=\"10\"} 1\n") != std::string::npos);
+
+	// only metrics that recorded anything are summarized
+	registry.counter("idle_total", "Never counted");
+	const std::vector<std::string> summary = registry.summarize();
+	REQUIRE(summary.size() == 4);
+	REQUIRE(summary[0] == "sent_total{type=\"say \\\"hi\\\"\"} 3");
+	REQUIRE(summary[2].starts_with("wait_seconds{step=\"a\"} count 2 p50 1.5ms p99 3."));
+	REQUIRE(summary[3] == "fanout count 1 p50 7 p99 7 max 7");
+}
+
+TEST_CASE("Metrics benchmarks", "[!benchmark]") {
+	MetricsRegistry registry{};
+	Counter& counter = registry.counter("bench_total", "Benchmark");
+	Histogram& histogram = registry.histogram("bench_seconds", "Benchmark", HistogramUnit::Nanoseconds);
+
+	BENCHMARK("Counter add x1000") {
+		for (int32_t i = 0; i < 1000; ++i) {
+			counter.add();
+		}
+		return counter.value();
+	};
+
+	BENCHMARK("Histogram record x1000") {
+		for (uint64_t i = 0; i < 1000; ++i) {
+			histogram.record(i * 7919);
+		}
+	};
+
+	BENCHMARK("MetricsRegistry to_prometheus") {
+		return registry.to_prometheus();
+	};
+}
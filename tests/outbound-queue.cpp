@@ -0,0 +1,217 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <catch.hpp>
+#include "tavernmx/outbound-queue.h"
+
+using namespace tavernmx::messaging;
+using tavernmx::OutboundLimits;
+using tavernmx::OutboundQueue;
+using tavernmx::SlowConsumerPolicy;
+using PushResult = OutboundQueue::PushResult;
+
+namespace
+{
+	Frame make_echo(int32_t i) {
+		return make_frame(ChatEcho{ .room_name = "general",
+			.text = "line of chat number " + std::to_string(i),
+			.timestamp = 1700000000 + i,
+			.user_name = "test_user" });
+	}
+
+	/// Decodes the single message held by \p frame.
+	Message decode(const Frame& frame) {
+		MessageBlockDecoder decoder{};
+		decoder.feed(*frame);
+		const std::optional<MessageBlock> block = decoder.next();
+		REQUIRE(block.has_value());
+		std::vector<Message> messages = unpack_messages(block.value());
+		REQUIRE(messages.size() == 1);
+		return std::move(messages.front());
+	}
+
+	/// Pops everything left in \p queue, decoded.
+	std::vector<Message> pop_all(OutboundQueue& queue) {
+		std::vector<Message> messages{};
+		while (const std::optional<Frame> frame = queue.pop()) {
+			messages.push_back(decode(frame.value()));
+		}
+		return messages;
+	}
+
+	int32_t echo_number(const Message& message) {
+		REQUIRE(message.message_type == MessageType::CHAT_ECHO);
+		return message_value_or<int32_t>(message, "timestamp") - 1700000000;
+	}
+}
+
+TEST_CASE("OutboundQueue delivers everything in order while within its limits") {
+	OutboundQueue queue{ OutboundLimits{ .max_frames = 16 } };
+	REQUIRE(queue.empty());
+	for (int32_t i = 0; i < 8; ++i) {
+		REQUIRE(queue.push(make_echo(i), 1) == PushResult::Queued);
+	}
+	REQUIRE(queue.push(make_frame(create_ack())) == PushResult::Queued);
+	REQUIRE_FALSE(queue.empty());
+	REQUIRE(queue.stats().queued_frames == 9);
+	REQUIRE(queue.stats().queued_bytes > 0);
+
+	const std::vector<Message> messages = pop_all(queue);
+	REQUIRE(messages.size() == 9);
+	for (int32_t i = 0; i < 8; ++i) {
+		REQUIRE(echo_number(messages[i]) == i);
+	}
+	REQUIRE(messages[8].message_type == MessageType::ACK);
+	REQUIRE(queue.empty());
+	REQUIRE(queue.stats().queued_frames == 0);
+	REQUIRE(queue.stats().queued_bytes == 0);
+	REQUIRE(queue.stats().dropped_events == 0);
+}
+
+TEST_CASE("OutboundQueue drops the oldest echoes under DropOldest") {
+	OutboundQueue queue{ OutboundLimits{ .max_frames = 4, .policy = SlowConsumerPolicy::DropOldest } };
+	REQUIRE(queue.push(make_frame(create_ack())) == PushResult::Queued);
+	for (int32_t i = 0; i < 7; ++i) {
+		REQUIRE(queue.push(make_echo(i), 2) == PushResult::Queued);
+	}
+	queue.trim();
+	REQUIRE(queue.stats().queued_frames == 4);
+	REQUIRE(queue.stats().dropped_events == 8);
+
+	// the client is told what it missed first, and the control frame is never dropped
+	const std::vector<Message> messages = pop_all(queue);
+	REQUIRE(messages.size() == 5);
+	REQUIRE(messages[0].message_type == MessageType::CHAT_MISSED);
+	REQUIRE(message_value_or<int32_t>(messages[0], "event_count") == 8);
+	REQUIRE(messages[1].message_type == MessageType::ACK);
+	REQUIRE(echo_number(messages[2]) == 4);
+	REQUIRE(echo_number(messages[3]) == 5);
+	REQUIRE(echo_number(messages[4]) == 6);
+	REQUIRE(queue.empty());
+}
+
+TEST_CASE("OutboundQueue stops queueing echoes under Degrade until drained to half") {
+	OutboundQueue queue{ OutboundLimits{ .max_frames = 4, .policy = SlowConsumerPolicy::Degrade } };
+	for (int32_t i = 0; i < 4; ++i) {
+		REQUIRE(queue.push(make_echo(i), 1) == PushResult::Queued);
+	}
+	REQUIRE(queue.push(make_echo(4), 1) == PushResult::Dropped);
+	REQUIRE(queue.stats().degraded);
+	REQUIRE(queue.push(make_frame(create_ack())) == PushResult::Queued);
+	for (int32_t i = 5; i < 10; ++i) {
+		REQUIRE(queue.push(make_echo(i), 1) == PushResult::Dropped);
+	}
+
+	// queued echoes drain first; the marker goes out once the queue is down to half its limit
+	REQUIRE(echo_number(decode(queue.pop().value())) == 0);
+	REQUIRE(echo_number(decode(queue.pop().value())) == 1);
+	REQUIRE(queue.stats().degraded);
+	REQUIRE(echo_number(decode(queue.pop().value())) == 2);
+	const Message missed = decode(queue.pop().value());
+	REQUIRE(missed.message_type == MessageType::CHAT_MISSED);
+	REQUIRE(message_value_or<int32_t>(missed, "event_count") == 6);
+	REQUIRE_FALSE(queue.stats().degraded);
+
+	REQUIRE(queue.push(make_echo(10), 1) == PushResult::Queued);
+	const std::vector<Message> messages = pop_all(queue);
+	REQUIRE(messages.size() == 3);
+	REQUIRE(echo_number(messages[0]) == 3);
+	REQUIRE(messages[1].message_type == MessageType::ACK);
+	REQUIRE(echo_number(messages[2]) == 10);
+	REQUIRE(queue.stats().dropped_events == 6);
+}
+
+TEST_CASE("OutboundQueue overflows under Disconnect") {
+	OutboundQueue queue{ OutboundLimits{ .max_frames = 4, .policy = SlowConsumerPolicy::Disconnect } };
+	for (int32_t i = 0; i < 4; ++i) {
+		REQUIRE(queue.push(make_echo(i), 1) == PushResult::Queued);
+	}
+	REQUIRE_FALSE(queue.stats().overflowed);
+	REQUIRE(queue.push(make_echo(4), 1) == PushResult::Overflowed);
+	REQUIRE(queue.stats().overflowed);
+	// nothing more is accepted, even once the queue drains
+	pop_all(queue);
+	REQUIRE(queue.push(make_frame(create_ack())) == PushResult::Overflowed);
+	REQUIRE(queue.stats().queued_frames == 0);
+}
+
+TEST_CASE("OutboundQueue never holds more than twice its limits") {
+	const Frame echo = make_echo(0);
+	const size_t max_bytes = echo->size() * 10;
+
+	SECTION("Frames") {
+		OutboundQueue queue{ OutboundLimits{ .max_frames = 4 } };
+		// the consumer is stuck, so nothing is trimmed: newer echoes are dropped on arrival instead
+		for (size_t i = 0; i < 1000; ++i) {
+			queue.push(echo, 1);
+			REQUIRE(queue.stats().queued_frames <= 8);
+		}
+		REQUIRE(queue.stats().dropped_events == 992);
+		REQUIRE(queue.push(make_frame(create_ack())) == PushResult::Overflowed);
+		REQUIRE(queue.stats().overflowed);
+	}
+
+	SECTION("Bytes") {
+		OutboundQueue queue{ OutboundLimits{ .max_bytes = max_bytes, .max_frames = 1000000 } };
+		for (size_t i = 0; i < 1000; ++i) {
+			queue.push(echo, 1);
+			REQUIRE(queue.stats().queued_bytes <= max_bytes * 2);
+		}
+		queue.trim();
+		REQUIRE(queue.stats().queued_bytes <= max_bytes);
+	}
+}
+
+TEST_CASE("OutboundQueue accounts for every event with concurrent producers") {
+	constexpr size_t PRODUCERS = 4;
+	constexpr size_t FRAMES_PER_PRODUCER = 20000;
+	constexpr size_t MAX_FRAMES = 64;
+	OutboundQueue queue{ OutboundLimits{ .max_frames = MAX_FRAMES } };
+	const Frame echo = make_echo(0);
+
+	std::atomic<size_t> producers_done{ 0 };
+	std::vector<std::jthread> producers{};
+	for (size_t p = 0; p < PRODUCERS; ++p) {
+		producers.emplace_back([&queue, &echo, &producers_done] {
+			for (size_t i = 0; i < FRAMES_PER_PRODUCER; ++i) {
+				queue.push(echo, 1);
+			}
+			++producers_done;
+		});
+	}
+
+	// a consumer slower than its producers
+	uint64_t delivered = 0;
+	uint64_t missed = 0;
+	size_t deepest = 0;
+	for (bool done = false; !done;) {
+		done = producers_done == PRODUCERS;
+		while (const std::optional<Frame> frame = queue.pop()) {
+			if (frame.value() == echo) {
+				++delivered;
+			} else {
+				missed += static_cast<uint64_t>(message_value_or<int32_t>(decode(frame.value()), "event_count"));
+			}
+			deepest = std::max(deepest, queue.stats().queued_frames);
+			std::this_thread::yield();
+		}
+	}
+	REQUIRE(queue.empty());
+	REQUIRE(delivered + missed == PRODUCERS * FRAMES_PER_PRODUCER);
+	REQUIRE(missed == queue.stats().dropped_events);
+	REQUIRE(deepest <= MAX_FRAMES * 2);
+}
+
+TEST_CASE("OutboundQueue accepts a lone frame bigger than its limits") {
+	const Frame echo = make_echo(0);
+	for (const SlowConsumerPolicy policy :
+		 { SlowConsumerPolicy::DropOldest, SlowConsumerPolicy::Degrade, SlowConsumerPolicy::Disconnect }) {
+		OutboundQueue queue{ OutboundLimits{ .max_bytes = echo->size() / 2, .policy = policy } };
+		REQUIRE(queue.push(echo, 1) == PushResult::Queued);
+		queue.trim();
+		REQUIRE(queue.stats().queued_frames == 1);
+		REQUIRE(queue.pop().value() == echo);
+		REQUIRE(queue.push(echo, 1) == PushResult::Queued);
+		REQUIRE(queue.stats().dropped_events == 0);
+	}
+}
@@ -0,0 +1,412 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <catch.hpp>
+#include "tavernmx/platform.h"
+#include "tavernmx/queue.h"
+
+#if defined(TMX_LINUX)
+#include <poll.h>
+#endif
+
+using Catch::Matchers::RangeEquals;
+using tavernmx::MpscQueue;
+using tavernmx::QueueSignal;
+using tavernmx::SpscQueue;
+using tavernmx::ThreadSafeQueue;
+
+namespace
+{
+	/// Number of items each producer pushes in the contention tests.
+	constexpr int32_t ITEMS_PER_PRODUCER = 100000;
+
+	/// Pushes ITEMS_PER_PRODUCER items from each of \p producers threads and pops them all on this thread.
+	/// Returns the sum of everything popped.
+	template <typename Q>
+	int64_t produce_and_consume(Q& queue, int32_t producers) {
+		std::vector<std::jthread> threads{};
+		for (int32_t p = 0; p < producers; ++p) {
+			threads.emplace_back([&queue] {
+				for (int32_t i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+					queue.push(i);
+				}
+			});
+		}
+		int64_t sum = 0;
+		for (int64_t remaining = static_cast<int64_t>(producers) * ITEMS_PER_PRODUCER; remaining > 0;) {
+			if (std::optional<int32_t> item = queue.pop()) {
+				sum += *item;
+				--remaining;
+			}
+		}
+		return sum;
+	}
+
+	/// As produce_and_consume, but the consumer takes items in batches with drain_into().
+	template <typename Q>
+	int64_t produce_and_drain(Q& queue, int32_t producers) {
+		std::vector<std::jthread> threads{};
+		for (int32_t p = 0; p < producers; ++p) {
+			threads.emplace_back([&queue] {
+				for (int32_t i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+					queue.push(i);
+				}
+			});
+		}
+		int64_t sum = 0;
+		std::vector<int32_t> batch{};
+		for (int64_t remaining = static_cast<int64_t>(producers) * ITEMS_PER_PRODUCER; remaining > 0;) {
+			batch.clear();
+			remaining -= static_cast<int64_t>(queue.drain_into(batch));
+			for (const int32_t item : batch) {
+				sum += item;
+			}
+		}
+		return sum;
+	}
+
+	constexpr int64_t expected_sum(int32_t producers) {
+		return static_cast<int64_t>(producers) * ITEMS_PER_PRODUCER * (ITEMS_PER_PRODUCER - 1) / 2;
+	}
+
+	/// Move-only value whose move constructor throws once moves_left runs out (if it isn't negative).
+	struct FragileValue
+	{
+		static inline int32_t moves_left = -1;
+		int32_t value{};
+
+		explicit FragileValue(int32_t value) : value{ value } {}
+
+		FragileValue(FragileValue&& other) : value{ other.value } {
+			if (moves_left == 0) {
+				throw std::runtime_error{ "move failed" };
+			}
+			if (moves_left > 0) {
+				--moves_left;
+			}
+		}
+
+		FragileValue& operator=(FragileValue&&) = default;
+	};
+}
+
+TEMPLATE_TEST_CASE("Lock-free queues: ThreadSafeQueue interface", "", MpscQueue<std::string>,
+	SpscQueue<std::string>) {
+	TestType queue{};
+	REQUIRE(queue.empty());
+	REQUIRE(std::cmp_equal(queue.size(), 0));
+	REQUIRE_FALSE(queue.pop().has_value());
+
+	queue.push("one");
+	const std::string two{ "two" };
+	queue.push(two);
+	queue.emplace(3, 'x');
+	REQUIRE_FALSE(queue.empty());
+	REQUIRE(std::cmp_equal(queue.size(), 3));
+	REQUIRE(queue.front() == "one");
+
+	REQUIRE(queue.pop() == "one");
+	REQUIRE(queue.pop() == "two");
+	REQUIRE(queue.pop() == "xxx");
+	REQUIRE(queue.empty());
+	REQUIRE_FALSE(queue.pop().has_value());
+
+	// nodes handed back by the consumer are reused without disturbing order
+	for (int32_t round = 0; round < 3; ++round) {
+		for (int32_t i = 0; i < 10; ++i) {
+			queue.push(std::to_string(i));
+		}
+		for (int32_t i = 0; i < 10; ++i) {
+			REQUIRE(queue.pop() == std::to_string(i));
+		}
+	}
+	REQUIRE(queue.empty());
+}
+
+TEMPLATE_TEST_CASE("Queues: batched production and consumption", "", ThreadSafeQueue<int32_t>, MpscQueue<int32_t>,
+	SpscQueue<int32_t>) {
+	TestType queue{};
+	std::vector<int32_t> batch{ -1 };
+	REQUIRE(std::cmp_equal(queue.drain_into(batch), 0));
+	const std::vector<int32_t> values{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+	queue.push_range(std::cbegin(values), std::cbegin(values));
+	REQUIRE(queue.empty());
+	queue.push_range(std::cbegin(values), std::cend(values));
+	REQUIRE(std::cmp_equal(queue.drain_into(batch, 4), 4));
+	REQUIRE_THAT(batch, RangeEquals(std::vector<int32_t>{ -1, 0, 1, 2, 3 }));
+	REQUIRE(std::cmp_equal(queue.size(), 6));
+	REQUIRE(queue.pop() == 4);
+	batch.clear();
+	REQUIRE(std::cmp_equal(queue.drain_into(batch), 5));
+	REQUIRE_THAT(batch, RangeEquals(std::vector<int32_t>{ 5, 6, 7, 8, 9 }));
+	REQUIRE(queue.empty());
+}
+
+TEMPLATE_TEST_CASE("Lock-free queues: drain_into leaves the queue intact if the output throws", "",
+	MpscQueue<FragileValue>, SpscQueue<FragileValue>) {
+	TestType queue{};
+	for (int32_t i = 0; i < 5; ++i) {
+		queue.emplace(i);
+	}
+	std::vector<FragileValue> batch{};
+	batch.reserve(5);
+	FragileValue::moves_left = 2;
+	REQUIRE_THROWS_AS(queue.drain_into(batch), std::runtime_error);
+	FragileValue::moves_left = -1;
+	REQUIRE(std::cmp_equal(batch.size(), 2));
+	REQUIRE(std::cmp_equal(queue.size(), 3));
+	REQUIRE(queue.pop()->value == 2);
+	batch.clear();
+	REQUIRE(std::cmp_equal(queue.drain_into(batch), 2));
+	REQUIRE(batch[0].value == 3);
+	REQUIRE(batch[1].value == 4);
+	REQUIRE(queue.empty());
+}
+
+TEST_CASE("ThreadSafeQueue: swap_all takes everything") {
+	ThreadSafeQueue<std::string> queue{};
+	std::vector<std::string> values{ "a", "b", "c" };
+	queue.push_range(std::make_move_iterator(std::begin(values)), std::make_move_iterator(std::end(values)));
+	std::queue<std::string> taken = queue.swap_all();
+	REQUIRE(queue.empty());
+	REQUIRE(std::cmp_equal(taken.size(), 3));
+	REQUIRE(taken.front() == "a");
+	REQUIRE(taken.back() == "c");
+	REQUIRE(queue.swap_all().empty());
+}
+
+TEST_CASE("MpscQueue: push_range is not interleaved with other producers") {
+	constexpr int32_t PRODUCERS = 4;
+	constexpr int32_t BATCHES = 1000;
+	constexpr int32_t BATCH_SIZE = 8;
+	MpscQueue<int32_t> queue{};
+	{
+		std::vector<std::jthread> threads{};
+		for (int32_t p = 0; p < PRODUCERS; ++p) {
+			threads.emplace_back([&queue, p] {
+				std::vector<int32_t> batch(BATCH_SIZE, p);
+				for (int32_t i = 0; i < BATCHES; ++i) {
+					queue.push_range(std::cbegin(batch), std::cend(batch));
+				}
+			});
+		}
+	}
+	std::vector<int32_t> all{};
+	REQUIRE(std::cmp_equal(queue.drain_into(all), PRODUCERS * BATCHES * BATCH_SIZE));
+	size_t split_batches = 0;
+	for (size_t i = 0; i < all.size(); i += BATCH_SIZE) {
+		split_batches += std::count(std::cbegin(all) + i, std::cbegin(all) + i + BATCH_SIZE, all[i]) != BATCH_SIZE;
+	}
+	REQUIRE(split_batches == 0);
+}
+
+TEST_CASE("MpscQueue: unconsumed elements are destroyed with the queue") {
+	const std::shared_ptr<int32_t> item = std::make_shared<int32_t>(1);
+	{
+		MpscQueue<std::shared_ptr<int32_t>> mpsc{};
+		SpscQueue<std::shared_ptr<int32_t>> spsc{};
+		mpsc.push(item);
+		mpsc.push(item);
+		spsc.push(item);
+		REQUIRE(item.use_count() == 4);
+	}
+	REQUIRE(item.use_count() == 1);
+}
+
+TEST_CASE("MpscQueue: concurrent producers") {
+	constexpr int32_t PRODUCERS = 4;
+	MpscQueue<int32_t> queue{};
+	REQUIRE(produce_and_consume(queue, PRODUCERS) == expected_sum(PRODUCERS));
+	REQUIRE(queue.empty());
+	REQUIRE(produce_and_drain(queue, PRODUCERS) == expected_sum(PRODUCERS));
+	REQUIRE(queue.empty());
+}
+
+TEST_CASE("SpscQueue: concurrent producer and consumer") {
+	SpscQueue<int32_t> queue{};
+	REQUIRE(produce_and_consume(queue, 1) == expected_sum(1));
+	REQUIRE(produce_and_drain(queue, 1) == expected_sum(1));
+	REQUIRE(queue.empty());
+}
+
+TEMPLATE_TEST_CASE("Queues: wait_pop", "", ThreadSafeQueue<int32_t>, MpscQueue<int32_t>, SpscQueue<int32_t>) {
+	TestType queue{};
+	SECTION("Times out when nothing is pushed") {
+		const auto start = std::chrono::steady_clock::now();
+		REQUIRE_FALSE(queue.wait_pop(std::chrono::milliseconds{ 20 }).has_value());
+		REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds{ 20 });
+	}
+
+	SECTION("Returns waiting elements immediately") {
+		queue.push(1);
+		REQUIRE(queue.wait_pop(std::chrono::milliseconds{ 0 }) == 1);
+	}
+
+	SECTION("Wakes as soon as another thread pushes") {
+		std::chrono::steady_clock::time_point pushed_at{};
+		std::jthread producer{ [&queue, &pushed_at] {
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 20 });
+			pushed_at = std::chrono::steady_clock::now();
+			queue.push(7);
+		} };
+		REQUIRE(queue.wait_pop(std::chrono::seconds{ 5 }) == 7);
+		REQUIRE(std::chrono::steady_clock::now() - pushed_at < std::chrono::seconds{ 1 });
+	}
+}
+
+TEST_CASE("Queues: wait_for_any over a shared signal") {
+	const std::shared_ptr<QueueSignal> signal = std::make_shared<QueueSignal>();
+	ThreadSafeQueue<std::string> names{ signal };
+	MpscQueue<int32_t> numbers{ signal };
+	REQUIRE_FALSE(tavernmx::wait_for_any(std::chrono::milliseconds{ 10 }, names, numbers));
+
+	std::jthread producer{ [&numbers] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 20 });
+		numbers.push(3);
+	} };
+	REQUIRE(tavernmx::wait_for_any(std::chrono::seconds{ 5 }, names, numbers));
+	REQUIRE(names.empty());
+	REQUIRE(numbers.pop() == 3);
+
+	// a push that nobody waited for is still reported to the next wait
+	names.push("late");
+	REQUIRE(signal->wait(std::chrono::milliseconds{ 0 }));
+	REQUIRE_FALSE(signal->try_acquire());
+}
+
+#if defined(TMX_LINUX)
+TEST_CASE("QueueSignal: event descriptor is readable while a notification is pending") {
+	const std::shared_ptr<QueueSignal> signal = std::make_shared<QueueSignal>();
+	SpscQueue<int32_t> queue{ signal };
+	queue.push(1);
+	REQUIRE(signal->enable_event_fd());
+	const auto readable = [&signal] {
+		pollfd fd{ .fd = signal->event_fd(), .events = POLLIN, .revents = 0 };
+		return poll(&fd, 1, 0) == 1;
+	};
+	REQUIRE(readable());
+	REQUIRE(signal->try_acquire());
+	REQUIRE_FALSE(readable());
+	REQUIRE(queue.pop() == 1);
+
+	queue.push(2);
+	queue.push(3);
+	REQUIRE(readable());
+	REQUIRE(signal->try_acquire());
+	REQUIRE_FALSE(readable());
+}
+#endif
+
+TEST_CASE("Queue wake-up latency benchmarks", "[!benchmark]") {
+	BENCHMARK("Push to wait_pop on another thread") {
+		SpscQueue<int32_t> queue{};
+		std::jthread producer{ [&queue] { queue.push(1); } };
+		return queue.wait_pop(std::chrono::seconds{ 1 });
+	};
+}
+
+TEST_CASE("Queue bulk operation benchmarks", "[!benchmark]") {
+	// Moving 10k items costs 10k lock round trips one at a time, and one in bulk.
+	constexpr int32_t ITEM_COUNT = 10000;
+	std::vector<int32_t> items(ITEM_COUNT);
+	std::iota(std::begin(items), std::end(items), 0);
+
+	BENCHMARK_ADVANCED("ThreadSafeQueue pop x10k")(Catch::Benchmark::Chronometer meter) {
+		std::vector<ThreadSafeQueue<int32_t>> queues(meter.runs());
+		for (ThreadSafeQueue<int32_t>& queue : queues) {
+			queue.push_range(std::cbegin(items), std::cend(items));
+		}
+		meter.measure([&queues](int32_t run) {
+			int64_t sum = 0;
+			while (std::optional<int32_t> item = queues[run].pop()) {
+				sum += *item;
+			}
+			return sum;
+		});
+	};
+
+	BENCHMARK_ADVANCED("ThreadSafeQueue drain_into x10k")(Catch::Benchmark::Chronometer meter) {
+		std::vector<ThreadSafeQueue<int32_t>> queues(meter.runs());
+		for (ThreadSafeQueue<int32_t>& queue : queues) {
+			queue.push_range(std::cbegin(items), std::cend(items));
+		}
+		meter.measure([&queues](int32_t run) {
+			std::vector<int32_t> drained{};
+			queues[run].drain_into(drained);
+			return drained.size();
+		});
+	};
+
+	BENCHMARK_ADVANCED("ThreadSafeQueue swap_all x10k")(Catch::Benchmark::Chronometer meter) {
+		std::vector<ThreadSafeQueue<int32_t>> queues(meter.runs());
+		for (ThreadSafeQueue<int32_t>& queue : queues) {
+			queue.push_range(std::cbegin(items), std::cend(items));
+		}
+		meter.measure([&queues](int32_t run) { return queues[run].swap_all().size(); });
+	};
+
+	BENCHMARK("ThreadSafeQueue push x10k") {
+		ThreadSafeQueue<int32_t> queue{};
+		for (const int32_t item : items) {
+			queue.push(item);
+		}
+		return queue.size();
+	};
+
+	BENCHMARK("ThreadSafeQueue push_range x10k") {
+		ThreadSafeQueue<int32_t> queue{};
+		queue.push_range(std::cbegin(items), std::cend(items));
+		return queue.size();
+	};
+
+	BENCHMARK("MpscQueue push x10k") {
+		MpscQueue<int32_t> queue{};
+		for (const int32_t item : items) {
+			queue.push(item);
+		}
+		return queue.size();
+	};
+
+	BENCHMARK("MpscQueue push_range x10k") {
+		MpscQueue<int32_t> queue{};
+		queue.push_range(std::cbegin(items), std::cend(items));
+		return queue.size();
+	};
+}
+
+TEST_CASE("Queue contention benchmarks", "[!benchmark]") {
+	for (const int32_t producers : { 1, 4 }) {
+		const std::string suffix = std::to_string(producers) + (producers == 1 ? " producer" : " producers");
+
+		BENCHMARK("ThreadSafeQueue pop, " + suffix) {
+			ThreadSafeQueue<int32_t> queue{};
+			return produce_and_consume(queue, producers);
+		};
+
+		BENCHMARK("MpscQueue pop, " + suffix) {
+			MpscQueue<int32_t> queue{};
+			return produce_and_consume(queue, producers);
+		};
+
+		BENCHMARK("MpscQueue drain_into, " + suffix) {
+			MpscQueue<int32_t> queue{};
+			return produce_and_drain(queue, producers);
+		};
+
+		if (producers == 1) {
+			BENCHMARK("SpscQueue pop, " + suffix) {
+				SpscQueue<int32_t> queue{};
+				return produce_and_consume(queue, producers);
+			};
+
+			BENCHMARK("SpscQueue drain_into, " + suffix) {
+				SpscQueue<int32_t> queue{};
+				return produce_and_drain(queue, producers);
+			};
+		}
+	}
+}
@@ -0,0 +1,94 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <chrono>
+#include <catch.hpp>
+#include "tavernmx/rate-limit.h"
+
+using namespace std::chrono_literals;
+using tavernmx::MessageRateLimiter;
+using tavernmx::MessageRateLimits;
+using tavernmx::RateLimit;
+using tavernmx::TokenBucket;
+using tavernmx::messaging::MessageType;
+
+namespace
+{
+	const std::chrono::steady_clock::time_point START = std::chrono::steady_clock::now();
+}
+
+TEST_CASE("TokenBucket allows a burst, then the sustained rate") {
+	TokenBucket bucket{ RateLimit{ .per_second = 10.0, .burst = 5.0 }, START };
+	for (int32_t i = 0; i < 5; ++i) {
+		REQUIRE(bucket.try_take(START) == 0ms);
+	}
+	REQUIRE(bucket.try_take(START) == 100ms);
+	REQUIRE(bucket.try_take(START + 40ms) == 60ms);
+	REQUIRE(bucket.try_take(START + 100ms) == 0ms);
+	REQUIRE(bucket.try_take(START + 100ms) == 100ms);
+
+	// a long quiet spell refills no more than the burst
+	const auto later = START + 1h;
+	for (int32_t i = 0; i < 5; ++i) {
+		REQUIRE(bucket.try_take(later) == 0ms);
+	}
+	REQUIRE(bucket.try_take(later) > 0ms);
+}
+
+TEST_CASE("TokenBucket holds a flooding sender to the sustained rate") {
+	TokenBucket bucket{ RateLimit{ .per_second = 20.0, .burst = 50.0 }, START };
+	size_t allowed = 0;
+	for (auto now = START; now < START + 10s; now += 1ms) {
+		allowed += bucket.try_take(now) == 0ms ? 1 : 0;
+	}
+	REQUIRE(allowed >= 50 + 200 - 1);
+	REQUIRE(allowed <= 50 + 200);
+}
+
+TEST_CASE("TokenBucket without a limit never runs out") {
+	TokenBucket unlimited{};
+	TokenBucket zero_rate{ RateLimit{ .per_second = 0.0, .burst = 1.0 }, START };
+	for (int32_t i = 0; i < 1000; ++i) {
+		REQUIRE(unlimited.try_take(START) == 0ms);
+		REQUIRE(zero_rate.try_take(START) == 0ms);
+	}
+}
+
+TEST_CASE("MessageRateLimiter limits each message type separately") {
+	MessageRateLimits limits{};
+	limits.set(MessageType::CHAT_SEND, RateLimit{ .per_second = 1.0, .burst = 2.0 });
+	limits.set(MessageType::ROOM_CREATE, RateLimit{ .per_second = 1.0, .burst = 1.0 });
+	// only message types that cost the server work can be limited
+	limits.set(MessageType::HEARTBEAT, RateLimit{ .per_second = 1.0, .burst = 1.0 });
+	REQUIRE_FALSE(limits.get(MessageType::HEARTBEAT).is_limited());
+	REQUIRE_FALSE(limits.get(MessageType::ROOM_LIST).is_limited());
+
+	MessageRateLimiter limiter{ limits, START };
+	REQUIRE(limiter.check(MessageType::CHAT_SEND, START) == 0ms);
+	REQUIRE(limiter.check(MessageType::CHAT_SEND, START) == 0ms);
+	REQUIRE(limiter.check(MessageType::CHAT_SEND, START) == 1000ms);
+	REQUIRE(limiter.check(MessageType::ROOM_CREATE, START) == 0ms);
+	REQUIRE(limiter.check(MessageType::ROOM_CREATE, START) == 1000ms);
+	for (int32_t i = 0; i < 100; ++i) {
+		REQUIRE(limiter.check(MessageType::HEARTBEAT, START) == 0ms);
+		REQUIRE(limiter.check(MessageType::ROOM_LIST, START) == 0ms);
+	}
+	REQUIRE(limiter.rejected_count() == 2);
+	REQUIRE(limiter.check(MessageType::CHAT_SEND, START + 500ms) == 500ms);
+	REQUIRE(limiter.check(MessageType::CHAT_SEND, START + 1s) == 0ms);
+	REQUIRE(limiter.rejected_count() == 3);
+}
+
+TEST_CASE("Rate limit benchmarks", "[!benchmark]") {
+	MessageRateLimits limits{};
+	limits.set(MessageType::CHAT_SEND, RateLimit{ .per_second = 1e9, .burst = 1e9 });
+	MessageRateLimiter limiter{ limits, START };
+	auto now = START;
+
+	BENCHMARK("MessageRateLimiter check x1000") {
+		size_t allowed = 0;
+		for (int32_t i = 0; i < 1000; ++i) {
+			now += 1us;
+			allowed += limiter.check(MessageType::CHAT_SEND, now) == 0ms ? 1 : 0;
+		}
+		return allowed;
+	};
+}
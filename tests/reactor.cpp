@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <catch.hpp>
+#include "tavernmx/platform.h"
+#include "tavernmx/reactor.h"
+#include "tavernmx/server-workers.h"
+#include "tls-loopback.h"
+
+#if defined(TMX_LINUX)
+#include <poll.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace tavernmx::messaging;
+using tavernmx::Reactor;
+using tavernmx::server::ClientConnection;
+using tavernmx::server::RoomHistoryDirectory;
+using tavernmx::testing::PeerConnection;
+
+namespace
+{
+	/// Number of idle connections held open by the M:N test.
+	constexpr size_t IDLE_CONNECTION_COUNT = 10000;
+
+	/// Reads a numeric field, such as "Threads" or "VmRSS", from /proc/self/status.
+	size_t process_status(const std::string& field) {
+		std::ifstream status{ "/proc/self/status" };
+		for (std::string line{}; std::getline(status, line);) {
+			if (line.starts_with(field + ":")) {
+				return std::stoul(line.substr(field.size() + 1));
+			}
+		}
+		return 0;
+	}
+
+	/// Raises the open file limit as far as allowed, returning the new soft limit.
+	size_t raise_file_limit() {
+		rlimit limit{};
+		getrlimit(RLIMIT_NOFILE, &limit);
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+		getrlimit(RLIMIT_NOFILE, &limit);
+		return static_cast<size_t>(limit.rlim_cur);
+	}
+
+	/// A fixed set of reactors, each run by one thread, as the server runs its client connections.
+	class ReactorThreads
+	{
+	public:
+		explicit ReactorThreads(size_t count) {
+			for (size_t i = 0; i < count; ++i) {
+				this->reactors.push_back(std::make_shared<Reactor>());
+			}
+			for (const std::shared_ptr<Reactor>& reactor : this->reactors) {
+				this->threads.emplace_back([this, reactor] {
+					while (this->running) {
+						reactor->run_once(100);
+					}
+				});
+			}
+		}
+
+		~ReactorThreads() {
+			this->running = false;
+			for (const std::shared_ptr<Reactor>& reactor : this->reactors) {
+				reactor->wake();
+			}
+		}
+
+		std::vector<std::shared_ptr<Reactor>> reactors{};
+
+	private:
+		std::atomic<bool> running{ true };
+		std::vector<std::jthread> threads{};
+	};
+}
+
+TEST_CASE("Reactor: 10k idle client connections share a fixed pool of threads") {
+	// each connection is a ClientConnection serviced as the server does, over TLS on a socket pair whose
+	// other end is played by the test
+	const size_t connection_count = std::min(IDLE_CONNECTION_COUNT, (raise_file_limit() - 64) / 2);
+	INFO("Open file limit allows " << connection_count << " connections");
+	REQUIRE(connection_count >= 1000);
+
+	const auto server_ctx = tavernmx::testing::make_server_context();
+	const auto client_ctx = tavernmx::testing::make_client_context();
+	SSL_CTX_set_num_tickets(server_ctx.get(), 0);
+	const auto room_histories = std::make_shared<RoomHistoryDirectory>();
+	const size_t pool_size = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 8);
+	std::vector<std::shared_ptr<ClientConnection>> connections{};
+	std::vector<PeerConnection> peers{};
+	connections.reserve(connection_count);
+	peers.reserve(connection_count);
+	{
+		ReactorThreads pool{ pool_size };
+		const size_t threads_before = process_status("Threads");
+		const size_t rss_before = process_status("VmRSS");
+
+		for (size_t i = 0; i < connection_count; ++i) {
+			tavernmx::testing::TlsPair pair = tavernmx::testing::make_tls_pair(server_ctx.get(), client_ctx.get());
+			connections.push_back(std::make_shared<ClientConnection>(std::move(pair.server),
+				pool.reactors[i % pool_size]));
+			tavernmx::server::client_worker(connections.back(), room_histories);
+			peers.emplace_back(std::move(pair.client));
+			peers.back().send_message(create_hello("user-" + std::to_string(i)));
+		}
+		for (PeerConnection& peer : peers) {
+			REQUIRE(peer.receive_until(MessageType::ACK));
+		}
+
+		size_t registered = 0;
+		for (const std::shared_ptr<Reactor>& reactor : pool.reactors) {
+			registered += reactor->size();
+		}
+		REQUIRE(registered == connection_count);
+
+		// connections cost no threads; their memory is mostly OpenSSL's record buffers, at both ends
+		const size_t threads_after = process_status("Threads");
+		const size_t bytes_per_connection = (process_status("VmRSS") - rss_before) * 1024 / connection_count;
+		WARN("Resident memory per client connection, both ends: " << bytes_per_connection << " bytes");
+		REQUIRE(threads_after == threads_before);
+		REQUIRE(bytes_per_connection < 128 * 1024);
+
+		// idle connections are sent nothing, and any of them still answers promptly once it has something to do
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 200 });
+		size_t woken = 0;
+		for (const PeerConnection& peer : peers) {
+			pollfd poll_fd{ .fd = peer.get_socket(), .events = POLLIN, .revents = 0 };
+			woken += poll(&poll_fd, 1, 0) > 0 ? 1 : 0;
+		}
+		REQUIRE(woken == 0);
+		for (size_t i = 0; i < connection_count; i += connection_count / 10) {
+			peers[i].send_message(create_heartbeat());
+			REQUIRE(peers[i].receive_until(MessageType::ACK));
+		}
+		// the reactors stop before the connections close, which they then do on this thread
+	}
+}
+
+TEST_CASE("Reactor: timers cut the wait short and run on the reactor thread") {
+	Reactor reactor{};
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<int32_t> fired{};
+	reactor.schedule(start + std::chrono::milliseconds{ 50 }, [&fired] { fired.push_back(50); });
+	const tavernmx::TimerId cancelled =
+		reactor.schedule(start + std::chrono::milliseconds{ 20 }, [&fired] { fired.push_back(20); });
+	reactor.schedule(start + std::chrono::milliseconds{ 30 }, [] { throw std::runtime_error{ "timer failed" }; });
+	REQUIRE(reactor.cancel_timer(cancelled));
+
+	// the throwing timer is logged and skipped; the wait ends when the next timer is due, not at the timeout
+	while (fired.empty()) {
+		reactor.run_once(5000);
+		REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds{ 2 });
+	}
+	REQUIRE(fired == std::vector<int32_t>{ 50 });
+	REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds{ 50 });
+	REQUIRE_FALSE(reactor.cancel_timer(cancelled));
+}
+#endif
@@ -1,11 +1,54 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
 #include <array>
+#include <numeric>
+#include <string>
 #include <utility>
+#include <vector>
 #include <catch.hpp>
 #include "tavernmx/ringbuffer.h"
 
 using Catch::Matchers::RangeEquals;
 using tavernmx::RingBuffer;
 
+namespace
+{
+	/// The previous RingBuffer layout (one heap allocation per element), kept as a benchmark baseline.
+	template <typename T, size_t Capacity>
+	class PointerRingBuffer
+	{
+	public:
+		void insert(T value) {
+			this->data[this->head] = std::make_unique<T>(std::move(value));
+			this->head = (this->head + 1) % Capacity;
+			if (this->tail == this->head) {
+				this->tail = (this->tail + 1) % Capacity;
+			}
+		}
+
+		template <typename F>
+		void for_each(F func) const {
+			for (size_t pos = this->tail; pos != this->head; pos = (pos + 1) % Capacity) {
+				func(*this->data[pos]);
+			}
+		}
+
+	private:
+		std::array<std::unique_ptr<T>, Capacity> data{};
+		size_t head{ 0 };
+		size_t tail{ 0 };
+	};
+
+	/// Same shape as a chat event: two strings and a timestamp.
+	struct BenchmarkEvent
+	{
+		std::string user_name{};
+		std::string text{};
+		int64_t timestamp{};
+	};
+
+	constexpr size_t BENCHMARK_CAPACITY = 1000;
+}
+
 TEST_CASE("RingBuffer: construct/capacity/empty/size check") {
 	RingBuffer<int32_t, 100> buffer{};
 	REQUIRE(buffer.empty());
@@ -136,3 +179,182 @@ TEST_CASE("RingBuffer: reverse iteration, wrapped") {
 		REQUIRE(--countdown == *it);
 	}
 }
+
+TEST_CASE("RingBuffer: insert_range keeps the newest elements") {
+	RingBuffer<int32_t, 10> buffer{};
+	std::vector<int32_t> values(25);
+	std::iota(std::begin(values), std::end(values), 0);
+
+	buffer.insert_range(std::cbegin(values), std::cbegin(values) + 3);
+	REQUIRE_THAT(buffer, RangeEquals(std::to_array<int32_t>({ 0, 1, 2 })));
+	buffer.insert_range(std::cbegin(values) + 3, std::cend(values));
+	REQUIRE(buffer.full());
+	REQUIRE_THAT(buffer, RangeEquals(std::to_array<int32_t>({ 16, 17, 18, 19, 20, 21, 22, 23, 24 })));
+
+	buffer.reset();
+	REQUIRE(buffer.empty());
+	REQUIRE(buffer.tail() == nullptr);
+	buffer.insert_range(std::cbegin(values), std::cend(values));
+	REQUIRE(std::cmp_equal(*buffer.tail(), 16));
+}
+
+TEST_CASE("RingBuffer: elements are constructed and destroyed in place") {
+	const std::shared_ptr<int32_t> counted = std::make_shared<int32_t>(0);
+	{
+		RingBuffer<std::shared_ptr<int32_t>, 4> buffer{};
+		for (int32_t i = 0; i < 10; ++i) {
+			buffer.insert(counted);
+		}
+		REQUIRE(counted.use_count() == 4);
+
+		RingBuffer<std::shared_ptr<int32_t>, 4> copied{ buffer };
+		REQUIRE(counted.use_count() == 7);
+		RingBuffer<std::shared_ptr<int32_t>, 4> moved{ std::move(copied) };
+		REQUIRE(counted.use_count() == 7);
+		REQUIRE(copied.empty());
+
+		buffer.insert(*buffer.tail());
+		REQUIRE(counted.use_count() == 7);
+		buffer.reset();
+		REQUIRE(counted.use_count() == 4);
+	}
+	REQUIRE(counted.use_count() == 1);
+}
+
+TEST_CASE("RingBuffer: copies keep their own elements") {
+	RingBuffer<std::string, 3> buffer{};
+	buffer.insert("a");
+	buffer.insert("b");
+	RingBuffer<std::string, 3> copied{};
+	copied = buffer;
+	buffer.insert("c");
+	REQUIRE_THAT(buffer, RangeEquals(std::vector<std::string>{ "b", "c" }));
+	REQUIRE_THAT(copied, RangeEquals(std::vector<std::string>{ "a", "b" }));
+}
+
+TEST_CASE("RingBuffer: random access, wrapped") {
+	static_assert(std::random_access_iterator<RingBuffer<int32_t, 10>::Iterator>);
+	RingBuffer<int32_t, 10> buffer{};
+	for (int32_t i = 0; std::cmp_less(i, 15); ++i) {
+		buffer.insert(i);
+	}
+	// { 10, 11, 12, 13, 14, 5, 6, 7, 8, 9 }
+	//                head^     ^tail
+	auto it = buffer.begin();
+	REQUIRE(std::cmp_equal(buffer.end() - it, 9));
+	REQUIRE(std::cmp_equal(it[4], 10));
+	REQUIRE(std::cmp_equal(*(it + 8), 14));
+	it += 6;
+	REQUIRE(std::cmp_equal(*it, 12));
+	REQUIRE(std::cmp_equal(*(it - 2), 10));
+	REQUIRE(it > buffer.begin());
+	REQUIRE(it < buffer.end());
+
+	// operator[] counts back from the head
+	REQUIRE(std::cmp_equal(buffer[0], 14));
+	REQUIRE(std::cmp_equal(buffer[4], 10));
+	REQUIRE(std::cmp_equal(buffer[8], 6));
+}
+
+TEST_CASE("RingBuffer: last() views the newest elements") {
+	// storage for 10 is rounded up to 16 slots, so the run wraps once enough elements go in
+	RingBuffer<int32_t, 10> buffer{};
+	REQUIRE(buffer.last(5).empty());
+	for (int32_t i = 0; std::cmp_less(i, 5); ++i) {
+		buffer.insert(i);
+	}
+	auto view = buffer.last(3);
+	REQUIRE(view.second.empty());
+	REQUIRE_THAT(view.first, RangeEquals(std::to_array<int32_t>({ 2, 3, 4 })));
+	REQUIRE(std::cmp_equal(buffer.last(100).size(), 5));
+
+	for (int32_t i = 5; std::cmp_less(i, 20); ++i) {
+		buffer.insert(i);
+	}
+	view = buffer.last(100);
+	REQUIRE(std::cmp_equal(view.size(), 9));
+	REQUIRE_FALSE(view.second.empty());
+	std::vector<int32_t> joined{ std::cbegin(view.first), std::cend(view.first) };
+	joined.insert(std::cend(joined), std::cbegin(view.second), std::cend(view.second));
+	REQUIRE_THAT(joined, RangeEquals(std::to_array<int32_t>({ 11, 12, 13, 14, 15, 16, 17, 18, 19 })));
+	for (size_t i = 0; i < view.size(); ++i) {
+		REQUIRE(std::cmp_equal(view[i], 11 + i));
+	}
+	REQUIRE_THAT(buffer, RangeEquals(joined));
+}
+
+TEST_CASE("RingBuffer benchmarks", "[!benchmark]") {
+	std::vector<BenchmarkEvent> events{};
+	for (size_t i = 0; i < BENCHMARK_CAPACITY * 2; ++i) {
+		events.push_back(BenchmarkEvent{ .user_name = "user" + std::to_string(i % 7),
+			.text = "chat line " + std::to_string(i),
+			.timestamp = static_cast<int64_t>(i) });
+	}
+
+	BENCHMARK("Insert 2k events, pointer per element") {
+		auto buffer = std::make_unique<PointerRingBuffer<BenchmarkEvent, BENCHMARK_CAPACITY>>();
+		for (const BenchmarkEvent& event : events) {
+			buffer->insert(event);
+		}
+		return buffer;
+	};
+
+	BENCHMARK("Insert 2k events, inline") {
+		auto buffer = std::make_unique<RingBuffer<BenchmarkEvent, BENCHMARK_CAPACITY>>();
+		for (const BenchmarkEvent& event : events) {
+			buffer->insert(event);
+		}
+		return buffer;
+	};
+
+	BENCHMARK("Insert 2k events, inline insert_range") {
+		auto buffer = std::make_unique<RingBuffer<BenchmarkEvent, BENCHMARK_CAPACITY>>();
+		buffer->insert_range(std::cbegin(events), std::cend(events));
+		return buffer;
+	};
+
+	auto pointer_buffer = std::make_unique<PointerRingBuffer<BenchmarkEvent, BENCHMARK_CAPACITY>>();
+	auto inline_buffer = std::make_unique<RingBuffer<BenchmarkEvent, BENCHMARK_CAPACITY>>();
+	for (const BenchmarkEvent& event : events) {
+		pointer_buffer->insert(event);
+		inline_buffer->insert(event);
+	}
+
+	BENCHMARK("Iterate 1k events, pointer per element") {
+		int64_t sum = 0;
+		pointer_buffer->for_each([&sum](const BenchmarkEvent& event) { sum += event.timestamp; });
+		return sum;
+	};
+
+	BENCHMARK("Iterate 1k events, inline") {
+		int64_t sum = 0;
+		for (const BenchmarkEvent& event : *inline_buffer) {
+			sum += event.timestamp;
+		}
+		return sum;
+	};
+
+	BENCHMARK("Newest 50 of 1k events, iterate and skip") {
+		int64_t sum = 0;
+		size_t skip = inline_buffer->size() - 1 - 50;
+		for (const BenchmarkEvent& event : *inline_buffer) {
+			if (skip > 0) {
+				--skip;
+				continue;
+			}
+			sum += event.timestamp;
+		}
+		return sum;
+	};
+
+	BENCHMARK("Newest 50 of 1k events, last()") {
+		int64_t sum = 0;
+		const auto view = inline_buffer->last(50);
+		for (const std::span<BenchmarkEvent>& segment : { view.first, view.second }) {
+			for (const BenchmarkEvent& event : segment) {
+				sum += event.timestamp;
+			}
+		}
+		return sum;
+	};
+}
@@ -0,0 +1,219 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+#include <catch.hpp>
+#include "tavernmx/room-event-store.h"
+
+using namespace tavernmx::rooms;
+
+namespace
+{
+	/// Collects the text of the newest \p count events of \p store, oldest first.
+	std::vector<std::string> read_last(const RoomEventStore& store, size_t count) {
+		std::vector<std::string> texts{};
+		store.read_last(count, [&texts](const RoomEventView& event) { texts.emplace_back(event.event_text); });
+		return texts;
+	}
+
+	/// A typical chat line: one of a few dozen users, and text starting with \p i a few dozen characters long.
+	RoomEvent make_event(size_t i) {
+		return RoomEvent{ .origin_user_name = "user-" + std::to_string(i % 40),
+			.event_text = std::to_string(i) + " chat line" + std::string(i % 50, '.') };
+	}
+
+	/// The layout room history had before RoomEventStore, to compare against: a ring of pointers to whole
+	/// RoomEvents, each in a heap node of its own. Single threaded.
+	class EventRing
+	{
+	public:
+		explicit EventRing(size_t capacity) : slots(capacity) {}
+
+		void insert(RoomEvent event) {
+			this->slots[this->head % this->slots.size()] =
+				std::make_unique<Node>(Node{ .position = this->head, .event = std::move(event) });
+			++this->head;
+		}
+
+		template <typename Visitor>
+		void read_last(size_t count, Visitor&& visitor) const {
+			for (size_t pos = this->head - std::min({ count, this->head, this->slots.size() }); pos != this->head;
+				 ++pos) {
+				visitor(this->slots[pos % this->slots.size()]->event);
+			}
+		}
+
+		/// Bytes used, counting string memory beyond what fits inline.
+		size_t storage_bytes() const {
+			const size_t inline_capacity = std::string{}.capacity();
+			size_t bytes = sizeof(*this) + this->slots.size() * sizeof(std::unique_ptr<Node>);
+			this->read_last(this->slots.size(), [&bytes, inline_capacity](const RoomEvent& event) {
+				bytes += sizeof(Node);
+				for (const std::string* text : { &event.origin_user_name, &event.event_text }) {
+					bytes += text->capacity() > inline_capacity ? text->capacity() + 1 : 0;
+				}
+			});
+			return bytes;
+		}
+
+	private:
+		struct Node
+		{
+			// the lock-free ring checked it to detect being lapped, so nodes are the size they were
+			size_t position{};
+			RoomEvent event;
+		};
+
+		std::vector<std::unique_ptr<Node>> slots;
+		size_t head{};
+	};
+
+	constexpr size_t BENCHMARK_CAPACITY = 1000;
+	constexpr size_t BENCHMARK_READ_COUNT = 100;
+}
+
+TEST_CASE("RoomEventStore: read_last returns the newest events") {
+	RoomEventStore store{ 10, std::make_shared<SymbolTable>() };
+	REQUIRE(store.empty());
+	REQUIRE(read_last(store, 5).empty());
+
+	store.insert(RoomEvent{ .timestamp = EventTimeStamp{ std::chrono::seconds{ 1234 } },
+		.origin_user_name = "alice",
+		.event_text = "hello" });
+	std::vector<RoomEventView> events{};
+	store.read_last(5, [&events](const RoomEventView& event) { events.push_back(event); });
+	REQUIRE(events.size() == 1);
+	REQUIRE(events.front().timestamp.time_since_epoch().count() == 1234);
+	REQUIRE(events.front().origin_user_name == "alice");
+	REQUIRE(events.front().event_text == "hello");
+
+	// texts of very different sizes, including empty ones, so blocks fill up on text as well as on events
+	for (size_t i = 1; i < 40; ++i) {
+		store.insert(RoomEvent{ .origin_user_name = "bob", .event_text = std::string(i % 3 == 0 ? 0 : i * 20, 'x') });
+	}
+	REQUIRE(store.size() == 10);
+	const std::vector<std::string> texts = read_last(store, 100);
+	REQUIRE(texts.size() == 10);
+	for (size_t i = 0; i < texts.size(); ++i) {
+		const size_t inserted = 30 + i;
+		REQUIRE(texts[i].size() == (inserted % 3 == 0 ? 0 : inserted * 20));
+	}
+	REQUIRE(read_last(store, 2).size() == 2);
+}
+
+TEST_CASE("RoomEventStore: user names are interned once across stores") {
+	const auto user_names = std::make_shared<SymbolTable>();
+	RoomEventStore first{ 100, user_names };
+	RoomEventStore second{ 100, user_names };
+	for (size_t i = 0; i < 300; ++i) {
+		first.insert(RoomEvent{ .origin_user_name = "user-" + std::to_string(i % 3), .event_text = "x" });
+		second.insert(RoomEvent{ .origin_user_name = "user-" + std::to_string(i % 4), .event_text = "y" });
+	}
+	REQUIRE(user_names->size() == 4);
+	std::vector<std::string> names{};
+	second.read_last(4, [&names](const RoomEventView& event) { names.emplace_back(event.origin_user_name); });
+	REQUIRE(names == std::vector<std::string>{ "user-0", "user-1", "user-2", "user-3" });
+}
+
+TEST_CASE("RoomEventStore: memory stays bounded and below a ring of RoomEvents") {
+	constexpr size_t capacity = 1000;
+	RoomEventStore store{ capacity, std::make_shared<SymbolTable>() };
+	EventRing ring{ capacity };
+	REQUIRE(store.storage_bytes() == sizeof(store));
+
+	for (size_t i = 0; i < 20 * capacity; ++i) {
+		store.insert(make_event(i));
+		ring.insert(make_event(i));
+	}
+	REQUIRE(store.size() == capacity);
+	const std::vector<std::string> texts = read_last(store, capacity);
+	REQUIRE(texts.front() == make_event(19 * capacity).event_text);
+	REQUIRE(texts.back() == make_event(20 * capacity - 1).event_text);
+
+	// the columns cost 16 bytes per event on top of the text itself; a ring node costs 80 before any strings
+	const size_t text_bytes = std::accumulate(std::cbegin(texts), std::cend(texts), size_t{ 0 },
+		[](size_t total, const std::string& text) { return total + text.size(); });
+	REQUIRE(store.storage_bytes() < (text_bytes + capacity * 16) * 3 / 2);
+	REQUIRE(store.storage_bytes() * 3 / 2 < ring.storage_bytes());
+}
+
+TEST_CASE("RoomEventStore: readers see consistent snapshots while the writer inserts") {
+	constexpr size_t insert_count = 200000;
+	RoomEventStore store{ 64, std::make_shared<SymbolTable>() };
+	std::atomic<bool> done{ false };
+	std::mutex failures_mutex{};
+	std::vector<std::string> failures{};
+
+	std::vector<std::jthread> readers{};
+	for (size_t i = 0; i < 3; ++i) {
+		readers.emplace_back([&] {
+			while (!done) {
+				// every snapshot must be a run of consecutive inserts, each with its own user and text intact
+				std::vector<size_t> seen{};
+				store.read_last(32, [&](const RoomEventView& event) {
+					const size_t number = std::stoul(std::string{ event.event_text });
+					if (event.origin_user_name != make_event(number).origin_user_name ||
+						event.event_text != make_event(number).event_text) {
+						std::lock_guard lock{ failures_mutex };
+						failures.push_back("torn event " + std::to_string(number));
+					}
+					seen.push_back(number);
+				});
+				for (size_t j = 1; j < seen.size(); ++j) {
+					if (seen[j] != seen[j - 1] + 1) {
+						std::lock_guard lock{ failures_mutex };
+						failures.push_back(std::to_string(seen[j - 1]) + " then " + std::to_string(seen[j]));
+					}
+				}
+			}
+		});
+	}
+
+	for (size_t i = 0; i < insert_count; ++i) {
+		store.insert(make_event(i));
+	}
+	done = true;
+	readers.clear();
+
+	REQUIRE(failures.empty());
+	REQUIRE(read_last(store, 1) == std::vector<std::string>{ make_event(insert_count - 1).event_text });
+}
+
+TEST_CASE("RoomEventStore benchmarks", "[!benchmark]") {
+	EventRing ring{ BENCHMARK_CAPACITY };
+	RoomEventStore store{ BENCHMARK_CAPACITY, std::make_shared<SymbolTable>() };
+	for (size_t i = 0; i < 2 * BENCHMARK_CAPACITY; ++i) {
+		ring.insert(make_event(i));
+		store.insert(make_event(i));
+	}
+
+	BENCHMARK("Read newest 100, ring of RoomEvents") {
+		size_t total = 0;
+		ring.read_last(BENCHMARK_READ_COUNT, [&total](const RoomEvent& event) {
+			total += event.origin_user_name.size() + event.event_text.size();
+		});
+		return total;
+	};
+
+	BENCHMARK("Read newest 100, columnar store") {
+		size_t total = 0;
+		store.read_last(BENCHMARK_READ_COUNT, [&total](const RoomEventView& event) {
+			total += event.origin_user_name.size() + event.event_text.size();
+		});
+		return total;
+	};
+
+	BENCHMARK("Insert, ring of RoomEvents") {
+		ring.insert(make_event(7));
+	};
+
+	BENCHMARK("Insert, columnar store") {
+		store.insert(make_event(7));
+	};
+}
@@ -0,0 +1,64 @@
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include <catch.hpp>
+#include "tavernmx/server.h"
+
+using namespace tavernmx::messaging;
+using namespace tavernmx::rooms;
+using tavernmx::server::RoomHistoryDirectory;
+
+namespace
+{
+	/// Unpacks the ROOM_HISTORY response held by \p frame.
+	Message unpack_history(const Frame& frame) {
+		MessageBlockDecoder decoder{};
+		decoder.feed(std::span{ *frame });
+		const std::optional<MessageBlock> block = decoder.next();
+		REQUIRE(block.has_value());
+		std::vector<Message> messages = unpack_messages(block.value());
+		REQUIRE(messages.size() == 1);
+		REQUIRE(messages[0].message_type == MessageType::ROOM_HISTORY);
+		return messages[0];
+	}
+}
+
+TEST_CASE("RoomHistoryDirectory: identical requests share one encoded response") {
+	RoomHistoryDirectory directory{};
+	const auto history = std::make_shared<tavernmx::server::RoomHistory>(100, directory.user_names());
+	history->insert(RoomEvent{ .origin_user_name = "user", .event_text = "first" });
+	directory.publish("lobby", history);
+
+	const Frame first = directory.find_frame("lobby", 50);
+	REQUIRE(first);
+	for (size_t i = 0; i < 99; ++i) {
+		REQUIRE(directory.find_frame("lobby", 50) == first);
+	}
+	REQUIRE(directory.usage().front().frames_encoded == 1);
+	REQUIRE(directory.usage().front().frames_served == 100);
+
+	SECTION("Each event count has a response of its own") {
+		REQUIRE(directory.find_frame("lobby", 10) != first);
+		REQUIRE(directory.find_frame("lobby", 10) == directory.find_frame("lobby", 10));
+		REQUIRE(directory.usage().front().frames_encoded == 2);
+	}
+
+	SECTION("An insert makes the next request encode the history again") {
+		history->insert(RoomEvent{ .origin_user_name = "user", .event_text = "second" });
+		const Frame second = directory.find_frame("lobby", 50);
+		REQUIRE(second != first);
+		REQUIRE(directory.usage().front().frames_encoded == 2);
+		REQUIRE(message_value_or<int32_t>(unpack_history(first), "event_count") == 1);
+		REQUIRE(message_value_or<int32_t>(unpack_history(second), "event_count") == 2);
+		REQUIRE(directory.find_frame("lobby", 50) == second);
+		REQUIRE(directory.usage().front().frames_encoded == 2);
+	}
+
+	SECTION("A room without published history has no response") {
+		REQUIRE(directory.find_frame("missing", 50) == nullptr);
+		directory.erase("lobby");
+		REQUIRE(directory.find_frame("lobby", 50) == nullptr);
+	}
+}
@@ -0,0 +1,125 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <string>
+#include <utility>
+#include <catch.hpp>
+#include "tavernmx/room.h"
+
+using Catch::Matchers::RangeEquals;
+using tavernmx::rooms::Room;
+using tavernmx::rooms::RoomManager;
+
+namespace
+{
+	/// Number of rooms used for benchmarks.
+	constexpr size_t BENCHMARK_ROOM_COUNT = 10000;
+
+	/// Creates \p count rooms named "room-0", "room-1", ...
+	void create_rooms(RoomManager<Room>& rooms, size_t count, std::vector<std::string>& names) {
+		for (size_t i = 0; std::cmp_less(i, count); ++i) {
+			names.push_back("room-" + std::to_string(i));
+			rooms.create_room(names.back());
+		}
+	}
+}
+
+TEST_CASE("RoomManager: create and look up rooms by name") {
+	RoomManager<Room> rooms{};
+	REQUIRE(rooms.create_room("general"));
+	REQUIRE(rooms.create_room("chat"));
+	REQUIRE_FALSE(rooms.create_room("general"));
+	REQUIRE_FALSE(rooms.create_room("-invalid"));
+	REQUIRE(std::cmp_equal(rooms.size(), 2));
+
+	const std::string key{ "general" };
+	REQUIRE(rooms[key]->room_name() == "general");
+	REQUIRE(rooms[std::string_view{ key }.substr(0, 4)] == nullptr);
+	REQUIRE(rooms["nope"] == nullptr);
+	REQUIRE_THAT(rooms.room_names(), RangeEquals(std::vector<std::string>{ "general", "chat" }));
+}
+
+TEST_CASE("RoomManager: destroyed rooms leave names in creation order") {
+	RoomManager<Room> rooms{};
+	std::vector<std::string> names{};
+	create_rooms(rooms, 10, names);
+
+	std::vector<std::string> expected{};
+	for (size_t i = 0; std::cmp_less(i, names.size()); ++i) {
+		if (i % 3 == 0) {
+			rooms[names[i]]->request_destroy();
+		} else {
+			expected.push_back(names[i]);
+		}
+	}
+	rooms.remove_destroyed_rooms();
+
+	REQUIRE(std::cmp_equal(rooms.size(), expected.size()));
+	REQUIRE_THAT(rooms.room_names(), RangeEquals(expected));
+	for (size_t i = 0; std::cmp_less(i, expected.size()); ++i) {
+		REQUIRE(rooms.rooms()[i]->room_name() == expected[i]);
+	}
+	REQUIRE(rooms[names[0]] == nullptr);
+	REQUIRE(rooms[names[1]] != nullptr);
+
+	// a destroyed name can be reused, and goes to the end of the list
+	REQUIRE(rooms.create_room(names[0]));
+	REQUIRE(rooms.room_names().back() == names[0]);
+
+	rooms.clear();
+	REQUIRE(std::cmp_equal(rooms.size(), 0));
+	REQUIRE(rooms[names[1]] == nullptr);
+}
+
+TEST_CASE("RoomManager: a removed room's name can be reused at once") {
+	RoomManager<Room> rooms{};
+	REQUIRE(rooms.create_room("general"));
+	const std::shared_ptr<Room> chat = rooms.create_room("chat");
+	REQUIRE(rooms.create_room("lobby"));
+
+	REQUIRE(rooms.remove_room("chat") == chat);
+	REQUIRE(rooms.remove_room("chat") == nullptr);
+	REQUIRE(rooms["chat"] == nullptr);
+	REQUIRE_THAT(rooms.room_names(), RangeEquals(std::vector<std::string>{ "general", "lobby" }));
+
+	const std::shared_ptr<Room> new_chat = rooms.create_room("chat");
+	REQUIRE(new_chat);
+	REQUIRE(new_chat != chat);
+	REQUIRE(rooms["chat"] == new_chat);
+	REQUIRE(std::cmp_equal(rooms.size(), 3));
+}
+
+TEST_CASE("RoomManager benchmarks", "[!benchmark]") {
+	RoomManager<Room> rooms{};
+	std::vector<std::string> names{};
+	create_rooms(rooms, BENCHMARK_ROOM_COUNT, names);
+
+	BENCHMARK("Look up 10k rooms by name") {
+		size_t found = 0;
+		for (const std::string& name : names) {
+			found += rooms[name] != nullptr;
+		}
+		return found;
+	};
+
+	BENCHMARK_ADVANCED("Create 10k rooms")(Catch::Benchmark::Chronometer meter) {
+		std::vector<RoomManager<Room>> managers(meter.runs());
+		meter.measure([&managers, &names](int32_t run) {
+			for (const std::string& name : names) {
+				managers[run].create_room(name);
+			}
+			return managers[run].size();
+		});
+	};
+
+	BENCHMARK_ADVANCED("Destroy 1 of 10k rooms")(Catch::Benchmark::Chronometer meter) {
+		std::vector<RoomManager<Room>> managers(meter.runs());
+		for (RoomManager<Room>& manager : managers) {
+			std::vector<std::string> unused{};
+			create_rooms(manager, BENCHMARK_ROOM_COUNT, unused);
+		}
+		meter.measure([&managers, &names](int32_t run) {
+			managers[run][names[BENCHMARK_ROOM_COUNT / 2]]->request_destroy();
+			managers[run].remove_destroyed_rooms();
+			return managers[run].size();
+		});
+	};
+}
@@ -0,0 +1,135 @@
+#include <chrono>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <catch.hpp>
+#include "test-server.h"
+
+using namespace tavernmx::messaging;
+using namespace tavernmx::server;
+
+TEST_CASE("RoomShard: rooms are routed by a hash of their name") {
+	std::set<size_t> shards_used{};
+	for (int32_t i = 0; i < 64; ++i) {
+		const std::string room_name = "room-" + std::to_string(i);
+		const size_t index = room_shard_index(room_name, 4);
+		REQUIRE(index == std::hash<std::string_view>{}(room_name) % 4);
+		REQUIRE(room_shard_index(room_name, 4) == index);
+		REQUIRE(room_shard_index(room_name, 1) == 0);
+		shards_used.insert(index);
+	}
+	REQUIRE(shards_used.size() == 4);
+}
+
+#if defined(TMX_LINUX)
+TEST_CASE("RoomShard: a room destroyed and created again in one batch starts over") {
+	const std::filesystem::path directory = tavernmx::testing::make_test_directory();
+	const ServerConfiguration config = tavernmx::testing::write_test_config(directory);
+	const auto server_ctx = tavernmx::testing::make_server_context();
+	const auto client_ctx = tavernmx::testing::make_client_context();
+	tavernmx::testing::TlsPair pair = tavernmx::testing::make_tls_pair(server_ctx.get(), client_ctx.get());
+	const auto client = std::make_shared<ClientConnection>(std::move(pair.server),
+		std::make_shared<tavernmx::Reactor>());
+	client->identify("user");
+	const auto shard = std::make_shared<RoomShard>(0);
+	const auto histories = std::make_shared<RoomHistoryDirectory>();
+	std::thread worker{ room_worker, shard, histories, nullptr, std::cref(config) };
+
+	// as the server worker routes them when a client destroys a room and another recreates it straight after
+	std::vector<RoomCommand> commands{};
+	commands.push_back(RoomCommand{ .client = nullptr, .message = create_room_create("lobby") });
+	commands.push_back(RoomCommand{ .client = client, .message = create_chat_send("lobby", "before") });
+	commands.push_back(RoomCommand{ .client = client, .message = create_room_destroy("lobby") });
+	commands.push_back(RoomCommand{ .client = client, .message = create_room_create("lobby") });
+	commands.push_back(RoomCommand{ .client = client, .message = create_chat_send("lobby", "after") });
+	shard->commands.push_range(std::make_move_iterator(std::begin(commands)), std::make_move_iterator(std::end(commands)));
+
+	std::shared_ptr<tavernmx::server::RoomHistory> history{};
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 1 };
+	while (std::chrono::steady_clock::now() < deadline && (history == nullptr || history->size() == 0)) {
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+		history = histories->find("lobby");
+	}
+	shard->stop();
+	worker.join();
+	std::filesystem::remove_all(directory);
+
+	REQUIRE(history != nullptr);
+	REQUIRE(history->size() == 1);
+}
+
+TEST_CASE("RoomShard: the room list covers rooms on every shard") {
+	std::string initial_rooms{};
+	std::set<std::string> room_names{};
+	std::set<size_t> shards_used{};
+	for (int32_t i = 0; i < 16; ++i) {
+		const std::string room_name = "room-" + std::to_string(i);
+		initial_rooms += (i == 0 ? "\"" : ", \"") + room_name + "\"";
+		room_names.insert(room_name);
+		shards_used.insert(room_shard_index(room_name, 4));
+	}
+	REQUIRE(shards_used.size() > 1);
+	const tavernmx::testing::TestServer server{ "\"room_shards\": 4, \"initial_rooms\": [" + initial_rooms + "]" };
+	tavernmx::testing::PeerConnection client = server.connect("user");
+
+	client.send_message(create_room_create("created"));
+	REQUIRE(client.receive_until(MessageType::ROOM_CREATE));
+	room_names.insert("created");
+	client.send_message(create_room_list());
+	const std::optional<Message> room_list = client.receive_until(MessageType::ROOM_LIST);
+	REQUIRE(room_list);
+
+	std::set<std::string> listed{};
+	for (const auto& [key, room_name] : room_list->values.items()) {
+		listed.insert(room_name.get<std::string>());
+	}
+	REQUIRE(listed == room_names);
+}
+
+TEST_CASE("RoomShard: a room worker that exits with an exception marks its shard failed") {
+	const std::filesystem::path directory = tavernmx::testing::make_test_directory();
+	const ServerConfiguration config = tavernmx::testing::write_test_config(directory);
+	const auto server_ctx = tavernmx::testing::make_server_context();
+	const auto client_ctx = tavernmx::testing::make_client_context();
+	tavernmx::testing::TlsPair pair = tavernmx::testing::make_tls_pair(server_ctx.get(), client_ctx.get());
+	const auto client = std::make_shared<ClientConnection>(std::move(pair.server),
+		std::make_shared<tavernmx::Reactor>());
+	client->identify("user");
+	const auto shard = std::make_shared<RoomShard>(0);
+	std::thread worker{ room_worker, shard, std::make_shared<RoomHistoryDirectory>(), nullptr, std::cref(config) };
+
+	// a chat line whose text isn't a string
+	Message chat_send = create_chat_send("lobby", "");
+	chat_send.values["text"] = 5;
+	std::vector<RoomCommand> commands{};
+	commands.push_back(RoomCommand{ .client = client, .message = create_room_create("lobby") });
+	commands.push_back(RoomCommand{ .client = client, .message = std::move(chat_send) });
+	shard->commands.push_range(std::make_move_iterator(std::begin(commands)), std::make_move_iterator(std::end(commands)));
+
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 1 };
+	while (std::chrono::steady_clock::now() < deadline && !shard->has_failed()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+	}
+	// it failed by itself, without being asked to stop
+	const bool running = shard->is_running();
+	shard->stop();
+	worker.join();
+	std::filesystem::remove_all(directory);
+	REQUIRE(shard->has_failed());
+	REQUIRE(running);
+}
+
+TEST_CASE("RoomShard: the server shuts down when a room worker fails") {
+	const tavernmx::testing::TestServer server{ "\"initial_rooms\": [\"lobby\"]" };
+	tavernmx::testing::PeerConnection client = server.connect("user");
+	Message chat_send = create_chat_send("lobby", "");
+	chat_send.values["text"] = 5;
+	client.send_message(create_room_join("lobby"));
+	client.send_message(chat_send);
+
+	// as main() waits for it, rather than keep routing commands to a shard nobody services
+	REQUIRE(server_shutdown_signal.try_acquire_for(std::chrono::seconds{ 2 }));
+}
+#endif
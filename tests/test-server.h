@@ -0,0 +1,143 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <semaphore>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "tavernmx/server-workers.h"
+#include "tls-loopback.h"
+
+#if defined(TMX_LINUX)
+#include <unistd.h>
+
+extern std::binary_semaphore server_ready_signal;
+extern std::binary_semaphore server_accept_signal;
+extern std::binary_semaphore server_shutdown_signal;
+
+namespace tavernmx::testing
+{
+	/// Creates an empty directory, unique to this process and call, under the system's temporary directory.
+	inline std::filesystem::path make_test_directory() {
+		static std::atomic<int32_t> directory_count{ 0 };
+		std::filesystem::path path = std::filesystem::temp_directory_path() /
+			("tavernmx-test-" + std::to_string(getpid()) + "-" + std::to_string(directory_count++));
+		std::filesystem::remove_all(path);
+		std::filesystem::create_directories(path);
+		return path;
+	}
+
+	/**
+     * @brief Writes a fresh certificate, and a server configuration using it, to \p directory.
+     * @param directory Directory to write to, see make_test_directory().
+     * @param settings Extra members of the configuration's JSON object, e.g. "\"room_shards\": 4".
+     * @return The configuration, as loaded from its file.
+     */
+	inline server::ServerConfiguration write_test_config(const std::filesystem::path& directory,
+		std::string_view settings = {}) {
+		TestCertificate{}.write_to(directory);
+		const std::filesystem::path config_path = directory / "server-config.json";
+		std::ofstream{ config_path } << "{ \"host_certificate\": \"" << (directory / "certificate.pem").string()
+			<< "\", \"host_private_key\": \"" << (directory / "private-key.pem").string()
+			<< "\", \"reactor_threads\": 1, \"room_shards\": 1, \"log_level\": \"off\""
+			<< (settings.empty() ? "" : ", ") << settings << " }";
+		return server::ServerConfiguration{ config_path.string() };
+	}
+
+	/**
+     * @brief A whole server running in the test process on a port of 127.0.0.1 chosen by the system, with the
+     * same threads as the real one: server worker, room workers, reactors, and an accept loop. Only one may
+     * run at a time, as the workers share global signals.
+     */
+	class TestServer
+	{
+	public:
+		/**
+         * @brief Writes a fresh certificate and a configuration to a temporary directory, then starts the server.
+         * @param settings Extra members of the configuration's JSON object, see write_test_config().
+         */
+		explicit TestServer(std::string_view settings = {})
+			: directory{ make_test_directory() },
+			  config{ write_test_config(this->directory, settings) },
+			  connections{ std::make_shared<server::ClientConnectionManager>(0,
+				  static_cast<size_t>(this->config.reactor_threads), this->config.outbound_limits,
+				  this->config.rate_limits, this->config.tcp_keepalive_seconds,
+				  server::ConnectionLiveness{ .heartbeat_interval = std::chrono::seconds{ this->config.heartbeat_seconds },
+					  .heartbeat_timeout = std::chrono::seconds{ this->config.heartbeat_timeout_seconds } }) } {
+			this->connections->load_certificate(this->config.host_certificate_path, this->config.host_private_key_path);
+			this->server_thread = std::thread{ server::server_worker, this->config, this->connections };
+			server_ready_signal.acquire();
+			this->connections->begin_accept();
+			server_accept_signal.release();
+			for (const std::shared_ptr<Reactor>& reactor : this->connections->get_reactors()) {
+				this->reactor_threads.emplace_back(server::reactor_worker, this->connections, reactor);
+			}
+			this->accept_thread = std::thread{ [this]() {
+				while (!this->stopping) {
+					for (const std::shared_ptr<server::ClientConnection>& client : this->connections->accept_connections(
+							 20, static_cast<size_t>(this->config.max_handshakes))) {
+						server::client_worker(client, this->connections->get_room_histories());
+					}
+				}
+			} };
+		}
+
+		/**
+         * @brief Shuts the server down and waits for all of its threads.
+         */
+		~TestServer() {
+			this->stopping = true;
+			this->accept_thread.join();
+			this->connections->shutdown();
+			this->server_thread.join();
+			for (std::thread& thread : this->reactor_threads) {
+				thread.join();
+			}
+			// released by the server worker on its way out, for main()
+			(void)server_shutdown_signal.try_acquire();
+			std::filesystem::remove_all(this->directory);
+		}
+
+		TestServer(const TestServer&) = delete;
+
+		TestServer& operator=(const TestServer&) = delete;
+
+		/// The port the server accepts connections on.
+		int32_t port() const { return this->connections->get_accept_port(); }
+
+		/**
+         * @brief Connects to the server and identifies as \p user_name.
+         * @return The client's end of the connection, once the server has acknowledged its HELLO.
+         */
+		PeerConnection connect(std::string_view user_name) const {
+			PeerConnection client{ connect_tls(this->port(), this->client_ctx.get()) };
+			client.send_message(messaging::create_hello(user_name));
+			if (!client.receive_until(messaging::MessageType::ACK)) {
+				throw std::runtime_error{ "Test server did not acknowledge HELLO" };
+			}
+			return client;
+		}
+
+		/// The server's configuration, as loaded from its file.
+		const server::ServerConfiguration& configuration() const { return this->config; }
+
+		/// The server's manager of client connections.
+		const std::shared_ptr<server::ClientConnectionManager>& client_connections() const {
+			return this->connections;
+		}
+
+	private:
+		std::filesystem::path directory{};
+		server::ServerConfiguration config;
+		std::shared_ptr<server::ClientConnectionManager> connections{};
+		ssl::ssl_unique_ptr<SSL_CTX> client_ctx{ make_client_context() };
+		std::atomic<bool> stopping{ false };
+		std::thread server_thread{};
+		std::vector<std::thread> reactor_threads{};
+		std::thread accept_thread{};
+	};
+}
+#endif
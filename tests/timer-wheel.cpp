@@ -0,0 +1,176 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <random>
+#include <vector>
+#include <catch.hpp>
+#include "tavernmx/timer-wheel.h"
+
+using namespace std::chrono_literals;
+using tavernmx::NO_TIMER;
+using tavernmx::TimerId;
+using tavernmx::TimerWheel;
+
+namespace
+{
+	const TimerWheel::Clock::time_point START = TimerWheel::Clock::now();
+}
+
+TEST_CASE("TimerWheel fires timers once they are due, never early") {
+	TimerWheel timers{ 10ms, START };
+	std::vector<int32_t> fired{};
+	timers.schedule(START + 25ms, [&fired]() { fired.push_back(25); });
+	timers.schedule(START + 10ms, [&fired]() { fired.push_back(10); });
+	timers.schedule(START + 1s, [&fired]() { fired.push_back(1000); });
+	REQUIRE(timers.size() == 3);
+
+	REQUIRE(timers.advance(START + 9ms) == 0);
+	REQUIRE(timers.advance(START + 10ms) == 1);
+	REQUIRE(fired == std::vector<int32_t>{ 10 });
+	// due times round up to the next tick
+	REQUIRE(timers.advance(START + 29ms) == 0);
+	REQUIRE(timers.advance(START + 30ms) == 1);
+	REQUIRE(timers.advance(START + 999ms) == 0);
+	REQUIRE(timers.advance(START + 5s) == 1);
+	REQUIRE(fired == std::vector<int32_t>{ 10, 25, 1000 });
+	REQUIRE(timers.size() == 0);
+	REQUIRE(timers.next_expiry() == TimerWheel::Clock::time_point::max());
+
+	// a timer already due fires on the next tick
+	timers.schedule(START, [&fired]() { fired.push_back(0); });
+	REQUIRE(timers.advance(START + 5s) == 0);
+	REQUIRE(timers.advance(START + 5s + 10ms) == 1);
+	REQUIRE(fired.back() == 0);
+}
+
+TEST_CASE("TimerWheel cancels pending timers only") {
+	TimerWheel timers{ 1ms, START };
+	bool first_fired = false;
+	const TimerId first = timers.schedule(START + 5ms, [&first_fired]() { first_fired = true; });
+	REQUIRE(first != NO_TIMER);
+	REQUIRE(timers.is_pending(first));
+	REQUIRE(timers.cancel(first));
+	REQUIRE_FALSE(timers.is_pending(first));
+	REQUIRE_FALSE(timers.cancel(first));
+	REQUIRE_FALSE(timers.cancel(NO_TIMER));
+
+	// the cancelled timer's slot is reused, but its TimerId can't touch the new timer
+	bool second_fired = false;
+	const TimerId second = timers.schedule(START + 5ms, [&second_fired]() { second_fired = true; });
+	REQUIRE(second != first);
+	REQUIRE_FALSE(timers.cancel(first));
+	REQUIRE(timers.advance(START + 1s) == 1);
+	REQUIRE_FALSE(first_fired);
+	REQUIRE(second_fired);
+	REQUIRE_FALSE(timers.cancel(second));
+}
+
+TEST_CASE("TimerWheel callbacks can schedule and cancel timers") {
+	TimerWheel timers{ 1ms, START };
+	std::vector<int32_t> fired{};
+	TimerId doomed = NO_TIMER;
+	timers.schedule(START + 5ms, [&]() {
+		fired.push_back(5);
+		REQUIRE(timers.cancel(doomed));
+		// due now, so it waits for the next tick
+		timers.schedule(START + 5ms, [&fired]() { fired.push_back(6); });
+		timers.schedule(START + 100ms, [&fired]() { fired.push_back(100); });
+	});
+	doomed = timers.schedule(START + 6ms, [&fired]() { fired.push_back(-1); });
+	REQUIRE(timers.advance(START + 5ms) == 1);
+	REQUIRE(timers.advance(START + 6ms) == 1);
+	REQUIRE(timers.advance(START + 1s) == 1);
+	REQUIRE(fired == std::vector<int32_t>{ 5, 6, 100 });
+}
+
+TEST_CASE("TimerWheel keeps timers due beyond its span") {
+	TimerWheel timers{ 1ms, START };
+	// 2^24 ms is about 4.7 hours
+	bool fired = false;
+	timers.schedule(START + 10h, [&fired]() { fired = true; });
+	for (auto now = START; now < START + 10h; now += 7min) {
+		REQUIRE(timers.advance(now) == 0);
+		REQUIRE(timers.next_expiry() <= START + 10h);
+	}
+	REQUIRE(timers.advance(START + 10h - 1ms) == 0);
+	REQUIRE(timers.advance(START + 10h) == 1);
+	REQUIRE(fired);
+}
+
+TEST_CASE("TimerWheel agrees with a sorted reference") {
+	constexpr auto TICK = 1ms;
+	TimerWheel timers{ TICK, START };
+	// due tick => ids still pending
+	std::multimap<int64_t, int32_t> expected{};
+	std::map<int32_t, TimerId> pending{};
+	std::vector<std::pair<int64_t, int32_t>> fired{};
+	std::mt19937 random{ 12345 };
+	int64_t now_tick = 0;
+
+	for (int32_t id = 0; id < 20000; ++id) {
+		// mostly near timers, some spanning every level of the wheel
+		const int64_t delay = std::uniform_int_distribution<int32_t>{ 0, 9 }(random) == 0
+								  ? std::uniform_int_distribution<int64_t>{ 0, 30'000'000 }(random)
+								  : std::uniform_int_distribution<int64_t>{ 0, 5'000 }(random);
+		const int64_t due_tick = std::max(now_tick + delay, now_tick + 1);
+		pending[id] = timers.schedule(START + TICK * (now_tick + delay), [&fired, &now_tick, id]() {
+			fired.emplace_back(now_tick, id);
+		});
+		expected.emplace(due_tick, id);
+
+		if (std::uniform_int_distribution<int32_t>{ 0, 3 }(random) == 0) {
+			// cancel a random pending timer
+			const auto it = std::next(pending.begin(),
+				std::uniform_int_distribution<size_t>{ 0, pending.size() - 1 }(random));
+			REQUIRE(timers.cancel(it->second));
+			std::erase_if(expected, [victim = it->first](const auto& entry) { return entry.second == victim; });
+			pending.erase(it);
+		}
+		if (id % 10 == 0) {
+			now_tick += std::uniform_int_distribution<int64_t>{ 0, id % 1000 == 0 ? 2'000'000 : 200 }(random);
+			fired.clear();
+			timers.advance(START + TICK * now_tick);
+
+			std::vector<std::pair<int64_t, int32_t>> due{};
+			while (!expected.empty() && expected.begin()->first <= now_tick) {
+				due.emplace_back(now_tick, expected.begin()->second);
+				pending.erase(expected.begin()->second);
+				expected.erase(expected.begin());
+			}
+			std::sort(fired.begin(), fired.end());
+			std::sort(due.begin(), due.end());
+			REQUIRE(fired == due);
+			REQUIRE(timers.size() == expected.size());
+			if (!expected.empty()) {
+				REQUIRE(timers.next_expiry() <= START + TICK * expected.begin()->first);
+			}
+		}
+	}
+}
+
+TEST_CASE("Timer wheel benchmarks", "[!benchmark]") {
+	TimerWheel timers{ 10ms, START };
+	std::vector<TimerId> ids(10000);
+	auto now = START;
+
+	BENCHMARK("TimerWheel schedule + cancel x10000") {
+		for (size_t i = 0; i < ids.size(); ++i) {
+			ids[i] = timers.schedule(now + std::chrono::milliseconds{ 100 + i * 7 % 60000 }, []() {});
+		}
+		for (const TimerId id : ids) {
+			timers.cancel(id);
+		}
+		return timers.size();
+	};
+
+	BENCHMARK("TimerWheel advance 1s past 10000 idle timers") {
+		if (timers.size() == 0) {
+			for (size_t i = 0; i < ids.size(); ++i) {
+				ids[i] = timers.schedule(now + 1h + std::chrono::milliseconds{ i }, []() {});
+			}
+		}
+		now += 1s;
+		return timers.advance(now);
+	};
+}
@@ -0,0 +1,245 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include "tavernmx/connection.h"
+#include "tavernmx/platform.h"
+#include "tavernmx/ssl.h"
+
+#if defined(TMX_LINUX)
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace tavernmx::testing
+{
+	/**
+     * @brief A freshly generated private key and self-signed certificate for "localhost", so tests can run real
+     * TLS connections without any files checked in.
+     */
+	class TestCertificate
+	{
+	public:
+		TestCertificate() : key{ EVP_EC_gen("P-256") }, cert{ X509_new() } {
+			ASN1_INTEGER_set(X509_get_serialNumber(this->cert), 1);
+			X509_gmtime_adj(X509_getm_notBefore(this->cert), 0);
+			X509_gmtime_adj(X509_getm_notAfter(this->cert), 60 * 60);
+			X509_set_pubkey(this->cert, this->key);
+			X509_NAME* name = X509_get_subject_name(this->cert);
+			X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"),
+				-1, -1, 0);
+			X509_set_issuer_name(this->cert, name);
+			X509_sign(this->cert, this->key, EVP_sha256());
+		}
+
+		~TestCertificate() {
+			X509_free(this->cert);
+			EVP_PKEY_free(this->key);
+		}
+
+		TestCertificate(const TestCertificate&) = delete;
+
+		TestCertificate& operator=(const TestCertificate&) = delete;
+
+		/// Loads the certificate and key into \p ctx.
+		void use_in(SSL_CTX* ctx) const {
+			if (SSL_CTX_use_certificate(ctx, this->cert) != 1 || SSL_CTX_use_PrivateKey(ctx, this->key) != 1) {
+				throw std::runtime_error{ "Unable to load test certificate" };
+			}
+		}
+
+		/// Writes the certificate and key to "certificate.pem" and "private-key.pem" in \p directory.
+		void write_to(const std::filesystem::path& directory) const {
+			FILE* cert_file = std::fopen((directory / "certificate.pem").string().c_str(), "w");
+			FILE* key_file = std::fopen((directory / "private-key.pem").string().c_str(), "w");
+			const bool written = cert_file != nullptr && key_file != nullptr && PEM_write_X509(cert_file, this->cert) == 1 &&
+				PEM_write_PrivateKey(key_file, this->key, nullptr, nullptr, 0, nullptr, nullptr) == 1;
+			if (cert_file != nullptr) {
+				std::fclose(cert_file);
+			}
+			if (key_file != nullptr) {
+				std::fclose(key_file);
+			}
+			if (!written) {
+				throw std::runtime_error{ "Unable to write test certificate" };
+			}
+		}
+
+	private:
+		EVP_PKEY* key{};
+		X509* cert{};
+	};
+
+	/**
+     * @brief Creates a server SSL_CTX with a freshly generated, self-signed certificate.
+     * @return ssl::ssl_unique_ptr<SSL_CTX>
+     */
+	inline ssl::ssl_unique_ptr<SSL_CTX> make_server_context() {
+		ssl::ssl_unique_ptr<SSL_CTX> ctx{ SSL_CTX_new(TLS_method()) };
+		SSL_CTX_set_min_proto_version(ctx.get(), TLS1_2_VERSION);
+		SSL_CTX_set_mode(ctx.get(), SSL_MODE_AUTO_RETRY | ssl::SSL_WRITE_MODES);
+		TestCertificate{}.use_in(ctx.get());
+		return ctx;
+	}
+
+	/**
+     * @brief Creates a client SSL_CTX that accepts any server certificate.
+     * @return ssl::ssl_unique_ptr<SSL_CTX>
+     */
+	inline ssl::ssl_unique_ptr<SSL_CTX> make_client_context() {
+		ssl::ssl_unique_ptr<SSL_CTX> ctx{ SSL_CTX_new(TLS_method()) };
+		SSL_CTX_set_min_proto_version(ctx.get(), TLS1_2_VERSION);
+		SSL_CTX_set_mode(ctx.get(), SSL_MODE_AUTO_RETRY | ssl::SSL_WRITE_MODES);
+		SSL_CTX_set_verify(ctx.get(), SSL_VERIFY_NONE, nullptr);
+		return ctx;
+	}
+
+	/**
+     * @brief Wraps one end of a connected, non-blocking socket in an SSL BIO.
+     * @param fd The socket; the BIO takes ownership of it.
+     * @param ctx SSL_CTX to create the connection from.
+     * @param mode ssl::NEWSSL_SERVER or ssl::NEWSSL_CLIENT.
+     * @return ssl::ssl_unique_ptr<BIO>
+     */
+	inline ssl::ssl_unique_ptr<BIO> make_tls_bio(int32_t fd, SSL_CTX* ctx, long mode) {
+		// as in the server, a peer that has already gone must not kill the process when the other end shuts down
+		std::signal(SIGPIPE, SIG_IGN);
+		return ssl::ssl_unique_ptr<BIO>{ BIO_new_socket(fd, BIO_CLOSE) } |
+			ssl::ssl_unique_ptr<BIO>{ BIO_new_ssl(ctx, mode) };
+	}
+
+	/**
+     * @brief Both ends of a TLS connection over a local socket pair.
+     */
+	struct TlsPair
+	{
+		/// The server's end.
+		ssl::ssl_unique_ptr<BIO> server{};
+		/// The client's end.
+		ssl::ssl_unique_ptr<BIO> client{};
+	};
+
+	/**
+     * @brief Connects a client to a server over a non-blocking socket pair, optionally completing the TLS
+     * handshake on this thread.
+     * @param server_ctx SSL_CTX for the server's end, see make_server_context().
+     * @param client_ctx SSL_CTX for the client's end, see make_client_context().
+     * @param handshake true to complete the handshake before returning.
+     * @return TlsPair
+     */
+	inline TlsPair make_tls_pair(SSL_CTX* server_ctx, SSL_CTX* client_ctx, bool handshake = true) {
+		std::array<int32_t, 2> fds{};
+		if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds.data()) != 0) {
+			throw std::runtime_error{ "socketpair failed" };
+		}
+		TlsPair pair{ .server = make_tls_bio(fds[0], server_ctx, ssl::NEWSSL_SERVER),
+			.client = make_tls_bio(fds[1], client_ctx, ssl::NEWSSL_CLIENT) };
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 5 };
+		bool server_done = !handshake;
+		bool client_done = !handshake;
+		while (!server_done || !client_done) {
+			if (std::chrono::steady_clock::now() > deadline) {
+				throw std::runtime_error{ "TLS handshake timed out" };
+			}
+			server_done = server_done ||
+				ssl::continue_handshake(pair.server.get()) == ssl::HandshakeStatus::Complete;
+			client_done = client_done ||
+				ssl::continue_handshake(pair.client.get()) == ssl::HandshakeStatus::Complete;
+		}
+		return pair;
+	}
+
+	/**
+     * @brief Opens a TCP connection to \p port on 127.0.0.1, without TLS.
+     * @param port TCP port.
+     * @return The non-blocking socket, which the caller owns.
+     */
+	inline int32_t connect_tcp(int32_t port) {
+		const int32_t fd = socket(AF_INET, SOCK_STREAM, 0);
+		sockaddr_in address{ .sin_family = AF_INET, .sin_port = htons(static_cast<uint16_t>(port)), .sin_addr = {},
+			.sin_zero = {} };
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+			if (fd >= 0) {
+				close(fd);
+			}
+			throw std::runtime_error{ "Unable to connect to test server" };
+		}
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		return fd;
+	}
+
+	/**
+     * @brief Connects to a server on \p port of 127.0.0.1 and completes the TLS handshake with it, waiting
+     * for the server's side to run elsewhere.
+     * @param port TCP port.
+     * @param client_ctx SSL_CTX for the client's end, see make_client_context().
+     * @return The client's end of the connection.
+     */
+	inline ssl::ssl_unique_ptr<BIO> connect_tls(int32_t port, SSL_CTX* client_ctx) {
+		ssl::ssl_unique_ptr<BIO> bio = make_tls_bio(connect_tcp(port), client_ctx, ssl::NEWSSL_CLIENT);
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 5 };
+		while (ssl::continue_handshake(bio.get()) != ssl::HandshakeStatus::Complete) {
+			if (std::chrono::steady_clock::now() > deadline) {
+				throw std::runtime_error{ "TLS handshake timed out" };
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+		}
+		return bio;
+	}
+
+	/**
+     * @brief The far end of a connection, played by the test over a BIO it made.
+     */
+	class PeerConnection : public BaseConnection
+	{
+	public:
+		explicit PeerConnection(ssl::ssl_unique_ptr<BIO> connection_bio) { this->bio = std::move(connection_bio); }
+
+		/**
+         * @brief Receives until \p count blocks have arrived, or a second passes.
+         * @return The number of blocks received.
+         */
+		size_t receive_blocks(size_t count) {
+			size_t received = 0;
+			const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 1 };
+			while (received < count && std::chrono::steady_clock::now() < deadline) {
+				received += this->receive_messages().size();
+			}
+			return received;
+		}
+
+		/**
+         * @brief Receives until a message of \p message_type arrives, or \p timeout passes. Anything else
+         * received on the way is discarded.
+         * @return The message, if one arrived.
+         */
+		std::optional<messaging::Message> receive_until(messaging::MessageType message_type,
+			std::chrono::milliseconds timeout = std::chrono::seconds{ 1 }) {
+			const auto deadline = std::chrono::steady_clock::now() + timeout;
+			while (std::chrono::steady_clock::now() < deadline && this->is_connected()) {
+				for (const messaging::MessageBlock& block : this->receive_messages()) {
+					for (messaging::Message& msg : messaging::unpack_messages(block)) {
+						if (msg.message_type == message_type) {
+							return std::move(msg);
+						}
+					}
+				}
+			}
+			return std::nullopt;
+		}
+	};
+}
+#endif